@@ -0,0 +1,273 @@
+#include "checkpoint.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <initializer_list>
+#include <ios>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <type_traits>
+
+namespace {
+
+char const CHECKPOINT_MAGIC[8] = { 's', 'i', 'd', 'i', 's', 'c', 'k', 'p' };
+std::uint32_t const CHECKPOINT_VERSION = 5;
+
+template<typename T>
+std::ostream& write_val(std::ostream& os, T const& val) {
+	static_assert(std::is_trivially_copyable<T>::value, "Type must be trivial.");
+	return os.write(reinterpret_cast<char const*>(&val), sizeof(T));
+}
+template<typename T>
+std::istream& read_val(std::istream& is, T& val) {
+	static_assert(std::is_trivially_copyable<T>::value, "Type must be trivial.");
+	return is.read(reinterpret_cast<char*>(&val), sizeof(T));
+}
+
+std::ostream& write_str(std::ostream& os, std::string const& str) {
+	write_val<std::uint64_t>(os, str.size());
+	return os.write(str.data(), str.size());
+}
+std::istream& read_str(std::istream& is, std::string& str) {
+	std::uint64_t size;
+	if (!read_val(is, size)) {
+		return is;
+	}
+	str.resize(size);
+	return is.read(&str[0], size);
+}
+
+template<typename T>
+std::ostream& write_vec(std::ostream& os, std::vector<T> const& vec) {
+	write_val<std::uint64_t>(os, vec.size());
+	for (T const& val : vec) {
+		write_val(os, val);
+	}
+	return os;
+}
+template<typename T>
+std::istream& read_vec(std::istream& is, std::vector<T>& vec) {
+	std::uint64_t size;
+	if (!read_val(is, size)) {
+		return is;
+	}
+	vec.resize(size);
+	for (T& val : vec) {
+		read_val(is, val);
+	}
+	return is;
+}
+
+// The random number engine is only guaranteed to round-trip through its text
+// representation.
+std::ostream& write_rnd(std::ostream& os, RndEngine const& rnd) {
+	std::ostringstream ss;
+	ss << rnd;
+	return write_str(os, ss.str());
+}
+std::istream& read_rnd(std::istream& is, RndEngine& rnd) {
+	std::string str;
+	if (!read_str(is, str)) {
+		return is;
+	}
+	std::istringstream ss(str);
+	ss >> rnd;
+	if (!ss) {
+		is.setstate(std::ios_base::failbit);
+	}
+	return is;
+}
+
+// Every field is written as stored, so that reading it back gives the same
+// bits. `Stats` keeps its moments as ratios to the maximum weight, which is the
+// form its accessors return.
+std::ostream& write_integ(std::ostream& os, Integrator const& integ) {
+	Stats weights = integ.weights();
+	write_val<Double>(os, integ.prime_inv());
+	write_val<std::uint64_t>(os, integ.count_acc());
+	write_val<Double>(os, weights.ratio_m1_to_max1());
+	write_val<Double>(os, weights.ratio_m2_to_max2());
+	write_val<Double>(os, weights.ratio_m3_to_max3());
+	write_val<Double>(os, weights.ratio_m4_to_max4());
+	write_val<Double>(os, weights.max1());
+	return write_val<std::uint64_t>(os, integ.count());
+}
+std::istream& read_integ(std::istream& is, Integrator& integ) {
+	Double prime_inv;
+	std::uint64_t count_acc;
+	Double mom[4];
+	Double max;
+	std::uint64_t count;
+	read_val(is, prime_inv);
+	read_val(is, count_acc);
+	for (Double& m : mom) {
+		read_val(is, m);
+	}
+	read_val(is, max);
+	if (!read_val(is, count)) {
+		return is;
+	}
+	integ = Integrator(
+		prime_inv,
+		count_acc,
+		Stats({ mom[0], mom[1], mom[2], mom[3] }, max, count));
+	return is;
+}
+
+// The statistics accumulator can't be saved directly, so only flushed
+// accumulators are written. Those are given entirely by their previous totals.
+std::ostream& write_integ_accum(std::ostream& os, IntegratorAccum const& integ) {
+	if (!integ.flushed()) {
+		os.setstate(std::ios_base::failbit);
+		return os;
+	}
+	write_val<Double>(os, integ.prime_inv());
+	return write_integ(os, integ.prev());
+}
+std::istream& read_integ_accum(std::istream& is, IntegratorAccum& integ) {
+	Double prime_inv;
+	Integrator prev;
+	read_val(is, prime_inv);
+	if (!read_integ(is, prev)) {
+		return is;
+	}
+	integ = IntegratorAccum(prime_inv, prev);
+	return is;
+}
+
+std::ostream& write_batch(std::ostream& os, EventBatch const& batch) {
+	write_val(os, batch.event_type);
+	write_vec(os, batch.weight);
+	for (std::vector<Double> const& unit_vec_dim : batch.unit_vec) {
+		write_vec(os, unit_vec_dim);
+	}
+	for (std::vector<Double> const* var : {
+			&batch.x, &batch.y, &batch.z, &batch.ph_t_sq, &batch.phi_h,
+			&batch.phi, &batch.tau, &batch.phi_k, &batch.R }) {
+		write_vec(os, *var);
+	}
+	write_vec(os, batch.sf);
+	return os;
+}
+std::istream& read_batch(std::istream& is, EventBatch& batch) {
+	read_val(is, batch.event_type);
+	read_vec(is, batch.weight);
+	for (std::vector<Double>& unit_vec_dim : batch.unit_vec) {
+		read_vec(is, unit_vec_dim);
+	}
+	for (std::vector<Double>* var : {
+			&batch.x, &batch.y, &batch.z, &batch.ph_t_sq, &batch.phi_h,
+			&batch.phi, &batch.tau, &batch.phi_k, &batch.R }) {
+		read_vec(is, *var);
+		if (var->size() != batch.weight.size()) {
+			is.setstate(std::ios_base::failbit);
+		}
+	}
+	read_vec(is, batch.sf);
+	if (!batch.sf.empty() && batch.sf.size() != batch.weight.size()) {
+		is.setstate(std::ios_base::failbit);
+	}
+	return is;
+}
+
+std::ostream& write_worker(std::ostream& os, WorkerCheckpoint const& worker) {
+	write_rnd(os, worker.rnd);
+	write_val(os, worker.num_events_done);
+	worker.gen_schedule.write(os);
+	std::uint64_t num_gens = worker.integs.size();
+	write_val(os, num_gens);
+	for (std::size_t idx = 0; idx < num_gens; ++idx) {
+		write_integ_accum(os, worker.integs[idx]);
+		write_batch(os, worker.batches[idx]);
+		write_val<std::uint64_t>(os, worker.batch_idxs[idx]);
+		write_val(os, worker.rej_scales[idx]);
+		worker.weight_dists[idx].write(os);
+		write_val(os, worker.num_overflow[idx]);
+	}
+	return os;
+}
+std::istream& read_worker(std::istream& is, WorkerCheckpoint& worker) {
+	read_rnd(is, worker.rnd);
+	read_val(is, worker.num_events_done);
+	worker.gen_schedule.read(is);
+	std::uint64_t num_gens;
+	if (!read_val(is, num_gens)) {
+		return is;
+	}
+	worker.integs.resize(
+		num_gens,
+		IntegratorAccum(std::numeric_limits<Double>::quiet_NaN()));
+	worker.batches.resize(num_gens);
+	worker.batch_idxs.resize(num_gens);
+	worker.rej_scales.resize(num_gens);
+	worker.weight_dists.resize(num_gens);
+	worker.num_overflow.resize(num_gens);
+	for (std::size_t idx = 0; idx < num_gens; ++idx) {
+		std::uint64_t batch_idx;
+		read_integ_accum(is, worker.integs[idx]);
+		read_batch(is, worker.batches[idx]);
+		read_val(is, batch_idx);
+		worker.batch_idxs[idx] = batch_idx;
+		read_val(is, worker.rej_scales[idx]);
+		worker.weight_dists[idx].read(is);
+		read_val(is, worker.num_overflow[idx]);
+	}
+	return is;
+}
+
+}
+
+std::ostream& write_checkpoint(std::ostream& os, Checkpoint const& checkpoint) {
+	os.write(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+	write_val(os, CHECKPOINT_VERSION);
+	write_str(os, checkpoint.params);
+	write_val(os, checkpoint.num_events);
+	write_val<std::uint64_t>(os, checkpoint.workers.size());
+	for (WorkerCheckpoint const& worker : checkpoint.workers) {
+		write_worker(os, worker);
+	}
+	return os;
+}
+
+std::istream& read_checkpoint(std::istream& is, Checkpoint& checkpoint) {
+	char magic[sizeof(CHECKPOINT_MAGIC)];
+	std::uint32_t version;
+	std::uint64_t num_workers;
+	if (!is.read(magic, sizeof(magic))
+			|| !std::equal(magic, magic + sizeof(magic), CHECKPOINT_MAGIC)
+			|| !read_val(is, version)
+			|| version != CHECKPOINT_VERSION) {
+		is.setstate(std::ios_base::failbit);
+		return is;
+	}
+	read_str(is, checkpoint.params);
+	read_val(is, checkpoint.num_events);
+	if (!read_val(is, num_workers)) {
+		return is;
+	}
+	checkpoint.workers.resize(num_workers);
+	for (WorkerCheckpoint& worker : checkpoint.workers) {
+		read_worker(is, worker);
+	}
+	return is;
+}
+
+void write_checkpoint_file(std::string const& file_name, std::string const& data) {
+	std::string file_name_tmp = file_name + ".tmp";
+	{
+		std::ofstream file(file_name_tmp, std::ios_base::binary | std::ios_base::trunc);
+		file.write(data.data(), data.size());
+		file.flush();
+		if (!file) {
+			throw std::runtime_error(
+				"Could not write to file '" + file_name_tmp + "'.");
+		}
+	}
+	if (std::rename(file_name_tmp.c_str(), file_name.c_str()) != 0) {
+		throw std::runtime_error(
+			"Could not replace file '" + file_name + "'.");
+	}
+}
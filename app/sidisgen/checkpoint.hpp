@@ -0,0 +1,49 @@
+#ifndef SIDISGEN_CHECKPOINT_HPP
+#define SIDISGEN_CHECKPOINT_HPP
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "generator.hpp"
+#include "utility.hpp"
+
+// State of a single generation worker, enough to continue drawing exactly the
+// same events as if generation hadn't been interrupted.
+struct WorkerCheckpoint {
+	RndEngine rnd;
+	Long num_events_done;
+	AliasTable gen_schedule;
+	std::vector<IntegratorAccum> integs;
+	std::vector<EventBatch> batches;
+	std::vector<std::size_t> batch_idxs;
+	std::vector<Double> rej_scales;
+	std::vector<QuantileAccum> weight_dists;
+	std::vector<Long> num_overflow;
+};
+
+// Snapshot of a generation run, taken after `num_events` events have been
+// written to the event file.
+struct Checkpoint {
+	// Parameters of the run, in parameter file format.
+	std::string params;
+	Long num_events;
+	std::vector<WorkerCheckpoint> workers;
+};
+
+// Name of the file that holds the latest checkpoint for an event file.
+inline std::string checkpoint_file_name(std::string const& event_file_name) {
+	return event_file_name + ".ckpt";
+}
+
+// Serialization to binary streams.
+std::ostream& write_checkpoint(std::ostream& os, Checkpoint const& checkpoint);
+std::istream& read_checkpoint(std::istream& is, Checkpoint& checkpoint);
+
+// Replaces the checkpoint file with serialized checkpoint data. The file is
+// replaced atomically, so an interruption leaves either the old or the new
+// checkpoint intact.
+void write_checkpoint_file(std::string const& file_name, std::string const& data);
+
+#endif
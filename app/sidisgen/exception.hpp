@@ -26,6 +26,8 @@ int const ERROR_WRITING_EVENTS                = -18;
 int const ERROR_READING_STATS                 = -19;
 int const ERROR_WRITING_STATS                 = -20;
 int const ERROR_UNIMPLEMENTED                 = -21;
+int const ERROR_READING_CHECKPOINT            = -22;
+int const ERROR_WRITING_CHECKPOINT            = -23;
 
 class Exception : public std::exception {
 	std::string const _what;
@@ -0,0 +1,475 @@
+#ifndef SIDISGEN_FOAM_HPP
+#define SIDISGEN_FOAM_HPP
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <queue>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "utility.hpp"
+
+// Parameters for building a `FoamEngine`.
+struct FoamParams {
+	// Maximum number of cells.
+	std::size_t max_cells;
+	// Number of density evaluations used to explore each cell.
+	std::size_t explore_samples;
+	// Number of candidate split positions along each dimension of a cell,
+	// plus one.
+	std::size_t num_bins;
+	// Construction stops early once the estimated relative variance of the
+	// event weights is below this.
+	Double target_rel_var;
+	// Seed for the samples drawn during exploration.
+	std::uint64_t seed;
+};
+
+// Number of cells that are split at once, with their children explored in
+// parallel. This doesn't depend on the number of threads, so that the result
+// doesn't either.
+std::size_t const FOAM_SPLIT_BATCH = 64;
+// Fraction of the cell probability that is spread over all cells in
+// proportion to their volume, so that no cell is left without events.
+Double const FOAM_CELL_MIX = 0.1;
+// When warm starting from an existing engine, each of its cells is first
+// checked with a fraction of the exploration samples. The cell is only explored
+// again if the mean squared density has moved by more than a number of
+// standard errors plus a relative tolerance.
+std::size_t const FOAM_WARM_CHECK_FRACTION = 8;
+std::size_t const FOAM_WARM_MIN_CHECK_SAMPLES = 16;
+Double const FOAM_WARM_SIGMA = 3.;
+Double const FOAM_WARM_TOL = 0.1;
+// If more than this fraction of the cells have changed, the old cells are a
+// poor fit for the new density, so the build starts from scratch instead.
+Double const FOAM_WARM_MAX_CHANGED = 0.5;
+
+// Distribution over the unit hypercube of dimension `D`, following the FOAM
+// algorithm. The hypercube is split into a binary tree of cells, each time
+// dividing the cell that gains the most from being split. Only the leaf cells
+// are kept for drawing events. The cells are drawn with probability
+// proportional to the RMS of the density within them, times their volume.
+// Weights are normalized so that the mean weight of the events, multiplied by
+// the density, is close to one.
+template<std::size_t D>
+class FoamEngine final {
+	// The layouts of `Cell` and `CellExplore` match the binary format, so that
+	// they can be used directly from a memory-mapped generator file.
+	struct Cell {
+		std::array<Double, D> lower;
+		std::array<Double, D> upper;
+	};
+	// Statistics of a cell from exploration, including the best way to split
+	// it.
+	struct CellExplore {
+		Double mean;
+		Double rms;
+		std::uint64_t split_dim;
+		Double split_pos;
+		// By how much splitting reduces the sum over cells of volume times
+		// RMS. The square of that sum is the mean squared weight.
+		Double gain;
+	};
+	static_assert(sizeof(Cell) == 2 * D * sizeof(Double), "Unexpected padding.");
+	static_assert(sizeof(CellExplore) == 5 * sizeof(Double), "Unexpected padding.");
+
+	SharedArray<Cell> _cells;
+	// Kept so that a later build can start from these cells.
+	SharedArray<CellExplore> _explores;
+	SharedArray<Double> _cell_prob;
+	AliasTable _cell_table;
+	// Estimate of the integral of the density.
+	Double _norm;
+	// Weight of a point drawn from each cell. Not serialized, but worked out
+	// whenever the cells change, so that drawing doesn't need the volume.
+	std::vector<Double> _cell_weight;
+
+	void update_cell_weights() {
+		_cell_weight.resize(_cells.size());
+		for (std::size_t idx = 0; idx < _cells.size(); ++idx) {
+			_cell_weight[idx] = volume(_cells[idx]) / (_cell_prob[idx] * _norm);
+		}
+	}
+
+	static Cell unit_cell() {
+		Cell cell;
+		cell.lower.fill(0.);
+		cell.upper.fill(1.);
+		return cell;
+	}
+
+	static Double volume(Cell const& cell) {
+		Double result = 1.;
+		for (std::size_t dim = 0; dim < D; ++dim) {
+			result *= cell.upper[dim] - cell.lower[dim];
+		}
+		return result;
+	}
+
+	// Random number engine for sampling a cell. Every call to `explore` or
+	// `check` during a build uses a different `step` or `idx`.
+	static std::mt19937_64 cell_rnd(
+			FoamParams const& params,
+			std::size_t step,
+			std::size_t idx) {
+		std::seed_seq seq {
+			static_cast<std::uint32_t>(params.seed),
+			static_cast<std::uint32_t>(params.seed >> 32),
+			static_cast<std::uint32_t>(step),
+			static_cast<std::uint32_t>(idx),
+			static_cast<std::uint32_t>(static_cast<std::uint64_t>(idx) >> 32) };
+		return std::mt19937_64(seq);
+	}
+
+	// Samples the density uniformly within a cell, to estimate its integral
+	// and choose a split.
+	template<typename F>
+	static CellExplore explore(
+			F const& density,
+			FoamParams const& params,
+			Cell const& cell,
+			std::size_t step,
+			std::size_t idx) {
+		std::mt19937_64 rnd = cell_rnd(params, step, idx);
+		std::uniform_real_distribution<Double> dist;
+		std::size_t num_bins = params.num_bins;
+		// Histograms of the count and squared density along each dimension.
+		std::vector<std::size_t> hist_count(D * num_bins, 0);
+		std::vector<Double> hist_sq(D * num_bins, 0.);
+		Double sum = 0.;
+		Double sum_sq = 0.;
+		for (std::size_t sample = 0; sample < params.explore_samples; ++sample) {
+			std::array<Double, D> unit;
+			std::array<Double, D> vec;
+			for (std::size_t dim = 0; dim < D; ++dim) {
+				unit[dim] = dist(rnd);
+				vec[dim] = cell.lower[dim] + unit[dim] * (cell.upper[dim] - cell.lower[dim]);
+			}
+			Double value = density(vec);
+			sum += value;
+			sum_sq += value * value;
+			for (std::size_t dim = 0; dim < D; ++dim) {
+				std::size_t bin = std::min(
+					static_cast<std::size_t>(unit[dim] * num_bins),
+					num_bins - 1);
+				hist_count[dim * num_bins + bin] += 1;
+				hist_sq[dim * num_bins + bin] += value * value;
+			}
+		}
+		CellExplore result;
+		Double cell_volume = volume(cell);
+		result.mean = sum / params.explore_samples;
+		result.rms = std::sqrt(sum_sq / params.explore_samples);
+		result.split_dim = 0;
+		result.split_pos = 0.5 * (cell.lower[0] + cell.upper[0]);
+		result.gain = 0.;
+		Double r = cell_volume * result.rms;
+		bool found = false;
+		for (std::size_t dim = 0; dim < D; ++dim) {
+			std::size_t count_left = 0;
+			Double sq_left = 0.;
+			for (std::size_t split = 1; split < num_bins; ++split) {
+				count_left += hist_count[dim * num_bins + split - 1];
+				sq_left += hist_sq[dim * num_bins + split - 1];
+				std::size_t count_right = params.explore_samples - count_left;
+				Double sq_right = sum_sq - sq_left;
+				if (count_left == 0 || count_right == 0) {
+					continue;
+				}
+				Double frac = static_cast<Double>(split) / num_bins;
+				Double r_split = cell_volume * (
+					frac * std::sqrt(sq_left / count_left)
+					+ (1. - frac) * std::sqrt(std::max(sq_right, 0.) / count_right));
+				if (!found || r - r_split > result.gain) {
+					found = true;
+					result.split_dim = dim;
+					result.split_pos = cell.lower[dim]
+						+ frac * (cell.upper[dim] - cell.lower[dim]);
+					result.gain = r - r_split;
+				}
+			}
+		}
+		if (!std::isfinite(result.gain)) {
+			result.gain = 0.;
+		}
+		return result;
+	}
+
+	// Checks with a few samples whether the density within a cell still
+	// matches the statistics from an earlier exploration.
+	template<typename F>
+	static bool changed(
+			F const& density,
+			FoamParams const& params,
+			Cell const& cell,
+			CellExplore const& cell_explore,
+			std::size_t step,
+			std::size_t idx) {
+		std::mt19937_64 rnd = cell_rnd(params, step, idx);
+		std::uniform_real_distribution<Double> dist;
+		std::size_t num_samples = std::max(
+			FOAM_WARM_MIN_CHECK_SAMPLES,
+			params.explore_samples / FOAM_WARM_CHECK_FRACTION);
+		Double sum_sq = 0.;
+		Double sum_sq_sq = 0.;
+		for (std::size_t sample = 0; sample < num_samples; ++sample) {
+			std::array<Double, D> vec;
+			for (std::size_t dim = 0; dim < D; ++dim) {
+				vec[dim] = cell.lower[dim] + dist(rnd) * (cell.upper[dim] - cell.lower[dim]);
+			}
+			Double value = density(vec);
+			sum_sq += value * value;
+			sum_sq_sq += value * value * value * value;
+		}
+		Double mean_sq = sum_sq / num_samples;
+		Double mean_sq_old = cell_explore.rms * cell_explore.rms;
+		Double var_sq = std::max(sum_sq_sq / num_samples - mean_sq * mean_sq, 0.);
+		Double err = std::sqrt(var_sq / num_samples);
+		if (!std::isfinite(mean_sq) || (mean_sq_old == 0. && mean_sq > 0.)) {
+			return true;
+		}
+		return std::abs(mean_sq - mean_sq_old)
+			> FOAM_WARM_SIGMA * err + FOAM_WARM_TOL * mean_sq_old;
+	}
+
+	// Explores the cells at `indices` in parallel.
+	template<typename F>
+	static void explore_cells(
+			F const& density,
+			FoamParams const& params,
+			ThreadShareTask const& threads,
+			std::size_t step,
+			std::vector<std::size_t> const& indices,
+			std::vector<Cell> const& cells,
+			std::vector<CellExplore>* explores) {
+#ifdef _OPENMP
+		int num_threads = threads.num_threads();
+		#pragma omp parallel for num_threads(num_threads) schedule(dynamic)
+#else
+		static_cast<void>(threads);
+#endif
+		for (long idx_idx = 0; idx_idx < static_cast<long>(indices.size()); ++idx_idx) {
+			std::size_t idx = indices[idx_idx];
+			(*explores)[idx] = explore(density, params, cells[idx], step, idx);
+		}
+	}
+
+public:
+	// Constructs a uniform distribution.
+	FoamEngine() :
+			_cells(std::vector<Cell>(1, unit_cell())),
+			_explores(std::vector<CellExplore>(1, CellExplore { 1., 1., 0, 0.5, 0. })),
+			_cell_prob(std::vector<Double>(1, 1.)),
+			_cell_table(std::vector<Double>(1, 1.)),
+			_norm(1.),
+			_cell_weight(1, 1.) { }
+
+	// Splits cells until the cell budget or the target variance is reached,
+	// or until `budget` runs out. Each batch of cells is explored with as many
+	// threads as `threads` gives it at the time. If `start` is provided, its
+	// cells are used as the starting point, and only those in which the
+	// density has changed are explored again.
+	template<typename F>
+	static FoamEngine<D> build(
+			F const& density,
+			FoamParams const& params,
+			ThreadShareTask const& threads=ThreadShareTask(),
+			FoamEngine<D> const* start=nullptr,
+			BuildBudget budget=BuildBudget()) {
+		if (params.max_cells == 0 || params.explore_samples == 0 || params.num_bins < 2) {
+			throw std::runtime_error(
+				"FOAM needs at least one cell, one sample, and two bins.");
+		}
+		// The cells are built up in vectors, and only handed to the engine at
+		// the end.
+		std::vector<Cell> cells(1, unit_cell());
+		std::vector<CellExplore> explores(1);
+		std::size_t step = 0;
+		std::vector<std::size_t> pending;
+		if (start == nullptr) {
+			pending.push_back(0);
+		} else {
+			cells.assign(start->_cells.begin(), start->_cells.end());
+			explores.assign(start->_explores.begin(), start->_explores.end());
+			std::vector<char> cell_changed(cells.size());
+#ifdef _OPENMP
+			int num_threads = threads.num_threads();
+			#pragma omp parallel for num_threads(num_threads) schedule(dynamic)
+#endif
+			for (long idx = 0; idx < static_cast<long>(cells.size()); ++idx) {
+				cell_changed[idx] = changed(
+					density, params, cells[idx], explores[idx], step, idx);
+			}
+			step += 1;
+			budget.add_evals(cells.size() * std::max(
+				FOAM_WARM_MIN_CHECK_SAMPLES,
+				params.explore_samples / FOAM_WARM_CHECK_FRACTION));
+			for (std::size_t idx = 0; idx < cells.size(); ++idx) {
+				if (cell_changed[idx]) {
+					pending.push_back(idx);
+				}
+			}
+			if (pending.size() > FOAM_WARM_MAX_CHANGED * cells.size()) {
+				cells.assign(1, unit_cell());
+				explores.assign(1, CellExplore());
+				pending.assign(1, 0);
+			}
+		}
+		explore_cells(density, params, threads, step, pending, cells, &explores);
+		step += 1;
+		budget.add_evals(pending.size() * params.explore_samples);
+		// Cells waiting to be split, with the best ones first. Ties are broken
+		// by the cell index, so that the order is reproducible.
+		std::priority_queue<std::pair<Double, std::size_t> > queue;
+		Double integ = 0.;
+		Double r_total = 0.;
+		for (std::size_t idx = 0; idx < cells.size(); ++idx) {
+			Double cell_volume = volume(cells[idx]);
+			queue.push(std::make_pair(explores[idx].gain, idx));
+			integ += cell_volume * explores[idx].mean;
+			r_total += cell_volume * explores[idx].rms;
+		}
+		while (cells.size() < params.max_cells && !queue.empty()) {
+			if (integ > 0. && r_total * r_total / (integ * integ) - 1. <= params.target_rel_var) {
+				break;
+			}
+			if (!budget.allows(2 * params.explore_samples)) {
+				break;
+			}
+			// Split a batch of the best cells. The first child replaces the
+			// parent cell, and the second is added to the end.
+			std::size_t max_children = std::min(
+				2 * FOAM_SPLIT_BATCH,
+				budget.remaining_evals() / params.explore_samples);
+			std::vector<std::size_t> children;
+			while (children.size() + 2 <= max_children
+					&& cells.size() < params.max_cells
+					&& !queue.empty()) {
+				std::size_t idx = queue.top().second;
+				queue.pop();
+				CellExplore const parent = explores[idx];
+				if (!(parent.gain > 0.)) {
+					// Nothing left to gain from splitting.
+					queue = std::priority_queue<std::pair<Double, std::size_t> >();
+					break;
+				}
+				Double parent_volume = volume(cells[idx]);
+				integ -= parent_volume * parent.mean;
+				r_total -= parent_volume * parent.rms;
+				Cell cell_right = cells[idx];
+				cells[idx].upper[parent.split_dim] = parent.split_pos;
+				cell_right.lower[parent.split_dim] = parent.split_pos;
+				cells.push_back(cell_right);
+				explores.push_back(CellExplore());
+				children.push_back(idx);
+				children.push_back(cells.size() - 1);
+			}
+			explore_cells(density, params, threads, step, children, cells, &explores);
+			step += 1;
+			budget.add_evals(children.size() * params.explore_samples);
+			for (std::size_t idx : children) {
+				Double cell_volume = volume(cells[idx]);
+				integ += cell_volume * explores[idx].mean;
+				r_total += cell_volume * explores[idx].rms;
+				queue.push(std::make_pair(explores[idx].gain, idx));
+			}
+		}
+		if (!(integ > 0.) || !std::isfinite(integ)) {
+			throw std::runtime_error(
+				"FOAM found no region with positive density.");
+		}
+		// Recompute the totals, to avoid the round-off from updating them.
+		r_total = 0.;
+		Double norm = 0.;
+		for (std::size_t idx = 0; idx < cells.size(); ++idx) {
+			Double cell_volume = volume(cells[idx]);
+			r_total += cell_volume * explores[idx].rms;
+			norm += cell_volume * explores[idx].mean;
+		}
+		std::vector<Double> cell_prob(cells.size());
+		for (std::size_t idx = 0; idx < cells.size(); ++idx) {
+			Double cell_volume = volume(cells[idx]);
+			Double prob = r_total > 0. && std::isfinite(r_total) ?
+				cell_volume * explores[idx].rms / r_total :
+				cell_volume;
+			cell_prob[idx] = (1. - FOAM_CELL_MIX) * prob
+				+ FOAM_CELL_MIX * cell_volume;
+		}
+		FoamEngine<D> engine;
+		engine._cell_table = AliasTable(cell_prob);
+		engine._cells = std::move(cells);
+		engine._explores = std::move(explores);
+		engine._cell_prob = std::move(cell_prob);
+		engine._norm = norm;
+		engine.update_cell_weights();
+		return engine;
+	}
+
+	std::size_t num_cells() const {
+		return _cells.size();
+	}
+
+	// Draws a weighted point from the distribution.
+	template<typename R>
+	void generate(R& rnd, Double* weight, std::array<Double, D>* vec) const {
+		std::size_t idx = _cell_table.draw(rnd);
+		Cell const& cell = _cells[idx];
+		std::uniform_real_distribution<Double> dist;
+		for (std::size_t dim = 0; dim < D; ++dim) {
+			(*vec)[dim] = cell.lower[dim] + dist(rnd) * (cell.upper[dim] - cell.lower[dim]);
+		}
+		*weight = _cell_weight[idx];
+	}
+
+	Double prime() const {
+		return 1. / _norm;
+	}
+
+	// Binary serialization.
+	std::ostream& write(std::ostream& os) const {
+		std::uint64_t num_cells = _cells.size();
+		os.write(reinterpret_cast<char const*>(&num_cells), sizeof(num_cells));
+		os.write(reinterpret_cast<char const*>(&_norm), sizeof(Double));
+		os.write(reinterpret_cast<char const*>(_cells.data()), _cells.size() * sizeof(Cell));
+		os.write(reinterpret_cast<char const*>(_explores.data()), _explores.size() * sizeof(CellExplore));
+		os.write(reinterpret_cast<char const*>(_cell_prob.data()), _cell_prob.size() * sizeof(Double));
+		return _cell_table.write(os);
+	}
+	// Reads the engine without copying the cells, if possible.
+	BinaryView& read(BinaryView& view) {
+		std::uint64_t num_cells;
+		view.read(&num_cells).read(&_norm);
+		if (!view || num_cells == 0) {
+			view.fail();
+			return view;
+		}
+		_cells = view.read_array<Cell>(num_cells);
+		_explores = view.read_array<CellExplore>(num_cells);
+		_cell_prob = view.read_array<Double>(num_cells);
+		if (view) {
+			for (CellExplore const& cell_explore : _explores) {
+				if (cell_explore.split_dim >= D) {
+					view.fail();
+					return view;
+				}
+			}
+		}
+		_cell_table.read(view);
+		if (view && _cell_table.size() != num_cells) {
+			view.fail();
+		}
+		if (view) {
+			update_cell_weights();
+		}
+		return view;
+	}
+};
+
+#endif
+
@@ -0,0 +1,416 @@
+#include "gen_file.hpp"
+
+#include <cstring>
+#include <iomanip>
+#include <ios>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+// Mapped generator files are memory-mapped where POSIX is available.
+// Elsewhere, they are read into memory in full.
+#if defined(__unix__) || defined(__APPLE__)
+#define SIDISGEN_GEN_FILE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define SIDISGEN_GEN_FILE_MMAP 0
+#endif
+
+#include <TArrayC.h>
+
+#include <sidis/extra/event_file.hpp>
+
+namespace {
+
+// Size of the header written by `Dist<D>::write` before the engine data.
+std::uint64_t const DIST_HEADER_SIZE = sizeof(DistType) + sizeof(std::size_t);
+// Size of the header written by `RcTable::write` before the coefficients.
+std::uint64_t const RC_TABLE_HEADER_SIZE = 5 * sizeof(std::uint64_t) + sizeof(Double);
+
+// Name under which the radiative correction table is stored in ROOT generator
+// files.
+std::string const RC_TABLE_ROOT_KEY
+	= std::string(event_type_short_name(EventType::NRAD)) + "_rc_table";
+
+// Read-only memory mapping of a whole file, or a copy of it in memory where
+// mapping isn't available.
+class MappedFile final {
+#if SIDISGEN_GEN_FILE_MMAP
+	void* _data;
+	std::size_t _size;
+
+public:
+	explicit MappedFile(std::string const& file_name) :
+			_data(MAP_FAILED),
+			_size(0) {
+		int fd = ::open(file_name.c_str(), O_RDONLY);
+		if (fd < 0) {
+			throw std::runtime_error("Could not open file '" + file_name + "'.");
+		}
+		struct stat file_stat;
+		if (::fstat(fd, &file_stat) != 0
+				|| static_cast<std::size_t>(file_stat.st_size) < sizeof(GenFileHeader)) {
+			::close(fd);
+			throw std::runtime_error("File '" + file_name + "' is too small.");
+		}
+		_size = static_cast<std::size_t>(file_stat.st_size);
+		_data = ::mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+		// The mapping stays valid after the file is closed.
+		::close(fd);
+		if (_data == MAP_FAILED) {
+			throw std::runtime_error("Could not map file '" + file_name + "'.");
+		}
+	}
+	MappedFile(MappedFile const&) = delete;
+	MappedFile& operator=(MappedFile const&) = delete;
+	~MappedFile() {
+		::munmap(_data, _size);
+	}
+
+	char const* data() const {
+		return static_cast<char const*>(_data);
+	}
+	std::size_t size() const {
+		return _size;
+	}
+#else
+	// Stored as words, so that the data is aligned for arrays.
+	std::vector<std::uint64_t> _data;
+	std::size_t _size;
+
+public:
+	explicit MappedFile(std::string const& file_name) : _size(0) {
+		std::ifstream file(file_name, std::ios_base::in | std::ios_base::binary);
+		if (!file) {
+			throw std::runtime_error("Could not open file '" + file_name + "'.");
+		}
+		file.seekg(0, std::ios_base::end);
+		std::streamoff file_size = file.tellg();
+		file.seekg(0, std::ios_base::beg);
+		if (!file || file_size < static_cast<std::streamoff>(sizeof(GenFileHeader))) {
+			throw std::runtime_error("File '" + file_name + "' is too small.");
+		}
+		_size = static_cast<std::size_t>(file_size);
+		_data.resize((_size + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t));
+		if (!file.read(reinterpret_cast<char*>(_data.data()), _size)) {
+			throw std::runtime_error("Could not read file '" + file_name + "'.");
+		}
+	}
+	MappedFile(MappedFile const&) = delete;
+	MappedFile& operator=(MappedFile const&) = delete;
+
+	char const* data() const {
+		return reinterpret_cast<char const*>(_data.data());
+	}
+	std::size_t size() const {
+		return _size;
+	}
+#endif
+};
+
+// Whether `[offset, offset + size)` lies within a file of `file_size` bytes.
+bool in_file(std::uint64_t offset, std::uint64_t size, std::uint64_t file_size) {
+	return offset <= file_size && size <= file_size - offset;
+}
+
+// Writes a block of data to a ROOT file under `key`, using `write_fn` to write
+// it to a stream. This is a little convoluted:
+// * stringstream -> unique_ptr<char[]> -> TArrayC -> ROOT file
+template<typename F>
+void root_write_block(TFile& file, std::string const& key, F write_fn) {
+	std::stringstream ss;
+	if (!write_fn(ss)) {
+		throw std::runtime_error("Could not write to stream.");
+	}
+	ss.seekg(0, std::ios_base::end);
+	std::streamsize data_len = ss.tellg();
+	ss.seekg(0, std::ios_base::beg);
+	if (!ss) {
+		throw std::runtime_error("Could not get size of stream.");
+	} else if (data_len > std::numeric_limits<Int_t>::max()) {
+		throw std::runtime_error(
+			"Block is too large for a ROOT file, use the 'mapped' generator "
+			"file format instead.");
+	}
+	std::unique_ptr<char[]> data_ptr = std::unique_ptr<char[]>(new char[data_len]);
+	ss.read(&data_ptr[0], data_len);
+	if (!ss || ss.gcount() != data_len) {
+		throw std::runtime_error("Could not copy stream to buffer.");
+	}
+	TArrayC data;
+	data.Adopt(data_len, data_ptr.release());
+	if (file.WriteObject(&data, key.c_str()) == 0) {
+		throw std::runtime_error("Could not write to file.");
+	}
+}
+
+// Reads a block of data written by `root_write_block`. Returns false if there
+// is no block under `key`. The buffer is copied once, so that it is aligned.
+bool root_read_block(TFile& file, std::string const& key, BinaryView* view) {
+	std::unique_ptr<TArrayC> data(file.Get<TArrayC>(key.c_str()));
+	if (data == nullptr) {
+		return false;
+	}
+	*view = BinaryView::copy(data->GetArray(), data->GetSize());
+	return true;
+}
+
+// Writes a section of a mapped generator file using `write_fn`. The section is
+// padded so that the data after the first `header_size` bytes is aligned, and
+// is then written straight to the file, without any intermediate copies.
+template<typename F>
+GenFileSection write_section(
+		std::ofstream& file,
+		std::uint32_t event_type,
+		std::uint32_t kind,
+		std::uint64_t header_size,
+		F write_fn) {
+	std::uint64_t pos = static_cast<std::uint64_t>(file.tellp());
+	std::uint64_t pad = (GEN_FILE_ALIGN - (pos + header_size) % GEN_FILE_ALIGN)
+		% GEN_FILE_ALIGN;
+	char const zeros[GEN_FILE_ALIGN] = { };
+	file.write(zeros, pad);
+	GenFileSection section;
+	section.event_type = event_type;
+	section.kind = kind;
+	section.offset = pos + pad;
+	if (!write_fn(file)) {
+		throw std::runtime_error("Could not write to file.");
+	}
+	section.size = static_cast<std::uint64_t>(file.tellp()) - section.offset;
+	return section;
+}
+
+}
+
+GenFileWriter::GenFileWriter(std::string file_name, GenFileFormat format) :
+		_format(format),
+		_file_name(file_name) {
+	if (_format == GenFileFormat::ROOT) {
+		_root_file.reset(new TFile(file_name.c_str(), "CREATE"));
+		if (_root_file->IsZombie()) {
+			throw std::runtime_error("Could not create file '" + file_name + "'.");
+		}
+		return;
+	}
+	if (!sidis::event_file::host_is_little_endian()) {
+		throw std::runtime_error(
+			"Mapped generator files can only be written on little-endian hosts.");
+	}
+	// Don't overwrite existing files, same as for ROOT files.
+	if (std::ifstream(file_name)) {
+		throw std::runtime_error("File '" + file_name + "' already exists.");
+	}
+	_file.open(file_name, std::ios_base::out | std::ios_base::binary);
+	if (!_file) {
+		throw std::runtime_error("Could not create file '" + file_name + "'.");
+	}
+	// Reserve space for the header, which is filled in at the end. Until then,
+	// the file has no magic number and can't be mistaken for a complete one.
+	GenFileHeader header;
+	std::memset(&header, 0, sizeof(header));
+	_file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+	if (!_file) {
+		throw std::runtime_error("Could not write to file '" + _file_name + "'.");
+	}
+}
+
+void GenFileWriter::write_dist(Generator const& gen) {
+	auto write_fn = [&](std::ostream& os) -> std::ostream& {
+		return Generator::write_dist(os, gen);
+	};
+	if (_format == GenFileFormat::ROOT) {
+		root_write_block(*_root_file, event_type_short_name(gen.event_type()), write_fn);
+		return;
+	}
+	_sections.push_back(write_section(
+		_file,
+		static_cast<std::uint32_t>(gen.event_type()),
+		GEN_FILE_SECTION_DIST,
+		DIST_HEADER_SIZE,
+		write_fn));
+}
+
+void GenFileWriter::write_rc_table(RcTable const& rc_table) {
+	auto write_fn = [&](std::ostream& os) -> std::ostream& {
+		return rc_table.write(os);
+	};
+	if (_format == GenFileFormat::ROOT) {
+		root_write_block(*_root_file, RC_TABLE_ROOT_KEY, write_fn);
+		return;
+	}
+	_sections.push_back(write_section(
+		_file,
+		static_cast<std::uint32_t>(EventType::NRAD),
+		GEN_FILE_SECTION_RC_TABLE,
+		RC_TABLE_HEADER_SIZE,
+		write_fn));
+}
+
+void GenFileWriter::finish(Params const& params) {
+	if (_format == GenFileFormat::ROOT) {
+		params.write_root(*_root_file);
+		_root_file->Close();
+		return;
+	}
+	std::ostringstream params_ss;
+	params_ss << std::setprecision(std::numeric_limits<Double>::max_digits10);
+	params.write_stream(params_ss);
+	std::string params_text = params_ss.str();
+	GenFileHeader header;
+	std::memcpy(header.magic, GEN_FILE_MAGIC, sizeof(GEN_FILE_MAGIC));
+	header.version = GEN_FILE_VERSION;
+	header.num_sections = static_cast<std::uint32_t>(_sections.size());
+	std::uint64_t pos = static_cast<std::uint64_t>(_file.tellp());
+	std::uint64_t pad = (alignof(GenFileSection) - pos % alignof(GenFileSection))
+		% alignof(GenFileSection);
+	char const zeros[alignof(GenFileSection)] = { };
+	_file.write(zeros, pad);
+	header.sections_offset = pos + pad;
+	_file.write(
+		reinterpret_cast<char const*>(_sections.data()),
+		_sections.size() * sizeof(GenFileSection));
+	header.params_offset = header.sections_offset
+		+ _sections.size() * sizeof(GenFileSection);
+	header.params_size = params_text.size();
+	_file.write(params_text.data(), params_text.size());
+	_file.seekp(0);
+	_file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+	_file.close();
+	if (!_file) {
+		throw std::runtime_error("Could not write to file '" + _file_name + "'.");
+	}
+}
+
+GenFileReader::GenFileReader(std::string file_name) :
+		_format(GenFileFormat::ROOT),
+		_file_name(file_name),
+		_data(nullptr),
+		_size(0) {
+	std::memset(&_header, 0, sizeof(_header));
+	char magic[sizeof(GEN_FILE_MAGIC)] = { };
+	std::ifstream file(file_name, std::ios_base::in | std::ios_base::binary);
+	if (!file) {
+		throw std::runtime_error("Could not open file '" + file_name + "'.");
+	}
+	file.read(magic, sizeof(magic));
+	file.close();
+	if (std::memcmp(magic, GEN_FILE_MAGIC, sizeof(GEN_FILE_MAGIC)) != 0) {
+		_root_file.reset(new TFile(file_name.c_str(), "OPEN"));
+		if (_root_file->IsZombie()) {
+			throw std::runtime_error("Could not open file '" + file_name + "'.");
+		}
+		return;
+	}
+	_format = GenFileFormat::MAPPED;
+	if (!sidis::event_file::host_is_little_endian()) {
+		throw std::runtime_error(
+			"Mapped generator files can only be read on little-endian hosts.");
+	}
+	std::shared_ptr<MappedFile> mapped = std::make_shared<MappedFile>(file_name);
+	_data = mapped->data();
+	_size = mapped->size();
+	_mapping = std::move(mapped);
+	std::memcpy(&_header, _data, sizeof(_header));
+	bool valid = _header.version >= 1 && _header.version <= GEN_FILE_VERSION
+		&& _header.sections_offset % alignof(GenFileSection) == 0
+		&& in_file(
+			_header.sections_offset,
+			_header.num_sections * sizeof(GenFileSection),
+			_size)
+		&& in_file(_header.params_offset, _header.params_size, _size);
+	for (std::uint32_t idx = 0; valid && idx < _header.num_sections; ++idx) {
+		GenFileSection section;
+		std::memcpy(
+			&section,
+			_data + _header.sections_offset + idx * sizeof(GenFileSection),
+			sizeof(section));
+		valid = in_file(section.offset, section.size, _size);
+	}
+	if (!valid) {
+		throw std::runtime_error(
+			"Invalid header in generator file '" + file_name + "'.");
+	}
+}
+
+void GenFileReader::read_params(Params& params) {
+	if (_format == GenFileFormat::ROOT) {
+		params.read_root(*_root_file);
+		return;
+	}
+	std::istringstream params_ss(std::string(
+		_data + _header.params_offset,
+		_data + _header.params_offset + _header.params_size));
+	params.read_stream(params_ss);
+}
+
+bool GenFileReader::find_section(
+		std::uint32_t event_type,
+		std::uint32_t kind,
+		GenFileSection* section) const {
+	for (std::uint32_t idx = 0; idx < _header.num_sections; ++idx) {
+		std::memcpy(
+			section,
+			_data + _header.sections_offset + idx * sizeof(GenFileSection),
+			sizeof(GenFileSection));
+		if (section->event_type == event_type && section->kind == kind) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool GenFileReader::read_dist(Generator& gen) {
+	if (_format == GenFileFormat::ROOT) {
+		std::string ev_key = event_type_short_name(gen.event_type());
+		BinaryView view(nullptr, nullptr, 0);
+		if (!root_read_block(*_root_file, ev_key, &view)) {
+			return false;
+		}
+		if (!Generator::read_dist(view, gen)) {
+			throw std::runtime_error("Could not read from buffer.");
+		}
+		return true;
+	}
+	GenFileSection section;
+	if (!find_section(
+			static_cast<std::uint32_t>(gen.event_type()),
+			GEN_FILE_SECTION_DIST,
+			&section)) {
+		return false;
+	}
+	BinaryView view(_mapping, _data + section.offset, section.size);
+	if (!Generator::read_dist(view, gen)) {
+		throw std::runtime_error("Could not read from mapped file.");
+	}
+	return true;
+}
+
+bool GenFileReader::read_rc_table(RcTable& rc_table) {
+	if (_format == GenFileFormat::ROOT) {
+		BinaryView view(nullptr, nullptr, 0);
+		if (!root_read_block(*_root_file, RC_TABLE_ROOT_KEY, &view)) {
+			return false;
+		}
+		if (!rc_table.read(view)) {
+			throw std::runtime_error("Could not read from buffer.");
+		}
+		return true;
+	}
+	GenFileSection section;
+	if (!find_section(
+			static_cast<std::uint32_t>(EventType::NRAD),
+			GEN_FILE_SECTION_RC_TABLE,
+			&section)) {
+		return false;
+	}
+	BinaryView view(_mapping, _data + section.offset, section.size);
+	if (!rc_table.read(view)) {
+		throw std::runtime_error("Could not read from mapped file.");
+	}
+	return true;
+}
+
@@ -0,0 +1,124 @@
+#ifndef SIDISGEN_GEN_FILE_HPP
+#define SIDISGEN_GEN_FILE_HPP
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <TFile.h>
+
+#include "generator.hpp"
+#include "params.hpp"
+#include "rc_table.hpp"
+#include "utility.hpp"
+
+// Generator files hold the generators built during initialization, together
+// with the parameters used to build them. Two formats are supported (see
+// `GenFileFormat`). Mapped generator files are little-endian, and consist of:
+// * The `GenFileHeader`.
+// * One `GenFileSection` for each generator, and for the radiative correction
+//   table if there is one, starting at `sections_offset`.
+// * The serialized distribution of each generator, at the offset given by its
+//   section. The distribution header (type and dimension) is placed so that
+//   the engine data after it starts on a `GEN_FILE_ALIGN` boundary. The same
+//   is done for the coefficients of the radiative correction table.
+// * The parameters used to build the generators, as the text of a parameter
+//   file, starting at `params_offset`.
+
+char const GEN_FILE_MAGIC[8] = { 'S', 'I', 'D', 'I', 'S', 'G', 'E', 'N' };
+// Version 1 files are the same, except that they never have a radiative
+// correction table, so they can still be read.
+std::uint32_t const GEN_FILE_VERSION = 2;
+std::uint64_t const GEN_FILE_ALIGN = 64;
+
+struct GenFileHeader {
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t num_sections;
+	std::uint64_t sections_offset;
+	std::uint64_t params_offset;
+	std::uint64_t params_size;
+};
+static_assert(sizeof(GenFileHeader) == 40, "Unexpected padding.");
+
+// Kinds of sections in mapped generator files.
+std::uint32_t const GEN_FILE_SECTION_DIST = 0;
+std::uint32_t const GEN_FILE_SECTION_RC_TABLE = 1;
+
+struct GenFileSection {
+	// Value of `EventType`.
+	std::uint32_t event_type;
+	// One of the `GEN_FILE_SECTION_*` kinds.
+	std::uint32_t kind;
+	std::uint64_t offset;
+	std::uint64_t size;
+};
+static_assert(sizeof(GenFileSection) == 24, "Unexpected padding.");
+
+// Writes generators to a new generator file. The file is only complete once
+// `finish` has been called.
+class GenFileWriter final {
+	GenFileFormat _format;
+	std::string _file_name;
+	std::unique_ptr<TFile> _root_file;
+	std::ofstream _file;
+	std::vector<GenFileSection> _sections;
+
+public:
+	// Gives an error instead of overwriting an existing file.
+	GenFileWriter(std::string file_name, GenFileFormat format);
+	GenFileWriter(GenFileWriter const&) = delete;
+	GenFileWriter& operator=(GenFileWriter const&) = delete;
+
+	void write_dist(Generator const& gen);
+	// Writes the table of the exact radiative correction for non-radiative
+	// events.
+	void write_rc_table(RcTable const& rc_table);
+	// Writes the parameters, and finishes the file.
+	void finish(Params const& params);
+};
+
+// Reads generators from a generator file of either format. Mapped generator
+// files are memory-mapped (or read into memory in full, where mapping isn't
+// available), and the generators read from them refer to the mapping directly. The mapping stays alive for as long as any such generator
+// does, even after the reader is gone.
+class GenFileReader final {
+	GenFileFormat _format;
+	std::string _file_name;
+	std::unique_ptr<TFile> _root_file;
+	// Keeps the mapping alive.
+	std::shared_ptr<void const> _mapping;
+	char const* _data;
+	std::size_t _size;
+	GenFileHeader _header;
+
+	// Finds the section of a mapped generator file with the given event type
+	// and kind.
+	bool find_section(
+		std::uint32_t event_type,
+		std::uint32_t kind,
+		GenFileSection* section) const;
+
+public:
+	explicit GenFileReader(std::string file_name);
+	GenFileReader(GenFileReader const&) = delete;
+	GenFileReader& operator=(GenFileReader const&) = delete;
+
+	GenFileFormat format() const {
+		return _format;
+	}
+
+	void read_params(Params& params);
+	// Reads the distribution for the event type of `gen`. Returns false if
+	// the file has no generator for that event type.
+	bool read_dist(Generator& gen);
+	// Reads the table of the exact radiative correction for non-radiative
+	// events. Returns false if the file has no such table. As with the
+	// distributions, the table may refer to the mapping directly.
+	bool read_rc_table(RcTable& rc_table);
+};
+
+#endif
+
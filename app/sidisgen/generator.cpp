@@ -2,13 +2,21 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <initializer_list>
 #include <limits>
+#include <random>
 #include <stdexcept>
 #include <string>
 #include <type_traits>
 #include <utility>
 
+#include <sidis/extra/math.hpp>
+#include <sidis/extra/map.hpp>
+
 #include "params_format.hpp"
+#include "perf.hpp"
+#include "rc_table.hpp"
 
 using namespace sidis;
 
@@ -54,21 +62,216 @@ cut::CutRad cut_rad_from_params(Params& params) {
 	return result;
 }
 
+xs::Context context_from_params(Params& params, sf::SfSet const& sf) {
+	part::Particles ps(
+		params["setup.target"].any(),
+		params["setup.beam"].any(),
+		params["setup.hadron"].any(),
+		params["phys.mass_threshold"].any());
+	Double S = 2. * mass(ps.target) * params["setup.beam_energy"].any().as<Double>();
+	return xs::Context(
+		ps, S, sf,
+		params["setup.beam_pol"].any(),
+		params["setup.target_pol"].any());
+}
+
+Double apply_var_map(VarMap const& var_map, Double p, math::Bound bound, Double* jac) {
+	switch (var_map.type) {
+	case VarMapType::LINEAR:
+		return math::apply_map(math::map::Linear(), p, bound, jac);
+	case VarMapType::INVERSE:
+		return math::apply_map(math::map::Inverse(var_map.scale), p, bound, jac);
+	case VarMapType::LOG:
+		return math::apply_map(math::map::Log(var_map.scale), p, bound, jac);
+	case VarMapType::DECAY:
+		return math::apply_map(math::map::Decay(var_map.scale), p, bound, jac);
+	default:
+		UNREACHABLE();
+	}
+}
+
+// Same as `cut::take`, but with the transformations given by `maps`. A
+// transformation that doesn't suit the range of its variable (e.x. a
+// logarithm reaching zero) gives a non-finite Jacobian, and the point is
+// rejected.
+bool take_mapped(
+		cut::Cut const& cut, NradMaps const& maps,
+		part::Particles const& ps, Double S, Double const point[6],
+		kin::PhaseSpace* ph_space, Double* jacobian) {
+	Double jac_x, jac_y, jac_z, jac_ph_t_sq, jac_phi_h, jac_phi;
+	Double x = apply_var_map(maps.x, point[0], cut::x_bound(cut, ps, S), &jac_x);
+	Double y = apply_var_map(maps.y, point[1], cut::y_bound(cut, ps, S, x), &jac_y);
+	Double z = apply_var_map(maps.z, point[2], cut::z_bound(cut, ps, S, x, y), &jac_z);
+	Double ph_t_sq = apply_var_map(
+		maps.ph_t_sq, point[3], cut::ph_t_sq_bound(cut, ps, S, x, y, z), &jac_ph_t_sq);
+	Double phi_h = math::apply_map(
+		math::map::Linear(), point[4],
+		cut.phi_h.valid() ? cut.phi_h : math::Bound(-PI, PI), &jac_phi_h);
+	Double phi = math::apply_map(
+		math::map::Linear(), point[5],
+		cut.phi.valid() ? cut.phi : math::Bound(-PI, PI), &jac_phi);
+	*ph_space = kin::PhaseSpace { x, y, z, ph_t_sq, phi_h, phi };
+	*jacobian = jac_x * jac_y * jac_z * jac_ph_t_sq * jac_phi_h * jac_phi;
+	return std::isfinite(*jacobian);
+}
+
+// Same as `cut::take`, but split into steps so that the construction of the
+// kinematics can be timed separately from the rest when profiling.
+bool take_timed(
+		cut::Cut const& cut, NradMaps const& maps,
+		part::Particles const& ps, Double S, Double const point[6],
+		kin::Kinematics* kin, Double* jacobian) {
+	kin::PhaseSpace ph_space;
+	bool taken;
+	{
+		PerfTimer timer(PerfPart::TAKE);
+		if (maps.standard()) {
+			taken = cut::take(cut, ps, S, point, &ph_space, jacobian);
+		} else {
+			taken = take_mapped(cut, maps, ps, S, point, &ph_space, jacobian);
+		}
+	}
+	if (taken) {
+		PerfTimer timer(PerfPart::KINEMATICS);
+		*kin = kin::Kinematics(ps, S, ph_space);
+	}
+	PerfTimer timer(PerfPart::TAKE);
+	return taken && cut::valid(cut, *kin);
+}
+
+bool take_timed(
+		cut::Cut const& cut, cut::CutRad const& cut_rad, NradMaps const& maps,
+		part::Particles const& ps, Double S, Double const point[9],
+		kin::KinematicsRad* kin_rad, Double* jacobian) {
+	kin::Kinematics kin;
+	Double jacobian_nrad;
+	if (!take_timed(cut, maps, ps, S, point, &kin, &jacobian_nrad)) {
+		return false;
+	}
+	kin::PhaseSpaceRad ph_space;
+	bool taken;
+	{
+		PerfTimer timer(PerfPart::TAKE);
+		taken = cut::take(cut_rad, kin, point + 6, &ph_space, jacobian);
+	}
+	if (taken) {
+		PerfTimer timer(PerfPart::KINEMATICS);
+		*kin_rad = kin::KinematicsRad(kin, ph_space.tau, ph_space.phi_k, ph_space.R);
+		*jacobian *= jacobian_nrad;
+	}
+	PerfTimer timer(PerfPart::TAKE);
+	return taken && cut::valid(cut_rad, *kin_rad);
+}
+
+// Smallest weight that optimization gives to a radiative channel, so that no
+// channel is ever dropped entirely.
+Double const RAD_CHANNEL_MIN_WEIGHT = 0.02;
+
+// The `tau` mappings of the radiative channels (see `RAD_NUM_CHANNELS`) for a
+// particular non-radiative kinematics. The peaks are the same as those used by
+// `cut::take`.
+class RadChannelMaps {
+	math::Bound _bound;
+	math::map::Sigmoid2 _standard;
+	math::map::Sigmoid _p_peak;
+	math::map::Sigmoid _s_peak;
+	RadChannelWeights _u_size;
+
+public:
+	RadChannelMaps(cut::CutRad const& cut_rad, kin::Kinematics const& kin) {
+		Double tau_p1 = kin.Q_sq / kin.X;
+		Double tau_pr = -(1. - kin.y);
+		Double tau_lim1 = SQRT_2 * kin.lambda_1_sqrt * kin.m / math::sq(kin.X);
+		Double tau_limr = math::sq(1. - kin.y);
+		_bound = cut::tau_bound(cut_rad, kin);
+		_standard = math::map::Sigmoid2(tau_p1, tau_lim1, tau_pr, tau_limr);
+		_p_peak = math::map::Sigmoid(tau_p1, tau_lim1);
+		_s_peak = math::map::Sigmoid(tau_p1 * tau_pr, tau_lim1 * tau_limr);
+		_u_size = {
+			_standard.u(_bound.max()) - _standard.u(_bound.min()),
+			_p_peak.u(_bound.max()) - _p_peak.u(_bound.min()),
+			_s_peak.u(_bound.max()) - _s_peak.u(_bound.min()),
+		};
+	}
+
+	// Maps `p` in the range `[0, 1)` onto `tau` using one of the channels.
+	Double take(std::size_t channel, Double p) const {
+		Double jac;
+		switch (channel) {
+		case 0:
+			return math::apply_map(_standard, p, _bound, &jac);
+		case 1:
+			return math::apply_map(_p_peak, p, _bound, &jac);
+		case 2:
+			return math::apply_map(_s_peak, p, _bound, &jac);
+		default:
+			UNREACHABLE();
+		}
+	}
+
+	// Probability density of `tau` within each of the channels. Each mapping is
+	// an `arcsinh`, so the densities are known in closed form.
+	RadChannelWeights density(Double tau) const {
+		Double du_standard = 1. / std::hypot(_standard.width, tau - _standard.center)
+			+ 1. / std::hypot(
+				_standard.width * _standard.width_r,
+				tau - _standard.center * _standard.center_r);
+		Double du_p_peak = 1. / std::hypot(_p_peak.width, tau - _p_peak.center);
+		Double du_s_peak = 1. / std::hypot(_s_peak.width, tau - _s_peak.center);
+		return {
+			du_standard / _u_size[0],
+			du_p_peak / _u_size[1],
+			du_s_peak / _u_size[2],
+		};
+	}
+};
+
+// Some kinematic regions will be out of range for the structure functions, so
+// the density is zero in those cases. When profiling, the reason is recorded.
+// TODO: Find a way of notifying when situations like this occur.
+bool xs_valid(Double xs) {
+	if (!std::isfinite(xs)) {
+		if (perf_enabled) {
+			perf_counters.num_zero_nan += 1;
+		}
+		return false;
+	} else if (!(xs >= 0.)) {
+		if (perf_enabled) {
+			perf_counters.num_zero_neg += 1;
+		}
+		return false;
+	} else {
+		return true;
+	}
+}
+
+}
+
+NradMaps::NradMaps(Params& params, EventType ev_type) :
+		x(params[p_name_map(ev_type, "x")].any().as<VarMap>()),
+		y(params[p_name_map(ev_type, "y")].any().as<VarMap>()),
+		z(params[p_name_map(ev_type, "z")].any().as<VarMap>()),
+		ph_t_sq(params[p_name_map(ev_type, "ph_t_sq")].any().as<VarMap>()) { }
+
+bool NradMaps::standard() const {
+	// Must match the transformations in `cut::take`.
+	return x == VarMap(VarMapType::INVERSE, 1e-3)
+		&& y == VarMap(VarMapType::INVERSE, 0.)
+		&& z == VarMap(VarMapType::LINEAR)
+		&& ph_t_sq == VarMap(VarMapType::DECAY, 0.25);
 }
 
 NradDensity::NradDensity(Params& params, sf::SfSet const& sf) :
 		_cut(cut_from_params(params)),
-		_sf(sf),
+		_maps(params, EventType::NRAD),
+		_ctx(context_from_params(params, sf)),
 		_rc_method(params["phys.rc_method"].any()),
 		_soft_threshold(params["phys.soft_threshold"].any()),
-		_ps(
-			params["setup.target"].any(),
-			params["setup.beam"].any(),
-			params["setup.hadron"].any(),
-			params["phys.mass_threshold"].any()),
-		_S(2. * mass(_ps.target) * params["setup.beam_energy"].any().as<Double>()),
-		_beam_pol(params["setup.beam_pol"].any()),
-		_target_pol(params["setup.target_pol"].any()) {
+		_xs(
+			_rc_method == RcMethod::NONE ? xs::Kind::BORN : xs::Kind::NRAD_IR,
+			_ctx,
+			_soft_threshold),
+		_rc_table(nullptr) {
 	if (_rc_method == RcMethod::APPROX || _rc_method == RcMethod::EXACT) {
 		// Validate that if there is a `k_0_bar` cut, that its range completely
 		// encompasses the non-radiative part from 0 to the soft threshold.
@@ -98,18 +301,30 @@ Double NradDensity::transform(
 		Point<6> const& unit_vec,
 		kin::Kinematics* kin) const noexcept {
 	Double jacobian;
-	if (!cut::take(_cut, _ps, _S, unit_vec.data(), kin, &jacobian)) {
+	if (!take_timed(_cut, _maps, _ctx.particles(), _ctx.S(), unit_vec.data(), kin, &jacobian)) {
 		jacobian = 0.;
 	}
 	return jacobian;
 }
 
-Double NradDensity::eval(Point<6> const& unit_vec, kin::Kinematics* kin) const noexcept {
+Double NradDensity::eval(
+		Point<6> const& unit_vec,
+		kin::Kinematics* kin,
+		sf::SfLP* sf) const noexcept {
+	if (perf_enabled) {
+		perf_counters.num_evals += 1;
+	}
 	Double jacobian;
-	if (!cut::take(_cut, _ps, _S, unit_vec.data(), kin, &jacobian)) {
+	if (!take_timed(_cut, _maps, _ctx.particles(), _ctx.S(), unit_vec.data(), kin, &jacobian)) {
+		if (perf_enabled) {
+			perf_counters.num_zero_cut += 1;
+		}
 		return 0.;
 	}
-	math::Vec3 eta = frame::hadron_from_target(*kin) * _target_pol;
+	PerfTimer timer(PerfPart::XS);
+	if (sf != nullptr) {
+		*sf = _ctx.sf().sf_lp(kin->hadron, kin->x, kin->z, kin->Q_sq, kin->ph_t_sq);
+	}
 	// TODO: Evaluate when it is a good approximation to say that
 	// `nrad ~ nrad_ir`. This happens because for small `k_0_bar`, the
 	// contribution of `rad_f` integrated up to `k_0_bar` becomes vanishingly
@@ -119,24 +334,127 @@ Double NradDensity::eval(Point<6> const& unit_vec, kin::Kinematics* kin) const n
 	Double xs;
 	switch (_rc_method) {
 	case RcMethod::NONE:
-		xs = xs::born(*kin, _sf, _beam_pol, eta);
-		break;
 	case RcMethod::APPROX:
-		xs = xs::nrad_ir(*kin, _sf, _beam_pol, eta, _soft_threshold);
+		xs = sf != nullptr ?
+			_xs.eval(*kin, _ctx.phenom(*kin), *sf) :
+			_xs.eval(*kin, _ctx);
 		break;
 	case RcMethod::EXACT:
-		xs = xs::nrad_integ(*kin, _sf, _beam_pol, eta, _soft_threshold).val;
+		if (_rc_table != nullptr) {
+			xs = sf != nullptr ?
+				_xs.eval(*kin, _ctx.phenom(*kin), *sf) :
+				_xs.eval(*kin, _ctx);
+			xs *= 1. + _rc_table->eval(unit_vec.data(), kin->phi_h, kin->phi);
+		} else {
+			xs = sf != nullptr ?
+				xs::nrad_integ(*kin, _ctx, *sf, _soft_threshold).val :
+				xs::nrad_integ(*kin, _ctx, _soft_threshold).val;
+		}
 		break;
 	default:
 		UNREACHABLE();
 	}
-	// Some kinematic regions will be out of range for the structure functions,
-	// so return 0 in those cases.
-	// TODO: Find a way of notifying when situations like this occur.
-	if (!std::isfinite(xs) || !(xs >= 0.)) {
-		return 0.;
-	} else {
-		return jacobian * xs;
+	return xs_valid(xs) ? jacobian * xs : 0.;
+}
+
+void NradDensity::eval_batch(EventBatch& batch, bool with_sf) const {
+	std::size_t n = batch.size();
+	bool batched = !with_sf
+		&& _ctx.target_pol() == math::VEC3_ZERO
+		&& (_rc_method != RcMethod::EXACT || _rc_table != nullptr);
+	if (!batched) {
+		kin::Kinematics kin;
+		for (std::size_t idx = 0; idx < n; ++idx) {
+			Point<6> vec;
+			for (std::size_t dim = 0; dim < 6; ++dim) {
+				vec[dim] = batch.unit_vec[dim][idx];
+			}
+			batch.weight[idx] *= eval(
+				vec, &kin, with_sf ? &batch.sf[idx] : nullptr);
+			// The kinematics aren't filled in if the point is outside of the
+			// cuts.
+			if (batch.weight[idx] != 0.) {
+				batch.x[idx] = kin.x;
+				batch.y[idx] = kin.y;
+				batch.z[idx] = kin.z;
+				batch.ph_t_sq[idx] = kin.ph_t_sq;
+				batch.phi_h[idx] = kin.phi_h;
+				batch.phi[idx] = kin.phi;
+			}
+		}
+		return;
+	}
+
+	// Map every point into phase space first, keeping those within the cuts.
+	EventBatch::Scratch& scratch = batch.scratch;
+	scratch.idxs.clear();
+	scratch.ph_spaces.clear();
+	scratch.jacobians.clear();
+	scratch.rc_factors.clear();
+	kin::Kinematics kin;
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		Point<6> vec;
+		for (std::size_t dim = 0; dim < 6; ++dim) {
+			vec[dim] = batch.unit_vec[dim][idx];
+		}
+		if (perf_enabled) {
+			perf_counters.num_evals += 1;
+		}
+		Double jacobian;
+		if (!take_timed(_cut, _maps, _ctx.particles(), _ctx.S(), vec.data(), &kin, &jacobian)) {
+			if (perf_enabled) {
+				perf_counters.num_zero_cut += 1;
+			}
+			batch.weight[idx] = 0.;
+			continue;
+		}
+		scratch.idxs.push_back(idx);
+		scratch.ph_spaces.push_back({
+			kin.x, kin.y, kin.z, kin.ph_t_sq, kin.phi_h, kin.phi });
+		scratch.jacobians.push_back(jacobian);
+		if (_rc_method == RcMethod::EXACT) {
+			scratch.rc_factors.push_back(
+				1. + _rc_table->eval(vec.data(), kin.phi_h, kin.phi));
+		}
+	}
+	if (scratch.idxs.empty()) {
+		return;
+	}
+
+	// Then evaluate the cross-section over all of them at once.
+	kin::KinematicsBatch kin_batch;
+	{
+		PerfTimer timer(PerfPart::KINEMATICS);
+		kin_batch = kin::KinematicsBatch(
+			_ctx.particles(), _ctx.S(), scratch.ph_spaces);
+	}
+	scratch.xs.resize(scratch.idxs.size());
+	{
+		PerfTimer timer(PerfPart::XS);
+		if (_rc_method == RcMethod::NONE) {
+			xs::born_batch(kin_batch, _ctx, scratch.xs_buf, scratch.xs.data());
+		} else {
+			xs::nrad_ir_batch(
+				kin_batch, _ctx, scratch.xs_buf, scratch.xs.data(),
+				_soft_threshold);
+		}
+	}
+	for (std::size_t batch_idx = 0; batch_idx < scratch.idxs.size(); ++batch_idx) {
+		std::size_t idx = scratch.idxs[batch_idx];
+		Double xs = scratch.xs[batch_idx];
+		if (_rc_method == RcMethod::EXACT) {
+			xs *= scratch.rc_factors[batch_idx];
+		}
+		batch.weight[idx] *= xs_valid(xs) ? scratch.jacobians[batch_idx] * xs : 0.;
+		if (batch.weight[idx] != 0.) {
+			kin::PhaseSpace const& ph_space = scratch.ph_spaces[batch_idx];
+			batch.x[idx] = ph_space.x;
+			batch.y[idx] = ph_space.y;
+			batch.z[idx] = ph_space.z;
+			batch.ph_t_sq[idx] = ph_space.ph_t_sq;
+			batch.phi_h[idx] = ph_space.phi_h;
+			batch.phi[idx] = ph_space.phi;
+		}
 	}
 }
 
@@ -145,20 +463,40 @@ Double NradDensity::eval(Point<6> const& unit_vec) const noexcept {
 	return eval(unit_vec, &kin);
 }
 
+Double NradDensity::rc_ratio(
+		Point<4> const& unit_vec,
+		Double phi_h,
+		Double phi,
+		Double* density_ir) const noexcept {
+	Point<6> unit_vec_nrad = {{
+		unit_vec[0], unit_vec[1], unit_vec[2], unit_vec[3], 0.5, 0.5 }};
+	kin::Kinematics kin;
+	Double jacobian = transform(unit_vec_nrad, &kin);
+	if (!(jacobian > 0.)) {
+		if (density_ir != nullptr) {
+			*density_ir = 0.;
+		}
+		return std::numeric_limits<Double>::quiet_NaN();
+	}
+	kin::PhaseSpace ph_space { kin.x, kin.y, kin.z, kin.ph_t_sq, phi_h, phi };
+	kin::Kinematics kin_phi(_ctx.particles(), _ctx.S(), ph_space);
+	Double xs_nrad_ir = xs::nrad_ir(kin_phi, _ctx, _soft_threshold);
+	Double xs_rad_f = xs::rad_f_integ(kin_phi, _ctx, _soft_threshold).val;
+	if (density_ir != nullptr) {
+		*density_ir = jacobian * xs_nrad_ir;
+	}
+	return xs_rad_f / xs_nrad_ir;
+}
+
 RadDensity::RadDensity(Params& params, sf::SfSet const& sf) :
 		_cut(cut_from_params(params)),
+		_maps(params, EventType::RAD),
 		_cut_rad(cut_rad_from_params(params)),
-		_sf(sf),
+		_ctx(context_from_params(params, sf)),
 		_rc_method(params["phys.rc_method"].any()),
 		_soft_threshold(params["phys.soft_threshold"].any()),
-		_ps(
-			params["setup.target"].any(),
-			params["setup.beam"].any(),
-			params["setup.hadron"].any(),
-			params["phys.mass_threshold"].any()),
-		_S(2. * mass(_ps.target) * params["setup.beam_energy"].any().as<Double>()),
-		_beam_pol(params["setup.beam_pol"].any()),
-		_target_pol(params["setup.target_pol"].any()) {
+		_xs(xs::Kind::RAD, _ctx),
+		_channels(params["mc.rad.init.channels"].any()) {
 	if (_rc_method == RcMethod::NONE) {
 		throw std::runtime_error(
 			"Cannot enable radiative events while parameter 'phys.rc_method' "
@@ -171,31 +509,205 @@ RadDensity::RadDensity(Params& params, sf::SfSet const& sf) :
 			"Parameter 'cut.k_0_bar' does not encompass any of the radiative "
 			"range above 'phys.soft_threshold'.");
 	}
+	// Without explicit weights, the channels start out equally weighted.
+	_channel_weights.fill(1. / RAD_NUM_CHANNELS);
+	if (_channels && params.is_set("mc.rad.init.channel_weights")) {
+		math::Vec3 weights = params["mc.rad.init.channel_weights"].any();
+		set_channel_weights({ weights.x, weights.y, weights.z });
+	}
+}
+
+void RadDensity::set_channel_weights(RadChannelWeights const& weights) {
+	Double norm = 0.;
+	for (Double weight : weights) {
+		if (!(weight >= 0.) || !std::isfinite(weight)) {
+			throw std::runtime_error("Radiative channel weights must be non-negative.");
+		}
+		norm += weight;
+	}
+	if (!(norm > 0.)) {
+		throw std::runtime_error("Radiative channel weights must not all be zero.");
+	}
+	for (std::size_t channel = 0; channel < RAD_NUM_CHANNELS; ++channel) {
+		_channel_weights[channel] = weights[channel] / norm;
+	}
+}
+
+// Same as `take_timed`, but `tau` is sampled from the channels. The first
+// radiative coordinate chooses the channel, and is then rescaled back onto the
+// unit interval for the mapping of that channel. The Jacobian for `tau` comes
+// from the density summed over all channels, so that any `tau` is weighted the
+// same no matter which channel produced it. If `channel_density` is provided,
+// the ratio of the density of each channel to the summed density is stored in
+// it.
+bool RadDensity::take(
+		RadChannelWeights const& weights,
+		Point<9> const& unit_vec,
+		kin::KinematicsRad* kin_rad,
+		Double* jacobian,
+		RadChannelWeights* channel_density) const noexcept {
+	if (!_channels) {
+		return take_timed(_cut, _cut_rad, _maps, _ctx.particles(), _ctx.S(), unit_vec.data(), kin_rad, jacobian);
+	}
+	kin::Kinematics kin;
+	Double jacobian_nrad;
+	if (!take_timed(_cut, _maps, _ctx.particles(), _ctx.S(), unit_vec.data(), &kin, &jacobian_nrad)) {
+		return false;
+	}
+	Double tau, phi_k, R;
+	{
+		PerfTimer timer(PerfPart::TAKE);
+		Double p = unit_vec[6];
+		std::size_t channel = 0;
+		for (; channel + 1 < RAD_NUM_CHANNELS; ++channel) {
+			if (p < weights[channel]) {
+				break;
+			}
+			p -= weights[channel];
+		}
+		// Rounding can leave `p` in a trailing channel with no weight.
+		if (!(weights[channel] > 0.)) {
+			return false;
+		}
+		RadChannelMaps maps(_cut_rad, kin);
+		tau = maps.take(channel, std::min(p / weights[channel], 1.));
+		RadChannelWeights density = maps.density(tau);
+		Double density_sum = 0.;
+		for (std::size_t idx = 0; idx < RAD_NUM_CHANNELS; ++idx) {
+			density_sum += weights[idx] * density[idx];
+		}
+		if (!(density_sum > 0.) || !std::isfinite(density_sum)) {
+			return false;
+		}
+		if (channel_density != nullptr) {
+			for (std::size_t idx = 0; idx < RAD_NUM_CHANNELS; ++idx) {
+				(*channel_density)[idx] = density[idx] / density_sum;
+			}
+		}
+		// The `phi_k` and `R` mappings are the same as for `cut::take`. The `R`
+		// mapping already follows the `1 / R` behaviour near the peaks.
+		Double phi_k_lim = kin.lambda_Y_sqrt / kin.lambda_1_sqrt / SQRT_2 * kin.m;
+		Double R_trans = (kin.mx_sq - math::sq(kin.Mth))
+			/ (1. + kin.S_x / math::sq(kin.M) - kin.ph_l / kin.M) / 128.;
+		Double jac_phi_k, jac_R;
+		phi_k = math::apply_map(
+			math::map::Sigmoid(0., phi_k_lim),
+			unit_vec[7],
+			_cut_rad.phi_k.valid() ? _cut_rad.phi_k : math::Bound(-PI, PI),
+			&jac_phi_k);
+		R = math::apply_map(
+			math::map::Log(R_trans),
+			unit_vec[8], cut::R_bound(_cut_rad, kin, tau, phi_k), &jac_R);
+		*jacobian = jacobian_nrad * jac_phi_k * jac_R / density_sum;
+	}
+	{
+		PerfTimer timer(PerfPart::KINEMATICS);
+		*kin_rad = kin::KinematicsRad(kin, tau, phi_k, R);
+	}
+	PerfTimer timer(PerfPart::TAKE);
+	return cut::valid(_cut_rad, *kin_rad);
+}
+
+Double RadDensity::xs(kin::KinematicsRad const& kin_rad) const noexcept {
+	return _xs.eval(kin_rad, _ctx);
+}
+
+RadChannelWeights RadDensity::optimize_channel_weights(
+		std::size_t samples,
+		std::size_t iters,
+		std::uint64_t seed) const {
+	RadChannelWeights weights = _channel_weights;
+	if (!_channels) {
+		return weights;
+	}
+	RndEngine rnd(seed);
+	std::uniform_real_distribution<Double> dist;
+	// Estimates the second moment of the density when drawing with `weights`,
+	// together with the contribution to it from each channel, and the second
+	// moment that the standard channel would have on its own.
+	RadChannelWeights moments;
+	Double moment;
+	Double moment_standard;
+	auto estimate = [&]() {
+		moments.fill(0.);
+		moment = 0.;
+		moment_standard = 0.;
+		for (std::size_t sample = 0; sample < samples; ++sample) {
+			Point<9> unit_vec;
+			for (Double& coord : unit_vec) {
+				coord = dist(rnd);
+			}
+			kin::KinematicsRad kin_rad;
+			Double jacobian;
+			RadChannelWeights channel_density;
+			if (!take(weights, unit_vec, &kin_rad, &jacobian, &channel_density)) {
+				continue;
+			}
+			Double value = jacobian * xs(kin_rad);
+			if (!std::isfinite(value) || !(value > 0.)) {
+				continue;
+			}
+			for (std::size_t channel = 0; channel < RAD_NUM_CHANNELS; ++channel) {
+				moments[channel] += channel_density[channel] * value * value;
+			}
+			moment += value * value;
+			moment_standard += value * value / channel_density[0];
+		}
+	};
+	for (std::size_t iter = 0; iter < iters; ++iter) {
+		// Each channel weight is scaled by the square root of its contribution
+		// to the second moment (Kleiss and Pittau), which lowers the variance
+		// of the weights drawn with the summed channels.
+		estimate();
+		Double norm = 0.;
+		for (std::size_t channel = 0; channel < RAD_NUM_CHANNELS; ++channel) {
+			weights[channel] *= std::sqrt(moments[channel]);
+			norm += weights[channel];
+		}
+		if (!(norm > 0.) || !std::isfinite(norm)) {
+			throw std::runtime_error(
+				"Could not optimize radiative channel weights, as the density "
+				"is zero everywhere that was sampled.");
+		}
+		for (Double& weight : weights) {
+			weight = RAD_CHANNEL_MIN_WEIGHT
+				+ (1. - RAD_NUM_CHANNELS * RAD_CHANNEL_MIN_WEIGHT) * weight / norm;
+		}
+	}
+	// When the peaks are already resolved well by the standard channel, the
+	// other channels only add noise, so fall back to the standard channel.
+	estimate();
+	if (moment_standard <= moment) {
+		weights.fill(0.);
+		weights[0] = 1.;
+	}
+	return weights;
 }
 
 Double RadDensity::transform(
 		Point<9> const& unit_vec,
 		kin::KinematicsRad* kin) const noexcept {
 	Double jacobian;
-	if (!cut::take(_cut, _cut_rad, _ps, _S, unit_vec.data(), kin, &jacobian)) {
+	if (!take(_channel_weights, unit_vec, kin, &jacobian)) {
 		jacobian = 0.;
 	}
 	return jacobian;
 }
 
 Double RadDensity::eval(Point<9> const& unit_vec, kin::KinematicsRad* kin_rad) const noexcept {
-	Double jacobian;
-	if (!cut::take(_cut, _cut_rad, _ps, _S, unit_vec.data(), kin_rad, &jacobian)) {
-		return 0.;
+	if (perf_enabled) {
+		perf_counters.num_evals += 1;
 	}
-	kin::Kinematics kin = kin_rad->project();
-	math::Vec3 eta = frame::hadron_from_target(kin) * _target_pol;
-	Double xs = xs::rad(*kin_rad, _sf, _beam_pol, eta);
-	if (!std::isfinite(xs) || !(xs >= 0.)) {
+	Double jacobian;
+	if (!take(_channel_weights, unit_vec, kin_rad, &jacobian)) {
+		if (perf_enabled) {
+			perf_counters.num_zero_cut += 1;
+		}
 		return 0.;
-	} else {
-		return jacobian * xs;
 	}
+	PerfTimer timer(PerfPart::XS);
+	Double xs = this->xs(*kin_rad);
+	return xs_valid(xs) ? jacobian * xs : 0.;
 }
 
 Double RadDensity::eval(Point<9> const& unit_vec) const noexcept {
@@ -203,21 +715,104 @@ Double RadDensity::eval(Point<9> const& unit_vec) const noexcept {
 	return eval(unit_vec, &kin_rad);
 }
 
+void EventBatch::resize(std::size_t n, bool with_sf) {
+	// Every weight is overwritten by `Generator::draw_batch`, so nothing needs
+	// to be cleared. The radiative variables of non-radiative events are never
+	// written, and stay zero.
+	weight.resize(n);
+	sf.resize(with_sf ? n : 0);
+	for (std::vector<Double>& unit_vec_dim : unit_vec) {
+		unit_vec_dim.resize(n);
+	}
+	for (std::vector<Double>* var : {
+			&x, &y, &z, &ph_t_sq, &phi_h, &phi, &tau, &phi_k, &R }) {
+		var->resize(n);
+	}
+}
+
+RndEngine make_rnd_stream(Int seed, std::size_t shard, std::size_t worker) {
+	RndEngine::Key key = {{ static_cast<std::uint64_t>(seed), 0 }};
+	RndEngine::Counter ctr = {{
+		0,
+		static_cast<std::uint64_t>(worker),
+		static_cast<std::uint64_t>(shard),
+		0,
+	}};
+	return RndEngine(key, ctr);
+}
+
 DistParams::DistParams(EventType event_type, Params& params_full) {
-	dist_type = DistType::BUBBLE;
+	dist_type = params_full[p_name_init_dist(event_type)].any();
 	Double target_eff = params_full[p_name_init_target_eff(event_type)].any();
 	Double scale_exp = params_full[p_name_init_scale_exp(event_type)].any();
 	Int max_cells = params_full[p_name_init_max_cells(event_type)].any();
 	if (max_cells <= 0) {
 		max_cells = 1;
 	}
-	new (&params.bubble) BubbleParams();
-	params.bubble.check_samples = 16384;
-	params.bubble.target_rel_var = std::expm1(-2. * std::log(target_eff));
-	params.bubble.scale_exp_est = scale_exp;
-	params.bubble.min_cell_explore_samples = 512;
-	params.bubble.hist_num_per_bin = 2;
-	params.bubble.max_explore_cells = static_cast<std::size_t>(max_cells);
+	max_seconds = params_full[p_name_init_max_seconds(event_type)].any();
+	Long max_evals_param = params_full[p_name_init_max_evals(event_type)].any();
+	if (!(max_seconds >= 0.) || max_evals_param < 0) {
+		throw std::runtime_error(
+			"Parameters '" + p_name_init_max_seconds(event_type) + "' and '"
+			+ p_name_init_max_evals(event_type) + "' must not be negative.");
+	}
+	max_evals = static_cast<std::size_t>(max_evals_param);
+	switch (dist_type) {
+	case DistType::BUBBLE:
+		new (&params.bubble) BubbleParams();
+		params.bubble.check_samples = 16384;
+		params.bubble.target_rel_var = std::expm1(-2. * std::log(target_eff));
+		params.bubble.scale_exp_est = scale_exp;
+		params.bubble.min_cell_explore_samples = 512;
+		params.bubble.hist_num_per_bin = 2;
+		params.bubble.max_explore_cells = static_cast<std::size_t>(max_cells);
+		break;
+	case DistType::FOAM:
+		{
+			Int num_samples = params_full[p_name_init_foam_samples(event_type)].any();
+			Int num_bins = params_full[p_name_init_foam_bins(event_type)].any();
+			if (num_samples <= 0 || num_bins < 2) {
+				throw std::runtime_error(
+					"Parameter '" + p_name_init_foam_samples(event_type) + "' must "
+					+ "be positive, and '" + p_name_init_foam_bins(event_type)
+					+ "' must be at least two.");
+			}
+			std::random_device rnd_dev;
+			new (&params.foam) FoamParams();
+			params.foam.max_cells = static_cast<std::size_t>(max_cells);
+			params.foam.explore_samples = static_cast<std::size_t>(num_samples);
+			params.foam.num_bins = static_cast<std::size_t>(num_bins);
+			params.foam.target_rel_var = std::expm1(-2. * std::log(target_eff));
+			params.foam.seed = (static_cast<std::uint64_t>(rnd_dev()) << 32) | rnd_dev();
+		}
+		break;
+	case DistType::VEGAS:
+		{
+			Int num_bins = params_full[p_name_init_vegas_bins(event_type)].any();
+			Long num_samples = params_full[p_name_init_vegas_samples(event_type)].any();
+			Int max_iters = params_full[p_name_init_vegas_iters(event_type)].any();
+			if (num_bins <= 0 || num_samples <= 0 || max_iters <= 0) {
+				throw std::runtime_error(
+					"Parameters '" + p_name_init_vegas_bins(event_type) + "', '"
+					+ p_name_init_vegas_samples(event_type) + "', and '"
+					+ p_name_init_vegas_iters(event_type) + "' must be "
+					+ "positive.");
+			}
+			std::random_device rnd_dev;
+			new (&params.vegas) VegasParams();
+			params.vegas.num_bins = static_cast<std::size_t>(num_bins);
+			params.vegas.num_samples = static_cast<std::size_t>(num_samples);
+			params.vegas.max_iters = static_cast<std::size_t>(max_iters);
+			params.vegas.max_strata = static_cast<std::size_t>(max_cells);
+			params.vegas.target_rel_var = std::expm1(-2. * std::log(target_eff));
+			params.vegas.seed = (static_cast<std::uint64_t>(rnd_dev()) << 32) | rnd_dev();
+		}
+		break;
+	default:
+		throw std::runtime_error(
+			"Parameter '" + p_name_init_dist(event_type) + "' has an "
+			+ "unsupported value '" + dist_type_name(dist_type) + "'.");
+	}
 }
 
 Generator::Generator(Density density) :
@@ -308,18 +903,82 @@ Event Generator::draw(RndEngine& rnd) const {
 	return event;
 }
 
-void Generator::build_dist(DistParams dist_params) {
+void Generator::draw_batch(
+		RndEngine& rnd,
+		std::size_t n,
+		EventBatch& batch,
+		bool with_sf) const {
+	with_sf = with_sf && _event_type == EventType::NRAD;
+	batch.event_type = _event_type;
+	batch.resize(n, with_sf);
+	switch (_event_type) {
+	case EventType::NRAD:
+		{
+			for (std::size_t idx = 0; idx < n; ++idx) {
+				UnitEvent<6> unit_event = _dist.nrad.draw(rnd);
+				batch.weight[idx] = unit_event.weight;
+				for (std::size_t dim = 0; dim < 6; ++dim) {
+					batch.unit_vec[dim][idx] = unit_event.vec[dim];
+				}
+			}
+			_density.nrad.eval_batch(batch, with_sf);
+		}
+		break;
+	case EventType::RAD:
+		{
+			for (std::size_t idx = 0; idx < n; ++idx) {
+				UnitEvent<9> unit_event = _dist.rad.draw(rnd);
+				batch.weight[idx] = unit_event.weight;
+				for (std::size_t dim = 0; dim < 9; ++dim) {
+					batch.unit_vec[dim][idx] = unit_event.vec[dim];
+				}
+			}
+			kin::KinematicsRad kin;
+			for (std::size_t idx = 0; idx < n; ++idx) {
+				Point<9> vec;
+				for (std::size_t dim = 0; dim < 9; ++dim) {
+					vec[dim] = batch.unit_vec[dim][idx];
+				}
+				batch.weight[idx] *= _density.rad.eval(vec, &kin);
+				if (batch.weight[idx] != 0.) {
+					batch.x[idx] = kin.x;
+					batch.y[idx] = kin.y;
+					batch.z[idx] = kin.z;
+					batch.ph_t_sq[idx] = kin.ph_t_sq;
+					batch.phi_h[idx] = kin.phi_h;
+					batch.phi[idx] = kin.phi;
+					batch.tau[idx] = kin.tau;
+					batch.phi_k[idx] = kin.phi_k;
+					batch.R[idx] = kin.R;
+				}
+			}
+		}
+		break;
+	default:
+		UNREACHABLE();
+	}
+}
+
+void Generator::build_dist(DistParams dist_params, Generator const* warm_start) {
+	if (warm_start != nullptr
+			&& (warm_start->_event_type != _event_type || !warm_start->_dist_valid)) {
+		throw std::runtime_error("Warm start generator is of a different type.");
+	}
 	switch (_event_type) {
 	case EventType::NRAD:
 		_dist_valid = false;
 		_dist.nrad.~Dist<6>();
-		new (&_dist.nrad) Dist<6>(build_dist_approx<6>(dist_params, _density.nrad));
+		new (&_dist.nrad) Dist<6>(build_dist_approx<6>(
+			dist_params, _density.nrad,
+			warm_start != nullptr ? &warm_start->_dist.nrad : nullptr));
 		_dist_valid = true;
 		break;
 	case EventType::RAD:
 		_dist_valid = false;
 		_dist.rad.~Dist<9>();
-		new (&_dist.rad) Dist<9>(build_dist_approx<9>(dist_params, _density.rad));
+		new (&_dist.rad) Dist<9>(build_dist_approx<9>(
+			dist_params, _density.rad,
+			warm_start != nullptr ? &warm_start->_dist.rad : nullptr));
 		_dist_valid = true;
 		break;
 	default:
@@ -338,12 +997,12 @@ std::ostream& Generator::write_dist(std::ostream& os, Generator const& gen) {
 	}
 }
 
-std::istream& Generator::read_dist(std::istream& is, Generator& gen) {
+BinaryView& Generator::read_dist(BinaryView& view, Generator& gen) {
 	switch (gen._event_type) {
 	case EventType::NRAD:
-		return Dist<6>::read(is, gen._dist.nrad);
+		return Dist<6>::read(view, gen._dist.nrad);
 	case EventType::RAD:
-		return Dist<9>::read(is, gen._dist.rad);
+		return Dist<9>::read(view, gen._dist.rad);
 	default:
 		UNREACHABLE();
 	}
@@ -2,18 +2,24 @@
 #define SIDISGEN_GENERATOR_HPP
 
 #include <array>
+#include <cstdint>
 #include <random>
+#include <vector>
 
 #include <bubble.hpp>
 
 #include <sidis/sidis.hpp>
 
 #include "utility.hpp"
+#include "foam.hpp"
+#include "philox.hpp"
+#include "vegas.hpp"
 
 template<std::size_t D>
 using Point = std::array<Double, D>;
 
 class Params;
+class RcTable;
 
 namespace sidis {
 	namespace kin {
@@ -22,22 +28,74 @@ namespace sidis {
 	}
 }
 
+struct EventBatch;
+
+// Transformations from the unit hypercube onto the non-radiative phase space
+// variables. The azimuthal angles are always mapped linearly.
+struct NradMaps {
+	VarMap x;
+	VarMap y;
+	VarMap z;
+	VarMap ph_t_sq;
+
+	NradMaps(Params& params, EventType ev_type);
+	// Whether these are the transformations used by `cut::take`, so that it
+	// can be used directly.
+	bool standard() const;
+};
+
 // Map the non-radiative cross-section onto unit hypercube for Monte-Carlo.
 class NradDensity final {
 	sidis::cut::Cut _cut;
-	sidis::sf::SfSet const& _sf;
+	NradMaps _maps;
+	sidis::xs::Context _ctx;
 	RcMethod _rc_method;
 	Double _soft_threshold;
-	sidis::part::Particles _ps;
-	Double _S;
-	Double _beam_pol;
-	sidis::math::Vec3 _target_pol;
+	// Used for all `_rc_method`s except `RcMethod::EXACT`, unless the
+	// radiative correction is tabulated.
+	sidis::xs::Evaluator _xs;
+	// Tabulated radiative correction for `RcMethod::EXACT`, if any. Not owned.
+	RcTable const* _rc_table;
 
 public:
 	NradDensity(Params& params, sidis::sf::SfSet const& sf);
-	// Get the density in the unit hypercube.
-	Double eval(Point<6> const& unit_vec, sidis::kin::Kinematics* kin) const noexcept;
+
+	sidis::xs::Context const& context() const {
+		return _ctx;
+	}
+	// Uses `rc_table` for the radiative correction with `RcMethod::EXACT`,
+	// instead of computing it for every evaluation. The table must outlive
+	// the density and all of its copies.
+	void set_rc_table(RcTable const* rc_table) {
+		_rc_table = rc_table;
+	}
+	// Ratio of the exact radiative correction to `nrad_ir`, at the point
+	// `unit_vec` of the first four dimensions of the unit hypercube, but with
+	// azimuthal angles `phi_h` and `phi`. Gives NaN outside of the cuts. If
+	// `density_ir` is provided, it is set to the density of `nrad_ir` in the
+	// unit hypercube at the same point.
+	Double rc_ratio(
+		Point<4> const& unit_vec,
+		Double phi_h,
+		Double phi,
+		Double* density_ir=nullptr) const noexcept;
+	// Get the density in the unit hypercube. If `sf` is provided, the full set
+	// of structure functions used for the evaluation is stored in it (only if
+	// the point is within the cuts).
+	Double eval(
+		Point<6> const& unit_vec,
+		sidis::kin::Kinematics* kin,
+		sidis::sf::SfLP* sf=nullptr) const noexcept;
 	Double eval(Point<6> const& unit_vec) const noexcept;
+	// Multiplies the weights of `batch` by the density at its points in the
+	// unit hypercube, and fills in the phase space variables of the points
+	// within the cuts. Agrees with `eval` up to rounding. Without target
+	// polarization, the cross-section is computed for the whole batch at once
+	// through `xs::born_batch` or `xs::nrad_ir_batch`. The batched
+	// cross-sections have no form for a polarized target, for the integrated
+	// radiative part, or for keeping the structure functions, so in those
+	// cases (`with_sf` set) the points are evaluated one at a time instead.
+	void eval_batch(EventBatch& batch, bool with_sf=false) const;
 	// Transform from the unit hypercube into phase space.
 	Double transform(Point<6> const& unit_vec, sidis::kin::Kinematics* kin) const noexcept;
 
@@ -46,20 +104,53 @@ public:
 	}
 };
 
+// Number of channels used to sample `tau` for radiative events. The channels
+// are, in order: the standard mapping used by `cut::take` (covering both
+// collinear peaks), the p-peak (photon collinear with the scattered lepton),
+// and the s-peak (photon collinear with the incoming lepton).
+std::size_t const RAD_NUM_CHANNELS = 3;
+using RadChannelWeights = std::array<Double, RAD_NUM_CHANNELS>;
+
 // Map the radiative cross-section onto unit hypercube for Monte-Carlo.
 class RadDensity final {
 	sidis::cut::Cut _cut;
+	NradMaps _maps;
 	sidis::cut::CutRad _cut_rad;
-	sidis::sf::SfSet const& _sf;
+	sidis::xs::Context _ctx;
 	RcMethod _rc_method;
 	Double _soft_threshold;
-	sidis::part::Particles _ps;
-	Double _S;
-	Double _beam_pol;
-	sidis::math::Vec3 _target_pol;
+	sidis::xs::Evaluator _xs;
+	// Whether `tau` is sampled from several channels, instead of only from the
+	// standard mapping. The channel weights are normalized.
+	bool _channels;
+	RadChannelWeights _channel_weights;
+
+	bool take(
+		RadChannelWeights const& weights,
+		Point<9> const& unit_vec,
+		sidis::kin::KinematicsRad* kin,
+		Double* jacobian,
+		RadChannelWeights* channel_density=nullptr) const noexcept;
+	Double xs(sidis::kin::KinematicsRad const& kin) const noexcept;
 
 public:
 	RadDensity(Params& params, sidis::sf::SfSet const& sf);
+
+	bool channels() const {
+		return _channels;
+	}
+	RadChannelWeights const& channel_weights() const {
+		return _channel_weights;
+	}
+	void set_channel_weights(RadChannelWeights const& weights);
+	// Adapts the channel weights to reduce the variance of the density, using
+	// `samples` points for each of `iters` iterations. Returns the new weights,
+	// without changing the density.
+	RadChannelWeights optimize_channel_weights(
+		std::size_t samples,
+		std::size_t iters,
+		std::uint64_t seed) const;
+
 	Double eval(Point<9> const& unit_vec, sidis::kin::KinematicsRad* kin) const noexcept;
 	Double eval(Point<9> const& unit_vec) const noexcept;
 	Double transform(Point<9> const& unit_vec, sidis::kin::KinematicsRad* kin) const noexcept;
@@ -93,36 +184,14 @@ struct Density final {
 	}
 };
 
-// Types of probability distributions available.
-enum class DistType {
-	// Uniform distribution. Default.
-	UNIFORM,
-	// k-d tree constructed to approximate density.
-	FOAM,
-	// Variation of FOAM, with different construction process.
-	BUBBLE,
-	// Stratified VEGAS algorithm.
-	VEGAS,
-};
-
-// Identifying name for each type of distribution.
-inline char const* dist_type_name(DistType type) {
-	switch (type) {
-	case DistType::UNIFORM:
-		return "uniform";
-	case DistType::FOAM:
-		return "foam";
-	case DistType::BUBBLE:
-		return "bubble";
-	case DistType::VEGAS:
-		return "vegas";
-	default:
-		UNREACHABLE();
-	}
-}
-
 // Random number engine type used by Monte-Carlo generators.
-using RndEngine = std::mt19937_64;
+using RndEngine = Philox4x64;
+
+// Creates the random number engine for a single stream of events, identified
+// by its shard and worker. All streams share the seed as their key, and each
+// places its shard and worker in its own words of the counter, so different
+// streams never produce the same output block.
+RndEngine make_rnd_stream(Int seed, std::size_t shard, std::size_t worker);
 
 // Monte-Carlo event drawn from the unit hypercube.
 template<std::size_t D>
@@ -132,9 +201,10 @@ struct UnitEvent final {
 };
 
 struct UniformParams { };
-struct FoamParams { };
 using BubbleParams = bubble::CellBuilderParams<Double>;
-struct VegasParams { };
+// Number of density evaluations used to estimate their cost, when the Bubble
+// cell limit is worked out from a time budget.
+std::size_t const BUBBLE_BUDGET_PROBE_SAMPLES = 1024;
 
 // Parameters for building a probability distribution.
 struct DistParams final {
@@ -147,16 +217,21 @@ struct DistParams final {
 		VegasParams vegas;
 		Impl() { }
 	} params;
+	// Threads used while building, for when several distributions are built
+	// at the same time.
+	ThreadShareTask threads;
+	// Limits on the time and density evaluations spent building. Zero means
+	// no limit.
+	Double max_seconds;
+	std::size_t max_evals;
 
 	DistParams(EventType event_type, Params& params);
 };
 
 // Underlying engines.
 struct UniformEngine { };
-struct FoamEngine { };
 template<std::size_t D>
 using BubbleEngine = bubble::CellGenerator<D, Double>;
-struct VegasEngine { };
 
 // Random number distribution over the unit hypercube of dimension `D`. This
 // type wraps several possible underlying engines, as described by the enum
@@ -173,9 +248,9 @@ class Dist final {
 	bool _dist_valid;
 	union Impl {
 		UniformEngine uniform;
-		FoamEngine foam;
+		FoamEngine<D> foam;
 		BubbleEngine<D> bubble;
-		VegasEngine vegas;
+		VegasEngine<D> vegas;
 		Impl() { }
 		~Impl() { }
 	} _engine;
@@ -199,13 +274,20 @@ public:
 	// Average weight of events produced by the distribution.
 	Double prime() const;
 
-	// Serialization to binary streams.
+	// Serialization to binary streams. Reading is done from a block of
+	// memory, so that the engine can refer to it directly instead of copying
+	// it (see `BinaryView`).
 	static std::ostream& write(std::ostream& os, Dist<D> const& dist);
-	static std::istream& read(std::istream& is, Dist<D>& dist);
+	static BinaryView& read(BinaryView& view, Dist<D>& dist);
 
-	// Constructs a distribution that approximates the provided density.
+	// Constructs a distribution that approximates the provided density. If
+	// `start` is provided, the construction begins from that distribution,
+	// which must be of the same type.
 	template<std::size_t D1, typename F1>
-	friend Dist<D1> build_dist_approx(DistParams const& dist_params, F1 const& density);
+	friend Dist<D1> build_dist_approx(
+		DistParams const& dist_params,
+		F1 const& density,
+		Dist<D1> const* start);
 };
 
 // Generated event from a cross-section.
@@ -219,6 +301,47 @@ struct Event final {
 	} kin;
 };
 
+// Batch of generated events from a single cross-section, stored as a
+// structure of arrays. Only the base phase space variables are kept, since the
+// full kinematics can be reconstructed from them when needed.
+struct EventBatch final {
+	EventType event_type;
+	std::vector<Double> weight;
+	// Coordinates in the unit hypercube. Only the first 6 (non-radiative) or 9
+	// (radiative) dimensions are used.
+	std::array<std::vector<Double>, 9> unit_vec;
+	// Phase space variables. The radiative variables are zero for
+	// non-radiative events.
+	std::vector<Double> x, y, z, ph_t_sq, phi_h, phi;
+	std::vector<Double> tau, phi_k, R;
+	// Structure functions at the event kinematics. Only filled in when
+	// requested from `Generator::draw_batch`, and empty otherwise.
+	std::vector<sidis::sf::SfLP> sf;
+
+	// Scratch space for evaluating the density over the batch. It isn't part
+	// of the events, and is only kept so that its storage can be reused from
+	// one batch to the next.
+	struct Scratch {
+		// Indices of the points within the cuts, with their phase space
+		// variables and jacobians.
+		std::vector<std::size_t> idxs;
+		std::vector<sidis::kin::PhaseSpace> ph_spaces;
+		std::vector<Double> jacobians;
+		// Factors from the tabulated radiative correction, if any.
+		std::vector<Double> rc_factors;
+		std::vector<Double> xs;
+		sidis::xs::BatchBuffer xs_buf;
+	} scratch;
+
+	std::size_t size() const {
+		return weight.size();
+	}
+	// Resizes the batch to `n` events, reusing the existing storage. The
+	// previous contents are left in place, so the phase space variables are
+	// only meaningful for events with non-zero weight.
+	void resize(std::size_t n, bool with_sf=false);
+};
+
 // Generator for producing Monte-Carlo events from a cross-section.
 class Generator final {
 	EventType _event_type;
@@ -250,15 +373,29 @@ public:
 		return _event_type;
 	}
 
-	// Builds the underlying distribution to approximate the cross-section.
-	void build_dist(DistParams dist_params);
+	// Builds the underlying distribution to approximate the cross-section. If
+	// `warm_start` is provided, the build begins from its distribution
+	// instead of from scratch.
+	void build_dist(DistParams dist_params, Generator const* warm_start=nullptr);
 
 	Event draw(RndEngine& rnd) const;
+	// Draws `n` events at once into `batch`. The unit hypercube points are all
+	// drawn first, and then the density is evaluated over the whole batch. If
+	// `with_sf` is set, the structure functions computed by the density are
+	// kept as well. This is only supported for non-radiative events, since the
+	// radiative density only evaluates shifted structure functions.
+	void draw_batch(
+		RndEngine& rnd,
+		std::size_t n,
+		EventBatch& batch,
+		bool with_sf=false) const;
 	Double prime() const;
 
-	// Serialization to binary streams of underlying distribution.
+	// Serialization of underlying distribution. When reading from a
+	// memory-mapped generator file, the distribution uses the mapped memory
+	// directly where it can, and keeps the mapping alive.
 	static std::ostream& write_dist(std::ostream& os, Generator const& gen);
-	static std::istream& read_dist(std::istream& is, Generator& gen);
+	static BinaryView& read_dist(BinaryView& view, Generator& gen);
 };
 
 #include "generator.ipp"
@@ -3,6 +3,11 @@
 
 #include "generator.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <stdexcept>
+#include <string>
 #include <utility>
 
 template<std::size_t D>
@@ -15,7 +20,7 @@ Dist<D>::Dist(DistType dist_type) :
 		_dist_valid = true;
 		break;
 	case DistType::FOAM:
-		new (&_engine.foam) FoamEngine();
+		new (&_engine.foam) FoamEngine<D>();
 		_dist_valid = true;
 		break;
 	case DistType::BUBBLE:
@@ -23,7 +28,7 @@ Dist<D>::Dist(DistType dist_type) :
 		_dist_valid = true;
 		break;
 	case DistType::VEGAS:
-		new (&_engine.vegas) VegasEngine();
+		new (&_engine.vegas) VegasEngine<D>();
 		_dist_valid = true;
 		break;
 	default:
@@ -41,7 +46,7 @@ Dist<D>::Dist(Dist<D>&& other) noexcept :
 		_dist_valid = true;
 		break;
 	case DistType::FOAM:
-		new (&_engine.foam) FoamEngine(std::move(other._engine.foam));
+		new (&_engine.foam) FoamEngine<D>(std::move(other._engine.foam));
 		_dist_valid = true;
 		break;
 	case DistType::BUBBLE:
@@ -49,7 +54,7 @@ Dist<D>::Dist(Dist<D>&& other) noexcept :
 		_dist_valid = true;
 		break;
 	case DistType::VEGAS:
-		new (&_engine.vegas) VegasEngine(std::move(other._engine.vegas));
+		new (&_engine.vegas) VegasEngine<D>(std::move(other._engine.vegas));
 		_dist_valid = true;
 		break;
 	default:
@@ -67,7 +72,7 @@ Dist<D>::~Dist() {
 			break;
 		case DistType::FOAM:
 			_dist_valid = false;
-			_engine.foam.~FoamEngine();
+			_engine.foam.~FoamEngine<D>();
 			break;
 		case DistType::BUBBLE:
 			_dist_valid = false;
@@ -75,7 +80,7 @@ Dist<D>::~Dist() {
 			break;
 		case DistType::VEGAS:
 			_dist_valid = false;
-			_engine.vegas.~VegasEngine();
+			_engine.vegas.~VegasEngine<D>();
 			break;
 		default:
 			UNREACHABLE();
@@ -97,12 +102,14 @@ UnitEvent<D> Dist<D>::draw(RndEngine& rnd) const {
 		}
 		break;
 	case DistType::FOAM:
-		throw "Error";
+		_engine.foam.generate(rnd, &event.weight, &event.vec);
+		break;
 	case DistType::BUBBLE:
 		_engine.bubble.generate(rnd, &event.weight, &event.vec);
 		break;
 	case DistType::VEGAS:
-		throw "Error";
+		_engine.vegas.generate(rnd, &event.weight, &event.vec);
+		break;
 	default:
 		UNREACHABLE();
 	}
@@ -115,11 +122,11 @@ Double Dist<D>::prime() const {
 	case DistType::UNIFORM:
 		return 1.;
 	case DistType::FOAM:
-		throw "Error";
+		return _engine.foam.prime();
 	case DistType::BUBBLE:
 		return _engine.bubble.prime();
 	case DistType::VEGAS:
-		throw "Error";
+		return _engine.vegas.prime();
 	default:
 		UNREACHABLE();
 	}
@@ -138,11 +145,11 @@ std::ostream& Dist<D>::write(std::ostream& os, Dist<D> const& dist) {
 	case DistType::UNIFORM:
 		goto error;
 	case DistType::FOAM:
-		goto error;
+		return dist._engine.foam.write(os);
 	case DistType::BUBBLE:
 		return dist._engine.bubble.write(os);
 	case DistType::VEGAS:
-		goto error;
+		return dist._engine.vegas.write(os);
 	default:
 		UNREACHABLE();
 	}
@@ -152,13 +159,13 @@ error:
 }
 
 template<std::size_t D>
-std::istream& Dist<D>::read(std::istream& is, Dist<D>& dist) {
+BinaryView& Dist<D>::read(BinaryView& view, Dist<D>& dist) {
 	DistType dist_type_read;
 	std::size_t dim;
-	if (!is.read(reinterpret_cast<char*>(&dist_type_read), sizeof(DistType))) {
+	if (!view.read(&dist_type_read)) {
 		goto error;
 	}
-	if (!is.read(reinterpret_cast<char*>(&dim), sizeof(std::size_t))) {
+	if (!view.read(&dim)) {
 		goto error;
 	}
 	if (dim != D) {
@@ -174,48 +181,134 @@ std::istream& Dist<D>::read(std::istream& is, Dist<D>& dist) {
 		goto error;
 	case DistType::FOAM:
 		dist._dist_type = DistType::FOAM;
-		new (&dist._engine.foam) FoamEngine();
+		new (&dist._engine.foam) FoamEngine<D>();
 		dist._dist_valid = true;
-		goto error;
+		dist._engine.foam.read(view);
+		break;
 	case DistType::BUBBLE:
 		dist._dist_type = DistType::BUBBLE;
 		new (&dist._engine.bubble) BubbleEngine<D>();
 		dist._dist_valid = true;
-		dist._engine.bubble.read(is);
+		// Bubble can only read from streams, so its cells are copied. The
+		// layout of the cells is private to Bubble, so they can't be
+		// flattened into an alias table here, and each draw still walks the
+		// cell tree. `FoamEngine` is the engine that draws cells in constant
+		// time.
+		view.read_stream([&dist](std::istream& is) {
+			dist._engine.bubble.read(is);
+		});
 		break;
 	case DistType::VEGAS:
 		dist._dist_type = DistType::VEGAS;
-		new (&dist._engine.vegas) VegasEngine();
+		new (&dist._engine.vegas) VegasEngine<D>();
 		dist._dist_valid = true;
-		goto error;
+		dist._engine.vegas.read(view);
+		break;
 	default:
 		goto error;
 	}
-	return is;
+	return view;
 error:
-	is.setstate(std::ios_base::failbit);
-	return is;
+	view.fail();
+	return view;
 }
 
 template<std::size_t D, typename F>
-inline Dist<D> build_dist_approx(DistParams const& dist_params, F const& density) {
+inline Dist<D> build_dist_approx(
+		DistParams const& dist_params,
+		F const& density,
+		Dist<D> const* start) {
+	if (start != nullptr) {
+		if (start->_dist_type != dist_params.dist_type) {
+			throw std::runtime_error(
+				"Can't warm start a '" + std::string(dist_type_name(dist_params.dist_type))
+				+ "' distribution from a '" + dist_type_name(start->_dist_type)
+				+ "' distribution.");
+		} else if (dist_params.dist_type != DistType::FOAM
+				&& dist_params.dist_type != DistType::VEGAS) {
+			throw std::runtime_error(
+				"Warm start isn't supported for '"
+				+ std::string(dist_type_name(dist_params.dist_type))
+				+ "' distributions.");
+		}
+	}
+	BuildBudget budget(dist_params.max_seconds, dist_params.max_evals);
 	Dist<D> dist(dist_params.dist_type);
 	switch (dist_params.dist_type) {
 	case DistType::UNIFORM:
 		break;
 	case DistType::FOAM:
-		throw "Error";
+		dist._engine.foam = FoamEngine<D>::build(
+			density, dist_params.params.foam, dist_params.threads,
+			start != nullptr ? &start->_engine.foam : nullptr,
+			budget);
+		break;
 	case DistType::BUBBLE:
 		{
+			// The parallel loops are inside of the builder, so the number of
+			// threads can only be chosen between its steps.
+			auto choose_threads = [&dist_params]() {
+#ifdef _OPENMP
+				if (dist_params.threads.share != nullptr) {
+					omp_set_num_threads(dist_params.threads.num_threads());
+				}
+#endif
+			};
 			bubble::CellBuilder<D, Double, F> builder(density, nullptr, nullptr);
 			builder.par = dist_params.params.bubble;
+			// The builder can't be stopped part way through, so the budget is
+			// turned into a limit on the number of cells beforehand. Roughly,
+			// every cell in the tree is explored once, and there are about
+			// twice as many cells in the tree as are explored at the end.
+			if (budget.max_seconds() > 0. || budget.max_evals() > 0) {
+				std::size_t max_evals = budget.remaining_evals();
+				if (budget.max_seconds() > 0.) {
+					RndEngine rnd(0);
+					std::uniform_real_distribution<Double> dist_unit;
+					std::chrono::steady_clock::time_point probe_begin
+						= std::chrono::steady_clock::now();
+					for (std::size_t sample = 0; sample < BUBBLE_BUDGET_PROBE_SAMPLES; ++sample) {
+						Point<D> vec;
+						for (std::size_t dim = 0; dim < D; ++dim) {
+							vec[dim] = dist_unit(rnd);
+						}
+						density(vec);
+					}
+					std::chrono::duration<Double> probe_duration
+						= std::chrono::steady_clock::now() - probe_begin;
+					Double evals_per_second = dist_params.threads.num_threads()
+						* BUBBLE_BUDGET_PROBE_SAMPLES / probe_duration.count();
+					Double max_evals_time = (budget.max_seconds() - budget.seconds())
+						* evals_per_second;
+					if (max_evals_time < max_evals) {
+						max_evals = max_evals_time > 0. ?
+							static_cast<std::size_t>(max_evals_time) :
+							0;
+					}
+				}
+				std::size_t explore_evals = max_evals > builder.par.check_samples ?
+					max_evals - builder.par.check_samples :
+					0;
+				std::size_t max_cells = std::max<std::size_t>(
+					1,
+					explore_evals / (2 * builder.par.min_cell_explore_samples));
+				builder.par.max_explore_cells = std::min(
+					builder.par.max_explore_cells,
+					max_cells);
+			}
+			choose_threads();
 			builder.explore();
+			choose_threads();
 			builder.tune();
 			dist._engine.bubble = bubble::make_generator(builder);
 		}
 		break;
 	case DistType::VEGAS:
-		throw "Error";
+		dist._engine.vegas = VegasEngine<D>::build(
+			density, dist_params.params.vegas, dist_params.threads,
+			start != nullptr ? &start->_engine.vegas : nullptr,
+			budget);
+		break;
 	default:
 		UNREACHABLE();
 	}
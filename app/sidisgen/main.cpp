@@ -1,5 +1,11 @@
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <cstdio>
+#include <deque>
+#include <exception>
 #include <fstream>
 #include <iomanip>
 #include <ios>
@@ -11,17 +17,18 @@
 #include <string>
 #include <sstream>
 #include <stdexcept>
+#include <thread>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
-#include <TArrayC.h>
 #include <TBranch.h>
 #include <TChain.h>
 #include <TClass.h>
 #include <TDirectory.h>
 #include <TError.h>
 #include <TFile.h>
-#include <TLorentzVector.h>
+#include <TROOT.h>
 #include <TSystem.h>
 #include <TTree.h>
 
@@ -33,12 +40,18 @@
 #include <sidis/sf_set/prokudin.hpp>
 #include <sidis/sf_set/test.hpp>
 
+#include "checkpoint.hpp"
+#include "gen_file.hpp"
 #include "generator.hpp"
 #include "exception.hpp"
 #include "params.hpp"
 #include "params_format.hpp"
+#include "perf.hpp"
+#include "rc_table.hpp"
+#include "ring_buffer.hpp"
 #include "terminal.hpp"
 #include "utility.hpp"
+#include "writer.hpp"
 
 using namespace sidis;
 
@@ -49,10 +62,55 @@ static_assert(
 namespace {
 
 int const OUTPUT_STATS_PRECISION = 3;
-
-// Converts between the `sidis` 4-vector type and the ROOT 4-vector type.
-TLorentzVector convert_vec4(math::Vec4 vec) {
-	return TLorentzVector(vec.x, vec.y, vec.z, vec.t);
+// Number of events drawn by each worker before they are written to file.
+std::size_t const EVENT_BLOCK_SIZE = 256;
+// Number of events drawn by each worker between updates of the table used to
+// choose generators.
+Long const GEN_SCHEDULE_INTERVAL = 1024;
+// Number of events drawn from a generator at once.
+std::size_t const DRAW_BATCH_SIZE = 64;
+// Number of blocks that each worker can draw ahead of the blocks being written.
+std::size_t const NUM_WORKER_BLOCKS = 4;
+// Minimum number of event records that can be queued for the writer.
+std::size_t const WRITER_QUEUE_SIZE = 4096;
+// Number of events drawn from each newly built generator to report the
+// efficiency that it achieved.
+std::size_t const INIT_EFF_SAMPLES = 16384;
+// Number of cells in the pilot builds used for autotuning, and number of events
+// drawn from each of them.
+std::array<Int, 2> const AUTOTUNE_PILOT_CELLS = { 512, 4096 };
+std::size_t const AUTOTUNE_PILOT_SAMPLES = 65536;
+// Range of cell counts that autotuning chooses from, and the most memory that
+// the cells of a single generator may use.
+Int const AUTOTUNE_MIN_CELLS = 16;
+Int const AUTOTUNE_MAX_CELLS = 1 << 24;
+Double const AUTOTUNE_MAX_BYTES = 1 << 30;
+// Largest scaling exponent that autotuning will assume.
+Double const AUTOTUNE_MAX_SCALE_EXP = 4.;
+// The power law fit to the pilot builds is trusted up to this many times the
+// number of cells in the larger pilot build.
+Int const AUTOTUNE_MAX_EXTRAPOLATION = 64;
+// Number of density evaluations in each iteration of the radiative channel
+// weight optimization, and the number of iterations.
+std::size_t const RAD_CHANNEL_SAMPLES = 65536;
+std::size_t const RAD_CHANNEL_ITERS = 4;
+
+// Produces the compact record of an event from a batch, to be passed to the
+// writer.
+EventRecord event_record(EventBatch const& batch, std::size_t idx) {
+	EventRecord record;
+	record.type = static_cast<Int>(batch.event_type) + 1;
+	record.weight = batch.weight[idx];
+	record.x = batch.x[idx];
+	record.y = batch.y[idx];
+	record.z = batch.z[idx];
+	record.ph_t_sq = batch.ph_t_sq[idx];
+	record.phi_h = batch.phi_h[idx];
+	record.phi = batch.phi[idx];
+	record.tau = batch.tau[idx];
+	record.phi_k = batch.phi_k[idx];
+	record.R = batch.R[idx];
+	return record;
 }
 
 // Convenience structure for array of integrators for each event type.
@@ -135,6 +193,22 @@ void root_write_integs(TDirectory& dir, IntegratorArray const& integs) {
 	}
 }
 
+// Statistics in the form stored by binary event files. Matches the contents of
+// the "stats" directory from `root_write_integs`.
+event_file::Stats event_file_stats(Integrator const& integ) {
+	event_file::Stats stats;
+	stats.prime = integ.prime();
+	stats.weight_mom[0] = integ.weights().ratio_m1_to_max1();
+	stats.weight_mom[1] = integ.weights().ratio_m2_to_max2();
+	stats.weight_mom[2] = integ.weights().ratio_m3_to_max3();
+	stats.weight_mom[3] = integ.weights().ratio_m4_to_max4();
+	stats.weight_max = integ.weights().max1();
+	stats.num_events = integ.count();
+	stats.num_events_acc = integ.count_acc();
+	stats.norm = integ.norm();
+	return stats;
+}
+
 IntegratorArray root_read_integs(TDirectory& dir) {
 	std::string file_name = dir.GetName();
 	IntegratorArray integs;
@@ -205,6 +279,151 @@ void stream_write_integ(std::ostream& os, std::string header, Integrator const&
 	os.flags(flags);
 }
 
+// Reports on the rejection sampling used to unweight events.
+void stream_write_rej(
+		std::ostream& os,
+		Double rej_scale,
+		Long num_overflow,
+		Integrator const& integ) {
+	Double overflow = static_cast<Double>(num_overflow) / integ.count_acc();
+	std::ios_base::fmtflags flags(os.flags());
+	os << std::scientific << std::setprecision(OUTPUT_STATS_PRECISION)
+		<< "\t\trej. scale:    " << rej_scale << std::endl
+		<< std::fixed << std::setprecision(3)
+		<< "\t\toverflow:      " << 100. * overflow << '%' << std::endl;
+	os.flags(flags);
+}
+
+// Times reported in the profile of the generation. The cross-section time is
+// split into the structure functions and everything else (mostly the leptonic
+// coefficients and their contraction with the hadronic ones).
+struct PerfTimes {
+	Double take;
+	Double kinematics;
+	Double sf;
+	Double xs;
+	Double io;
+	explicit PerfTimes(PerfCounters const& perf) :
+		take(perf.time[static_cast<std::size_t>(PerfPart::TAKE)]),
+		kinematics(perf.time[static_cast<std::size_t>(PerfPart::KINEMATICS)]),
+		sf(perf.time[static_cast<std::size_t>(PerfPart::SF)]),
+		xs(std::max(perf.time[static_cast<std::size_t>(PerfPart::XS)] - sf, 0.)),
+		io(perf.time[static_cast<std::size_t>(PerfPart::IO)]) { }
+	Double total() const {
+		return take + kinematics + sf + xs + io;
+	}
+};
+
+// Reports on the throughput of the generation, and where the time was spent.
+// Times are summed over all threads.
+void stream_write_perf(
+		std::ostream& os,
+		PerfCounters const& perf,
+		Long num_events,
+		Double wall_time) {
+	PerfTimes times(perf);
+	Double evals = static_cast<Double>(perf.num_evals);
+	Double num_zero = static_cast<Double>(
+		perf.num_zero_cut + perf.num_zero_nan + perf.num_zero_neg);
+	std::ios_base::fmtflags flags(os.flags());
+	os << std::scientific << std::setprecision(OUTPUT_STATS_PRECISION)
+		<< "\tthroughput" << std::endl
+		<< "\t\tevents/s:      " << num_events / wall_time << std::endl
+		<< "\t\tevals/event:   " << evals / num_events << std::endl
+		<< std::fixed << std::setprecision(3)
+		<< "\t\tzero weight:   " << 100. * num_zero / evals << '%' << std::endl
+		<< "\t\t  cuts:        " << 100. * perf.num_zero_cut / evals << '%' << std::endl
+		<< "\t\t  non-finite:  " << 100. * perf.num_zero_nan / evals << '%' << std::endl
+		<< "\t\t  negative:    " << 100. * perf.num_zero_neg / evals << '%' << std::endl;
+	std::pair<char const*, Double> const parts[] = {
+		{ "phase space:   ", times.take },
+		{ "kinematics:    ", times.kinematics },
+		{ "struct. func.: ", times.sf },
+		{ "lep. coeff.:   ", times.xs },
+		{ "I/O:           ", times.io },
+	};
+	os << "\ttime" << std::endl;
+	for (std::pair<char const*, Double> const& part : parts) {
+		os << std::scientific << std::setprecision(OUTPUT_STATS_PRECISION)
+			<< "\t\t" << part.first << part.second << " s"
+			<< std::fixed << std::setprecision(1)
+			<< " (" << 100. * part.second / times.total() << "%)" << std::endl;
+	}
+	os.flags(flags);
+}
+
+void root_write_perf(
+		TDirectory& dir,
+		PerfCounters const& perf,
+		Long num_events,
+		Double wall_time) {
+	std::string file_name = dir.GetName();
+	TDirectory* stats_dir = dir.GetDirectory("stats");
+	TDirectory* perf_dir = stats_dir == nullptr ?
+		nullptr :
+		stats_dir->mkdir("perf", "perf");
+	if (perf_dir == nullptr) {
+		throw Exception(
+			ERROR_WRITING_STATS,
+			"Could not create directory 'stats/perf' in file '" + file_name
+			+ "'.");
+	}
+	PerfTimes times(perf);
+	Double evals = static_cast<Double>(perf.num_evals);
+	std::pair<char const*, Double> const values[] = {
+		{ "wall_time", wall_time },
+		{ "events_per_sec", num_events / wall_time },
+		{ "evals_per_event", evals / num_events },
+		{ "zero_cut", perf.num_zero_cut / evals },
+		{ "zero_nan", perf.num_zero_nan / evals },
+		{ "zero_neg", perf.num_zero_neg / evals },
+		{ "time_take", times.take },
+		{ "time_kinematics", times.kinematics },
+		{ "time_sf", times.sf },
+		{ "time_lep", times.xs },
+		{ "time_io", times.io },
+	};
+	for (std::pair<char const*, Double> const& value : values) {
+		TParameter<Double> param(value.first, value.second);
+		if (perf_dir->WriteObject(&param, value.first) == 0) {
+			throw Exception(
+				ERROR_WRITING_STATS,
+				"Could not write profile to file '" + file_name + "'.");
+		}
+	}
+}
+
+// Builds the table used to choose which generator the next event should be
+// drawn from, based on the events drawn so far by each generator.
+AliasTable make_gen_schedule(std::vector<IntegratorAccum> const& integs) {
+	// We want to generate events so that the total weights contributed by
+	// events of each type have the same ratio as the cross-sections of each
+	// type. This is the case when the number of events drawn from each
+	// generator is proportional to its prime times the RMS of its accepted
+	// weights.
+	std::vector<Double> rms(integs.size());
+	Double rms_mean = 0.;
+	std::size_t rms_count = 0;
+	for (std::size_t idx = 0; idx < integs.size(); ++idx) {
+		rms[idx] = integs[idx].total_fast().weights_acc().est_sqrt_m2();
+		if (std::isfinite(rms[idx]) && rms[idx] > 0.) {
+			rms_mean += rms[idx];
+			rms_count += 1;
+		}
+	}
+	// Generators without any accepted events yet are given an average RMS, so
+	// that they still get a chance to be drawn from.
+	rms_mean = rms_count == 0 ? 1. : rms_mean / rms_count;
+	std::vector<Double> weights(integs.size());
+	for (std::size_t idx = 0; idx < integs.size(); ++idx) {
+		if (!std::isfinite(rms[idx]) || !(rms[idx] > 0.)) {
+			rms[idx] = rms_mean;
+		}
+		weights[idx] = integs[idx].prime() * rms[idx];
+	}
+	return AliasTable(weights);
+}
+
 // Logical union of two boolean arrays.
 void zip_and(bool* begin_1, bool* end_1, bool const* begin_2) {
 	bool const* it_2 = begin_2;
@@ -375,6 +594,119 @@ void alloc_sf(
 	}
 }
 
+// Initialization settings chosen by autotuning, together with the
+// measurements they are based on.
+struct Autotune {
+	Int max_cells;
+	Double target_eff;
+	Double scale_exp;
+	// CPU-seconds to draw a single event.
+	Double event_seconds;
+	// CPU-seconds to build the generator, as a constant part plus a part for
+	// each cell.
+	Double init_seconds;
+	Double init_seconds_per_cell;
+	Double bytes_per_cell;
+};
+
+// Chooses the number of cells, target efficiency, and scaling exponent for a
+// generator, to produce `num_events` events in the least CPU time. Two pilot
+// builds with a fixed number of cells give the cost of building, the memory
+// used, the cost of drawing events, and how the relative variance of the
+// weights scales with the number of cells (which is taken to be a power law).
+Autotune autotune(
+		Density const& density,
+		Params const& params,
+		EventType ev_type,
+		Long num_events,
+		int num_threads) {
+	std::array<Double, 2> build_seconds;
+	std::array<Double, 2> rel_var;
+	Autotune result;
+	std::random_device rnd_dev;
+	for (std::size_t pilot = 0; pilot < AUTOTUNE_PILOT_CELLS.size(); ++pilot) {
+		Int cells = AUTOTUNE_PILOT_CELLS[pilot];
+		// Pilot builds use all of their cells, without stopping at a target.
+		Params params_pilot = params;
+		params_pilot.set(p_name_init_max_cells(ev_type), new ValueInt(cells));
+		params_pilot.set(p_name_init_target_eff(ev_type), new ValueDouble(1.));
+		DistParams dist_params(ev_type, params_pilot);
+		Generator gen(density);
+		std::chrono::steady_clock::time_point build_begin
+			= std::chrono::steady_clock::now();
+		gen.build_dist(dist_params);
+		std::chrono::duration<Double> build_duration
+			= std::chrono::steady_clock::now() - build_begin;
+		build_seconds[pilot] = num_threads * build_duration.count();
+
+		std::stringstream ss;
+		if (!Generator::write_dist(ss, gen)) {
+			throw std::runtime_error("Could not write pilot generator to stream.");
+		}
+		result.bytes_per_cell = static_cast<Double>(ss.str().size()) / cells;
+
+		RndEngine rnd(rnd_dev());
+		EventBatch batch;
+		Double sum = 0.;
+		Double sum_sq = 0.;
+		std::chrono::steady_clock::time_point draw_begin
+			= std::chrono::steady_clock::now();
+		for (std::size_t count = 0; count < AUTOTUNE_PILOT_SAMPLES; count += DRAW_BATCH_SIZE) {
+			gen.draw_batch(rnd, DRAW_BATCH_SIZE, batch);
+			for (Double weight : batch.weight) {
+				sum += weight;
+				sum_sq += weight * weight;
+			}
+		}
+		std::chrono::duration<Double> draw_duration
+			= std::chrono::steady_clock::now() - draw_begin;
+		result.event_seconds = draw_duration.count() / AUTOTUNE_PILOT_SAMPLES;
+		if (!(sum > 0.)) {
+			throw std::runtime_error("Pilot generator produced no events.");
+		}
+		rel_var[pilot] = std::max(sum_sq * AUTOTUNE_PILOT_SAMPLES / (sum * sum) - 1., 0.);
+	}
+
+	Double cells_0 = AUTOTUNE_PILOT_CELLS[0];
+	Double cells_1 = AUTOTUNE_PILOT_CELLS[1];
+	result.init_seconds_per_cell = std::max(
+		(build_seconds[1] - build_seconds[0]) / (cells_1 - cells_0),
+		0.);
+	result.init_seconds = std::max(
+		build_seconds[0] - result.init_seconds_per_cell * cells_0,
+		0.);
+	result.scale_exp = 0.;
+	if (rel_var[1] > 0. && rel_var[1] < rel_var[0]) {
+		result.scale_exp = std::min(
+			std::log(rel_var[0] / rel_var[1]) / std::log(cells_1 / cells_0),
+			AUTOTUNE_MAX_SCALE_EXP);
+	}
+
+	// Try cell counts in powers of two, estimating the efficiency of each
+	// from the power law.
+	Double max_cells_memory = AUTOTUNE_MAX_BYTES / result.bytes_per_cell;
+	Double best_seconds = std::numeric_limits<Double>::infinity();
+	result.max_cells = AUTOTUNE_MIN_CELLS;
+	result.target_eff = 0.;
+	Int max_cells = std::min(
+		AUTOTUNE_MAX_CELLS,
+		AUTOTUNE_MAX_EXTRAPOLATION * AUTOTUNE_PILOT_CELLS[1]);
+	for (Int cells = AUTOTUNE_MIN_CELLS;
+			cells <= max_cells && cells <= max_cells_memory;
+			cells *= 2) {
+		Double cell_rel_var = rel_var[1] * std::pow(cells / cells_1, -result.scale_exp);
+		Double eff = 1. / std::sqrt(1. + cell_rel_var);
+		Double seconds = result.init_seconds + result.init_seconds_per_cell * cells
+			+ num_events * result.event_seconds / eff;
+		if (seconds < best_seconds) {
+			best_seconds = seconds;
+			result.max_cells = cells;
+			result.target_eff = eff;
+		}
+	}
+	return result;
+}
+
 int command_help() {
 	std::cout
 		<< "Usage:"                                              << std::endl
@@ -382,6 +714,8 @@ int command_help() {
 		<< "    sidisgen initialize <parameter file>"            << std::endl
 		<< "  Generate events"                                   << std::endl
 		<< "    sidisgen generate <parameter file>"              << std::endl
+		<< "    sidisgen generate <parameter file> --shard i/N"  << std::endl
+		<< "    sidisgen generate <parameter file> --resume"     << std::endl
 		<< "  List parameters used to produce file"              << std::endl
 		<< "    sidisgen inspect <output file>"                  << std::endl
 		<< "  Merge multiple event files into one"               << std::endl
@@ -519,12 +853,16 @@ int command_initialize(std::string params_file_name) {
 
 	// Create generator file.
 	std::string file_name = params["file.gen"].any();
+	GenFileFormat gen_file_format = params["file.gen_format"].any();
 	std::cout << "Creating generator file '" << file_name << "'." << std::endl;
-	TFile file(file_name.c_str(), "CREATE");
-	if (file.IsZombie()) {
+	std::unique_ptr<GenFileWriter> gen_file;
+	try {
+		gen_file.reset(new GenFileWriter(file_name, gen_file_format));
+	} catch (std::exception const& e) {
 		throw Exception(
 			ERROR_FILE_NOT_CREATED,
-			"Could not create generator file '" + file_name + "'.");
+			"Could not create generator file '" + file_name + "': "
+			+ e.what());
 	}
 
 	// Extract parameters needed for building the Monte-Carlo generators.
@@ -540,6 +878,7 @@ int command_initialize(std::string params_file_name) {
 		DistParams dist_params;
 	};
 	std::vector<BuilderTuple> builders;
+	std::unique_ptr<RcTableParams> rc_table_params;
 	std::cout << "Checking parameters." << std::endl;
 	for (EventType ev_type : ev_types) {
 		try {
@@ -547,6 +886,9 @@ int command_initialize(std::string params_file_name) {
 				Density(ev_type, params, *sf),
 				DistParams(ev_type, params)
 			});
+			if (ev_type == EventType::NRAD) {
+				rc_table_params.reset(new RcTableParams(params));
+			}
 		} catch (std::exception const& e) {
 			throw Exception(
 				ERROR_PARAMS_INVALID,
@@ -555,6 +897,42 @@ int command_initialize(std::string params_file_name) {
 		}
 	}
 
+	// Load the generators to warm start from, if any. Event types missing from
+	// the file are built from scratch.
+	std::vector<std::unique_ptr<Generator> > warm_gens(builders.size());
+	if (params.is_set("file.warm_start")) {
+		std::string warm_file_name = params["file.warm_start"].any();
+		std::cout << "Opening warm start generator file '" << warm_file_name << "'." << std::endl;
+		std::unique_ptr<GenFileReader> warm_file;
+		try {
+			warm_file.reset(new GenFileReader(warm_file_name));
+		} catch (std::exception const& e) {
+			throw Exception(
+				ERROR_FILE_NOT_FOUND,
+				"Could not find warm start generator file '" + warm_file_name
+				+ "': " + e.what());
+		}
+		for (std::size_t idx = 0; idx < builders.size(); ++idx) {
+			EventType ev_type = builders[idx].density.event_type;
+			std::string ev_name = event_type_name(ev_type);
+			try {
+				std::unique_ptr<Generator> warm_gen(new Generator(builders[idx].density));
+				if (!warm_file->read_dist(*warm_gen)) {
+					std::cout << "No " << ev_name << " generator to warm start "
+						<< "from, so it will be built from scratch." << std::endl;
+					continue;
+				}
+				std::cout << "Loaded " << ev_name << " generator for warm start." << std::endl;
+				warm_gens[idx] = std::move(warm_gen);
+			} catch (std::exception const& e) {
+				throw Exception(
+					ERROR_READING_FOAM,
+					"Failed to read " + ev_name + " generator from file '"
+					+ warm_file_name + "': " + e.what());
+			}
+		}
+	}
+
 	// Check that all provided parameters were used.
 	try {
 		params.filter("init"_F).check_complete();
@@ -578,52 +956,199 @@ int command_initialize(std::string params_file_name) {
 		0x00000000000000000,
 		0x7FFFFFFFFFFFFFFF);
 
-	// Build the generators and write to file.
-	for (BuilderTuple const& builder : builders) {
-		EventType ev_type = builder.density.event_type;
+	// Build the generators at the same time, each from its own thread. The
+	// threads available to OpenMP are shared between the builds, so that they
+	// don't oversubscribe the cores, and are given to the remaining builds as
+	// each one finishes.
+#ifdef _OPENMP
+	int num_build_threads = omp_get_max_threads();
+#else
+	int num_build_threads = 1;
+#endif
+	// Optimize the radiative channel weights where they weren't provided. The
+	// weights are saved in the generator file, since the generator is only
+	// valid together with the weights it was built for.
+	for (std::size_t idx = 0; idx < builders.size(); ++idx) {
+		if (builders[idx].density.event_type != EventType::RAD
+				|| !builders[idx].density.density.rad.channels()
+				|| params.is_set("mc.rad.init.channel_weights")) {
+			continue;
+		}
+		std::cout << "Optimizing radiative channel weights." << std::endl;
+		RadDensity& density = builders[idx].density.density.rad;
+		RadChannelWeights weights;
+		try {
+			weights = density.optimize_channel_weights(
+				RAD_CHANNEL_SAMPLES, RAD_CHANNEL_ITERS, rnd_dev());
+			density.set_channel_weights(weights);
+		} catch (std::exception const& e) {
+			throw Exception(
+				ERROR_BUILDING_FOAM,
+				std::string("Error while optimizing radiative channel weights: ")
+				+ e.what());
+		}
+		params.set(
+			"mc.rad.init.channel_weights",
+			new ValueVec3(weights[0], weights[1], weights[2]));
+		weights = density.channel_weights();
+		std::cout << "Chose radiative channel weights " << weights[0] << " "
+			<< weights[1] << " " << weights[2] << " (standard, p-peak, s-peak)."
+			<< std::endl;
+	}
+
+	// Tabulate the exact non-radiative radiative correction, if requested. The
+	// table is used in place of the exact correction from here on, and is
+	// saved in the generator file. It must outlive the generators.
+	std::unique_ptr<RcTable> rc_table;
+	for (std::size_t idx = 0; idx < builders.size(); ++idx) {
+		if (builders[idx].density.event_type != EventType::NRAD
+				|| !rc_table_params->enable) {
+			continue;
+		}
+		std::cout << "Tabulating non-radiative radiative correction." << std::endl;
+		NradDensity& density = builders[idx].density.density.nrad;
+		try {
+			rc_table.reset(new RcTable(
+				RcTable::build(density, *rc_table_params, rnd_dev())));
+		} catch (std::exception const& e) {
+			throw Exception(
+				ERROR_BUILDING_FOAM,
+				std::string("Error while tabulating radiative correction: ")
+				+ e.what());
+		}
+		density.set_rc_table(rc_table.get());
+		std::ios_base::fmtflags flags(std::cout.flags());
+		std::cout << std::scientific << std::setprecision(OUTPUT_STATS_PRECISION);
+		std::cout << "Tabulated radiative correction with " << rc_table->num_nodes()
+			<< " nodes and estimated error " << rc_table->error() << "." << std::endl;
+		if (rc_table->error() > rc_table_params->tolerance) {
+			std::cout << "Warning: Radiative correction table reached "
+				<< "'mc.nrad.init.rc_table.max_nodes' before the tolerance "
+				<< rc_table_params->tolerance << "." << std::endl;
+		}
+		std::cout.flags(flags);
+	}
+
+	// Choose the initialization settings automatically where requested. The
+	// chosen settings replace those from the parameter file, so that they are
+	// saved in the generator file.
+	for (std::size_t idx = 0; idx < builders.size(); ++idx) {
+		EventType ev_type = builders[idx].density.event_type;
 		std::string ev_name = event_type_name(ev_type);
-		std::string ev_key = event_type_short_name(ev_type);
+		if (!params[p_name_init_autotune(ev_type)].any()) {
+			continue;
+		}
+		if (!params.is_set("mc.num_events")) {
+			throw Exception(
+				ERROR_PARAMS_INVALID,
+				"Parameter 'mc.num_events' must be provided to autotune the "
+				+ ev_name + " generator.");
+		}
+		Long num_events = params["mc.num_events"].any();
+		std::cout << "Autotuning " << ev_name << " generator." << std::endl;
+		Autotune tune;
+		try {
+			tune = autotune(
+				builders[idx].density, params, ev_type, num_events,
+				num_build_threads);
+			params.set(p_name_init_max_cells(ev_type), new ValueInt(tune.max_cells));
+			params.set(p_name_init_target_eff(ev_type), new ValueDouble(tune.target_eff));
+			params.set(p_name_init_scale_exp(ev_type), new ValueDouble(tune.scale_exp));
+			builders[idx].dist_params = DistParams(ev_type, params);
+		} catch (std::exception const& e) {
+			throw Exception(
+				ERROR_BUILDING_FOAM,
+				"Error while autotuning " + ev_name + " generator: " + e.what());
+		}
+		std::ios_base::fmtflags flags(std::cout.flags());
+		std::cout << std::scientific << std::setprecision(OUTPUT_STATS_PRECISION);
+		std::cout << "Measured " << tune.event_seconds << " s per event, "
+			<< tune.init_seconds << " s plus " << tune.init_seconds_per_cell
+			<< " s per cell to build, and " << tune.bytes_per_cell
+			<< " bytes per cell." << std::endl;
+		std::cout << "Chose " << tune.max_cells << " cells, target efficiency "
+			<< tune.target_eff << ", and scaling exponent " << tune.scale_exp
+			<< "." << std::endl;
+		std::cout.flags(flags);
+	}
+
+	ThreadShare thread_share(num_build_threads, builders.size());
+	std::vector<Generator> gens;
+	gens.reserve(builders.size());
+	std::vector<std::exception_ptr> build_errors(builders.size());
+	for (std::size_t idx = 0; idx < builders.size(); ++idx) {
+		BuilderTuple& builder = builders[idx];
+		EventType ev_type = builder.density.event_type;
 		params.set(p_name_init_uid(ev_type), new ValueLong(uid_dist(rnd)));
-		std::cout << "Building " << ev_name << " generator." << std::endl;
-		Generator gen(builder.density);
+		std::cout << "Building " << event_type_name(ev_type) << " generator." << std::endl;
+		builder.dist_params.threads = ThreadShareTask(&thread_share, idx);
+		gens.emplace_back(builder.density);
+	}
+	auto build = [&](std::size_t idx) {
+		try {
+			gens[idx].build_dist(builders[idx].dist_params, warm_gens[idx].get());
+		} catch (...) {
+			build_errors[idx] = std::current_exception();
+		}
+		thread_share.finish(idx);
+	};
+	if (num_build_threads > 1) {
+		std::vector<std::thread> build_threads;
+		for (std::size_t idx = 0; idx < builders.size(); ++idx) {
+			build_threads.emplace_back(build, idx);
+		}
+		for (std::thread& build_thread : build_threads) {
+			build_thread.join();
+		}
+	} else {
+		// With a single thread, there is nothing to gain from running the
+		// builds at the same time.
+		for (std::size_t idx = 0; idx < builders.size(); ++idx) {
+			build(idx);
+		}
+	}
+
+	// Write the generators to file.
+	for (std::size_t idx = 0; idx < builders.size(); ++idx) {
+		Generator const& gen = gens[idx];
+		EventType ev_type = gen.event_type();
+		std::string ev_name = event_type_name(ev_type);
 		try {
-			gen.build_dist(builder.dist_params);
+			if (build_errors[idx] != nullptr) {
+				std::rethrow_exception(build_errors[idx]);
+			}
 		} catch (std::exception const& e) {
 			throw Exception(
 				ERROR_BUILDING_FOAM,
 				"Error while building " + ev_name + " generator: " + e.what());
 		}
-		// TODO: Write more detailed generator statistics to output. Right now,
-		// only the prime is displayed. But, we could also show the efficiency,
-		// number of cells, relative variance, etc.
+		// Estimate the efficiency that the generator achieved, which may be
+		// short of the target if a budget ran out.
+		Double eff;
+		{
+			RndEngine rnd_eff(rnd_dev());
+			EventBatch batch;
+			Double sum = 0.;
+			Double sum_sq = 0.;
+			for (std::size_t count = 0; count < INIT_EFF_SAMPLES; count += DRAW_BATCH_SIZE) {
+				gen.draw_batch(rnd_eff, DRAW_BATCH_SIZE, batch);
+				for (Double weight : batch.weight) {
+					sum += weight;
+					sum_sq += weight * weight;
+				}
+			}
+			eff = sum_sq > 0. ? sum / std::sqrt(sum_sq * INIT_EFF_SAMPLES) : 0.;
+		}
+		// TODO: Write more detailed generator statistics to output, such as the
+		// number of cells.
 		std::ios_base::fmtflags flags(std::cout.flags());
 		std::cout << std::scientific << std::setprecision(OUTPUT_STATS_PRECISION);
-		std::cout << "Finished " << ev_name << " generator with prime " << gen.prime() << "." << std::endl;
+		std::cout << "Finished " << ev_name << " generator with prime " << gen.prime()
+			<< " and efficiency " << eff << "." << std::endl;
 		std::cout.flags(flags);
 		std::cout << "Writing " << ev_name << " generator to file." << std::endl;
-		// Serialize the generator. This is a little convoluted:
-		// * stringstream -> unique_ptr<char[]> -> TArrayC -> ROOT file
 		try {
-			std::stringstream ss;
-			if (!Generator::write_dist(ss, gen)) {
-				throw std::runtime_error("Could not write to stream.");
-			}
-			ss.seekg(0, std::ios_base::end);
-			std::streamsize data_len = ss.tellg();
-			ss.seekg(0, std::ios_base::beg);
-			if (!ss || data_len > std::numeric_limits<Int_t>::max()) {
-				throw std::runtime_error("Could not get size of stream.");
-			}
-			std::unique_ptr<char[]> data_ptr = std::unique_ptr<char[]>(new char[data_len]);
-			ss.read(&data_ptr[0], data_len);
-			if (!ss || ss.gcount() != data_len) {
-				throw std::runtime_error("Could not copy stream to buffer.");
-			}
-			TArrayC data;
-			data.Adopt(data_len, data_ptr.release());
-			if (file.WriteObject(&data, ev_key.c_str()) == 0) {
-				throw std::runtime_error("Could not write to file.");
-			}
+			gen_file->write_dist(gen);
 		} catch (std::exception const& e) {
 			throw Exception(
 				ERROR_WRITING_FOAM,
@@ -632,9 +1157,21 @@ int command_initialize(std::string params_file_name) {
 		}
 	}
 
+	if (rc_table != nullptr) {
+		std::cout << "Writing radiative correction table to file." << std::endl;
+		try {
+			gen_file->write_rc_table(*rc_table);
+		} catch (std::exception const& e) {
+			throw Exception(
+				ERROR_WRITING_FOAM,
+				"Failed to write radiative correction table to file '"
+				+ file_name + "': " + e.what());
+		}
+	}
+
 	// Write parameters.
 	try {
-		params.write_root(file);
+		gen_file->finish(params);
 	} catch (std::exception const& e) {
 		throw Exception(
 			ERROR_WRITING_PARAMS,
@@ -646,7 +1183,10 @@ int command_initialize(std::string params_file_name) {
 	return SUCCESS;
 }
 
-int command_generate(std::string params_file_name) {
+int command_generate(
+		std::string params_file_name,
+		std::string shard_arg,
+		bool resume) {
 	// Load parameters.
 	std::ifstream params_file(params_file_name);
 	if (!params_file) {
@@ -664,6 +1204,42 @@ int command_generate(std::string params_file_name) {
 			"Failed to parse parameter file '" + params_file_name + "': "
 			+ e.what());
 	}
+	// Shards given on the command line take precedence.
+	if (!shard_arg.empty()) {
+		std::istringstream ss(shard_arg);
+		std::unique_ptr<Value> shard = TypeShardGen::INSTANCE.read_stream(ss);
+		if (!ss || !(ss >> std::ws).eof()) {
+			throw Exception(
+				ERROR_ARG_PARSE,
+				"Failed to parse shard '" + shard_arg + "'.");
+		}
+		params.set("mc.shard", shard.release());
+	}
+	// When resuming, load the checkpoint left by the interrupted run.
+	Checkpoint checkpoint;
+	Params params_checkpoint = PARAMS_STD_FORMAT;
+	std::string checkpoint_name = checkpoint_file_name(params["file.event"].any());
+	if (resume) {
+		std::cout << "Reading checkpoint file '" << checkpoint_name << "'." << std::endl;
+		std::ifstream checkpoint_file(checkpoint_name, std::ios_base::binary);
+		if (!checkpoint_file) {
+			throw Exception(
+				ERROR_FILE_NOT_FOUND,
+				"Could not open checkpoint file '" + checkpoint_name + "'.");
+		}
+		try {
+			if (!read_checkpoint(checkpoint_file, checkpoint)) {
+				throw std::runtime_error("Invalid checkpoint data.");
+			}
+			std::istringstream params_ss(checkpoint.params);
+			params_checkpoint.read_stream(params_ss);
+		} catch (std::exception const& e) {
+			throw Exception(
+				ERROR_READING_CHECKPOINT,
+				"Failed to read checkpoint file '" + checkpoint_name + "': "
+				+ e.what());
+		}
+	}
 	std::cout << std::endl;
 	std::ios_base::fmtflags flags(std::cout.flags());
 	std::cout << std::setprecision(std::numeric_limits<Double>::digits10 + 1);
@@ -686,17 +1262,20 @@ int command_generate(std::string params_file_name) {
 	}
 	std::string foam_file_name = params["file.gen"].any();
 	std::cout << "Opening generator file '" << foam_file_name << "'." << std::endl;
-	TFile foam_file(foam_file_name.c_str(), "OPEN");
-	if (foam_file.IsZombie()) {
+	std::unique_ptr<GenFileReader> foam_file;
+	try {
+		foam_file.reset(new GenFileReader(foam_file_name));
+	} catch (std::exception const& e) {
 		throw Exception(
 			ERROR_FILE_NOT_FOUND,
-			"Could not find generator file '" + foam_file_name + "'.");
+			"Could not find generator file '" + foam_file_name + "': "
+			+ e.what());
 	}
 
 	// Load the parameters from the generator file.
 	Params params_foam = PARAMS_STD_FORMAT;
 	try {
-		params_foam.read_root(foam_file);
+		foam_file->read_params(params_foam);
 	} catch (std::exception const& e) {
 		throw Exception(
 			ERROR_READING_PARAMS,
@@ -706,8 +1285,31 @@ int command_generate(std::string params_file_name) {
 
 	// Create random number engine.
 	std::random_device rnd_dev;
+	bool sharded = params.is_set("mc.shard");
+	ShardGen shard_gen;
+	if (sharded) {
+		shard_gen = params["mc.shard"].any();
+		if (shard_gen.indices.size() != 1) {
+			throw Exception(
+				ERROR_PARAMS_INVALID,
+				"Invalid parameter file '" + params_file_name + "': Parameter "
+				+ "'mc.shard' must provide exactly one shard.");
+		}
+		// Every shard must draw from the same seed, so it can't be random.
+		if (!params.is_set("mc.seed")) {
+			throw Exception(
+				ERROR_PARAMS_INVALID,
+				"Invalid parameter file '" + params_file_name + "': Parameter "
+				+ "'mc.seed' must be provided when using 'mc.shard'.");
+		}
+	}
 	if (!params.is_set("mc.seed")) {
-		params.set("mc.seed", new ValueSeedGen(rnd_dev()));
+		if (resume) {
+			// Continue with the seed chosen by the interrupted run.
+			params.set_from(params_checkpoint, "mc.seed");
+		} else {
+			params.set("mc.seed", new ValueSeedGen(rnd_dev()));
+		}
 	}
 	SeedGen seed_gen = params["mc.seed"].any();
 	if (seed_gen.seeds.size() != 1) {
@@ -716,7 +1318,22 @@ int command_generate(std::string params_file_name) {
 			"Invalid parameter file '" + params_file_name + "': Parameter "
 			+ "'mc.seed' must provide exactly one seed.");
 	}
-	RndEngine rnd(*seed_gen.seeds.begin());
+	Int seed = *seed_gen.seeds.begin();
+
+	// Settings chosen by autotuning are only known from the generator file.
+	for (EventType ev_type : ev_types) {
+		if (params_foam.is_set(p_name_init_autotune(ev_type))
+				&& params_foam.get<ValueBool>(p_name_init_autotune(ev_type)).val) {
+			params.set_from(params_foam.filter(
+				Filter(event_type_short_name(ev_type)) & "init"_F & "tune"_F));
+		}
+	}
+
+	// Optimized radiative channel weights are only known from the generator file.
+	if (params_foam.is_set("mc.rad.init.channel_weights")
+			&& !params.is_set("mc.rad.init.channel_weights")) {
+		params.set_from(params_foam, "mc.rad.init.channel_weights");
+	}
 
 	// Check whether the generator is able to provide the events according to
 	// what the user requested.
@@ -733,10 +1350,28 @@ int command_generate(std::string params_file_name) {
 	// Keeps all of the relevant data for each generator together.
 	struct GenTuple {
 		Generator gen;
-		IntegratorAccum integ;
 		Double rej_scale;
+		// If non-zero, the rejection scale is adapted to this quantile of the
+		// event weights.
+		Double rej_quantile;
+		Long rej_warmup;
+		// Whether the structure functions written with each event are taken
+		// from the density evaluation, instead of being computed separately.
+		bool sf_from_batch;
 	};
+	// The tabulated radiative correction, if any, must outlive the generators.
+	std::unique_ptr<RcTable> rc_table;
 	std::vector<GenTuple> gens;
+	bool write_sf_set = params["file.write_sf_set"].any();
+	// When profiling, the structure functions used by the generators are
+	// timed through a wrapper.
+	bool perf = params["mc.perf"].any();
+	std::unique_ptr<sf::SfSet> sf_perf;
+	if (perf) {
+		sf_perf.reset(new PerfSfSet(*sf));
+	}
+	RcMethod rc_method = params["phys.rc_method"].any();
+	bool rc_table_enable = params["mc.nrad.init.rc_table.enable"].any();
 
 	// Deserialize the generators.
 	for (EventType ev_type : ev_types) {
@@ -744,27 +1379,55 @@ int command_generate(std::string params_file_name) {
 		std::string ev_key = event_type_short_name(ev_type);
 		// Record the UID from the generator.
 		params.set_from(params_foam.filter(Filter(ev_key) & "init"_F & "uid"_F));
+		Double rej_scale = params[p_name_gen_rej_scale(ev_type)].any();
+		Double rej_quantile = params[p_name_gen_rej_quantile(ev_type)].any();
+		Long rej_warmup = params[p_name_gen_rej_warmup(ev_type)].any();
+		if (!(rej_quantile >= 0. && rej_quantile < 1.)) {
+			throw Exception(
+				ERROR_PARAMS_INVALID,
+				"Parameter '" + p_name_gen_rej_quantile(ev_type) + "' must be "
+				+ "in the range [0, 1).");
+		} else if (rej_quantile != 0. && rej_scale != 0.) {
+			throw Exception(
+				ERROR_PARAMS_INVALID,
+				"Parameters '" + p_name_gen_rej_quantile(ev_type) + "' and '"
+				+ p_name_gen_rej_scale(ev_type) + "' can't both be used.");
+		} else if (rej_warmup < 0) {
+			throw Exception(
+				ERROR_PARAMS_INVALID,
+				"Parameter '" + p_name_gen_rej_warmup(ev_type) + "' must not be "
+				+ "negative.");
+		}
+		// The non-radiative density can hand back its structure functions.
+		// This is worthwhile when it computes the full set anyway (the exact
+		// radiative correction, unless tabulated), or when every drawn event is
+		// written. With rejection sampling, it's cheaper to compute them only
+		// for accepted events.
+		bool sf_from_batch = write_sf_set
+			&& ev_type == EventType::NRAD
+			&& ((rc_method == RcMethod::EXACT && !rc_table_enable)
+				|| (rej_scale == 0. && rej_quantile == 0.));
 		std::cout << "Loading " << ev_name << " generator from file." << std::endl;
 		try {
-			TArrayC* data = foam_file.Get<TArrayC>(ev_key.c_str());
-			if (data == nullptr) {
-				throw std::runtime_error("Could not find key '" + ev_key + "'.");
-			}
-			std::stringstream ss;
-			ss.write(data->GetArray(), data->GetSize());
-			if (!ss) {
-				throw std::runtime_error("Could not copy to buffer.");
+			Density density(ev_type, params, perf ? *sf_perf : *sf);
+			if (ev_type == EventType::NRAD && rc_table_enable) {
+				rc_table.reset(new RcTable());
+				if (!foam_file->read_rc_table(*rc_table)) {
+					throw std::runtime_error(
+						"Could not find radiative correction table.");
+				}
+				density.density.nrad.set_rc_table(rc_table.get());
 			}
-			Generator gen(Density(ev_type, params, *sf));
-			if (!Generator::read_dist(ss, gen)) {
-				throw std::runtime_error("Could not read from buffer.");
+			Generator gen(density);
+			if (!foam_file->read_dist(gen)) {
+				throw std::runtime_error("Could not find generator '" + ev_key + "'.");
 			}
-			Double rej_scale = params[p_name_gen_rej_scale(ev_type)].any();
-			IntegratorAccum integ(1. / gen.prime());
 			gens.emplace_back(GenTuple {
 				Generator(std::move(gen)),
-				integ,
 				rej_scale,
+				rej_quantile,
+				rej_warmup,
+				sf_from_batch,
 			});
 		} catch (std::exception const& e) {
 			throw Exception(
@@ -774,16 +1437,69 @@ int command_generate(std::string params_file_name) {
 		}
 	}
 
-	foam_file.Close();
+	foam_file.reset();
+
+	// The resumed run must continue exactly where the interrupted one left off.
+	if (resume) {
+		try {
+			params_checkpoint.check_equivalent(params);
+		} catch (std::exception const& e) {
+			throw Exception(
+				ERROR_PARAMS_INVALID,
+				"Parameters from '" + params_file_name + "' don't match those "
+				+ "of checkpoint '" + checkpoint_name + "': " + e.what());
+		}
+	}
 
-	// Open the event file.
+	// Open the event file. The events are written from a separate thread, so
+	// ROOT must be made thread-safe first. Binary event files are opened later
+	// by their writer.
+	ROOT::EnableThreadSafety();
+	EventFileFormat event_file_format = params["file.format"].any();
 	std::string event_file_name = params["file.event"].any();
 	std::cout << "Opening event file '" << event_file_name << "'." << std::endl;
-	TFile event_file(event_file_name.c_str(), "CREATE");
-	if (event_file.IsZombie()) {
-		throw Exception(
-			ERROR_FILE_NOT_CREATED,
-			"Could not create event file '" + event_file_name + "'.");
+	std::unique_ptr<TFile> event_file;
+	TTree* events_resume = nullptr;
+	if (event_file_format == EventFileFormat::ROOT) {
+		if (!resume) {
+			event_file.reset(new TFile(event_file_name.c_str(), "CREATE"));
+			if (event_file->IsZombie()) {
+				throw Exception(
+					ERROR_FILE_NOT_CREATED,
+					"Could not create event file '" + event_file_name + "'.");
+			}
+		} else {
+			event_file.reset(new TFile(event_file_name.c_str(), "UPDATE"));
+			if (event_file->IsZombie()) {
+				throw Exception(
+					ERROR_FILE_NOT_FOUND,
+					"Could not open event file '" + event_file_name + "'.");
+			}
+			events_resume = event_file->Get<TTree>("events");
+			if (events_resume == nullptr
+					|| events_resume->GetEntries() < checkpoint.num_events) {
+				throw Exception(
+					ERROR_READING_CHECKPOINT,
+					"Events in event file '" + event_file_name + "' don't match "
+					+ "checkpoint '" + checkpoint_name + "'.");
+			}
+			// The tree is saved before the checkpoint is, so an interruption in
+			// between leaves extra events in the tree. Those will be generated
+			// again, so only keep the events up to the checkpoint.
+			if (events_resume->GetEntries() > checkpoint.num_events) {
+				TTree* events_trimmed = events_resume->CloneTree(checkpoint.num_events);
+				if (events_trimmed == nullptr
+						|| events_trimmed->GetEntries() != checkpoint.num_events) {
+					throw Exception(
+						ERROR_READING_CHECKPOINT,
+						"Could not remove events past checkpoint '"
+						+ checkpoint_name + "' from event file '"
+						+ event_file_name + "'.");
+				}
+				delete events_resume;
+				events_resume = events_trimmed;
+			}
+		}
 	}
 
 	// Setup initial conditions.
@@ -796,67 +1512,161 @@ int command_generate(std::string params_file_name) {
 	part::Particles ps(target, beam, hadron, M_th);
 	Double S = 2.*beam_energy*ps.M;
 
-	kin::Initial init(ps, beam_energy);
 	Long num_events = params["mc.num_events"].any();
 	if (num_events <= 0) {
 		throw Exception(
 			ERROR_PARAMS_INVALID,
 			"Parameter 'mc.num_events' must be greater than zero.");
 	}
-
-	// Prepare branches in output ROOT file.
-	event_file.cd();
-	TTree events("events", "events");
-	Int ev_idx;
-	Double weight;
-	Double x, y, z, ph_t_sq, phi_h, phi, tau, phi_k, R;
-	TLorentzVector p, k1, q, k2, ph, k;
-	events.Branch("type", &ev_idx);
-	events.Branch("weight", &weight);
-	events.Branch("x", &x);
-	events.Branch("y", &y);
-	events.Branch("z", &z);
-	events.Branch("ph_t_sq", &ph_t_sq);
-	events.Branch("phi_h", &phi_h);
-	events.Branch("phi", &phi);
-	events.Branch("tau", &tau);
-	events.Branch("phi_k", &phi_k);
-	events.Branch("R", &R);
-	bool write_momenta = params["file.write_momenta"].any();
-	bool write_photon = false;
-	bool write_sf_set = params["file.write_sf_set"].any();
-	bool write_mc_coords = params["file.write_mc_coords"].any();
-	if (write_momenta) {
-		events.Branch("p", "TLorentzVector", &p);
-		events.Branch("k1", "TLorentzVector", &k1);
-		events.Branch("q", "TLorentzVector", &q);
-		events.Branch("k2", "TLorentzVector", &k2);
-		events.Branch("ph", "TLorentzVector", &ph);
-		if (params["mc.rad.enable"].any()) {
-			write_photon = params["file.write_photon"].any();
-			if (write_photon) {
-				events.Branch("k", "TLorentzVector", &k);
+	Int num_threads = params["mc.num_threads"].any();
+	if (num_threads < 0) {
+		throw Exception(
+			ERROR_PARAMS_INVALID,
+			"Parameter 'mc.num_threads' must not be negative.");
+	} else if (num_threads == 0) {
+		num_threads = std::max<Int>(static_cast<Int>(std::thread::hardware_concurrency()), 1);
+	}
+	if (resume) {
+		// The number of workers determines which events are generated, so it
+		// must match the interrupted run even if it came from the hardware.
+		num_threads = static_cast<Int>(checkpoint.workers.size());
+		for (WorkerCheckpoint const& worker : checkpoint.workers) {
+			if (worker.integs.size() != gens.size()) {
+				throw Exception(
+					ERROR_READING_CHECKPOINT,
+					"Checkpoint '" + checkpoint_name + "' doesn't match the "
+					+ "enabled event types.");
 			}
 		}
 	}
-	sf::SfLP sf_out;
-	if (write_sf_set) {
-		// TODO: Right now, this is depending on the `SfXX` structure having a
-		// very specific format. This isn't guaranteed to be true in the future,
-		// if things get reorganized. Not sure what a better approach is, as
-		// ROOT doesn't have another way of writing plain C-structs into trees.
-		events.Branch("sf", &sf_out,
-			"F_UUL/D:F_UUT/D:F_UU_cos_phih/D:F_UU_cos_2phih/D:F_UL_sin_phih/D:F_UL_sin_2phih/D:F_UTL_sin_phih_m_phis/D:F_UTT_sin_phih_m_phis/D:F_UT_sin_2phih_m_phis/D:F_UT_sin_3phih_m_phis/D:F_UT_sin_phis/D:F_UT_sin_phih_p_phis/D:F_LU_sin_phih/D:F_LL/D:F_LL_cos_phih/D:F_LT_cos_phih_m_phis/D:F_LT_cos_2phih_m_phis/D:F_LT_cos_phis/D");
+	Double checkpoint_interval = params["mc.checkpoint_interval"].any();
+	if (!(checkpoint_interval >= 0.)) {
+		throw Exception(
+			ERROR_PARAMS_INVALID,
+			"Parameter 'mc.checkpoint_interval' must not be negative.");
 	}
-	Double mc_coords[9];
-	Double jacobian;
+	// Each worker has its own random number stream and integrators. The
+	// generators are shared between the workers, since drawing from them
+	// doesn't modify them. Each worker runs on its own thread, and passes the
+	// events it draws on in blocks through its own queue. The blocks are taken
+	// from the queues in order of worker, so that the output doesn't depend on
+	// the thread scheduling. Each worker also keeps a batch of pending events
+	// for every generator, which are used up one at a time.
+	struct WorkerTuple {
+		RndEngine rnd;
+		std::vector<IntegratorAccum> integs;
+		AliasTable gen_schedule;
+		std::vector<EventBatch> batches;
+		std::vector<std::size_t> batch_idxs;
+		// Current rejection scale for each generator, together with the
+		// weight distribution used to adapt it, and the number of accepted
+		// events with weights above the scale.
+		std::vector<Double> rej_scales;
+		std::vector<QuantileAccum> weight_dists;
+		std::vector<Long> num_overflow;
+		Long num_events;
+		Long num_events_done;
+		PerfCounters perf;
+		std::exception_ptr error;
+	};
+	std::vector<WorkerTuple> workers;
+	std::size_t shard_idx = *shard_gen.indices.begin();
+	for (Int worker_idx = 0; worker_idx < num_threads; ++worker_idx) {
+		std::vector<IntegratorAccum> integs;
+		std::vector<Double> rej_scales;
+		for (GenTuple const& gen : gens) {
+			integs.push_back(IntegratorAccum(1. / gen.gen.prime()));
+			rej_scales.push_back(gen.rej_scale);
+		}
+		Long num_events_begin = num_events * worker_idx / num_threads;
+		Long num_events_end = num_events * (worker_idx + 1) / num_threads;
+		workers.push_back(WorkerTuple {
+			make_rnd_stream(seed, shard_idx, worker_idx),
+			integs,
+			AliasTable(),
+			std::vector<EventBatch>(gens.size()),
+			std::vector<std::size_t>(gens.size(), 0),
+			rej_scales,
+			std::vector<QuantileAccum>(gens.size()),
+			std::vector<Long>(gens.size(), 0),
+			num_events_end - num_events_begin,
+			0,
+			PerfCounters(),
+			nullptr,
+		});
+		if (resume) {
+			WorkerTuple& worker = workers.back();
+			WorkerCheckpoint const& worker_checkpoint = checkpoint.workers[worker_idx];
+			worker.rnd = worker_checkpoint.rnd;
+			worker.integs = worker_checkpoint.integs;
+			worker.gen_schedule = worker_checkpoint.gen_schedule;
+			worker.batches = worker_checkpoint.batches;
+			worker.batch_idxs = worker_checkpoint.batch_idxs;
+			worker.rej_scales = worker_checkpoint.rej_scales;
+			worker.weight_dists = worker_checkpoint.weight_dists;
+			worker.num_overflow = worker_checkpoint.num_overflow;
+			worker.num_events_done = worker_checkpoint.num_events_done;
+		}
+	}
+
+	// Snapshots the state of a worker between blocks of events.
+	auto save_worker = [&](WorkerTuple const& worker) {
+		WorkerCheckpoint worker_checkpoint;
+		worker_checkpoint.rnd = worker.rnd;
+		worker_checkpoint.num_events_done = worker.num_events_done;
+		worker_checkpoint.gen_schedule = worker.gen_schedule;
+		worker_checkpoint.integs = worker.integs;
+		worker_checkpoint.batches = worker.batches;
+		worker_checkpoint.batch_idxs = worker.batch_idxs;
+		worker_checkpoint.rej_scales = worker.rej_scales;
+		worker_checkpoint.weight_dists = worker.weight_dists;
+		worker_checkpoint.num_overflow = worker.num_overflow;
+		return worker_checkpoint;
+	};
+
+	// Prepare the writer for the output file.
+	WriterOptions writer_options;
+	writer_options.write_momenta = params["file.write_momenta"].any();
+	writer_options.write_photon = false;
+	writer_options.write_sf_set = write_sf_set;
+	writer_options.checkpoints = checkpoint_interval > 0.;
+	if (writer_options.write_momenta && params["mc.rad.enable"].any()) {
+		writer_options.write_photon = params["file.write_photon"].any();
+	}
+	bool write_mc_coords = params["file.write_mc_coords"].any();
 	if (write_mc_coords) {
-		events.Branch("mc_coords", &mc_coords, "mc_coords[9]/D");
-		events.Branch("jac", &jacobian);
 		throw Exception(
 			ERROR_UNIMPLEMENTED,
 			"Parameter 'file.write_mc_coords' not yet implemented.");
 	}
+	std::unique_ptr<RootWriter> root_writer;
+	std::unique_ptr<BinaryWriter> binary_writer;
+	EventWriter* writer;
+	if (event_file_format == EventFileFormat::ROOT) {
+		event_file->cd();
+		try {
+			root_writer.reset(new RootWriter(
+				writer_options, ps, beam_energy, target_pol, events_resume));
+		} catch (std::exception const& e) {
+			throw Exception(
+				ERROR_READING_CHECKPOINT,
+				"Could not continue event file '" + event_file_name + "': "
+				+ e.what());
+		}
+		writer = root_writer.get();
+	} else {
+		try {
+			binary_writer.reset(new BinaryWriter(
+				event_file_name, writer_options, ps, beam_energy, target_pol,
+				resume ? checkpoint.num_events : -1));
+		} catch (std::exception const& e) {
+			throw Exception(
+				resume ? ERROR_READING_CHECKPOINT : ERROR_FILE_NOT_CREATED,
+				"Could not " + std::string(resume ? "continue" : "create")
+				+ " event file '" + event_file_name + "': " + e.what());
+		}
+		writer = binary_writer.get();
+	}
 
 	// Check that all provided parameters were used.
 	try {
@@ -872,189 +1682,499 @@ int command_generate(std::string params_file_name) {
 		}
 	}
 
-	// Write parameters.
-	try {
-		params.write_root(event_file);
-	} catch (std::exception const& e) {
-		throw Exception(
-			ERROR_WRITING_PARAMS,
-			"Failed to write parameters to event file '" + event_file_name
-			+ "': " + e.what());
+	// Write parameters. Binary event files get their parameters at the end, and
+	// resumed ROOT files already have them.
+	std::ostringstream params_ss;
+	params_ss << std::setprecision(std::numeric_limits<Double>::max_digits10);
+	params.write_stream(params_ss);
+	std::string params_text = params_ss.str();
+	if (event_file_format == EventFileFormat::ROOT && !resume) {
+		try {
+			params.write_root(*event_file);
+		} catch (std::exception const& e) {
+			throw Exception(
+				ERROR_WRITING_PARAMS,
+				"Failed to write parameters to event file '" + event_file_name
+				+ "': " + e.what());
+		}
 	}
 
-	// Generate events.
-	std::cout << "Generating events." << std::endl;
-	bool update_progress = true;
-	std::size_t percent = 0;
-	Long next_percent_rem = num_events % 100;
-	Long next_percent = num_events / 100;
-	for (Long event_idx = 0; event_idx < num_events; ++event_idx) {
-		// Update the progress bar.
-		while (event_idx >= next_percent + (next_percent_rem != 0)) {
-			percent += 1;
-			next_percent = math::prod_div(num_events, percent + 1, 100, next_percent_rem);
-			update_progress = true;
-		}
-		if (update_progress) {
-			write_progress_bar(std::cout, percent);
-			std::cout << '\r';
-			std::cout << std::flush;
-			update_progress = false;
-		}
-
-		// Choose a type of event (ex. radiative or non-radiative) to generate.
-		std::size_t chosen_gen_idx;
-		if (event_idx == 0) {
-			// On the first event, we don't know anything about the total cross-
-			// sections, so choose the event type arbitrarily.
-			chosen_gen_idx = 0;
-		} else {
-			// We want to generate events so that the total weights contributed
-			// by events of each type have the same ratio as the cross-sections
-			// of each type.
-			Double ratio_max = 0.;
-			for (std::size_t idx = 0; idx < gens.size(); ++idx) {
-				Integrator integ = gens[idx].integ.total_fast();
-				// Equivalent to cross-section divided by total weight.
-				Double ratio = integ.weights_acc().est_sqrt_m2() / integ.norm();
-				if (!std::isfinite(ratio)) {
-					ratio = std::numeric_limits<Double>::infinity();
+	// Estimates the adaptive rejection scales of a worker from a warm-up
+	// sample. The warm-up is split between the workers.
+	auto warm_up = [&](WorkerTuple& worker) {
+		EventBatch batch;
+		for (std::size_t idx = 0; idx < gens.size(); ++idx) {
+			GenTuple const& gen = gens[idx];
+			if (gen.rej_quantile == 0.) {
+				continue;
+			}
+			Long num_warmup = (gen.rej_warmup + num_threads - 1) / num_threads;
+			while (num_warmup > 0) {
+				std::size_t n = static_cast<std::size_t>(
+					std::min<Long>(num_warmup, DRAW_BATCH_SIZE));
+				gen.gen.draw_batch(worker.rnd, n, batch);
+				for (Double weight : batch.weight) {
+					worker.weight_dists[idx] += weight;
 				}
-				if (ratio > ratio_max) {
-					ratio_max = ratio;
-					chosen_gen_idx = idx;
+				num_warmup -= n;
+			}
+			worker.rej_scales[idx] = worker.weight_dists[idx].quantile(gen.rej_quantile);
+		}
+	};
+
+	// Draws the next block of events on a single worker.
+	auto generate_block = [&](
+			WorkerTuple& worker,
+			std::vector<EventRecord>& records,
+			std::vector<sf::SfLP>& sfs) {
+		records.clear();
+		sfs.clear();
+		// Update the adaptive rejection scales with the weights seen so far.
+		// Since the scale is fixed before any event of the block is drawn, the
+		// reweighting below still leaves the average weight unchanged.
+		for (std::size_t idx = 0; idx < gens.size(); ++idx) {
+			if (gens[idx].rej_quantile != 0.) {
+				worker.rej_scales[idx] = worker.weight_dists[idx].quantile(
+					gens[idx].rej_quantile);
+			}
+		}
+		while (records.size() < EVENT_BLOCK_SIZE
+				&& worker.num_events_done < worker.num_events) {
+			// Choose a type of event (ex. radiative or non-radiative) to
+			// generate.
+			if (worker.num_events_done % GEN_SCHEDULE_INTERVAL == 0) {
+				worker.gen_schedule = make_gen_schedule(worker.integs);
+			}
+			std::size_t chosen_gen_idx = worker.gen_schedule.draw(worker.rnd);
+			Generator const& gen = gens[chosen_gen_idx].gen;
+			IntegratorAccum& integ = worker.integs[chosen_gen_idx];
+			EventBatch& batch = worker.batches[chosen_gen_idx];
+			std::size_t& batch_idx = worker.batch_idxs[chosen_gen_idx];
+			Double rej_scale = worker.rej_scales[chosen_gen_idx];
+			bool adaptive = gens[chosen_gen_idx].rej_quantile != 0.;
+
+			// Generate an event.
+			Double weight;
+			do {
+				// Take the next event from the current generator, drawing a
+				// new batch once the pending one is used up.
+				if (batch_idx >= batch.size()) {
+					gen.draw_batch(
+						worker.rnd, DRAW_BATCH_SIZE, batch,
+						gens[chosen_gen_idx].sf_from_batch);
+					batch_idx = 0;
+				}
+				weight = batch.weight[batch_idx];
+				batch_idx += 1;
+				if (adaptive) {
+					worker.weight_dists[chosen_gen_idx] += weight;
+				}
+
+				// Apply rejection sampling through reweighting events, where
+				// "rejected" events are simply reweighted to zero. The scaling
+				// used here assures that the average weight will remain
+				// unchanged after rescaling.
+				if (rej_scale != 0.) {
+					std::uniform_real_distribution<Double> dist;
+					Double rej = dist(worker.rnd);
+					if (weight < rej * rej_scale) {
+						// Event is rejected.
+						weight = 0.;
+					} else if (weight < rej_scale) {
+						// Event is accepted.
+						weight = rej_scale;
+					} else {
+						// Event overflows rejection scale. Leave it as is.
+						worker.num_overflow[chosen_gen_idx] += 1;
+					}
+				}
+
+				// Update the integrator.
+				integ += weight;
+			} while (weight == 0.);
+			EventRecord record = event_record(batch, batch_idx - 1);
+			record.weight = weight;
+			if (writer_options.write_sf_set) {
+				// Radiative events need the unshifted structure functions,
+				// which the density doesn't compute.
+				if (!batch.sf.empty()) {
+					sfs.push_back(batch.sf[batch_idx - 1]);
+				} else {
+					sfs.push_back(sf->sf_lp(
+						hadron,
+						record.x, record.z, S * record.x * record.y, record.ph_t_sq));
 				}
 			}
+			records.push_back(record);
+			worker.num_events_done += 1;
 		}
-		Generator const& gen = gens[chosen_gen_idx].gen;
-		EventType ev_type = gen.event_type();
+		// Fold the weights of the block into the totals, so that the worker
+		// state can be checkpointed exactly. This is done after every block,
+		// whether or not a checkpoint is taken, so that the events don't
+		// depend on when checkpoints happen.
+		for (IntegratorAccum& integ : worker.integs) {
+			integ.flush();
+		}
+	};
 
-		// Generate an event.
-		Event event;
+	// The ROOT output is handled by a dedicated writer thread, so that the
+	// workers don't have to wait on compression or disk access. Event records
+	// are passed to it through a queue, ending with an `EVENT_RECORD_END`
+	// record. An `EVENT_RECORD_CHECKPOINT` record asks the writer to save
+	// `checkpoint_next` once all of the events before it are on disk. When
+	// writing structure functions, they go through a second queue, with one
+	// entry for each event record, so that the records themselves stay small.
+	std::size_t writer_queue_size = std::max(
+		WRITER_QUEUE_SIZE,
+		2 * static_cast<std::size_t>(num_threads) * EVENT_BLOCK_SIZE);
+	RingBuffer<EventRecord> writer_queue(writer_queue_size);
+	RingBuffer<sf::SfLP> writer_sf_queue(
+		writer_options.write_sf_set ? writer_queue_size : 1);
+	std::exception_ptr writer_error;
+	std::atomic<bool> writer_failed(false);
+	Checkpoint checkpoint_next;
+	checkpoint_next.workers.resize(num_threads);
+	std::atomic<bool> checkpoint_pending(false);
+	PerfCounters writer_perf;
+	std::thread writer_thread([&]() {
+		EventRecord record;
+		sf::SfLP record_sf;
 		do {
-			// Draw from the current generator.
-			event = gen.draw(rnd);
-			IntegratorAccum& integ = gens[chosen_gen_idx].integ;
-			Double rej_scale = gens[chosen_gen_idx].rej_scale;
-
-			// Apply rejection sampling through reweighting events, where
-			// "rejected" events are simply reweighted to zero. The scaling used
-			// here assures that the average weight will remain unchanged after
-			// rescaling.
-			if (rej_scale != 0.) {
-				std::uniform_real_distribution<Double> dist;
-				Double rej = dist(rnd);
-				if (event.weight < rej * rej_scale) {
-					// Event is rejected.
-					event.weight = 0.;
-				} else if (event.weight < rej_scale) {
-					// Event is accepted.
-					event.weight = rej_scale;
-				} else {
-					// Event overflows rejection scale. Leave it as is.
+			writer_queue.pop(&record);
+			bool is_event = record.type != EVENT_RECORD_CHECKPOINT
+				&& record.type != EVENT_RECORD_END;
+			if (is_event && writer_options.write_sf_set) {
+				writer_sf_queue.pop(&record_sf);
+			}
+			// After a failure, keep draining the queue so that the generation
+			// loop is never blocked.
+			if (record.type == EVENT_RECORD_CHECKPOINT && !writer_failed) {
+				try {
+					PerfTimer timer(PerfPart::IO);
+					std::ostringstream checkpoint_ss;
+					if (!write_checkpoint(checkpoint_ss, checkpoint_next)) {
+						throw std::runtime_error("Could not serialize checkpoint.");
+					}
+					writer->checkpoint();
+					write_checkpoint_file(checkpoint_name, checkpoint_ss.str());
+					checkpoint_pending = false;
+				} catch (std::exception const& e) {
+					writer_error = std::make_exception_ptr(Exception(
+						ERROR_WRITING_CHECKPOINT,
+						"Failed to write checkpoint '" + checkpoint_name + "': "
+						+ e.what()));
+					writer_failed = true;
+				}
+			} else if (is_event && !writer_failed) {
+				try {
+					PerfTimer timer(PerfPart::IO);
+					writer->write(record, record_sf);
+				} catch (...) {
+					writer_error = std::current_exception();
+					writer_failed = true;
 				}
 			}
+		} while (record.type != EVENT_RECORD_END);
+		writer_perf = perf_take();
+	});
+
+	// Each worker has a fixed set of blocks, which go back and forth between a
+	// queue of free blocks and a queue of drawn blocks. This way, a worker can
+	// keep drawing events while its earlier blocks are handed to the writer,
+	// but never gets more than `NUM_WORKER_BLOCKS` blocks ahead.
+	struct EventBlock {
+		std::vector<EventRecord> records;
+		// Only filled in when writing structure functions.
+		std::vector<sf::SfLP> sfs;
+		// Whether the worker has stopped after this block.
+		bool last;
+		// Snapshot of the worker after this block, if one was asked for.
+		bool has_checkpoint;
+		WorkerCheckpoint checkpoint;
+	};
+	std::vector<EventBlock> blocks(num_threads * NUM_WORKER_BLOCKS);
+	// The queues can't be moved, so they are kept in a `std::deque`.
+	std::deque<RingBuffer<EventBlock*> > free_blocks;
+	std::deque<RingBuffer<EventBlock*> > drawn_blocks;
+	for (Int worker_idx = 0; worker_idx < num_threads; ++worker_idx) {
+		free_blocks.emplace_back(NUM_WORKER_BLOCKS);
+		drawn_blocks.emplace_back(NUM_WORKER_BLOCKS);
+		for (std::size_t idx = 0; idx < NUM_WORKER_BLOCKS; ++idx) {
+			EventBlock* block = &blocks[worker_idx * NUM_WORKER_BLOCKS + idx];
+			block->records.reserve(EVENT_BLOCK_SIZE);
+			if (writer_options.write_sf_set) {
+				block->sfs.reserve(EVENT_BLOCK_SIZE);
+			}
+			free_blocks.back().push(block);
+		}
+	}
+	// Index of the block after which every worker saves a snapshot for the
+	// next checkpoint, or negative if there is none.
+	std::atomic<Long> checkpoint_block(-1);
+	// Asks the workers to stop early, after a failure.
+	std::atomic<bool> workers_stop(false);
+	auto run_worker = [&](Int worker_idx) {
+		WorkerTuple& worker = workers[worker_idx];
+		// Draw the warm-up samples for adaptive rejection sampling. A resumed
+		// run already has them from the checkpoint.
+		try {
+			if (!resume) {
+				warm_up(worker);
+			}
+		} catch (...) {
+			worker.error = std::current_exception();
+		}
+		Long block_idx = 0;
+		bool last = false;
+		while (!last) {
+			EventBlock* block;
+			free_blocks[worker_idx].pop(&block);
+			block->records.clear();
+			block->sfs.clear();
+			block->has_checkpoint = false;
+			if (worker.error == nullptr && !workers_stop) {
+				try {
+					generate_block(worker, block->records, block->sfs);
+				} catch (...) {
+					worker.error = std::current_exception();
+				}
+			}
+			last = worker.error != nullptr || workers_stop
+				|| worker.num_events_done >= worker.num_events;
+			if (!last && block_idx == checkpoint_block) {
+				block->has_checkpoint = true;
+				block->checkpoint = save_worker(worker);
+			}
+			block->last = last;
+			drawn_blocks[worker_idx].push(block);
+			block_idx += 1;
+		}
+		worker.perf += perf_take();
+	};
 
-			// Update the integrator.
-			integ += event.weight;
-		} while (event.weight == 0.);
+	// Generate events.
+	std::cout << "Generating events." << std::endl;
+	perf_enabled = perf;
+	std::chrono::steady_clock::time_point gen_begin = std::chrono::steady_clock::now();
+	std::vector<std::thread> worker_threads;
+	std::vector<bool> workers_done(num_threads, false);
+	std::exception_ptr gen_error;
+	try {
+		for (Int worker_idx = 0; worker_idx < num_threads; ++worker_idx) {
+			worker_threads.emplace_back(run_worker, worker_idx);
+		}
 
-		// Fill in the branches.
-		ev_idx = static_cast<Int>(ev_type) + 1;
-		weight = event.weight;
-		switch (event.event_type) {
-		case EventType::NRAD:
-			// Non-radiative event.
-			{
-				x = event.kin.nrad.x;
-				y = event.kin.nrad.y;
-				z = event.kin.nrad.z;
-				ph_t_sq = event.kin.nrad.ph_t_sq;
-				phi_h = event.kin.nrad.phi_h;
-				phi = event.kin.nrad.phi;
-				tau = 0.;
-				phi_k = 0.;
-				R = 0.;
-				if (write_momenta) {
-					kin::Final fin(init, target_pol, event.kin.nrad);
-					p = convert_vec4(init.p);
-					k1 = convert_vec4(init.k1);
-					q = convert_vec4(fin.q);
-					k2 = convert_vec4(fin.k2);
-					ph = convert_vec4(fin.ph);
-					k = TLorentzVector();
+		bool update_progress = true;
+		std::size_t percent = 0;
+		Long next_percent_rem = num_events % 100;
+		Long next_percent = num_events / 100;
+		Long event_idx = resume ? checkpoint.num_events : 0;
+		std::chrono::steady_clock::duration checkpoint_duration
+			= std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+				std::chrono::duration<Double>(checkpoint_interval));
+		std::chrono::steady_clock::time_point next_checkpoint
+			= std::chrono::steady_clock::now() + checkpoint_duration;
+		// Checkpoints are only taken between blocks that every worker still
+		// has left to draw.
+		Long num_blocks_min = std::numeric_limits<Long>::max();
+		for (WorkerTuple const& worker : workers) {
+			Long num_events_left = worker.num_events - worker.num_events_done;
+			Long num_blocks = (num_events_left + EVENT_BLOCK_SIZE - 1) / EVENT_BLOCK_SIZE;
+			num_blocks_min = std::min(num_blocks_min, num_blocks);
+		}
+		Int num_workers_done = 0;
+		Long block_idx = 0;
+		while (num_workers_done < num_threads && !writer_failed) {
+			// Take the next block from each worker in turn.
+			for (Int worker_idx = 0; worker_idx < num_threads; ++worker_idx) {
+				if (workers_done[worker_idx]) {
+					continue;
 				}
-				if (write_sf_set) {
-					sf_out = sf->sf_lp(hadron, x, z, S * x * y, ph_t_sq);
+				EventBlock* block;
+				drawn_blocks[worker_idx].pop(&block);
+				if (block->last) {
+					workers_done[worker_idx] = true;
+					num_workers_done += 1;
 				}
-			}
-			break;
-		case EventType::RAD:
-			// Radiative event.
-			{
-				x = event.kin.rad.x;
-				y = event.kin.rad.y;
-				z = event.kin.rad.z;
-				ph_t_sq = event.kin.rad.ph_t_sq;
-				phi_h = event.kin.rad.phi_h;
-				phi = event.kin.rad.phi;
-				tau = event.kin.rad.tau;
-				phi_k = event.kin.rad.phi_k;
-				R = event.kin.rad.R;
-				if (write_momenta) {
-					kin::FinalRad fin(init, target_pol, event.kin.rad);
-					p = convert_vec4(init.p);
-					k1 = convert_vec4(init.k1);
-					q = convert_vec4(fin.q);
-					k2 = convert_vec4(fin.k2);
-					ph = convert_vec4(fin.ph);
-					k = convert_vec4(fin.k);
+				if (workers[worker_idx].error != nullptr) {
+					free_blocks[worker_idx].push(block);
+					std::rethrow_exception(workers[worker_idx].error);
+				}
+				for (std::size_t idx = 0; idx < block->records.size(); ++idx) {
+					// Update the progress bar.
+					while (event_idx >= next_percent + (next_percent_rem != 0)) {
+						percent += 1;
+						next_percent = math::prod_div(num_events, percent + 1, 100, next_percent_rem);
+						update_progress = true;
+					}
+					if (update_progress) {
+						write_progress_bar(std::cout, percent);
+						std::cout << '\r';
+						std::cout << std::flush;
+						update_progress = false;
+					}
+
+					// Hand the event off to the writer.
+					if (writer_options.write_sf_set) {
+						writer_sf_queue.push(block->sfs[idx]);
+					}
+					writer_queue.push(block->records[idx]);
+					event_idx += 1;
 				}
-				if (write_sf_set) {
-					sf_out = sf->sf_lp(hadron, x, z, S * x * y, ph_t_sq);
+				if (block->has_checkpoint) {
+					checkpoint_next.workers[worker_idx] = std::move(block->checkpoint);
 				}
+				free_blocks[worker_idx].push(block);
 			}
-			break;
-		default:
-			UNREACHABLE();
+
+			// Once every worker's snapshot has arrived, the writer can save
+			// the checkpoint after the events before it.
+			if (block_idx == checkpoint_block) {
+				checkpoint_next.params = params_text;
+				checkpoint_next.num_events = event_idx;
+				EventRecord record_checkpoint;
+				record_checkpoint.type = EVENT_RECORD_CHECKPOINT;
+				writer_queue.push(record_checkpoint);
+			}
+			// Ask for the next checkpoint at the first block that no worker
+			// can have finished yet. Skip it if the writer hasn't finished
+			// with the previous one.
+			Long checkpoint_block_next = block_idx + NUM_WORKER_BLOCKS + 1;
+			if (checkpoint_interval > 0.
+					&& checkpoint_block_next < num_blocks_min - 1
+					&& !checkpoint_pending
+					&& std::chrono::steady_clock::now() >= next_checkpoint) {
+				checkpoint_pending = true;
+				checkpoint_block = checkpoint_block_next;
+				next_checkpoint = std::chrono::steady_clock::now() + checkpoint_duration;
+			}
+			block_idx += 1;
+		}
+	} catch (...) {
+		gen_error = std::current_exception();
+	}
+	// Stop the workers, and take their remaining blocks, so that none of them
+	// is left waiting for a free block.
+	workers_stop = true;
+	for (std::size_t worker_idx = 0; worker_idx < worker_threads.size(); ++worker_idx) {
+		while (!workers_done[worker_idx]) {
+			EventBlock* block;
+			drawn_blocks[worker_idx].pop(&block);
+			workers_done[worker_idx] = block->last;
+			free_blocks[worker_idx].push(block);
+		}
+		worker_threads[worker_idx].join();
+	}
+	EventRecord record_end;
+	record_end.type = EVENT_RECORD_END;
+	writer_queue.push(record_end);
+	writer_thread.join();
+	if (gen_error != nullptr) {
+		std::rethrow_exception(gen_error);
+	}
+	if (writer_error != nullptr) {
+		try {
+			std::rethrow_exception(writer_error);
+		} catch (Exception const&) {
+			throw;
+		} catch (std::exception const& e) {
+			throw Exception(
+				ERROR_WRITING_EVENTS,
+				"Failed to write events to event file '" + event_file_name
+				+ "': " + e.what());
 		}
-		events.Fill();
 	}
 	write_progress_bar(std::cout, 100);
 	std::cout << std::endl;
 
 	// Write events to file.
 	std::cout << "Writing events to file." << std::endl;
-	if (event_file.WriteObject(&events, events.GetName()) == 0) {
-		throw Exception(
-			ERROR_WRITING_EVENTS,
-			"Could not write events to event file '" + event_file_name + "'.");
+	if (event_file_format == EventFileFormat::ROOT) {
+		PerfTimer timer(PerfPart::IO);
+		TTree& events = root_writer->tree();
+		// Replace any copy of the tree saved at a checkpoint.
+		if (event_file->WriteObject(&events, events.GetName(), "WriteDelete") == 0) {
+			throw Exception(
+				ERROR_WRITING_EVENTS,
+				"Could not write events to event file '" + event_file_name + "'.");
+		}
 	}
+	std::chrono::duration<Double> gen_time
+		= std::chrono::steady_clock::now() - gen_begin;
+	perf_enabled = false;
 
 	// Handle statistics.
 	std::cout << "Statistics:" << std::endl;
 	IntegratorArray integs;
 	for (std::size_t idx = 0; idx < gens.size(); ++idx) {
 		Generator const& gen = gens[idx].gen;
-		Integrator integ = gens[idx].integ.total();
+		// Combine the statistics from every worker.
+		Integrator integ = workers[0].integs[idx].total();
+		for (std::size_t worker_idx = 1; worker_idx < workers.size(); ++worker_idx) {
+			integ += workers[worker_idx].integs[idx].total();
+		}
 		std::string header = event_type_name(gen.event_type()) + std::string(" events");
 		// Show statistics to user.
 		stream_write_integ(std::cout, header, integ);
+		if (gens[idx].rej_scale != 0. || gens[idx].rej_quantile != 0.) {
+			Double rej_scale = 0.;
+			Long num_overflow = 0;
+			for (WorkerTuple const& worker : workers) {
+				rej_scale += worker.rej_scales[idx] / workers.size();
+				num_overflow += worker.num_overflow[idx];
+			}
+			stream_write_rej(std::cout, rej_scale, num_overflow, integ);
+		}
 		// Add integrator to array to keep track of totals.
 		integs[gen.event_type()] = integ;
 	}
 	if (gens.size() > 1) {
 		stream_write_integ(std::cout, "total", integs.total());
 	}
+	// Combine the profiles from every thread. A resumed run only includes the
+	// events generated since the checkpoint.
+	PerfCounters perf_total = perf_take();
+	perf_total += writer_perf;
+	for (WorkerTuple const& worker : workers) {
+		perf_total += worker.perf;
+	}
+	Long num_events_perf = resume ? num_events - checkpoint.num_events : num_events;
+	if (perf) {
+		std::cout << "Profile:" << std::endl;
+		stream_write_perf(std::cout, perf_total, num_events_perf, gen_time.count());
+	}
 	// Write stats to file.
-	root_write_integs(event_file, integs);
+	if (event_file_format == EventFileFormat::ROOT) {
+		root_write_integs(*event_file, integs);
+		if (perf) {
+			root_write_perf(*event_file, perf_total, num_events_perf, gen_time.count());
+		}
+	} else {
+		std::array<event_file::Stats, NUM_EVENT_TYPES + 1> stats;
+		for (std::size_t arr_idx = 0; arr_idx < NUM_EVENT_TYPES + 1; ++arr_idx) {
+			stats[arr_idx] = event_file_stats(
+				arr_idx == 0 ? integs.total() : integs.map[arr_idx - 1]);
+		}
+		try {
+			binary_writer->finish(params_text, stats);
+		} catch (std::exception const& e) {
+			throw Exception(
+				ERROR_WRITING_STATS,
+				"Could not write statistics to file '" + event_file_name
+				+ "': " + e.what());
+		}
+	}
+
+	// The event file is complete, so the checkpoint is no longer needed.
+	if (checkpoint_interval > 0. || resume) {
+		std::remove(checkpoint_name.c_str());
+	}
 
 	return SUCCESS;
 }
 
-int command_merge_soft(
-		std::string file_out_name,
-		std::vector<std::string> file_names) {
+// Merges the parameters from a set of event files.
+Params merge_params_from_files(std::vector<std::string> const& file_names) {
 	std::cout << "Merging parameters from files." << std::endl;
 	Params params_out;
 	bool first = true;
@@ -1088,10 +2208,14 @@ int command_merge_soft(
 			}
 		}
 	}
+	return params_out;
+}
 
+// Merges the statistics from a set of event files.
+IntegratorArray merge_integs_from_files(std::vector<std::string> const& file_names) {
 	std::cout << "Merging statistics from files." << std::endl;
 	IntegratorArray integs;
-	first = true;
+	bool first = true;
 	for (std::string const& file_name : file_names) {
 		// TODO: Ensure that the merged statistics come from the same underlying
 		// FOAM.
@@ -1109,6 +2233,14 @@ int command_merge_soft(
 		}
 		first = false;
 	}
+	return integs;
+}
+
+int command_merge_soft(
+		std::string file_out_name,
+		std::vector<std::string> file_names) {
+	Params params_out = merge_params_from_files(file_names);
+	IntegratorArray integs = merge_integs_from_files(file_names);
 
 	TFile file_out(file_out_name.c_str(), "CREATE");
 	if (file_out.IsZombie()) {
@@ -1145,13 +2277,56 @@ int command_merge_soft(
 int command_merge_hard(
 		std::string file_out_name,
 		std::vector<std::string> file_names) {
-	static_cast<void>(file_out_name);
-	static_cast<void>(file_names);
-	throw Exception(
-		ERROR_UNIMPLEMENTED,
-		"Hard merges are not yet supported.");
-}
+	// Merging the parameters checks that the shards are disjoint, so here only
+	// need to check that they are complete. This only requires the parameters,
+	// so it is done before any events are copied.
+	Params params_out = merge_params_from_files(file_names);
+	if (params_out.is_set("mc.shard")) {
+		ShardGen shard_gen = params_out["mc.shard"].any();
+		if (!shard_gen.complete()) {
+			std::string message = "Shards '"
+				+ params_out["mc.shard"].to_string() + "' are incomplete.";
+			if (params_out["strict"].any()) {
+				throw Exception(ERROR_MERGING_PARAMS, message);
+			} else {
+				std::cout << "Warning: " << message << std::endl;
+			}
+		}
+	}
+	IntegratorArray integs = merge_integs_from_files(file_names);
+
+	TFile file_out(file_out_name.c_str(), "CREATE");
+	if (file_out.IsZombie()) {
+		throw Exception(
+			ERROR_FILE_NOT_CREATED,
+			"Could not create file '" + file_out_name + "'.");
+	}
+	try {
+		params_out.write_root(file_out);
+	} catch (std::exception const& e) {
+		throw Exception(
+			ERROR_WRITING_PARAMS,
+			"Failed to write parameters to file '" + file_out_name + "': "
+			+ e.what());
+	}
+	root_write_integs(file_out, integs);
 
+	// Copy the compressed baskets directly, without unpacking the events.
+	std::cout << "Merging events from files." << std::endl;
+	file_out.cd();
+	TChain chain("events", "events");
+	for (std::string const& file_name : file_names) {
+		std::cout << "\t" << file_name << std::endl;
+		chain.Add(file_name.c_str());
+	}
+	if (chain.Merge(&file_out, 0, "fast keep") == 0) {
+		throw Exception(
+			ERROR_WRITING_EVENTS,
+			"Could not write events to file '" + file_out_name + "'.");
+	}
+
+	return SUCCESS;
+}
 }
 
 int main(int argc, char** argv) {
@@ -1208,16 +2383,29 @@ int main(int argc, char** argv) {
 			}
 			return command_initialize(argv[2]);
 		} else if (command == "generate" || command == "-g") {
-			if (argc > 3) {
-				throw Exception(
-					ERROR_ARG_PARSE,
-					"Unexpected argument '" + std::string(argv[3]) + "'.");
-			} else if (argc < 3) {
+			if (argc < 3) {
 				throw Exception(
 					ERROR_ARG_PARSE,
 					"Expected parameter file argument.");
 			}
-			return command_generate(argv[2]);
+			std::string shard_arg;
+			bool resume = false;
+			int arg_idx = 3;
+			while (arg_idx < argc) {
+				std::string arg = argv[arg_idx];
+				if (arg == "--shard" && arg_idx + 1 < argc) {
+					shard_arg = argv[arg_idx + 1];
+					arg_idx += 2;
+				} else if (arg == "--resume") {
+					resume = true;
+					arg_idx += 1;
+				} else {
+					throw Exception(
+						ERROR_ARG_PARSE,
+						"Unexpected argument '" + arg + "'.");
+				}
+			}
+			return command_generate(argv[2], shard_arg, resume);
 		} else if (command == "merge-soft") {
 			if (argc < 4) {
 				throw Exception(
@@ -1,6 +1,7 @@
 #include "params_format.hpp"
 
 #include <algorithm>
+#include <cmath>
 #include <functional>
 #include <ios>
 #include <istream>
@@ -36,6 +37,8 @@ Tag overview.
 * "excl": Applies to exclusive events.
 * "seed": For random-number-generation seeds.
 * "uid": For unique identifiers.
+* "tune": Initialization settings that are chosen automatically when
+  autotuning is enabled.
 * "num": Special tag exclusively for "mc.num_events" parameter, as this
   parameter must be treated specially.
 * "cut-no-nrad": Special tag for cuts which are incompatible with non-radiative
@@ -60,15 +63,46 @@ extern Params const PARAMS_STD_FORMAT = []() {
 	params.add_param(
 		"file.event", TypeString::INSTANCE,
 		{ "gen", "file", "nrad", "rad", "excl" },
-		"<file>", "ROOT file for generated events",
-		"Path to ROOT file to be created to hold generated events. Will give "
-		"error instead of overwriting an existing file.");
+		"<file>", "file for generated events",
+		"Path to file to be created to hold generated events, in the format "
+		"given by 'file.format'. Will give error instead of overwriting an "
+		"existing file.");
 	params.add_param(
 		"file.gen", TypeString::INSTANCE,
 		{ "init", "gen", "file", "nrad", "rad", "excl" },
-		"<file>", "ROOT file for generator",
-		"Path to ROOT file to save the generator to after initialization. Will "
-		"give error instead of overwriting an existing file.");
+		"<file>", "file for generator",
+		"Path to file to save the generator to after initialization, in the "
+		"format given by 'file.gen_format'. Will give error instead of "
+		"overwriting an existing file. When reading, the format is detected "
+		"automatically.");
+	params.add_param(
+		"file.gen_format", new ValueGenFileFormat(GenFileFormat::MAPPED),
+		{ "init", "nrad", "rad", "excl" },
+		"<root/mapped>", "format of generator file",
+		"Format of the generator file. Either a ROOT file, or a flat binary "
+		"file that is memory-mapped when generating, so that the generators are "
+		"used without being copied into memory, and so that processes on the "
+		"same machine share the same physical memory for them. On systems "
+		"without memory mapping, the file is read into memory instead. ROOT "
+		"files can't hold generators larger than 2 GB. Default 'mapped'.");
+	params.add_param(
+		"file.warm_start", TypeString::INSTANCE,
+		{ "init", "file", "nrad", "rad" },
+		"<file>", "file for warm start of generator",
+		"Path to an existing generator file to start initialization from. "
+		"Rather than building from scratch, the cells or grid of each previous "
+		"generator are reused, and only the regions where the cross-section "
+		"has changed are explored again. Useful after small changes to the "
+		"cuts or setup. Only supported by the 'foam' and 'vegas' engines, and "
+		"each engine must match 'mc.<ev>.init.dist'.");
+	params.add_param(
+		"file.format", new ValueEventFileFormat(EventFileFormat::ROOT),
+		{ "gen", "write", "nrad", "rad", "excl" },
+		"<root/binary>", "format of event file",
+		"Format of the event file. Either a ROOT file with an 'events' tree, "
+		"or a flat binary file of fixed-size little-endian records that can be "
+		"memory-mapped (see 'sidis/extra/event_file.hpp'). Binary files can't "
+		"be merged. Default 'root'.");
 	params.add_param(
 		"file.write_momenta", new ValueBool(false),
 		{ "gen", "write", "nrad", "rad", "excl" },
@@ -107,6 +141,23 @@ extern Params const PARAMS_STD_FORMAT = []() {
 		"The rescaling factor used for non-radiative event weights during "
 		"rejection sampling. Larger values make generation slower, but improve "
 		"efficiency. Suggested between 0 and 2. Default '0'.");
+	params.add_param(
+		"mc.nrad.gen.rej_quantile", new ValueDouble(0.),
+		{ "gen", "dist", "nrad" },
+		"<real in [0,1)>", "adaptive rejection sampling for non-radiative events",
+		"If non-zero, the rescaling factor for non-radiative rejection sampling "
+		"is chosen automatically as this quantile of the event weights (e.x. "
+		"'0.999'). The quantile is estimated from a warm-up sample and kept up "
+		"to date during generation. Can't be used together with "
+		"'mc.nrad.gen.rej_scale'. Default '0'.");
+	params.add_param(
+		"mc.nrad.gen.rej_warmup", new ValueLong(16384),
+		{ "gen", "dist", "nrad" },
+		"<int>", "warm-up events for non-radiative rejection sampling",
+		"Number of non-radiative events drawn to estimate the rescaling factor "
+		"before generation starts, when 'mc.nrad.gen.rej_quantile' is "
+		"used. Warm-up events are neither written nor counted in the "
+		"statistics. Default '16384'.");
 	params.add_param(
 		"mc.nrad.init.uid", TypeLong::INSTANCE,
 		{ "init", "uid", "nrad" },
@@ -115,24 +166,155 @@ extern Params const PARAMS_STD_FORMAT = []() {
 		"initialization. Should not be set manually.");
 	params.add_param(
 		"mc.nrad.init.max_cells", new ValueInt(262144),
-		{ "init", "dist", "nrad" },
+		{ "init", "dist", "tune", "nrad" },
 		"<int>", "max number of cells in non-radiative FOAM",
 		"Maximum number of cells that will be created during construction of "
 		"the non-radiative FOAM. Default '262144'.");
 	params.add_param(
-		"mc.nrad.init.target_eff", new ValueDouble(0.95),
+		"mc.nrad.init.max_seconds", new ValueDouble(0.),
+		{ "init", "dist", "nrad" },
+		"<real>", "time budget for non-radiative initialization",
+		"Maximum number of seconds to spend building the non-radiative "
+		"generator. Once used up, refinement stops and the generator built so "
+		"far is kept. For 'bubble', the budget is turned into a limit on the "
+		"number of cells beforehand, so it is only approximate. If '0', no "
+		"limit. Default '0'.");
+	params.add_param(
+		"mc.nrad.init.max_evals", new ValueLong(0),
 		{ "init", "dist", "nrad" },
+		"<int>", "evaluation budget for non-radiative initialization",
+		"Maximum number of cross-section evaluations to spend building the "
+		"non-radiative generator, in the same way as "
+		"'mc.nrad.init.max_seconds'. If '0', no limit. Default '0'.");
+	params.add_param(
+		"mc.nrad.init.target_eff", new ValueDouble(0.95),
+		{ "init", "dist", "tune", "nrad" },
 		"<real in [0,1]>", "efficiency for non-radiative FOAM initialization",
 		"Efficiency which the non-radiative FOAM will be constructed to "
 		"achieve. Larger values may cause the initialization process to take "
 		"much longer. Default value '0.95'.");
 	params.add_param(
 		"mc.nrad.init.scale_exp", new ValueDouble(0.50),
-		{ "init", "dist", "nrad" },
+		{ "init", "dist", "tune", "nrad" },
 		"<real>", "scaling exponent for non-radiative FOAM initialization",
 		"Estimate of the scaling exponent relating non-radiative FOAM "
 		"efficiency to number of cells. Accurate value allows for faster "
 		"construction of FOAM. Suggested between 0 and 2. Default '0.50'.");
+	params.add_param(
+		"mc.nrad.init.autotune", new ValueBool(false),
+		{ "init", "dist", "nrad" },
+		"<on/off>", "choose non-radiative initialization settings automatically",
+		"Should the settings for building the non-radiative generator be "
+		"chosen automatically? Short pilot builds measure the cost of the "
+		"cross-section, the efficiency reached for a number of cells, and the "
+		"memory used by each cell. From these, the number of cells, target "
+		"efficiency, and scaling exponent are chosen to generate "
+		"'mc.num_events' events in the least total time. The chosen values "
+		"replace 'mc.nrad.init.max_cells', 'mc.nrad.init.target_eff', and "
+		"'mc.nrad.init.scale_exp', and are saved in the generator file. "
+		"Default 'off'.");
+	params.add_param(
+		"mc.nrad.init.dist", new ValueDistType(DistType::BUBBLE),
+		{ "init", "dist", "nrad" },
+		"<bubble/foam/vegas>", "engine for the non-radiative generator",
+		"Type of distribution used to approximate the non-radiative "
+		"cross-section. 'bubble' and 'foam' build a tree of cells, with "
+		"'foam' exploring the cells in parallel and drawing events from a "
+		"flat table of the leaf cells in constant time, while 'bubble' walks "
+		"the tree for each event. 'vegas' adapts a separable grid, which is "
+		"much faster to build in many dimensions but may reach a lower "
+		"efficiency. Default 'bubble'.");
+	params.add_param(
+		"mc.nrad.init.foam.samples", new ValueInt(512),
+		{ "init", "dist", "nrad" },
+		"<int>", "samples per cell in non-radiative FOAM",
+		"Number of density evaluations used to explore each cell of the "
+		"non-radiative FOAM. The number of cells is limited by "
+		"'mc.nrad.init.max_cells'. Default '512'.");
+	params.add_param(
+		"mc.nrad.init.foam.bins", new ValueInt(8),
+		{ "init", "dist", "nrad" },
+		"<int>", "split positions per dimension in non-radiative FOAM",
+		"Number of bins along each dimension of a non-radiative FOAM cell, "
+		"whose edges are the candidate positions for splitting the cell. "
+		"Default '8'.");
+	params.add_param(
+		"mc.nrad.init.vegas.bins", new ValueInt(128),
+		{ "init", "dist", "nrad" },
+		"<int>", "grid bins per dimension in non-radiative VEGAS",
+		"Number of bins along each dimension of the non-radiative VEGAS grid. "
+		"Default '128'.");
+	params.add_param(
+		"mc.nrad.init.vegas.samples", new ValueLong(262144),
+		{ "init", "dist", "nrad" },
+		"<int>", "samples per iteration of non-radiative VEGAS",
+		"Number of density evaluations in each iteration of the non-radiative VEGAS "
+		"grid adaptation. The samples are stratified, with as many strata as "
+		"allowed by 'mc.nrad.init.max_cells'. Default '262144'.");
+	params.add_param(
+		"mc.nrad.init.vegas.iters", new ValueInt(16),
+		{ "init", "dist", "nrad" },
+		"<int>", "max iterations of non-radiative VEGAS",
+		"Maximum number of iterations of the non-radiative VEGAS grid adaptation. "
+		"Adaptation stops earlier once 'mc.nrad.init.target_eff' is reached. "
+		"Default '16'.");
+	params.add_param(
+		"mc.nrad.init.rc_table.enable", new ValueBool(false),
+		{ "init", "dist", "nrad" },
+		"<on/off>", "tabulate the exact non-radiative radiative correction",
+		"Should the exact radiative correction to the non-radiative "
+		"cross-section be tabulated during initialization? The correction is "
+		"tabulated relative to the infrared-divergent part of the "
+		"cross-section, as harmonics in 'phi_h' and 'phi' over a grid in "
+		"'x', 'y', 'z', and 'ph_t_sq', and is stored in the generator file. "
+		"The non-radiative cross-section is then interpolated from the table, "
+		"at about the cost of 'phys.rc_method' 'approx'. Requires "
+		"'phys.rc_method' to be 'exact'. Default 'off'.");
+	params.add_param(
+		"mc.nrad.init.rc_table.tolerance", new ValueDouble(1e-3),
+		{ "init", "dist", "nrad" },
+		"<real>", "error tolerance of the radiative correction table",
+		"Error allowed in the tabulated radiative correction, relative to the "
+		"infrared-divergent part of the cross-section. The error at each point "
+		"is weighted by the cross-section there, relative to its average over "
+		"the phase space. The grid is refined along the dimension with the "
+		"largest estimated error until all are within the tolerance, or until "
+		"'mc.nrad.init.rc_table.max_nodes' is reached. Default '1e-3'.");
+	params.add_param(
+		"mc.nrad.init.rc_table.max_nodes", new ValueInt(20000),
+		{ "init", "dist", "nrad" },
+		"<int>", "max nodes in the radiative correction table",
+		"Maximum number of grid nodes in the radiative correction table. Each "
+		"node needs 8 evaluations of the exact radiative correction, or 64 if "
+		"the target has transverse polarization. Default '20000'.");
+	params.add_param(
+		"mc.nrad.map.x", new ValueVarMap(VarMapType::INVERSE, 1e-3),
+		{ "init", "dist", "nrad" },
+		"<linear/inverse/log/decay> <scale>", "non-radiative mapping of 'x'",
+		"Transformation from the unit hypercube onto 'x' for non-radiative "
+		"events, given as 'linear', 'inverse <offset>', 'log <offset>', or "
+		"'decay <length>' (see 'sidis/extra/map.hpp'). Choosing a "
+		"transformation that follows the cross-section flattens it before "
+		"it reaches the generator. The defaults for each variable are the "
+		"transformations used by 'cut::take'. Default 'inverse 0.001'.");
+	params.add_param(
+		"mc.nrad.map.y", new ValueVarMap(VarMapType::INVERSE, 0.),
+		{ "init", "dist", "nrad" },
+		"<linear/inverse/log/decay> <scale>", "non-radiative mapping of 'y'",
+		"Transformation from the unit hypercube onto 'y' for non-radiative "
+		"events, in the same form as 'mc.nrad.map.x'. Default 'inverse 0'.");
+	params.add_param(
+		"mc.nrad.map.z", new ValueVarMap(VarMapType::LINEAR),
+		{ "init", "dist", "nrad" },
+		"<linear/inverse/log/decay> <scale>", "non-radiative mapping of 'z'",
+		"Transformation from the unit hypercube onto 'z' for non-radiative "
+		"events, in the same form as 'mc.nrad.map.x'. Default 'linear'.");
+	params.add_param(
+		"mc.nrad.map.ph_t_sq", new ValueVarMap(VarMapType::DECAY, 0.25),
+		{ "init", "dist", "nrad" },
+		"<linear/inverse/log/decay> <scale>", "non-radiative mapping of 'ph_t_sq'",
+		"Transformation from the unit hypercube onto 'ph_t_sq' for non-radiative "
+		"events, in the same form as 'mc.nrad.map.x'. Default 'decay 0.25'.");
 	params.add_param(
 		"mc.rad.enable", new ValueBool(true),
 		{ "init", "gen", "rad" },
@@ -147,6 +329,23 @@ extern Params const PARAMS_STD_FORMAT = []() {
 		"The rescaling factor used for radiative event weights during "
 		"rejection sampling. Larger values make generation slower, but improve "
 		"efficiency. Suggested between 0 and 2. Default '0'.");
+	params.add_param(
+		"mc.rad.gen.rej_quantile", new ValueDouble(0.),
+		{ "gen", "dist", "rad" },
+		"<real in [0,1)>", "adaptive rejection sampling for radiative events",
+		"If non-zero, the rescaling factor for radiative rejection sampling "
+		"is chosen automatically as this quantile of the event weights (e.x. "
+		"'0.999'). The quantile is estimated from a warm-up sample and kept up "
+		"to date during generation. Can't be used together with "
+		"'mc.rad.gen.rej_scale'. Default '0'.");
+	params.add_param(
+		"mc.rad.gen.rej_warmup", new ValueLong(16384),
+		{ "gen", "dist", "rad" },
+		"<int>", "warm-up events for radiative rejection sampling",
+		"Number of radiative events drawn to estimate the rescaling factor "
+		"before generation starts, when 'mc.rad.gen.rej_quantile' is "
+		"used. Warm-up events are neither written nor counted in the "
+		"statistics. Default '16384'.");
 	params.add_param(
 		"mc.rad.init.uid", TypeLong::INSTANCE,
 		{ "init", "uid", "rad" },
@@ -155,24 +354,139 @@ extern Params const PARAMS_STD_FORMAT = []() {
 		"initialization. Should not be set manually.");
 	params.add_param(
 		"mc.rad.init.max_cells", new ValueInt(262144),
-		{ "init", "dist", "rad" },
+		{ "init", "dist", "tune", "rad" },
 		"<int>", "max number of cells in radiative FOAM",
 		"Maximum number of cells that will be created during construction of "
 		"the radiative FOAM. Default '262144'.");
 	params.add_param(
-		"mc.rad.init.target_eff", new ValueDouble(0.50),
+		"mc.rad.init.max_seconds", new ValueDouble(0.),
+		{ "init", "dist", "rad" },
+		"<real>", "time budget for radiative initialization",
+		"Maximum number of seconds to spend building the radiative "
+		"generator. Once used up, refinement stops and the generator built so "
+		"far is kept. For 'bubble', the budget is turned into a limit on the "
+		"number of cells beforehand, so it is only approximate. If '0', no "
+		"limit. Default '0'.");
+	params.add_param(
+		"mc.rad.init.max_evals", new ValueLong(0),
 		{ "init", "dist", "rad" },
+		"<int>", "evaluation budget for radiative initialization",
+		"Maximum number of cross-section evaluations to spend building the "
+		"radiative generator, in the same way as "
+		"'mc.rad.init.max_seconds'. If '0', no limit. Default '0'.");
+	params.add_param(
+		"mc.rad.init.target_eff", new ValueDouble(0.50),
+		{ "init", "dist", "tune", "rad" },
 		"<real in [0,1]>", "efficiency for radiative FOAM initialization",
 		"Efficiency which the radiative FOAM will be constructed to achieve. "
 		"Larger values may cause the initialization process to take much "
 		"longer. Default value '0.50'.");
 	params.add_param(
 		"mc.rad.init.scale_exp", new ValueDouble(0.18),
-		{ "init", "dist", "rad" },
+		{ "init", "dist", "tune", "rad" },
 		"<real>", "scaling exponent for radiative FOAM initialization",
 		"Estimate of the scaling exponent relating radiative FOAM efficiency "
 		"to number of cells. Accurate value allows for faster construction of "
 		"FOAM. Suggested between 0 and 2. Default '0.18'.");
+	params.add_param(
+		"mc.rad.init.autotune", new ValueBool(false),
+		{ "init", "dist", "rad" },
+		"<on/off>", "choose radiative initialization settings automatically",
+		"Should the settings for building the radiative generator be "
+		"chosen automatically? Short pilot builds measure the cost of the "
+		"cross-section, the efficiency reached for a number of cells, and the "
+		"memory used by each cell. From these, the number of cells, target "
+		"efficiency, and scaling exponent are chosen to generate "
+		"'mc.num_events' events in the least total time. The chosen values "
+		"replace 'mc.rad.init.max_cells', 'mc.rad.init.target_eff', and "
+		"'mc.rad.init.scale_exp', and are saved in the generator file. "
+		"Default 'off'.");
+	params.add_param(
+		"mc.rad.init.dist", new ValueDistType(DistType::BUBBLE),
+		{ "init", "dist", "rad" },
+		"<bubble/foam/vegas>", "engine for the radiative generator",
+		"Type of distribution used to approximate the radiative "
+		"cross-section. 'bubble' and 'foam' build a tree of cells, with "
+		"'foam' exploring the cells in parallel and drawing events from a "
+		"flat table of the leaf cells in constant time, while 'bubble' walks "
+		"the tree for each event. 'vegas' adapts a separable grid, which is "
+		"much faster to build in many dimensions but may reach a lower "
+		"efficiency. Default 'bubble'.");
+	params.add_param(
+		"mc.rad.init.foam.samples", new ValueInt(512),
+		{ "init", "dist", "rad" },
+		"<int>", "samples per cell in radiative FOAM",
+		"Number of density evaluations used to explore each cell of the "
+		"radiative FOAM. The number of cells is limited by "
+		"'mc.rad.init.max_cells'. Default '512'.");
+	params.add_param(
+		"mc.rad.init.foam.bins", new ValueInt(8),
+		{ "init", "dist", "rad" },
+		"<int>", "split positions per dimension in radiative FOAM",
+		"Number of bins along each dimension of a radiative FOAM cell, "
+		"whose edges are the candidate positions for splitting the cell. "
+		"Default '8'.");
+	params.add_param(
+		"mc.rad.init.vegas.bins", new ValueInt(128),
+		{ "init", "dist", "rad" },
+		"<int>", "grid bins per dimension in radiative VEGAS",
+		"Number of bins along each dimension of the radiative VEGAS grid. "
+		"Default '128'.");
+	params.add_param(
+		"mc.rad.init.vegas.samples", new ValueLong(262144),
+		{ "init", "dist", "rad" },
+		"<int>", "samples per iteration of radiative VEGAS",
+		"Number of density evaluations in each iteration of the radiative VEGAS "
+		"grid adaptation. The samples are stratified, with as many strata as "
+		"allowed by 'mc.rad.init.max_cells'. Default '262144'.");
+	params.add_param(
+		"mc.rad.init.vegas.iters", new ValueInt(16),
+		{ "init", "dist", "rad" },
+		"<int>", "max iterations of radiative VEGAS",
+		"Maximum number of iterations of the radiative VEGAS grid adaptation. "
+		"Adaptation stops earlier once 'mc.rad.init.target_eff' is reached. "
+		"Default '16'.");
+	params.add_param(
+		"mc.rad.init.channels", new ValueBool(false),
+		{ "init", "dist", "rad" },
+		"<on/off>", "multichannel sampling of radiative events",
+		"Whether to sample 'tau' for radiative events from several channels: "
+		"the standard mapping, and channels dedicated to the s-peak and the "
+		"p-peak, where the photon is collinear with the incoming or outgoing "
+		"lepton. The channel weights are optimized during initialization, "
+		"unless 'mc.rad.init.channel_weights' is provided. Default 'off'.");
+	params.add_param(
+		"mc.rad.init.channel_weights", TypeVec3::INSTANCE,
+		{ "init", "dist", "rad" },
+		"<standard> <p-peak> <s-peak>", "radiative channel weights",
+		"Relative weights of the radiative channels, when "
+		"'mc.rad.init.channels' is enabled. If not provided, the weights are "
+		"optimized during initialization, and then stored in the generator "
+		"file.");
+	params.add_param(
+		"mc.rad.map.x", new ValueVarMap(VarMapType::INVERSE, 1e-3),
+		{ "init", "dist", "rad" },
+		"<linear/inverse/log/decay> <scale>", "radiative mapping of 'x'",
+		"Transformation from the unit hypercube onto 'x' for radiative "
+		"events, in the same form as 'mc.nrad.map.x'. Default 'inverse 0.001'.");
+	params.add_param(
+		"mc.rad.map.y", new ValueVarMap(VarMapType::INVERSE, 0.),
+		{ "init", "dist", "rad" },
+		"<linear/inverse/log/decay> <scale>", "radiative mapping of 'y'",
+		"Transformation from the unit hypercube onto 'y' for radiative "
+		"events, in the same form as 'mc.nrad.map.x'. Default 'inverse 0'.");
+	params.add_param(
+		"mc.rad.map.z", new ValueVarMap(VarMapType::LINEAR),
+		{ "init", "dist", "rad" },
+		"<linear/inverse/log/decay> <scale>", "radiative mapping of 'z'",
+		"Transformation from the unit hypercube onto 'z' for radiative "
+		"events, in the same form as 'mc.nrad.map.x'. Default 'linear'.");
+	params.add_param(
+		"mc.rad.map.ph_t_sq", new ValueVarMap(VarMapType::DECAY, 0.25),
+		{ "init", "dist", "rad" },
+		"<linear/inverse/log/decay> <scale>", "radiative mapping of 'ph_t_sq'",
+		"Transformation from the unit hypercube onto 'ph_t_sq' for radiative "
+		"events, in the same form as 'mc.nrad.map.x'. Default 'decay 0.25'.");
 	params.add_param(
 		"mc.num_events", TypeLong::INSTANCE,
 		{ "gen", "num" },
@@ -185,6 +499,46 @@ extern Params const PARAMS_STD_FORMAT = []() {
 		"<int>, any", "seed for generated events",
 		"The seed that will be used for generating events. If 'any', seed is "
 		"chosen randomly. Default 'any'.");
+	params.add_param(
+		"mc.shard", TypeShardGen::INSTANCE,
+		{ "gen" },
+		"<index>/<count>", "shard of a larger generation job",
+		"Splits a generation job into independent shards, for running on a "
+		"batch farm. Every shard uses the same 'mc.seed', but draws from its "
+		"own random number stream. The streams come from a counter-based "
+		"engine (Philox4x64) keyed on the seed, with every shard and worker "
+		"using its own range of counters, so they never overlap. The shards "
+		"can be recombined using "
+		"`sidisgen merge-hard`, which checks that every shard is present "
+		"exactly once. Can also be provided with `sidisgen generate --shard`.");
+	params.add_param(
+		"mc.num_threads", new ValueInt(1),
+		{ "gen" },
+		"<int>", "number of threads for generating events",
+		"Number of workers that generate events in parallel. Each worker has "
+		"an independent random number stream derived from 'mc.seed', so the "
+		"generated events depend on this value, but not on the number of "
+		"cores available. If '0', uses one worker per hardware thread. "
+		"Default '1'.");
+	params.add_param(
+		"mc.checkpoint_interval", new ValueDouble(0.),
+		{ "gen" },
+		"<real (s)>", "time between checkpoints of event generation",
+		"Wall-clock time (in seconds) between checkpoints of the generator "
+		"state. Checkpoints are written next to the event file, with the "
+		"'.ckpt' extension, and allow an interrupted run to be continued "
+		"with `sidisgen generate --resume`, producing the same events as an "
+		"uninterrupted run. If '0', no checkpoints are made. Default '0'.");
+	params.add_param(
+		"mc.perf", new ValueBool(false),
+		{ "gen" },
+		"<on/off>", "report throughput and time spent in the generator",
+		"Should a profile of the event generation be reported? This includes "
+		"the number of events per second, the number of density evaluations "
+		"per event, the reasons for evaluations with zero weight, and the "
+		"time spent in each part of the generator. It is written to standard "
+		"output and to the 'stats/perf' directory of ROOT event files. Adds a "
+		"small overhead to the generation. Default 'off'.");
 	params.add_param(
 		"setup.beam_energy", TypeDouble::INSTANCE,
 		{ "init", "gen", "xs", "dist", "nrad", "rad", "excl" },
@@ -425,6 +779,42 @@ void params_merge_seed_gen(
 		params_out);
 }
 
+void params_merge_shard_gen(
+		Params const& params_1,
+		Params const& params_2,
+		std::string const& name,
+		Params* params_out) {
+	return params_merge_value<ValueShardGen>(
+		params_1, params_2, name,
+		[](ShardGen a, ShardGen b) {
+			a.indices.insert(b.indices.begin(), b.indices.end());
+			return a;
+		},
+		params_out);
+}
+
+void params_merge_int_max(
+		Params const& params_1,
+		Params const& params_2,
+		std::string const& name,
+		Params* params_out) {
+	return params_merge_value<ValueInt>(
+		params_1, params_2, name,
+		[](Int a, Int b) { return std::max(a, b); },
+		params_out);
+}
+
+void params_merge_double_max(
+		Params const& params_1,
+		Params const& params_2,
+		std::string const& name,
+		Params* params_out) {
+	return params_merge_value<ValueDouble>(
+		params_1, params_2, name,
+		[](Double a, Double b) { return std::max(a, b); },
+		params_out);
+}
+
 void params_merge_count(
 		Params const& params_1,
 		Params const& params_2,
@@ -443,6 +833,38 @@ std::runtime_error make_incompatible_param_error(
 		+ ").");
 }
 
+void params_merge_gen_file_format(
+		Params const& params_1,
+		Params const& params_2,
+		std::string const& name,
+		Params* params_out) {
+	// The format of the generator file doesn't affect the events, so a
+	// mismatch isn't an error, and the first is kept.
+	return params_merge_value<ValueGenFileFormat>(
+		params_1, params_2, name,
+		[](GenFileFormat a, GenFileFormat) { return a; },
+		params_out);
+}
+
+void params_merge_event_file_format(
+		Params const& params_1,
+		Params const& params_2,
+		std::string const& name,
+		Params* params_out) {
+	return params_merge_value<ValueEventFileFormat>(
+		params_1, params_2, name,
+		[&](EventFileFormat a, EventFileFormat b) {
+			if (a != b) {
+				throw make_incompatible_param_error(
+					name,
+					ValueEventFileFormat(a),
+					ValueEventFileFormat(b));
+			}
+			return a;
+		},
+		params_out);
+}
+
 }
 
 std::vector<EventType> p_enabled_event_types(Params& params) {
@@ -573,8 +995,37 @@ Params merge_params(Params& params_1, Params& params_2) {
 		}
 	}
 	// Check that the generation seeds are compatible, meaning non-overlapping,
-	// so that each set of events are independent.
-	if (params_1.is_set("mc.seed") && params_2.is_set("mc.seed")) {
+	// so that each set of events are independent. Shards of the same job
+	// share a seed, and instead must have non-overlapping shard indices.
+	bool sharded_1 = params_1.is_set("mc.shard");
+	bool sharded_2 = params_2.is_set("mc.shard");
+	if (sharded_1 != sharded_2) {
+		throw std::runtime_error(
+			"Cannot merge sharded events with events that aren't sharded.");
+	} else if (sharded_1 && sharded_2) {
+		ShardGen shard_gen_1 = params_1["mc.shard"].any();
+		ShardGen shard_gen_2 = params_2["mc.shard"].any();
+		SeedGen seed_gen_1 = params_1["mc.seed"].any();
+		SeedGen seed_gen_2 = params_2["mc.seed"].any();
+		if (seed_gen_1 != seed_gen_2) {
+			throw make_incompatible_param_error(
+				"mc.seed",
+				ValueSeedGen(seed_gen_1),
+				ValueSeedGen(seed_gen_2));
+		}
+		bool overlap = false;
+		for (Int index : shard_gen_1.indices) {
+			if (shard_gen_2.indices.count(index) != 0) {
+				overlap = true;
+			}
+		}
+		if (shard_gen_1.count != shard_gen_2.count || overlap) {
+			throw make_incompatible_param_error(
+				"mc.shard",
+				ValueShardGen(shard_gen_1),
+				ValueShardGen(shard_gen_2));
+		}
+	} else if (params_1.is_set("mc.seed") && params_2.is_set("mc.seed")) {
 		SeedGen seed_gen_1 = params_1["mc.seed"].any();
 		SeedGen seed_gen_2 = params_2["mc.seed"].any();
 		for (int seed : seed_gen_1.seeds) {
@@ -594,7 +1045,9 @@ Params merge_params(Params& params_1, Params& params_2) {
 	for (std::string const& name : params_1.filter(filter_file).names()) {
 		params_merge_file(params_1, params_2, name, &result);
 	}
+	params_merge_gen_file_format(params_1, params_2, "file.gen_format", &result);
 	// Merge write parameters.
+	params_merge_event_file_format(params_1, params_2, "file.format", &result);
 	params_merge_bool_and(params_1, params_2, "file.write_momenta", &result);
 	params_merge_bool_and(params_1, params_2, "file.write_photon", &result);
 	params_merge_bool_and(params_1, params_2, "file.write_sf_set", &result);
@@ -603,16 +1056,26 @@ Params merge_params(Params& params_1, Params& params_2) {
 	for (EventType ev_type : ev_types) {
 		params_merge_bool_or(params_1, params_2, p_name_enable(ev_type), &result);
 	}
-	// Merge seeds.
-	params_merge_seed_gen(params_1, params_2, "mc.seed", &result);
 	// Merge counts.
 	params_merge_count(params_1, params_2, "mc.num_events", &result);
+	// Merge thread counts. These don't affect the distribution of events, so
+	// just keep the largest.
+	params_merge_int_max(params_1, params_2, "mc.num_threads", &result);
+	params_merge_double_max(params_1, params_2, "mc.checkpoint_interval", &result);
+	params_merge_bool_or(params_1, params_2, "mc.perf", &result);
 	// All other information must be equal between `params_dist_1` and
 	// `params_dist_2` from the earlier call to `equivalent()`, so no need to
 	// merge, just copy value direct from `params_dist_1`.
 	Filter filter_set = (filter_dist | "uid"_F | "seed"_F);
 	result.set_from(params_1.filter(filter_set & filter_ev_type_1));
 	result.set_from(params_2.filter(filter_set & filter_ev_type_2));
+	// Merge seeds. This must come after the copy above, as seeds are also
+	// tagged with "seed".
+	if (sharded_1 && sharded_2) {
+		params_merge_shard_gen(params_1, params_2, "mc.shard", &result);
+	} else {
+		params_merge_seed_gen(params_1, params_2, "mc.seed", &result);
+	}
 	// TODO: This check verifies that every parameter set in `params_1` or
 	// `params_2` is also set in `result`, and vice versa. It shouldn't ever get
 	// tripped if there aren't any bugs in the merge, so enable it for debug
@@ -703,14 +1166,19 @@ VALUE_TYPE_DEFINE_SINGLETON(TypeBool)
 VALUE_TYPE_DEFINE_SINGLETON(TypeString)
 // Random number seeds.
 VALUE_TYPE_DEFINE_SINGLETON(TypeSeedGen)
+VALUE_TYPE_DEFINE_SINGLETON(TypeShardGen)
 // Enums.
 VALUE_TYPE_DEFINE_SINGLETON(TypeRcMethod)
+VALUE_TYPE_DEFINE_SINGLETON(TypeEventFileFormat)
+VALUE_TYPE_DEFINE_SINGLETON(TypeGenFileFormat)
+VALUE_TYPE_DEFINE_SINGLETON(TypeDistType)
 VALUE_TYPE_DEFINE_SINGLETON(TypeNucleus)
 VALUE_TYPE_DEFINE_SINGLETON(TypeLepton)
 VALUE_TYPE_DEFINE_SINGLETON(TypeHadron)
 // Math types.
 VALUE_TYPE_DEFINE_SINGLETON(TypeVec3)
 VALUE_TYPE_DEFINE_SINGLETON(TypeBound)
+VALUE_TYPE_DEFINE_SINGLETON(TypeVarMap)
 
 // Stream IO definitions.
 // Numbers.
@@ -721,6 +1189,18 @@ VALUE_TYPE_DEFINE_READ_WRITE_STREAM_ENUM(
 	TypeRcMethod, RcMethod, 3,
 	ESC({ RcMethod::NONE, RcMethod::APPROX, RcMethod::EXACT }),
 	ESC({ { "none" }, { "approx" }, { "exact" } }))
+VALUE_TYPE_DEFINE_READ_WRITE_STREAM_ENUM(
+	TypeEventFileFormat, EventFileFormat, 2,
+	ESC({ EventFileFormat::ROOT, EventFileFormat::BINARY }),
+	ESC({ { "root" }, { "binary" } }))
+VALUE_TYPE_DEFINE_READ_WRITE_STREAM_ENUM(
+	TypeGenFileFormat, GenFileFormat, 2,
+	ESC({ GenFileFormat::ROOT, GenFileFormat::MAPPED }),
+	ESC({ { "root" }, { "mapped" } }))
+VALUE_TYPE_DEFINE_READ_WRITE_STREAM_ENUM(
+	TypeDistType, DistType, 3,
+	ESC({ DistType::FOAM, DistType::BUBBLE, DistType::VEGAS }),
+	ESC({ { "foam" }, { "bubble" }, { "vegas" } }))
 VALUE_TYPE_DEFINE_READ_WRITE_STREAM_ENUM(
 	TypeNucleus, part::Nucleus, 3,
 	ESC({ part::Nucleus::P, part::Nucleus::N, part::Nucleus::D }),
@@ -741,6 +1221,9 @@ VALUE_TYPE_DEFINE_CONVERT_ROOT_NUMBER(TypeInt, Int, Int)
 VALUE_TYPE_DEFINE_CONVERT_ROOT_NUMBER(TypeLong, Long, Long)
 VALUE_TYPE_DEFINE_CONVERT_ROOT_NUMBER(TypeBool, bool, bool)
 VALUE_TYPE_DEFINE_CONVERT_ROOT_NUMBER(TypeRcMethod, RcMethod, int)
+VALUE_TYPE_DEFINE_CONVERT_ROOT_NUMBER(TypeEventFileFormat, EventFileFormat, int)
+VALUE_TYPE_DEFINE_CONVERT_ROOT_NUMBER(TypeGenFileFormat, GenFileFormat, int)
+VALUE_TYPE_DEFINE_CONVERT_ROOT_NUMBER(TypeDistType, DistType, int)
 VALUE_TYPE_DEFINE_CONVERT_ROOT_NUMBER(TypeNucleus, part::Nucleus, int)
 VALUE_TYPE_DEFINE_CONVERT_ROOT_NUMBER(TypeLepton, part::Lepton, int)
 VALUE_TYPE_DEFINE_CONVERT_ROOT_NUMBER(TypeHadron, part::Hadron, int)
@@ -811,6 +1294,67 @@ void TypeSeedGen::write_stream_base(std::ostream& os, SeedGen const& seed) const
 	}
 }
 
+// Shards are written as a list of index ranges, followed by the total number
+// of shards. For example, `0-3,7/8`.
+ShardGen TypeShardGen::read_stream_base(std::istream& is) const {
+	ShardGen shard;
+	shard.indices.clear();
+	char next;
+	do {
+		Int index_begin;
+		Int index_end;
+		is >> index_begin;
+		index_end = index_begin;
+		next = '\0';
+		is >> next;
+		if (next == '-') {
+			is >> index_end;
+			next = '\0';
+			is >> next;
+		}
+		if (!is || !(index_begin <= index_end)) {
+			is.setstate(std::ios_base::failbit);
+			return shard;
+		}
+		for (Int index = index_begin; index <= index_end; ++index) {
+			shard.indices.insert(index);
+		}
+	} while (next == ',');
+	if (next != '/') {
+		is.setstate(std::ios_base::failbit);
+		return shard;
+	}
+	is >> shard.count;
+	if (shard.indices.empty()
+			|| *shard.indices.begin() < 0
+			|| !(*shard.indices.rbegin() < shard.count)) {
+		is.setstate(std::ios_base::failbit);
+	}
+	return shard;
+}
+void TypeShardGen::write_stream_base(std::ostream& os, ShardGen const& shard) const {
+	bool first = true;
+	auto it = shard.indices.begin();
+	while (it != shard.indices.end()) {
+		Int index_begin = *it;
+		Int index_end = *it;
+		++it;
+		while (it != shard.indices.end() && *it == index_end + 1) {
+			index_end = *it;
+			++it;
+		}
+		if (!first) {
+			os << ',';
+		}
+		first = false;
+		os << index_begin;
+		if (index_end != index_begin) {
+			os << '-' << index_end;
+		}
+	}
+	os << '/' << shard.count;
+}
+
 // Math types.
 math::Vec3 TypeVec3::read_stream_base(std::istream& is) const {
 	math::Vec3 vec;
@@ -831,6 +1375,48 @@ math::Bound TypeBound::read_stream_base(std::istream& is) const {
 void TypeBound::write_stream_base(std::ostream& os, math::Bound const& bound) const {
 	os << bound.min() << ' ' << bound.max();
 }
+VarMap TypeVarMap::read_stream_base(std::istream& is) const {
+	std::string name;
+	is >> name;
+	if (name == "linear") {
+		return VarMap(VarMapType::LINEAR);
+	}
+	VarMap var_map;
+	if (name == "inverse") {
+		var_map.type = VarMapType::INVERSE;
+	} else if (name == "log") {
+		var_map.type = VarMapType::LOG;
+	} else if (name == "decay") {
+		var_map.type = VarMapType::DECAY;
+	} else {
+		is.setstate(std::ios_base::failbit);
+		return var_map;
+	}
+	is >> var_map.scale;
+	if (!std::isfinite(var_map.scale)
+			|| (var_map.type == VarMapType::DECAY && !(var_map.scale > 0.))) {
+		is.setstate(std::ios_base::failbit);
+	}
+	return var_map;
+}
+void TypeVarMap::write_stream_base(std::ostream& os, VarMap const& var_map) const {
+	switch (var_map.type) {
+	case VarMapType::LINEAR:
+		os << "linear";
+		break;
+	case VarMapType::INVERSE:
+		os << "inverse " << var_map.scale;
+		break;
+	case VarMapType::LOG:
+		os << "log " << var_map.scale;
+		break;
+	case VarMapType::DECAY:
+		os << "decay " << var_map.scale;
+		break;
+	default:
+		os.setstate(std::ios_base::failbit);
+	}
+}
 
 // Read/write to ROOT.
 
@@ -864,6 +1450,25 @@ SeedGen TypeSeedGen::convert_from_root_base(RootArrayI& seed) const {
 	}
 	return result;
 }
+// Shards.
+RootArrayI TypeShardGen::convert_to_root_base(ShardGen const& shard) const {
+	std::vector<Int> vals;
+	vals.push_back(shard.count);
+	vals.insert(vals.end(), shard.indices.begin(), shard.indices.end());
+	return RootArrayI(vals.size(), vals.data());
+}
+ShardGen TypeShardGen::convert_from_root_base(RootArrayI& shard) const {
+	if (shard.GetSize() < 2) {
+		throw std::runtime_error("Wrong number of array elements.");
+	}
+	ShardGen result;
+	result.count = shard.At(0);
+	result.indices.clear();
+	for (Int_t i = 1; i < shard.GetSize(); ++i) {
+		result.indices.insert(shard.At(i));
+	}
+	return result;
+}
 // Math types.
 RootArrayD TypeVec3::convert_to_root_base(math::Vec3 const& vec) const {
 	Double_t vals[3] = { vec.x, vec.y, vec.z };
@@ -885,4 +1490,14 @@ math::Bound TypeBound::convert_from_root_base(RootArrayD& bound) const {
 	}
 	return math::Bound(bound.At(0), bound.At(1));
 }
+RootArrayD TypeVarMap::convert_to_root_base(VarMap const& var_map) const {
+	Double_t vals[2] = { static_cast<Double_t>(var_map.type), var_map.scale };
+	return RootArrayD(2, vals);
+}
+VarMap TypeVarMap::convert_from_root_base(RootArrayD& var_map) const {
+	if (var_map.GetSize() != 2) {
+		throw std::runtime_error("Wrong number of array elements.");
+	}
+	return VarMap(static_cast<VarMapType>(var_map.At(0)), var_map.At(1));
+}
 
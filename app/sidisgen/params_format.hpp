@@ -1,6 +1,7 @@
 #ifndef SIDISGEN_PARAMS_FORMAT_HPP
 #define SIDISGEN_PARAMS_FORMAT_HPP
 
+#include <set>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -70,6 +71,32 @@ struct SeedGen {
 	}
 };
 
+// Shards of a larger generation job. All shards of a job share the same seed,
+// but draw events from different random number streams (see
+// `make_rnd_stream`). When merging events together, it can be verified that
+// every shard is present exactly once.
+struct ShardGen {
+	// Total number of shards in the job.
+	Int count;
+	// Set of shards that the events come from.
+	std::set<Int> indices;
+
+	ShardGen() : count(1), indices{ 0 } { }
+	ShardGen(Int index, Int count) : count(count), indices{ index } { }
+	// Whether every shard of the job is present.
+	bool complete() const {
+		return indices.size() == static_cast<std::size_t>(count)
+			&& *indices.begin() == 0
+			&& *indices.rbegin() == count - 1;
+	}
+	bool operator==(ShardGen const& rhs) const {
+		return count == rhs.count && indices == rhs.indices;
+	}
+	bool operator!=(ShardGen const& rhs) const {
+		return !(*this == rhs);
+	}
+};
+
 // Gets all enabled event types from the parameters.
 std::vector<EventType> p_enabled_event_types(Params& params);
 
@@ -81,6 +108,12 @@ inline std::string p_name_enable(EventType ev_type) {
 inline std::string p_name_gen_rej_scale(EventType ev_type) {
 	return std::string("mc.") + event_type_short_name(ev_type) + ".gen.rej_scale";
 }
+inline std::string p_name_gen_rej_quantile(EventType ev_type) {
+	return std::string("mc.") + event_type_short_name(ev_type) + ".gen.rej_quantile";
+}
+inline std::string p_name_gen_rej_warmup(EventType ev_type) {
+	return std::string("mc.") + event_type_short_name(ev_type) + ".gen.rej_warmup";
+}
 inline std::string p_name_init_target_eff(EventType ev_type) {
 	return std::string("mc.") + event_type_short_name(ev_type) + ".init.target_eff";
 }
@@ -90,9 +123,39 @@ inline std::string p_name_init_scale_exp(EventType ev_type) {
 inline std::string p_name_init_max_cells(EventType ev_type) {
 	return std::string("mc.") + event_type_short_name(ev_type) + ".init.max_cells";
 }
+inline std::string p_name_init_autotune(EventType ev_type) {
+	return std::string("mc.") + event_type_short_name(ev_type) + ".init.autotune";
+}
+inline std::string p_name_init_max_seconds(EventType ev_type) {
+	return std::string("mc.") + event_type_short_name(ev_type) + ".init.max_seconds";
+}
+inline std::string p_name_init_max_evals(EventType ev_type) {
+	return std::string("mc.") + event_type_short_name(ev_type) + ".init.max_evals";
+}
+inline std::string p_name_init_dist(EventType ev_type) {
+	return std::string("mc.") + event_type_short_name(ev_type) + ".init.dist";
+}
+inline std::string p_name_init_foam_samples(EventType ev_type) {
+	return std::string("mc.") + event_type_short_name(ev_type) + ".init.foam.samples";
+}
+inline std::string p_name_init_foam_bins(EventType ev_type) {
+	return std::string("mc.") + event_type_short_name(ev_type) + ".init.foam.bins";
+}
+inline std::string p_name_init_vegas_bins(EventType ev_type) {
+	return std::string("mc.") + event_type_short_name(ev_type) + ".init.vegas.bins";
+}
+inline std::string p_name_init_vegas_samples(EventType ev_type) {
+	return std::string("mc.") + event_type_short_name(ev_type) + ".init.vegas.samples";
+}
+inline std::string p_name_init_vegas_iters(EventType ev_type) {
+	return std::string("mc.") + event_type_short_name(ev_type) + ".init.vegas.iters";
+}
 inline std::string p_name_init_uid(EventType ev_type) {
 	return std::string("mc.") + event_type_short_name(ev_type) + ".init.uid";
 }
+inline std::string p_name_map(EventType ev_type, std::string const& var) {
+	return std::string("mc.") + event_type_short_name(ev_type) + ".map." + var;
+}
 
 // Convenience macros for declaring new types.
 #define VALUE_TYPE_DECLARE(RType, RValue, Wrapped, WrappedRoot) \
@@ -171,14 +234,19 @@ VALUE_TYPE_DECLARE(TypeBool, ValueBool, bool, TParameter<bool>)
 VALUE_TYPE_DECLARE(TypeString, ValueString, std::string, TObjString)
 // Random number seeds.
 VALUE_TYPE_DECLARE(TypeSeedGen, ValueSeedGen, SeedGen, RootArrayI)
+VALUE_TYPE_DECLARE(TypeShardGen, ValueShardGen, ShardGen, RootArrayI)
 // Enums.
 VALUE_TYPE_DECLARE(TypeRcMethod, ValueRcMethod, RcMethod, TParameter<int>)
+VALUE_TYPE_DECLARE(TypeEventFileFormat, ValueEventFileFormat, EventFileFormat, TParameter<int>)
+VALUE_TYPE_DECLARE(TypeGenFileFormat, ValueGenFileFormat, GenFileFormat, TParameter<int>)
+VALUE_TYPE_DECLARE(TypeDistType, ValueDistType, DistType, TParameter<int>)
 VALUE_TYPE_DECLARE(TypeNucleus, ValueNucleus, sidis::part::Nucleus, TParameter<int>)
 VALUE_TYPE_DECLARE(TypeLepton, ValueLepton, sidis::part::Lepton, TParameter<int>)
 VALUE_TYPE_DECLARE(TypeHadron, ValueHadron, sidis::part::Hadron, TParameter<int>)
 // Math types.
 VALUE_TYPE_DECLARE(TypeVec3, ValueVec3, sidis::math::Vec3, RootArrayD)
 VALUE_TYPE_DECLARE(TypeBound, ValueBound, sidis::math::Bound, RootArrayD)
+VALUE_TYPE_DECLARE(TypeVarMap, ValueVarMap, VarMap, RootArrayD)
 
 #endif
 
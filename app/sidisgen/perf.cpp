@@ -0,0 +1,22 @@
+#include "perf.hpp"
+
+bool perf_enabled = false;
+thread_local PerfCounters perf_counters;
+
+PerfCounters& PerfCounters::operator+=(PerfCounters const& rhs) {
+	num_evals += rhs.num_evals;
+	num_zero_cut += rhs.num_zero_cut;
+	num_zero_nan += rhs.num_zero_nan;
+	num_zero_neg += rhs.num_zero_neg;
+	for (std::size_t idx = 0; idx < NUM_PERF_PARTS; ++idx) {
+		time[idx] += rhs.time[idx];
+	}
+	return *this;
+}
+
+PerfCounters perf_take() {
+	PerfCounters result = perf_counters;
+	perf_counters = PerfCounters();
+	return result;
+}
+
@@ -0,0 +1,139 @@
+#ifndef SIDISGEN_PERF_HPP
+#define SIDISGEN_PERF_HPP
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+
+#include <sidis/sidis.hpp>
+
+#include "utility.hpp"
+
+// Parts of the generation that are timed when profiling.
+enum class PerfPart {
+	// Mapping from the unit hypercube into phase space, and checking cuts.
+	TAKE,
+	// Construction of `Kinematics` and `KinematicsRad`.
+	KINEMATICS,
+	// Evaluation of structure functions.
+	SF,
+	// Evaluation of the cross-section, including the structure functions.
+	XS,
+	// Writing events to the event file.
+	IO,
+};
+std::size_t const NUM_PERF_PARTS = 5;
+
+// Counters filled in while profiling.
+struct PerfCounters {
+	// Number of density evaluations.
+	Long num_evals;
+	// Number of density evaluations that gave zero because the point failed
+	// the cuts, the cross-section wasn't finite (usually from structure
+	// functions out of range of their grids), or the cross-section was
+	// negative.
+	Long num_zero_cut;
+	Long num_zero_nan;
+	Long num_zero_neg;
+	// Time spent in each `PerfPart`, in seconds.
+	std::array<Double, NUM_PERF_PARTS> time;
+
+	PerfCounters() :
+		num_evals(0),
+		num_zero_cut(0),
+		num_zero_nan(0),
+		num_zero_neg(0),
+		time() { }
+
+	PerfCounters& operator+=(PerfCounters const& rhs);
+};
+
+// Whether profiling is enabled. Only change this while no events are being
+// drawn.
+extern bool perf_enabled;
+// Counters for the current thread. Use `perf_take` to collect them.
+extern thread_local PerfCounters perf_counters;
+
+// Returns the counters of the current thread, and resets them.
+PerfCounters perf_take();
+
+// Adds the time until it goes out of scope to a part of the current thread's
+// counters. Does nothing if profiling isn't enabled.
+class PerfTimer final {
+	PerfPart _part;
+	bool _enabled;
+	std::chrono::steady_clock::time_point _start;
+
+public:
+	explicit PerfTimer(PerfPart part) : _part(part), _enabled(perf_enabled) {
+		if (_enabled) {
+			_start = std::chrono::steady_clock::now();
+		}
+	}
+	PerfTimer(PerfTimer const&) = delete;
+	PerfTimer& operator=(PerfTimer const&) = delete;
+	~PerfTimer() {
+		if (_enabled) {
+			std::chrono::duration<Double> duration
+				= std::chrono::steady_clock::now() - _start;
+			perf_counters.time[static_cast<std::size_t>(_part)] += duration.count();
+		}
+	}
+};
+
+// Wrapper around another structure function set that times every evaluation
+// under `PerfPart::SF`.
+class PerfSfSet final : public sidis::sf::SfSet {
+	sidis::sf::SfSet const& _sf;
+
+public:
+	explicit PerfSfSet(sidis::sf::SfSet const& sf) :
+		SfSet(sf.target),
+		_sf(sf) { }
+
+	#define SIDISGEN_PERF_SF(Type, name) \
+		Type name( \
+				sidis::part::Hadron h, \
+				Double x, Double z, Double Q_sq, Double ph_t_sq) const override { \
+			PerfTimer timer(PerfPart::SF); \
+			return _sf.name(h, x, z, Q_sq, ph_t_sq); \
+		}
+	SIDISGEN_PERF_SF(Double, F_UUL)
+	SIDISGEN_PERF_SF(Double, F_UUT)
+	SIDISGEN_PERF_SF(Double, F_UU_cos_phih)
+	SIDISGEN_PERF_SF(Double, F_UU_cos_2phih)
+	SIDISGEN_PERF_SF(Double, F_UL_sin_phih)
+	SIDISGEN_PERF_SF(Double, F_UL_sin_2phih)
+	SIDISGEN_PERF_SF(Double, F_UTL_sin_phih_m_phis)
+	SIDISGEN_PERF_SF(Double, F_UTT_sin_phih_m_phis)
+	SIDISGEN_PERF_SF(Double, F_UT_sin_2phih_m_phis)
+	SIDISGEN_PERF_SF(Double, F_UT_sin_3phih_m_phis)
+	SIDISGEN_PERF_SF(Double, F_UT_sin_phis)
+	SIDISGEN_PERF_SF(Double, F_UT_sin_phih_p_phis)
+	SIDISGEN_PERF_SF(Double, F_LU_sin_phih)
+	SIDISGEN_PERF_SF(Double, F_LL)
+	SIDISGEN_PERF_SF(Double, F_LL_cos_phih)
+	SIDISGEN_PERF_SF(Double, F_LT_cos_phih_m_phis)
+	SIDISGEN_PERF_SF(Double, F_LT_cos_2phih_m_phis)
+	SIDISGEN_PERF_SF(Double, F_LT_cos_phis)
+	SIDISGEN_PERF_SF(sidis::sf::SfBaseUU, sf_base_uu)
+	SIDISGEN_PERF_SF(sidis::sf::SfBaseUL, sf_base_ul)
+	SIDISGEN_PERF_SF(sidis::sf::SfBaseUT, sf_base_ut)
+	SIDISGEN_PERF_SF(sidis::sf::SfBaseUP, sf_base_up)
+	SIDISGEN_PERF_SF(sidis::sf::SfBaseLU, sf_base_lu)
+	SIDISGEN_PERF_SF(sidis::sf::SfBaseLL, sf_base_ll)
+	SIDISGEN_PERF_SF(sidis::sf::SfBaseLT, sf_base_lt)
+	SIDISGEN_PERF_SF(sidis::sf::SfBaseLP, sf_base_lp)
+	SIDISGEN_PERF_SF(sidis::sf::SfUU, sf_uu)
+	SIDISGEN_PERF_SF(sidis::sf::SfUL, sf_ul)
+	SIDISGEN_PERF_SF(sidis::sf::SfUT, sf_ut)
+	SIDISGEN_PERF_SF(sidis::sf::SfUP, sf_up)
+	SIDISGEN_PERF_SF(sidis::sf::SfLU, sf_lu)
+	SIDISGEN_PERF_SF(sidis::sf::SfLL, sf_ll)
+	SIDISGEN_PERF_SF(sidis::sf::SfLT, sf_lt)
+	SIDISGEN_PERF_SF(sidis::sf::SfLP, sf_lp)
+	#undef SIDISGEN_PERF_SF
+};
+
+#endif
+
@@ -0,0 +1,165 @@
+#ifndef SIDISGEN_PHILOX_HPP
+#define SIDISGEN_PHILOX_HPP
+
+#include <array>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+
+// Counter-based random number engine Philox4x64-10, from Salmon et al.,
+// "Parallel random numbers: as easy as 1, 2, 3" (2011). Every block of four
+// outputs is a keyed bijection of a 256-bit counter. The engine only ever
+// increments the first word of the counter, so engines with the same key that
+// start from counters differing in any other word never produce the same
+// block. Each such stream has 2^64 blocks before it wraps around.
+class Philox4x64 final {
+public:
+	using result_type = std::uint64_t;
+	using Key = std::array<std::uint64_t, 2>;
+	using Counter = std::array<std::uint64_t, 4>;
+
+private:
+	static std::uint64_t const MUL_0 = 0xd2e7470ee14c6c93;
+	static std::uint64_t const MUL_1 = 0xca5a826395121157;
+	static std::uint64_t const WEYL_0 = 0x9e3779b97f4a7c15;
+	static std::uint64_t const WEYL_1 = 0xbb67ae8584caa73b;
+	static unsigned const NUM_ROUNDS = 10;
+
+	Key _key;
+	// Counter of the next block.
+	Counter _ctr;
+	// Current block, and the position of the next output within it. A
+	// position of 4 means the block is used up.
+	Counter _block;
+	unsigned _idx;
+
+	static void mul_hi_lo(
+			std::uint64_t a, std::uint64_t b,
+			std::uint64_t* hi, std::uint64_t* lo) {
+#if defined(__SIZEOF_INT128__)
+		__extension__ typedef unsigned __int128 Wide;
+		Wide prod = static_cast<Wide>(a) * b;
+		*hi = static_cast<std::uint64_t>(prod >> 64);
+		*lo = static_cast<std::uint64_t>(prod);
+#else
+		std::uint64_t const MASK = 0xffffffff;
+		std::uint64_t p_0 = (a & MASK) * (b & MASK);
+		std::uint64_t p_1 = (a & MASK) * (b >> 32);
+		std::uint64_t p_2 = (a >> 32) * (b & MASK);
+		std::uint64_t p_3 = (a >> 32) * (b >> 32);
+		std::uint64_t mid = (p_0 >> 32) + (p_1 & MASK) + (p_2 & MASK);
+		*hi = p_3 + (p_1 >> 32) + (p_2 >> 32) + (mid >> 32);
+		*lo = (mid << 32) | (p_0 & MASK);
+#endif
+	}
+
+	void fill_block(Counter ctr) {
+		Key key = _key;
+		for (unsigned round = 0; round < NUM_ROUNDS; ++round) {
+			if (round != 0) {
+				key[0] += WEYL_0;
+				key[1] += WEYL_1;
+			}
+			std::uint64_t hi_0, lo_0, hi_1, lo_1;
+			mul_hi_lo(MUL_0, ctr[0], &hi_0, &lo_0);
+			mul_hi_lo(MUL_1, ctr[2], &hi_1, &lo_1);
+			ctr = {{ hi_1 ^ ctr[1] ^ key[0], lo_1, hi_0 ^ ctr[3] ^ key[1], lo_0 }};
+		}
+		_block = ctr;
+	}
+
+public:
+	static constexpr result_type min() {
+		return 0;
+	}
+	static constexpr result_type max() {
+		return ~std::uint64_t(0);
+	}
+
+	explicit Philox4x64(result_type seed = 0) :
+		Philox4x64({{ seed, 0 }}, {{ 0, 0, 0, 0 }}) { }
+	Philox4x64(Key key, Counter ctr) :
+		_key(key),
+		_ctr(ctr),
+		_block(),
+		_idx(4) { }
+
+	void seed(result_type seed = 0) {
+		*this = Philox4x64(seed);
+	}
+
+	// The block function on its own, for checking against reference values.
+	static Counter block(Key key, Counter ctr) {
+		Philox4x64 engine(key, ctr);
+		engine.fill_block(ctr);
+		return engine._block;
+	}
+
+	result_type operator()() {
+		if (_idx == 4) {
+			fill_block(_ctr);
+			_ctr[0] += 1;
+			_idx = 0;
+		}
+		result_type result = _block[_idx];
+		_idx += 1;
+		return result;
+	}
+
+	void discard(unsigned long long n) {
+		while (n != 0 && _idx != 4) {
+			_idx += 1;
+			n -= 1;
+		}
+		_ctr[0] += n / 4;
+		if (n % 4 != 0) {
+			operator()();
+			_idx += static_cast<unsigned>(n % 4) - 1;
+		}
+	}
+
+	friend bool operator==(Philox4x64 const& lhs, Philox4x64 const& rhs) {
+		return lhs._key == rhs._key && lhs._ctr == rhs._ctr
+			&& lhs._idx == rhs._idx;
+	}
+	friend bool operator!=(Philox4x64 const& lhs, Philox4x64 const& rhs) {
+		return !(lhs == rhs);
+	}
+
+	// Only the key, counter, and position are written, since the current block
+	// can be recomputed from them.
+	friend std::ostream& operator<<(std::ostream& os, Philox4x64 const& rnd) {
+		std::ios_base::fmtflags flags = os.flags();
+		os.flags(std::ios_base::dec);
+		os << rnd._key[0] << ' ' << rnd._key[1];
+		for (std::uint64_t word : rnd._ctr) {
+			os << ' ' << word;
+		}
+		os << ' ' << rnd._idx;
+		os.flags(flags);
+		return os;
+	}
+	friend std::istream& operator>>(std::istream& is, Philox4x64& rnd) {
+		std::ios_base::fmtflags flags = is.flags();
+		is.flags(std::ios_base::dec | std::ios_base::skipws);
+		Key key;
+		Counter ctr;
+		unsigned idx;
+		is >> key[0] >> key[1] >> ctr[0] >> ctr[1] >> ctr[2] >> ctr[3] >> idx;
+		is.flags(flags);
+		if (!is || idx > 4) {
+			is.setstate(std::ios_base::failbit);
+			return is;
+		}
+		rnd = Philox4x64(key, ctr);
+		if (idx != 4) {
+			ctr[0] -= 1;
+			rnd.fill_block(ctr);
+			rnd._idx = idx;
+		}
+		return is;
+	}
+};
+
+#endif
+
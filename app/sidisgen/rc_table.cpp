@@ -0,0 +1,497 @@
+#include "rc_table.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <initializer_list>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <sidis/sidis.hpp>
+
+#include "params.hpp"
+
+using namespace sidis;
+
+namespace {
+
+static_assert(
+	RC_TABLE_HARMONICS >= 2 && RC_TABLE_HARMONICS % 2 == 0,
+	"Harmonics must be even, so that the last one is a cosine.");
+
+// Nodes along each dimension of the initial grid.
+std::size_t const RC_TABLE_START_NODES = 3;
+// Factor by which the number of nodes along a dimension grows when it is
+// refined. It must be odd for the existing nodes to be kept.
+std::size_t const RC_TABLE_REFINE_FACTOR = 3;
+static_assert(RC_TABLE_REFINE_FACTOR % 2 == 1, "Refinement factor must be odd.");
+// Number of points used to estimate the interpolation error along each
+// dimension, for every refinement.
+std::size_t const RC_TABLE_ERROR_SAMPLES = 64;
+
+using Index = std::array<std::size_t, 4>;
+
+std::size_t total_nodes(Index const& nodes) {
+	return nodes[0] * nodes[1] * nodes[2] * nodes[3];
+}
+
+std::size_t flatten(Index const& nodes, Index const& idx) {
+	return ((idx[0] * nodes[1] + idx[1]) * nodes[2] + idx[2]) * nodes[3] + idx[3];
+}
+
+Index unflatten(Index const& nodes, std::size_t flat_idx) {
+	Index idx;
+	for (std::size_t dim = 4; dim-- > 0;) {
+		idx[dim] = flat_idx % nodes[dim];
+		flat_idx /= nodes[dim];
+	}
+	return idx;
+}
+
+// Fills `basis` with the first `count` harmonics of `theta`, in the order in
+// which they are stored in the table.
+void harmonics(Double theta, std::size_t count, Double* basis) {
+	basis[0] = 1.;
+	if (count == 1) {
+		return;
+	}
+	Double cos_1 = std::cos(theta);
+	Double sin_1 = std::sin(theta);
+	Double cos_k = cos_1;
+	Double sin_k = sin_1;
+	for (std::size_t k = 1; 2 * k < count; ++k) {
+		basis[2 * k - 1] = cos_k;
+		basis[2 * k] = sin_k;
+		Double cos_next = cos_k * cos_1 - sin_k * sin_1;
+		sin_k = sin_k * cos_1 + cos_k * sin_1;
+		cos_k = cos_next;
+	}
+	basis[count - 1] = cos_k;
+}
+
+// Factor turning the sum of samples times a harmonic into its coefficient. The
+// constant term and the last cosine are only counted once.
+Double harmonic_norm(std::size_t k, std::size_t count) {
+	return (k == 0 || k == count - 1 ? 1. : 2.) / count;
+}
+
+// Finds the harmonics of the ratio at `unit_vec` from equally spaced samples
+// of the azimuthal angles. All of them are NaN outside of the cuts, or where
+// the ratio isn't finite. If `density_ir` is provided, it is set to the
+// average density of `nrad_ir` over the samples.
+void eval_harmonics(
+		NradDensity const& density,
+		Point<4> const& unit_vec,
+		std::size_t harmonics_phi,
+		Double* coeffs,
+		Double* density_ir) {
+	std::size_t num_coeffs = RC_TABLE_HARMONICS * harmonics_phi;
+	std::fill(coeffs, coeffs + num_coeffs, 0.);
+	if (density_ir != nullptr) {
+		*density_ir = 0.;
+	}
+	Double basis_phi_h[RC_TABLE_HARMONICS];
+	Double basis_phi[RC_TABLE_HARMONICS];
+	for (std::size_t idx_h = 0; idx_h < RC_TABLE_HARMONICS; ++idx_h) {
+		Double phi_h = 2. * PI * idx_h / RC_TABLE_HARMONICS;
+		harmonics(phi_h, RC_TABLE_HARMONICS, basis_phi_h);
+		for (std::size_t idx_p = 0; idx_p < harmonics_phi; ++idx_p) {
+			Double phi = 2. * PI * idx_p / harmonics_phi;
+			harmonics(phi, harmonics_phi, basis_phi);
+			Double density_ir_sample;
+			Double ratio = density.rc_ratio(unit_vec, phi_h, phi, &density_ir_sample);
+			if (!std::isfinite(ratio)) {
+				std::fill(
+					coeffs, coeffs + num_coeffs,
+					std::numeric_limits<Double>::quiet_NaN());
+				return;
+			}
+			if (density_ir != nullptr) {
+				*density_ir += density_ir_sample / (RC_TABLE_HARMONICS * harmonics_phi);
+			}
+			for (std::size_t k_h = 0; k_h < RC_TABLE_HARMONICS; ++k_h) {
+				for (std::size_t k_p = 0; k_p < harmonics_phi; ++k_p) {
+					coeffs[k_h * harmonics_phi + k_p] += ratio
+						* harmonic_norm(k_h, RC_TABLE_HARMONICS) * basis_phi_h[k_h]
+						* harmonic_norm(k_p, harmonics_phi) * basis_phi[k_p];
+				}
+			}
+		}
+	}
+}
+
+// Evaluates the harmonics at each of `points` in parallel, one after the other
+// in `coeffs`. The densities of `nrad_ir` are written to `density_ir`, if
+// provided.
+void eval_points(
+		NradDensity const& density,
+		std::vector<Point<4> > const& points,
+		std::size_t harmonics_phi,
+		Double* coeffs,
+		Double* density_ir=nullptr) {
+	std::size_t num_coeffs = RC_TABLE_HARMONICS * harmonics_phi;
+#ifdef _OPENMP
+	int num_threads = omp_get_max_threads();
+	#pragma omp parallel for num_threads(num_threads) schedule(dynamic)
+#endif
+	for (long idx = 0; idx < static_cast<long>(points.size()); ++idx) {
+		eval_harmonics(
+			density, points[idx], harmonics_phi,
+			coeffs + idx * num_coeffs,
+			density_ir != nullptr ? density_ir + idx : nullptr);
+	}
+}
+
+// Position of a node in the unit hypercube. The nodes are placed at the centers
+// of a regular grid of cells, so that none are on the boundary of the
+// hypercube, where the kinematics are degenerate.
+Point<4> node_point(Index const& nodes, Index const& idx) {
+	Point<4> point;
+	for (std::size_t dim = 0; dim < 4; ++dim) {
+		point[dim] = (idx[dim] + 0.5) / nodes[dim];
+	}
+	return point;
+}
+
+// Evaluates the nodes at `flat_indices` of a grid with `nodes` nodes along each
+// dimension.
+void eval_nodes(
+		NradDensity const& density,
+		Index const& nodes,
+		std::vector<std::size_t> const& flat_indices,
+		std::size_t harmonics_phi,
+		std::vector<Double>* coeffs) {
+	std::size_t num_coeffs = RC_TABLE_HARMONICS * harmonics_phi;
+	std::vector<Point<4> > points;
+	points.reserve(flat_indices.size());
+	for (std::size_t flat_idx : flat_indices) {
+		points.push_back(node_point(nodes, unflatten(nodes, flat_idx)));
+	}
+	std::vector<Double> result(points.size() * num_coeffs);
+	eval_points(density, points, harmonics_phi, result.data());
+	for (std::size_t idx = 0; idx < flat_indices.size(); ++idx) {
+		std::copy(
+			result.begin() + idx * num_coeffs,
+			result.begin() + (idx + 1) * num_coeffs,
+			coeffs->begin() + flat_indices[idx] * num_coeffs);
+	}
+}
+
+// Replaces nodes outside of the cuts with the average of their neighbours, and
+// repeats until every node has a value. This keeps the interpolation smooth
+// near the edges of the cuts.
+std::vector<Double> fill_invalid(
+		Index const& nodes,
+		std::size_t num_coeffs,
+		std::vector<Double> coeffs) {
+	std::size_t count = total_nodes(nodes);
+	std::vector<std::size_t> invalid;
+	for (std::size_t flat_idx = 0; flat_idx < count; ++flat_idx) {
+		if (std::isnan(coeffs[flat_idx * num_coeffs])) {
+			invalid.push_back(flat_idx);
+		}
+	}
+	if (invalid.size() == count) {
+		throw std::runtime_error(
+			"Radiative correction could not be evaluated at any node within "
+			"the cuts.");
+	}
+	std::vector<Double> sum(num_coeffs);
+	while (!invalid.empty()) {
+		// Only nodes that were valid before the sweep are used, so that the
+		// result doesn't depend on the order of the nodes.
+		std::vector<Double> next = coeffs;
+		std::vector<std::size_t> still_invalid;
+		for (std::size_t flat_idx : invalid) {
+			Index idx = unflatten(nodes, flat_idx);
+			std::fill(sum.begin(), sum.end(), 0.);
+			std::size_t neighbours = 0;
+			for (std::size_t dim = 0; dim < 4; ++dim) {
+				for (int step : { -1, 1 }) {
+					if ((step < 0 && idx[dim] == 0)
+							|| (step > 0 && idx[dim] + 1 == nodes[dim])) {
+						continue;
+					}
+					Index idx_n = idx;
+					idx_n[dim] += step;
+					Double const* coeffs_n = &coeffs[flatten(nodes, idx_n) * num_coeffs];
+					if (std::isnan(coeffs_n[0])) {
+						continue;
+					}
+					for (std::size_t k = 0; k < num_coeffs; ++k) {
+						sum[k] += coeffs_n[k];
+					}
+					neighbours += 1;
+				}
+			}
+			if (neighbours == 0) {
+				still_invalid.push_back(flat_idx);
+				continue;
+			}
+			for (std::size_t k = 0; k < num_coeffs; ++k) {
+				next[flat_idx * num_coeffs + k] = sum[k] / neighbours;
+			}
+		}
+		coeffs = std::move(next);
+		invalid = std::move(still_invalid);
+	}
+	return coeffs;
+}
+
+}
+
+RcTableParams::RcTableParams(Params& params) :
+		enable(params["mc.nrad.init.rc_table.enable"].any()),
+		tolerance(params["mc.nrad.init.rc_table.tolerance"].any()),
+		max_nodes(0) {
+	Int max_nodes_param = params["mc.nrad.init.rc_table.max_nodes"].any();
+	if (!enable) {
+		return;
+	}
+	RcMethod rc_method = params["phys.rc_method"].any();
+	if (rc_method != RcMethod::EXACT) {
+		throw std::runtime_error(
+			"Parameter 'mc.nrad.init.rc_table.enable' requires "
+			"'phys.rc_method' to be 'exact'.");
+	} else if (!(tolerance > 0.)) {
+		throw std::runtime_error(
+			"Parameter 'mc.nrad.init.rc_table.tolerance' must be positive.");
+	} else if (max_nodes_param < 0
+			|| static_cast<std::size_t>(max_nodes_param)
+				< total_nodes({{
+					RC_TABLE_START_NODES, RC_TABLE_START_NODES,
+					RC_TABLE_START_NODES, RC_TABLE_START_NODES }})) {
+		throw std::runtime_error(
+			"Parameter 'mc.nrad.init.rc_table.max_nodes' is too small for the "
+			"initial grid.");
+	}
+	max_nodes = static_cast<std::size_t>(max_nodes_param);
+}
+
+RcTable RcTable::build(
+		NradDensity const& density,
+		RcTableParams const& params,
+		std::uint64_t seed) {
+	math::Vec3 target_pol = density.context().target_pol();
+	std::size_t harmonics_phi = target_pol.x != 0. || target_pol.y != 0. ?
+		RC_TABLE_HARMONICS :
+		1;
+	std::size_t num_coeffs = RC_TABLE_HARMONICS * harmonics_phi;
+	Index nodes = {{
+		RC_TABLE_START_NODES, RC_TABLE_START_NODES,
+		RC_TABLE_START_NODES, RC_TABLE_START_NODES }};
+	std::vector<Double> coeffs(total_nodes(nodes) * num_coeffs);
+	std::vector<std::size_t> flat_indices(total_nodes(nodes));
+	for (std::size_t flat_idx = 0; flat_idx < flat_indices.size(); ++flat_idx) {
+		flat_indices[flat_idx] = flat_idx;
+	}
+	eval_nodes(density, nodes, flat_indices, harmonics_phi, &coeffs);
+
+	RndEngine rnd(seed);
+	std::vector<Double> coeffs_filled;
+	Double error = 0.;
+	while (true) {
+		coeffs_filled = fill_invalid(nodes, num_coeffs, coeffs);
+		// Estimate the error of interpolating along each dimension, from
+		// points halfway between neighbouring nodes. The other coordinates of
+		// the points are placed on nodes, so that only the interpolation along
+		// that dimension contributes.
+		std::vector<Point<4> > points;
+		std::vector<std::size_t> lower;
+		std::vector<std::size_t> upper;
+		for (std::size_t dim = 0; dim < 4; ++dim) {
+			for (std::size_t sample = 0; sample < RC_TABLE_ERROR_SAMPLES; ++sample) {
+				Index idx;
+				for (std::size_t dim_i = 0; dim_i < 4; ++dim_i) {
+					std::size_t max_idx = nodes[dim_i] - (dim_i == dim ? 2 : 1);
+					idx[dim_i] = std::uniform_int_distribution<std::size_t>(0, max_idx)(rnd);
+				}
+				Point<4> point = node_point(nodes, idx);
+				point[dim] = (idx[dim] + 1.) / nodes[dim];
+				points.push_back(point);
+				lower.push_back(flatten(nodes, idx));
+				idx[dim] += 1;
+				upper.push_back(flatten(nodes, idx));
+			}
+		}
+		std::vector<Double> coeffs_exact(points.size() * num_coeffs);
+		std::vector<Double> density_ir(points.size());
+		eval_points(
+			density, points, harmonics_phi,
+			coeffs_exact.data(), density_ir.data());
+		// The error of the ratio is bounded by the sum of the errors of its
+		// harmonics. It is weighted by the density of `nrad_ir` relative to its
+		// average, since the ratio may grow large near the edges of the phase
+		// space where the cross-section vanishes, without mattering there.
+		Double density_ir_sum = 0.;
+		std::size_t density_ir_count = 0;
+		for (std::size_t idx = 0; idx < points.size(); ++idx) {
+			if (!std::isnan(coeffs_exact[idx * num_coeffs])) {
+				density_ir_sum += std::abs(density_ir[idx]);
+				density_ir_count += 1;
+			}
+		}
+		Double density_ir_mean = density_ir_count != 0 ?
+			density_ir_sum / density_ir_count :
+			0.;
+		std::array<Double, 4> errors = {{ 0., 0., 0., 0. }};
+		for (std::size_t idx = 0; idx < points.size(); ++idx) {
+			Double const* exact = &coeffs_exact[idx * num_coeffs];
+			if (std::isnan(exact[0]) || !(density_ir_mean > 0.)) {
+				continue;
+			}
+			Double const* lower_coeffs = &coeffs_filled[lower[idx] * num_coeffs];
+			Double const* upper_coeffs = &coeffs_filled[upper[idx] * num_coeffs];
+			Double point_error = 0.;
+			for (std::size_t k = 0; k < num_coeffs; ++k) {
+				Double interp = 0.5 * (lower_coeffs[k] + upper_coeffs[k]);
+				point_error += std::abs(exact[k] - interp);
+			}
+			point_error *= std::abs(density_ir[idx]) / density_ir_mean;
+			std::size_t dim = idx / RC_TABLE_ERROR_SAMPLES;
+			errors[dim] = std::max(errors[dim], point_error);
+		}
+		std::size_t dim_refine = static_cast<std::size_t>(
+			std::max_element(errors.begin(), errors.end()) - errors.begin());
+		error = errors[dim_refine];
+		if (!(error > params.tolerance)) {
+			break;
+		}
+		// Refine the dimension with the largest error. Each cell is split
+		// into an odd number of cells, so that the existing nodes stay at the
+		// centers of the new ones.
+		Index nodes_next = nodes;
+		nodes_next[dim_refine] = RC_TABLE_REFINE_FACTOR * nodes[dim_refine];
+		if (total_nodes(nodes_next) > params.max_nodes) {
+			break;
+		}
+		std::vector<Double> coeffs_next(total_nodes(nodes_next) * num_coeffs);
+		flat_indices.clear();
+		for (std::size_t flat_idx = 0; flat_idx < total_nodes(nodes_next); ++flat_idx) {
+			Index idx = unflatten(nodes_next, flat_idx);
+			if (idx[dim_refine] % RC_TABLE_REFINE_FACTOR != RC_TABLE_REFINE_FACTOR / 2) {
+				flat_indices.push_back(flat_idx);
+				continue;
+			}
+			idx[dim_refine] /= RC_TABLE_REFINE_FACTOR;
+			std::size_t flat_idx_prev = flatten(nodes, idx);
+			std::copy(
+				coeffs.begin() + flat_idx_prev * num_coeffs,
+				coeffs.begin() + (flat_idx_prev + 1) * num_coeffs,
+				coeffs_next.begin() + flat_idx * num_coeffs);
+		}
+		eval_nodes(density, nodes_next, flat_indices, harmonics_phi, &coeffs_next);
+		nodes = nodes_next;
+		coeffs = std::move(coeffs_next);
+	}
+
+	RcTable table;
+	for (std::size_t dim = 0; dim < 4; ++dim) {
+		table._nodes[dim] = nodes[dim];
+	}
+	table._harmonics_phi = harmonics_phi;
+	table._error = error;
+	table._coeffs = SharedArray<Double>(std::move(coeffs_filled));
+	return table;
+}
+
+std::size_t RcTable::num_nodes() const {
+	return _nodes[0] * _nodes[1] * _nodes[2] * _nodes[3];
+}
+
+Double RcTable::eval(Double const* unit_vec, Double phi_h, Double phi) const noexcept {
+	std::size_t num_coeffs = RC_TABLE_HARMONICS * _harmonics_phi;
+	Double basis_phi_h[RC_TABLE_HARMONICS];
+	Double basis_phi[RC_TABLE_HARMONICS];
+	harmonics(phi_h, RC_TABLE_HARMONICS, basis_phi_h);
+	harmonics(phi, _harmonics_phi, basis_phi);
+	Double basis[RC_TABLE_HARMONICS * RC_TABLE_HARMONICS];
+	for (std::size_t k_h = 0; k_h < RC_TABLE_HARMONICS; ++k_h) {
+		for (std::size_t k_p = 0; k_p < _harmonics_phi; ++k_p) {
+			basis[k_h * _harmonics_phi + k_p] = basis_phi_h[k_h] * basis_phi[k_p];
+		}
+	}
+	// Find the nodes surrounding the point. Beyond the outermost nodes, the
+	// ratio is held constant.
+	std::array<std::size_t, 4> cell;
+	std::array<std::size_t, 4> stride;
+	std::array<Double, 4> frac;
+	std::size_t stride_next = 1;
+	for (std::size_t dim = 4; dim-- > 0;) {
+		Double cells = static_cast<Double>(_nodes[dim] - 1);
+		Double t = unit_vec[dim] * _nodes[dim] - 0.5;
+		if (!(t >= 0.)) {
+			t = 0.;
+		} else if (t > cells) {
+			t = cells;
+		}
+		cell[dim] = std::min(static_cast<std::size_t>(t), _nodes[dim] - 2);
+		frac[dim] = t - cell[dim];
+		stride[dim] = stride_next;
+		stride_next *= _nodes[dim];
+	}
+	Double result = 0.;
+	for (unsigned corner = 0; corner < 16; ++corner) {
+		Double weight = 1.;
+		std::size_t flat_idx = 0;
+		for (std::size_t dim = 0; dim < 4; ++dim) {
+			bool upper = (corner >> dim) & 1;
+			weight *= upper ? frac[dim] : 1. - frac[dim];
+			flat_idx += (cell[dim] + upper) * stride[dim];
+		}
+		if (weight == 0.) {
+			continue;
+		}
+		Double const* coeffs = &_coeffs[flat_idx * num_coeffs];
+		Double value = 0.;
+		for (std::size_t k = 0; k < num_coeffs; ++k) {
+			value += coeffs[k] * basis[k];
+		}
+		result += weight * value;
+	}
+	return result;
+}
+
+std::ostream& RcTable::write(std::ostream& os) const {
+	os.write(reinterpret_cast<char const*>(_nodes.data()), sizeof(_nodes));
+	os.write(reinterpret_cast<char const*>(&_harmonics_phi), sizeof(_harmonics_phi));
+	os.write(reinterpret_cast<char const*>(&_error), sizeof(_error));
+	os.write(
+		reinterpret_cast<char const*>(_coeffs.data()),
+		_coeffs.size() * sizeof(Double));
+	return os;
+}
+
+BinaryView& RcTable::read(BinaryView& view) {
+	std::array<std::uint64_t, 4> nodes;
+	std::uint64_t harmonics_phi;
+	Double error;
+	if (!view.read(&nodes).read(&harmonics_phi).read(&error)) {
+		return view;
+	}
+	if (harmonics_phi != 1 && harmonics_phi != RC_TABLE_HARMONICS) {
+		view.fail();
+		return view;
+	}
+	std::uint64_t count = RC_TABLE_HARMONICS * harmonics_phi;
+	for (std::uint64_t nodes_dim : nodes) {
+		if (nodes_dim < 2
+				|| nodes_dim > std::numeric_limits<std::uint64_t>::max() / count) {
+			view.fail();
+			return view;
+		}
+		count *= nodes_dim;
+	}
+	SharedArray<Double> coeffs = view.read_array<Double>(count);
+	if (!view) {
+		return view;
+	}
+	_nodes = nodes;
+	_harmonics_phi = harmonics_phi;
+	_error = error;
+	_coeffs = std::move(coeffs);
+	return view;
+}
+
@@ -0,0 +1,83 @@
+#ifndef SIDISGEN_RC_TABLE_HPP
+#define SIDISGEN_RC_TABLE_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+#include "generator.hpp"
+#include "utility.hpp"
+
+class Params;
+
+// Number of samples of each azimuthal angle used to find the harmonics of the
+// radiative correction in that angle. The harmonics kept are the constant
+// term, the cosine and sine of up to three times the angle, and the cosine of
+// four times the angle.
+std::size_t const RC_TABLE_HARMONICS = 8;
+
+// Parameters for tabulating the radiative correction.
+struct RcTableParams final {
+	bool enable;
+	Double tolerance;
+	std::size_t max_nodes;
+
+	explicit RcTableParams(Params& params);
+};
+
+// Table of the exact radiative correction to the non-radiative cross-section,
+// as the ratio of `rad_f_integ` to `nrad_ir`. With `RcMethod::EXACT`, the
+// non-radiative density is then `nrad_ir` times one plus the ratio, which costs
+// about as much as `RcMethod::APPROX`.
+//
+// The ratio is tabulated over the first four dimensions of the non-radiative
+// unit hypercube (mapping onto `x`, `y`, `z`, and `ph_t_sq`), at the centers of
+// a regular grid of cells, and is interpolated linearly between them. At each
+// node, the dependence on `phi_h` and `phi` is stored as harmonics. Only the
+// constant harmonic of `phi` is kept if the target has no transverse
+// polarization, since then the ratio doesn't depend on `phi`. The grid is
+// refined one dimension at a time, where the estimated interpolation error is
+// largest. The error is weighted by the density of `nrad_ir` relative to its
+// average, so that the refinement isn't spent near the edges of the phase
+// space, where the cross-section vanishes but the ratio may not.
+class RcTable final {
+	std::array<std::uint64_t, 4> _nodes;
+	// Number of `phi` harmonics for each `phi_h` harmonic, either one or
+	// `RC_TABLE_HARMONICS`.
+	std::uint64_t _harmonics_phi;
+	// Estimate of the largest weighted error of the ratio.
+	Double _error;
+	// Harmonics at each node. The `phi` harmonics are innermost, followed by
+	// the `phi_h` harmonics, and then the nodes in row-major order.
+	SharedArray<Double> _coeffs;
+
+public:
+	RcTable() : _nodes{{ 0, 0, 0, 0 }}, _harmonics_phi(0), _error(0.) { }
+
+	// Tabulates the ratio for `density`, which must use `RcMethod::EXACT`. The
+	// grid is refined until the estimated error is within the tolerance, or
+	// until it would need more than the maximum number of nodes. The points
+	// used to estimate the error are drawn using `seed`.
+	static RcTable build(
+		NradDensity const& density,
+		RcTableParams const& params,
+		std::uint64_t seed);
+
+	std::size_t num_nodes() const;
+	Double error() const {
+		return _error;
+	}
+
+	// Ratio at the point `unit_vec` of the unit hypercube, of which only the
+	// first four coordinates are used, with azimuthal angles `phi_h` and `phi`.
+	Double eval(Double const* unit_vec, Double phi_h, Double phi) const noexcept;
+
+	// Binary serialization. Reading refers to the block of memory directly if
+	// possible (see `BinaryView`).
+	std::ostream& write(std::ostream& os) const;
+	BinaryView& read(BinaryView& view);
+};
+
+#endif
+
@@ -0,0 +1,102 @@
+#ifndef SIDISGEN_RING_BUFFER_HPP
+#define SIDISGEN_RING_BUFFER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Bounded lock-free queue, for passing values from a single producer thread to
+// a single consumer thread. The capacity is rounded up to a power of two.
+template<typename T>
+class RingBuffer final {
+	// Spins this many times before sleeping when the buffer is full or empty.
+	static unsigned const SPIN_COUNT = 64;
+
+	static std::size_t const CACHE_LINE_SIZE = 64;
+
+	// Index with a full cache line of padding on either side. Padding is used
+	// instead of `alignas`, because the buffers are kept in standard
+	// containers, which needn't respect extended alignment before C++17.
+	struct PaddedIndex {
+		char pad_before[CACHE_LINE_SIZE];
+		std::atomic<std::size_t> value;
+		char pad_after[CACHE_LINE_SIZE];
+	};
+
+	std::vector<T> _data;
+	std::size_t _mask;
+	// The head is only written by the consumer, and the tail only by the
+	// producer. Keep them on different cache lines to avoid false sharing.
+	PaddedIndex _head;
+	PaddedIndex _tail;
+
+	static void wait(unsigned* spins) {
+		if (*spins < SPIN_COUNT) {
+			*spins += 1;
+			std::this_thread::yield();
+		} else {
+			std::this_thread::sleep_for(std::chrono::microseconds(50));
+		}
+	}
+
+public:
+	explicit RingBuffer(std::size_t capacity) {
+		_head.value.store(0);
+		_tail.value.store(0);
+		std::size_t size = 1;
+		while (size < capacity) {
+			size *= 2;
+		}
+		_data.resize(size);
+		_mask = size - 1;
+	}
+	RingBuffer(RingBuffer const&) = delete;
+	RingBuffer& operator=(RingBuffer const&) = delete;
+
+	std::size_t capacity() const {
+		return _data.size();
+	}
+
+	// Adds a value to the buffer, returning false if the buffer is full. Only
+	// call from the producer thread.
+	bool try_push(T const& val) {
+		std::size_t tail = _tail.value.load(std::memory_order_relaxed);
+		if (tail - _head.value.load(std::memory_order_acquire) == _data.size()) {
+			return false;
+		}
+		_data[tail & _mask] = val;
+		_tail.value.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+	// Removes a value from the buffer, returning false if the buffer is empty.
+	// Only call from the consumer thread.
+	bool try_pop(T* val) {
+		std::size_t head = _head.value.load(std::memory_order_relaxed);
+		if (head == _tail.value.load(std::memory_order_acquire)) {
+			return false;
+		}
+		*val = _data[head & _mask];
+		_head.value.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Blocking versions of the above, which wait until there is space or a
+	// value available.
+	void push(T const& val) {
+		unsigned spins = 0;
+		while (!try_push(val)) {
+			wait(&spins);
+		}
+	}
+	void pop(T* val) {
+		unsigned spins = 0;
+		while (!try_pop(val)) {
+			wait(&spins);
+		}
+	}
+};
+
+#endif
+
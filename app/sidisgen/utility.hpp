@@ -1,9 +1,25 @@
 #ifndef SIDISGEN_UTILITY_HPP
 #define SIDISGEN_UTILITY_HPP
 
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
+#include <istream>
 #include <limits>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <random>
+#include <streambuf>
 #include <type_traits>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include <TArrayD.h>
 #include <TArrayI.h>
@@ -50,6 +66,50 @@ enum class RcMethod {
 	EXACT,
 };
 
+// Transformations from a unit coordinate onto a phase space variable, see
+// `sidis/extra/map.hpp`.
+enum class VarMapType {
+	LINEAR,
+	INVERSE,
+	LOG,
+	DECAY,
+};
+
+// Transformation used for a single phase space variable. The scale is the
+// offset for `INVERSE` and `LOG`, the length for `DECAY`, and unused for
+// `LINEAR`.
+struct VarMap {
+	VarMapType type;
+	Double scale;
+
+	VarMap(VarMapType type=VarMapType::LINEAR, Double scale=0.) :
+		type(type),
+		scale(scale) { }
+	bool operator==(VarMap const& rhs) const {
+		return type == rhs.type && scale == rhs.scale;
+	}
+	bool operator!=(VarMap const& rhs) const {
+		return !(*this == rhs);
+	}
+};
+
+// Formats for the event file.
+enum class EventFileFormat {
+	// ROOT file with an "events" tree.
+	ROOT,
+	// Flat binary file of fixed-size records, see `sidis/extra/event_file.hpp`.
+	BINARY,
+};
+
+// Formats for the generator file.
+enum class GenFileFormat {
+	// ROOT file with the serialized distribution of each generator stored in
+	// a `TArrayC`, limited to 2 GB each.
+	ROOT,
+	// Flat binary file that is memory-mapped when read, see `gen_file.hpp`.
+	MAPPED,
+};
+
 // All allowed event types.
 enum class EventType {
 	// Non-radiative (without photon emission).
@@ -94,6 +154,34 @@ inline char const* event_type_name(EventType type) {
 	}
 }
 
+// Types of probability distributions available.
+enum class DistType {
+	// Uniform distribution. Default.
+	UNIFORM,
+	// k-d tree constructed to approximate density.
+	FOAM,
+	// Variation of FOAM, with different construction process.
+	BUBBLE,
+	// Stratified VEGAS algorithm.
+	VEGAS,
+};
+
+// Identifying name for each type of distribution.
+inline char const* dist_type_name(DistType type) {
+	switch (type) {
+	case DistType::UNIFORM:
+		return "uniform";
+	case DistType::FOAM:
+		return "foam";
+	case DistType::BUBBLE:
+		return "bubble";
+	case DistType::VEGAS:
+		return "vegas";
+	default:
+		UNREACHABLE();
+	}
+}
+
 // Store statistics (count and moments) of the generated events.
 using Stats = bubble::Stats<Double>;
 using StatsAccum = bubble::StatsAccum<Double>;
@@ -148,6 +236,10 @@ public:
 	Double prime() const {
 		return 1. / _prime_inv;
 	}
+	// Inverse of the prime, as stored (`1 / prime()` doesn't round-trip).
+	Double prime_inv() const {
+		return _prime_inv;
+	}
 	// Total number of events.
 	std::size_t count() const {
 		return _count;
@@ -203,6 +295,9 @@ class IntegratorAccum final {
 	std::size_t _count_acc;
 	// Use an accumulator for the statistics.
 	StatsAccum _weights;
+	// Totals from before the accumulator was created (ex. when resuming from
+	// a checkpoint) or last flushed.
+	Integrator _prev;
 
 public:
 	// Creates a new integrator for an event generator with a given prime. The
@@ -212,7 +307,15 @@ public:
 		_prime_inv(prime_inv),
 		_count(0),
 		_count_acc(0),
-		_weights() { }
+		_weights(),
+		_prev() { }
+	// Creates an integrator that continues on from previous totals.
+	IntegratorAccum(Double prime_inv, Integrator prev) :
+		_prime_inv(prime_inv),
+		_count(prev.count()),
+		_count_acc(prev.count_acc()),
+		_weights(),
+		_prev(prev) { }
 
 	// Adds a new event from the event generator to the integral. The event must
 	// be drawn from a generator with the same prime as provided in the
@@ -228,16 +331,35 @@ public:
 
 	// Total up the measurements and get the result.
 	Integrator total() const {
-		return Integrator(_prime_inv, _count_acc, _weights.total());
+		return _prev + Integrator(
+			_prime_inv, _count_acc - _prev.count_acc(), _weights.total());
 	}
 	// A faster but less accurate version.
 	Integrator total_fast() const {
-		return Integrator(_prime_inv, _count_acc, _weights.total_fast());
+		return _prev + Integrator(
+			_prime_inv, _count_acc - _prev.count_acc(), _weights.total_fast());
+	}
+
+	// Moves the accumulated statistics into the previous totals. Afterwards,
+	// the state is given exactly by `prime_inv()` and `prev()`, so that it can
+	// be saved and restored without changing any later result.
+	void flush() {
+		_prev = total();
+		_weights = StatsAccum();
+	}
+	bool flushed() const {
+		return _count == _prev.count();
+	}
+	Integrator const& prev() const {
+		return _prev;
 	}
 
 	Double prime() const {
 		return 1. / _prime_inv;
 	}
+	Double prime_inv() const {
+		return _prime_inv;
+	}
 	std::size_t count() const {
 		return _count;
 	}
@@ -252,5 +374,509 @@ public:
 	}
 };
 
+// Divides a fixed number of threads between tasks that run at the same time,
+// so that together they don't oversubscribe the cores. Whenever a task
+// finishes, its threads are given to the tasks that remain.
+class ThreadShare final {
+	std::mutex _mutex;
+	int _num_threads;
+	std::vector<bool> _active;
+
+public:
+	ThreadShare(int num_threads, std::size_t num_tasks) :
+		_num_threads(num_threads > 0 ? num_threads : 1),
+		_active(num_tasks, true) { }
+	ThreadShare(ThreadShare const&) = delete;
+	ThreadShare& operator=(ThreadShare const&) = delete;
+
+	// Number of threads that `task` should currently use. The threads are
+	// split evenly, with the remainder going to the earlier tasks.
+	int num_threads(std::size_t task) {
+		std::lock_guard<std::mutex> lock(_mutex);
+		int num_active = 0;
+		int rank = 0;
+		for (std::size_t idx = 0; idx < _active.size(); ++idx) {
+			if (_active[idx]) {
+				if (idx < task) {
+					rank += 1;
+				}
+				num_active += 1;
+			}
+		}
+		if (num_active == 0) {
+			return _num_threads;
+		}
+		int result = _num_threads / num_active + (rank < _num_threads % num_active);
+		return result > 0 ? result : 1;
+	}
+	void finish(std::size_t task) {
+		std::lock_guard<std::mutex> lock(_mutex);
+		_active[task] = false;
+	}
+};
+
+// One task of a `ThreadShare`. If there is no share, the task uses the default
+// number of threads.
+struct ThreadShareTask {
+	ThreadShare* share;
+	std::size_t task;
+
+	ThreadShareTask() : share(nullptr), task(0) { }
+	ThreadShareTask(ThreadShare* share, std::size_t task) :
+		share(share),
+		task(task) { }
+
+	// Number of threads to use for the next parallel region.
+	int num_threads() const {
+		if (share != nullptr) {
+			return share->num_threads(task);
+		}
+#ifdef _OPENMP
+		return omp_get_max_threads();
+#else
+		return 1;
+#endif
+	}
+};
+
+// Limits on the time and number of density evaluations spent building a
+// distribution. A limit of zero means no limit. The time is counted from when
+// the budget is constructed.
+class BuildBudget final {
+	Double _max_seconds;
+	std::size_t _max_evals;
+	std::chrono::steady_clock::time_point _start;
+	std::size_t _num_evals;
+
+public:
+	explicit BuildBudget(Double max_seconds=0., std::size_t max_evals=0) :
+		_max_seconds(max_seconds),
+		_max_evals(max_evals),
+		_start(std::chrono::steady_clock::now()),
+		_num_evals(0) { }
+
+	Double max_seconds() const {
+		return _max_seconds;
+	}
+	std::size_t max_evals() const {
+		return _max_evals;
+	}
+	Double seconds() const {
+		std::chrono::duration<Double> duration
+			= std::chrono::steady_clock::now() - _start;
+		return duration.count();
+	}
+	std::size_t num_evals() const {
+		return _num_evals;
+	}
+	void add_evals(std::size_t num_evals) {
+		_num_evals += num_evals;
+	}
+	// Number of evaluations that can still be made.
+	std::size_t remaining_evals() const {
+		if (_max_evals == 0) {
+			return std::numeric_limits<std::size_t>::max();
+		} else {
+			return _num_evals < _max_evals ? _max_evals - _num_evals : 0;
+		}
+	}
+	// Whether there is room for another `num_evals` evaluations.
+	bool allows(std::size_t num_evals) const {
+		return num_evals <= remaining_evals()
+			&& (_max_seconds == 0. || seconds() < _max_seconds);
+	}
+};
+
+// Read-only array, which either owns its elements or refers to memory owned by
+// something else (such as a memory-mapped file). In the second case, the owner
+// is kept alive for as long as any array refers to it. Copies share the same
+// elements.
+template<typename T>
+class SharedArray final {
+	std::shared_ptr<void const> _owner;
+	T const* _data;
+	std::size_t _size;
+
+public:
+	SharedArray() : _owner(), _data(nullptr), _size(0) { }
+	SharedArray(std::vector<T> vec) {
+		std::shared_ptr<std::vector<T> > owned
+			= std::make_shared<std::vector<T> >(std::move(vec));
+		_data = owned->data();
+		_size = owned->size();
+		_owner = std::move(owned);
+	}
+	SharedArray(std::shared_ptr<void const> owner, T const* data, std::size_t size) :
+		_owner(std::move(owner)),
+		_data(data),
+		_size(size) { }
+
+	std::size_t size() const {
+		return _size;
+	}
+	T const* data() const {
+		return _data;
+	}
+	T const& operator[](std::size_t idx) const {
+		return _data[idx];
+	}
+	T const* begin() const {
+		return _data;
+	}
+	T const* end() const {
+		return _data + _size;
+	}
+};
+
+// Reads binary data from a block of memory, in the same format as it would be
+// read from a binary stream. Arrays are returned as views into the block where
+// possible, rather than being copied. As with streams, a failed read leaves the
+// reader in a failed state, which can be checked with `operator bool`.
+class BinaryView final {
+	std::shared_ptr<void const> _owner;
+	char const* _data;
+	std::size_t _size;
+	std::size_t _pos;
+	bool _good;
+
+	// Stream buffer over the block, so that it can be read with `std::istream`
+	// without being copied.
+	class StreamBuf final : public std::streambuf {
+	public:
+		StreamBuf(char const* begin, char const* end) {
+			char* begin_mut = const_cast<char*>(begin);
+			setg(begin_mut, begin_mut, const_cast<char*>(end));
+		}
+		std::size_t consumed() const {
+			return gptr() - eback();
+		}
+	};
+
+public:
+	BinaryView(std::shared_ptr<void const> owner, char const* data, std::size_t size) :
+		_owner(std::move(owner)),
+		_data(data),
+		_size(size),
+		_pos(0),
+		_good(true) { }
+
+	// Copies `size` bytes from `data` into a new block that is suitably
+	// aligned for arrays.
+	static BinaryView copy(char const* data, std::size_t size) {
+		std::shared_ptr<std::vector<std::uint64_t> > block
+			= std::make_shared<std::vector<std::uint64_t> >(
+				(size + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t));
+		char* block_data = reinterpret_cast<char*>(block->data());
+		if (size != 0) {
+			std::memcpy(block_data, data, size);
+		}
+		return BinaryView(std::move(block), block_data, size);
+	}
+
+	explicit operator bool() const {
+		return _good;
+	}
+	void fail() {
+		_good = false;
+	}
+	std::size_t pos() const {
+		return _pos;
+	}
+	std::size_t remaining() const {
+		return _size - _pos;
+	}
+
+	template<typename T>
+	BinaryView& read(T* value) {
+		static_assert(std::is_trivially_copyable<T>::value, "Must be trivially copyable.");
+		if (!_good || remaining() < sizeof(T)) {
+			_good = false;
+		} else {
+			std::memcpy(value, _data + _pos, sizeof(T));
+			_pos += sizeof(T);
+		}
+		return *this;
+	}
+	// Reads `count` consecutive elements. If they aren't aligned within the
+	// block, they are copied instead.
+	template<typename T>
+	SharedArray<T> read_array(std::size_t count) {
+		static_assert(std::is_trivially_copyable<T>::value, "Must be trivially copyable.");
+		if (!_good || count > remaining() / sizeof(T)) {
+			_good = false;
+			return SharedArray<T>();
+		}
+		char const* begin = _data + _pos;
+		_pos += count * sizeof(T);
+		if (reinterpret_cast<std::uintptr_t>(begin) % alignof(T) == 0) {
+			return SharedArray<T>(_owner, reinterpret_cast<T const*>(begin), count);
+		} else {
+			std::vector<T> vec(count);
+			if (count != 0) {
+				std::memcpy(vec.data(), begin, count * sizeof(T));
+			}
+			return SharedArray<T>(std::move(vec));
+		}
+	}
+	// Reads with a function taking an `std::istream`, for types that only
+	// support reading from streams.
+	template<typename F>
+	BinaryView& read_stream(F read_fn) {
+		if (!_good) {
+			return *this;
+		}
+		StreamBuf buf(_data + _pos, _data + _size);
+		std::istream is(&buf);
+		read_fn(is);
+		if (!is) {
+			_good = false;
+		} else {
+			_pos += buf.consumed();
+		}
+		return *this;
+	}
+};
+
+// Draws indices from a discrete distribution in constant time, using Walker's
+// alias method.
+class AliasTable final {
+	// Each entry is stored together with its alias, so that a draw only needs
+	// a single memory access. The layout matches the binary format.
+	struct Entry {
+		Double prob;
+		std::uint64_t alias;
+	};
+	static_assert(sizeof(Entry) == 2 * sizeof(std::uint64_t), "Unexpected padding.");
+	SharedArray<Entry> _entries;
+
+public:
+	AliasTable() = default;
+	// Constructs the table from non-negative weights, which don't need to be
+	// normalized. If all weights are zero, every index is equally likely.
+	explicit AliasTable(std::vector<Double> const& weights) {
+		std::size_t n = weights.size();
+		std::vector<Entry> entries(n);
+		for (std::size_t idx = 0; idx < n; ++idx) {
+			entries[idx].prob = 1.;
+			entries[idx].alias = idx;
+		}
+		Double total = 0.;
+		for (Double weight : weights) {
+			total += weight;
+		}
+		if (!(total > 0.) || !std::isfinite(total)) {
+			_entries = std::move(entries);
+			return;
+		}
+		// Split the indices into those with less than and more than the
+		// average probability, then pair them up.
+		std::vector<Double> scaled(n);
+		std::vector<std::size_t> small;
+		std::vector<std::size_t> large;
+		for (std::size_t idx = 0; idx < n; ++idx) {
+			scaled[idx] = weights[idx] * n / total;
+			if (scaled[idx] < 1.) {
+				small.push_back(idx);
+			} else {
+				large.push_back(idx);
+			}
+		}
+		while (!small.empty() && !large.empty()) {
+			std::size_t idx_small = small.back();
+			std::size_t idx_large = large.back();
+			small.pop_back();
+			entries[idx_small].prob = scaled[idx_small];
+			entries[idx_small].alias = idx_large;
+			scaled[idx_large] -= 1. - scaled[idx_small];
+			if (scaled[idx_large] < 1.) {
+				large.pop_back();
+				small.push_back(idx_large);
+			}
+		}
+		// Anything left over has probability one, up to round-off.
+		for (std::size_t idx : small) {
+			entries[idx].prob = 1.;
+		}
+		for (std::size_t idx : large) {
+			entries[idx].prob = 1.;
+		}
+		_entries = std::move(entries);
+	}
+
+	std::size_t size() const {
+		return _entries.size();
+	}
+
+	template<typename R>
+	std::size_t draw(R& rnd) const {
+		std::uniform_real_distribution<Double> dist(0., _entries.size());
+		Double u = dist(rnd);
+		std::size_t idx = static_cast<std::size_t>(u);
+		if (idx >= _entries.size()) {
+			idx = _entries.size() - 1;
+		}
+		Entry const& entry = _entries[idx];
+		return u - idx < entry.prob ? idx : entry.alias;
+	}
+
+	// Binary serialization, storing the table exactly.
+	std::ostream& write(std::ostream& os) const {
+		std::uint64_t size = _entries.size();
+		os.write(reinterpret_cast<char const*>(&size), sizeof(size));
+		os.write(
+			reinterpret_cast<char const*>(_entries.data()),
+			_entries.size() * sizeof(Entry));
+		return os;
+	}
+	std::istream& read(std::istream& is) {
+		std::uint64_t size;
+		if (!is.read(reinterpret_cast<char*>(&size), sizeof(size))) {
+			return is;
+		}
+		std::vector<Entry> entries(size);
+		is.read(reinterpret_cast<char*>(entries.data()), size * sizeof(Entry));
+		for (Entry const& entry : entries) {
+			if (entry.alias >= size) {
+				is.setstate(std::ios_base::failbit);
+			}
+		}
+		_entries = std::move(entries);
+		return is;
+	}
+	// Reads the table without copying it, if possible.
+	BinaryView& read(BinaryView& view) {
+		std::uint64_t size;
+		if (!view.read(&size)) {
+			return view;
+		}
+		SharedArray<Entry> entries = view.read_array<Entry>(size);
+		for (Entry const& entry : entries) {
+			if (entry.alias >= size) {
+				view.fail();
+			}
+		}
+		_entries = std::move(entries);
+		return view;
+	}
+};
+
+// Estimates quantiles of the positive values in a sample, using a histogram
+// with logarithmically spaced bins. Non-positive values are ignored. The
+// estimates are accurate to within the bin width, about 3% relative. Values
+// outside of 2^-64 to 2^64 are counted in the lowest or highest bin.
+class QuantileAccum final {
+	static int const BINS_PER_OCTAVE = 32;
+	static int const EXP_MIN = -64;
+	static int const EXP_MAX = 64;
+	static std::size_t const NUM_BINS = (EXP_MAX - EXP_MIN) * BINS_PER_OCTAVE;
+	// Only the bins from the lowest to the highest one that has been hit are
+	// stored, starting from bin `_idx_begin`. Weights usually span a few tens
+	// of octaves, so this is much smaller than the full range.
+	std::size_t _idx_begin;
+	std::vector<std::size_t> _bins;
+	std::size_t _count;
+
+public:
+	QuantileAccum() :
+		_idx_begin(0),
+		_bins(),
+		_count(0) { }
+
+	QuantileAccum& operator+=(Double x) {
+		if (!(x > 0.)) {
+			return *this;
+		}
+		// Split into `x = m * 2^exp` with `m` in [1/2, 1), and then use a
+		// linear spacing of bins within the octave.
+		int exp;
+		Double m = std::frexp(x, &exp);
+		int sub = static_cast<int>((2. * m - 1.) * BINS_PER_OCTAVE);
+		std::ptrdiff_t idx_signed = static_cast<std::ptrdiff_t>(exp - EXP_MIN) * BINS_PER_OCTAVE + sub;
+		std::size_t idx;
+		if (idx_signed < 0) {
+			idx = 0;
+		} else if (idx_signed >= static_cast<std::ptrdiff_t>(NUM_BINS)) {
+			idx = NUM_BINS - 1;
+		} else {
+			idx = static_cast<std::size_t>(idx_signed);
+		}
+		// Extend the stored range of bins to include the new one.
+		if (_bins.empty()) {
+			_idx_begin = idx;
+			_bins.push_back(0);
+		} else if (idx < _idx_begin) {
+			_bins.insert(_bins.begin(), _idx_begin - idx, 0);
+			_idx_begin = idx;
+		} else if (idx - _idx_begin >= _bins.size()) {
+			_bins.resize(idx - _idx_begin + 1, 0);
+		}
+		_bins[idx - _idx_begin] += 1;
+		_count += 1;
+		return *this;
+	}
+
+	// Number of positive values.
+	std::size_t count() const {
+		return _count;
+	}
+
+	// Serialization to binary streams.
+	std::ostream& write(std::ostream& os) const {
+		std::uint64_t count = _count;
+		std::uint64_t idx_begin = _idx_begin;
+		std::uint64_t num_bins = _bins.size();
+		os.write(reinterpret_cast<char const*>(&count), sizeof(count));
+		os.write(reinterpret_cast<char const*>(&idx_begin), sizeof(idx_begin));
+		os.write(reinterpret_cast<char const*>(&num_bins), sizeof(num_bins));
+		for (std::size_t bin : _bins) {
+			std::uint64_t bin_out = bin;
+			os.write(reinterpret_cast<char const*>(&bin_out), sizeof(bin_out));
+		}
+		return os;
+	}
+	std::istream& read(std::istream& is) {
+		std::uint64_t count;
+		std::uint64_t idx_begin;
+		std::uint64_t num_bins;
+		is.read(reinterpret_cast<char*>(&count), sizeof(count));
+		is.read(reinterpret_cast<char*>(&idx_begin), sizeof(idx_begin));
+		is.read(reinterpret_cast<char*>(&num_bins), sizeof(num_bins));
+		if (!is || idx_begin > NUM_BINS || num_bins > NUM_BINS - idx_begin) {
+			is.setstate(std::ios_base::failbit);
+			return is;
+		}
+		_count = count;
+		_idx_begin = idx_begin;
+		_bins.resize(num_bins);
+		for (std::size_t& bin : _bins) {
+			std::uint64_t bin_in;
+			is.read(reinterpret_cast<char*>(&bin_in), sizeof(bin_in));
+			bin = bin_in;
+		}
+		return is;
+	}
+
+	// Upper edge of the bin containing the quantile `q` in [0, 1]. Returns zero
+	// if there are no values.
+	Double quantile(Double q) const {
+		if (_count == 0) {
+			return 0.;
+		}
+		Double target = q * _count;
+		std::size_t cumulative = 0;
+		std::size_t idx = 0;
+		for (; idx < _bins.size() - 1; ++idx) {
+			cumulative += _bins[idx];
+			if (cumulative >= target && cumulative != 0) {
+				break;
+			}
+		}
+		idx += _idx_begin;
+		int exp = static_cast<int>(idx / BINS_PER_OCTAVE) + EXP_MIN;
+		int sub = static_cast<int>(idx % BINS_PER_OCTAVE);
+		return std::ldexp(1. + static_cast<Double>(sub + 1) / BINS_PER_OCTAVE, exp - 1);
+	}
+};
+
 #endif
 
@@ -0,0 +1,392 @@
+#ifndef SIDISGEN_VEGAS_HPP
+#define SIDISGEN_VEGAS_HPP
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "utility.hpp"
+
+// Parameters for building a `VegasEngine`.
+struct VegasParams {
+	// Number of grid bins along each dimension.
+	std::size_t num_bins;
+	// Number of density evaluations in each adaptation iteration.
+	std::size_t num_samples;
+	// Maximum number of adaptation iterations.
+	std::size_t max_iters;
+	// Maximum number of strata that the hypercube is divided into.
+	std::size_t max_strata;
+	// Adaptation stops early once the estimated relative variance of the event
+	// weights is below this.
+	Double target_rel_var;
+	// Seed for the samples drawn during adaptation.
+	std::uint64_t seed;
+};
+
+// Damping of the grid adaptation, as in the original VEGAS.
+Double const VEGAS_GRID_ALPHA = 1.5;
+// Damping of the strata adaptation, as in VEGAS+.
+Double const VEGAS_STRATA_BETA = 0.75;
+// Fraction of the strata probability that is spread evenly over all strata, so
+// that no stratum is left without events.
+Double const VEGAS_STRATA_MIX = 0.1;
+// Average and minimum number of samples in each stratum during adaptation.
+// Using too few samples per stratum makes the strata probabilities noisy.
+std::size_t const VEGAS_STRATUM_SAMPLES = 16;
+std::size_t const VEGAS_MIN_STRATUM_SAMPLES = 2;
+// The strata are split into this many chunks during adaptation, each with its
+// own random number stream. This way, the result doesn't depend on the number
+// of threads.
+std::size_t const VEGAS_NUM_CHUNKS = 256;
+
+// Distribution over the unit hypercube of dimension `D`, following the VEGAS
+// algorithm. A separable grid maps the hypercube onto itself, with narrower
+// bins where the density is large. On top of the grid, the hypercube is split
+// into equal strata, each drawn with its own probability (as in VEGAS+).
+// Weights are normalized so that the mean weight of the events, multiplied by
+// the density, is close to one.
+template<std::size_t D>
+class VegasEngine final {
+	std::size_t _num_bins;
+	// Edges of the grid bins, `num_bins + 1` for each dimension.
+	std::vector<Double> _edges;
+	// Number of strata along each dimension.
+	std::size_t _num_strata_dim;
+	// The strata probabilities and the table for drawing from them can be
+	// large, so they may refer directly to a memory-mapped generator file.
+	SharedArray<Double> _strata_prob;
+	AliasTable _strata_table;
+	// Estimate of the integral of the density.
+	Double _norm;
+
+	std::size_t num_strata() const {
+		return _strata_prob.size();
+	}
+
+	// Maps a point in stratum `stratum` (given by coordinates within the
+	// stratum) through the grid. Returns the Jacobian.
+	Double map(
+			std::size_t stratum,
+			std::array<Double, D> const& unit,
+			std::array<Double, D>* vec,
+			std::array<std::size_t, D>* bins) const {
+		Double jacobian = 1.;
+		for (std::size_t dim = 0; dim < D; ++dim) {
+			std::size_t stratum_dim = stratum % _num_strata_dim;
+			stratum /= _num_strata_dim;
+			Double y = (stratum_dim + unit[dim]) / _num_strata_dim * _num_bins;
+			std::size_t bin = std::min(static_cast<std::size_t>(y), _num_bins - 1);
+			Double const* edges = &_edges[dim * (_num_bins + 1)];
+			Double width = edges[bin + 1] - edges[bin];
+			(*vec)[dim] = edges[bin] + (y - bin) * width;
+			(*bins)[dim] = bin;
+			jacobian *= _num_bins * width;
+		}
+		return jacobian;
+	}
+
+	// Moves the grid edges along a dimension, so that each bin contains a
+	// similar part of the histogram of squared densities `hist`.
+	void refine_grid(std::size_t dim, std::vector<Double> const& hist) {
+		Double const* hist_dim = &hist[dim * _num_bins];
+		std::vector<Double> smooth(_num_bins);
+		Double total = 0.;
+		for (std::size_t bin = 0; bin < _num_bins; ++bin) {
+			Double sum = hist_dim[bin];
+			std::size_t count = 1;
+			if (bin > 0) {
+				sum += hist_dim[bin - 1];
+				count += 1;
+			}
+			if (bin + 1 < _num_bins) {
+				sum += hist_dim[bin + 1];
+				count += 1;
+			}
+			smooth[bin] = sum / count;
+			total += smooth[bin];
+		}
+		if (!(total > 0.) || !std::isfinite(total)) {
+			return;
+		}
+		Double total_weight = 0.;
+		for (Double& weight : smooth) {
+			Double r = weight / total;
+			if (r >= 1.) {
+				weight = 1.;
+			} else if (r > 0.) {
+				weight = std::pow((r - 1.) / std::log(r), VEGAS_GRID_ALPHA);
+			} else {
+				weight = 0.;
+			}
+			total_weight += weight;
+		}
+		Double* edges = &_edges[dim * (_num_bins + 1)];
+		std::vector<Double> edges_new(_num_bins + 1);
+		edges_new[0] = 0.;
+		edges_new[_num_bins] = 1.;
+		std::size_t bin = 0;
+		Double accum = 0.;
+		for (std::size_t idx = 1; idx < _num_bins; ++idx) {
+			Double target = total_weight * idx / _num_bins;
+			while (bin + 1 < _num_bins && accum + smooth[bin] < target) {
+				accum += smooth[bin];
+				bin += 1;
+			}
+			Double frac = smooth[bin] > 0. ?
+				std::min((target - accum) / smooth[bin], 1.) :
+				0.;
+			edges_new[idx] = edges[bin] + frac * (edges[bin + 1] - edges[bin]);
+		}
+		std::copy(edges_new.begin(), edges_new.end(), edges);
+	}
+
+public:
+	// Constructs a uniform distribution.
+	VegasEngine() :
+			_num_bins(1),
+			_edges(),
+			_num_strata_dim(1),
+			_strata_prob(std::vector<Double>(1, 1.)),
+			_strata_table(std::vector<Double>(1, 1.)),
+			_norm(1.) {
+		for (std::size_t dim = 0; dim < D; ++dim) {
+			_edges.push_back(0.);
+			_edges.push_back(1.);
+		}
+	}
+
+	// Adapts the grid and the strata to the density. Adaptation stops early if
+	// there isn't enough of `budget` left for another iteration, but at least
+	// one iteration is always done. Each parallel loop uses as many threads as
+	// `threads` gives it at the time. If `start` is
+	// provided, adaptation begins from its grid and strata (as long as they
+	// have the same sizes), so that it can stop after the first iteration if
+	// the density hasn't changed much.
+	template<typename F>
+	static VegasEngine<D> build(
+			F const& density,
+			VegasParams const& params,
+			ThreadShareTask const& threads=ThreadShareTask(),
+			VegasEngine<D> const* start=nullptr,
+			BuildBudget budget=BuildBudget()) {
+		if (params.num_bins == 0 || params.num_samples == 0 || params.max_iters == 0) {
+			throw std::runtime_error(
+				"VEGAS needs at least one bin, sample, and iteration.");
+		}
+		VegasEngine<D> engine;
+		engine._num_bins = params.num_bins;
+		engine._edges.resize(D * (params.num_bins + 1));
+		for (std::size_t dim = 0; dim < D; ++dim) {
+			for (std::size_t bin = 0; bin <= params.num_bins; ++bin) {
+				engine._edges[dim * (params.num_bins + 1) + bin]
+					= static_cast<Double>(bin) / params.num_bins;
+			}
+		}
+		// Use as many strata as possible while still having enough samples
+		// in each of them.
+		Double max_strata = std::min<Double>(
+			params.max_strata,
+			static_cast<Double>(params.num_samples) / VEGAS_STRATUM_SAMPLES);
+		while (std::pow(engine._num_strata_dim + 1., D) <= max_strata) {
+			engine._num_strata_dim += 1;
+		}
+		std::size_t num_strata = 1;
+		for (std::size_t dim = 0; dim < D; ++dim) {
+			num_strata *= engine._num_strata_dim;
+		}
+		std::vector<Double> strata_prob(num_strata, 1. / num_strata);
+		if (start != nullptr && start->_num_bins == engine._num_bins) {
+			engine._edges = start->_edges;
+		}
+		if (start != nullptr && start->_num_strata_dim == engine._num_strata_dim) {
+			strata_prob.assign(start->_strata_prob.begin(), start->_strata_prob.end());
+		}
+
+		std::vector<std::size_t> strata_count(num_strata);
+		std::vector<Double> strata_mean(num_strata);
+		std::vector<Double> strata_mean_sq(num_strata);
+		std::vector<std::vector<Double> > chunk_hist(VEGAS_NUM_CHUNKS);
+		Double integ = 0.;
+		for (std::size_t iter = 0; iter < params.max_iters; ++iter) {
+			// Stratified sampling, with the number of samples in each stratum
+			// proportional to its probability.
+			for (std::size_t stratum = 0; stratum < num_strata; ++stratum) {
+				strata_count[stratum] = std::max<std::size_t>(
+					VEGAS_MIN_STRATUM_SAMPLES,
+					static_cast<std::size_t>(std::llround(
+						params.num_samples * strata_prob[stratum])));
+			}
+#ifdef _OPENMP
+			int num_threads = threads.num_threads();
+			#pragma omp parallel for num_threads(num_threads) schedule(dynamic)
+#else
+			static_cast<void>(threads);
+#endif
+			for (long chunk = 0; chunk < static_cast<long>(VEGAS_NUM_CHUNKS); ++chunk) {
+				std::seed_seq seq {
+					static_cast<std::uint32_t>(params.seed),
+					static_cast<std::uint32_t>(params.seed >> 32),
+					static_cast<std::uint32_t>(iter),
+					static_cast<std::uint32_t>(chunk) };
+				std::mt19937_64 rnd(seq);
+				std::uniform_real_distribution<Double> dist;
+				std::vector<Double>& hist = chunk_hist[chunk];
+				hist.assign(D * engine._num_bins, 0.);
+				std::size_t stratum_begin = num_strata * chunk / VEGAS_NUM_CHUNKS;
+				std::size_t stratum_end = num_strata * (chunk + 1) / VEGAS_NUM_CHUNKS;
+				for (std::size_t stratum = stratum_begin; stratum < stratum_end; ++stratum) {
+					std::size_t count = strata_count[stratum];
+					Double sum = 0.;
+					Double sum_sq = 0.;
+					for (std::size_t sample = 0; sample < count; ++sample) {
+						std::array<Double, D> unit;
+						for (std::size_t dim = 0; dim < D; ++dim) {
+							unit[dim] = dist(rnd);
+						}
+						std::array<Double, D> vec;
+						std::array<std::size_t, D> bins;
+						Double jacobian = engine.map(stratum, unit, &vec, &bins);
+						Double value = jacobian * density(vec);
+						sum += value;
+						sum_sq += value * value;
+						// All strata have the same volume, so the squared
+						// density in each bin can be estimated by weighting
+						// each sample by the inverse of the stratum count.
+						for (std::size_t dim = 0; dim < D; ++dim) {
+							hist[dim * engine._num_bins + bins[dim]] += value * value / count;
+						}
+					}
+					strata_mean[stratum] = sum / count;
+					strata_mean_sq[stratum] = sum_sq / count;
+				}
+			}
+
+			std::size_t num_evals = 0;
+			for (std::size_t count : strata_count) {
+				num_evals += count;
+			}
+			budget.add_evals(num_evals);
+
+			// Estimate the relative variance of the event weights from the
+			// current grid and strata. Adaptation stops once it's small
+			// enough, or once there is no budget for another iteration.
+			integ = 0.;
+			for (std::size_t stratum = 0; stratum < num_strata; ++stratum) {
+				integ += strata_mean[stratum] / num_strata;
+			}
+			Double weight_sq = 0.;
+			for (std::size_t stratum = 0; stratum < num_strata; ++stratum) {
+				weight_sq += strata_mean_sq[stratum]
+					/ (strata_prob[stratum] * num_strata * num_strata);
+			}
+			Double rel_var = weight_sq / (integ * integ) - 1.;
+			if (rel_var <= params.target_rel_var
+					|| iter + 1 == params.max_iters
+					|| !budget.allows(num_evals)) {
+				break;
+			}
+
+			// The optimal probability for each stratum is proportional to the
+			// RMS of the density within it, which is damped to make the
+			// adaptation more stable.
+			std::vector<Double> strata_rms(num_strata);
+			Double rms_total = 0.;
+			for (std::size_t stratum = 0; stratum < num_strata; ++stratum) {
+				strata_rms[stratum] = std::pow(strata_mean_sq[stratum], 0.5 * VEGAS_STRATA_BETA);
+				rms_total += strata_rms[stratum];
+			}
+			for (std::size_t stratum = 0; stratum < num_strata; ++stratum) {
+				Double prob = rms_total > 0. && std::isfinite(rms_total) ?
+					strata_rms[stratum] / rms_total :
+					1. / num_strata;
+				strata_prob[stratum]
+					= (1. - VEGAS_STRATA_MIX) * prob + VEGAS_STRATA_MIX / num_strata;
+			}
+
+			// Combine the histograms from each chunk in order, and then adapt
+			// the grid.
+			std::vector<Double> hist(D * engine._num_bins, 0.);
+			for (std::vector<Double> const& hist_chunk : chunk_hist) {
+				for (std::size_t idx = 0; idx < hist.size(); ++idx) {
+					hist[idx] += hist_chunk[idx];
+				}
+			}
+			for (std::size_t dim = 0; dim < D; ++dim) {
+				engine.refine_grid(dim, hist);
+			}
+		}
+		if (!(integ > 0.) || !std::isfinite(integ)) {
+			throw std::runtime_error(
+				"VEGAS found no region with positive density.");
+		}
+		engine._strata_table = AliasTable(strata_prob);
+		engine._strata_prob = std::move(strata_prob);
+		engine._norm = integ;
+		return engine;
+	}
+
+	// Draws a weighted point from the distribution.
+	template<typename R>
+	void generate(R& rnd, Double* weight, std::array<Double, D>* vec) const {
+		std::size_t stratum = _strata_table.draw(rnd);
+		std::uniform_real_distribution<Double> dist;
+		std::array<Double, D> unit;
+		for (std::size_t dim = 0; dim < D; ++dim) {
+			unit[dim] = dist(rnd);
+		}
+		std::array<std::size_t, D> bins;
+		Double jacobian = map(stratum, unit, vec, &bins);
+		*weight = jacobian / (_strata_prob[stratum] * num_strata() * _norm);
+	}
+
+	Double prime() const {
+		return 1. / _norm;
+	}
+
+	// Binary serialization.
+	std::ostream& write(std::ostream& os) const {
+		std::uint64_t num_bins = _num_bins;
+		std::uint64_t num_strata_dim = _num_strata_dim;
+		os.write(reinterpret_cast<char const*>(&num_bins), sizeof(num_bins));
+		os.write(reinterpret_cast<char const*>(&num_strata_dim), sizeof(num_strata_dim));
+		os.write(reinterpret_cast<char const*>(&_norm), sizeof(Double));
+		os.write(reinterpret_cast<char const*>(_edges.data()), _edges.size() * sizeof(Double));
+		os.write(reinterpret_cast<char const*>(_strata_prob.data()), _strata_prob.size() * sizeof(Double));
+		return _strata_table.write(os);
+	}
+	// Reads the engine without copying the strata, if possible.
+	BinaryView& read(BinaryView& view) {
+		std::uint64_t num_bins;
+		std::uint64_t num_strata_dim;
+		view.read(&num_bins).read(&num_strata_dim).read(&_norm);
+		if (!view || num_bins == 0 || num_strata_dim == 0
+				|| std::pow(static_cast<Double>(num_strata_dim), D) > 1e9) {
+			view.fail();
+			return view;
+		}
+		_num_bins = num_bins;
+		_num_strata_dim = num_strata_dim;
+		std::size_t num_strata = 1;
+		for (std::size_t dim = 0; dim < D; ++dim) {
+			num_strata *= _num_strata_dim;
+		}
+		SharedArray<Double> edges = view.read_array<Double>(D * (_num_bins + 1));
+		_edges.assign(edges.begin(), edges.end());
+		_strata_prob = view.read_array<Double>(num_strata);
+		_strata_table.read(view);
+		if (view && _strata_table.size() != num_strata) {
+			view.fail();
+		}
+		return view;
+	}
+};
+
+#endif
+
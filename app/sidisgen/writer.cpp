@@ -0,0 +1,371 @@
+#include "writer.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ios>
+#include <stdexcept>
+
+// Files are truncated in place where POSIX is available. Elsewhere, they are
+// copied up to the new length.
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+using namespace sidis;
+
+namespace {
+
+// Converts between the `sidis` 4-vector type and the ROOT 4-vector type.
+TLorentzVector convert_vec4(math::Vec4 vec) {
+	return TLorentzVector(vec.x, vec.y, vec.z, vec.t);
+}
+
+// Shortens a file to `size` bytes, which must not be more than its length.
+void truncate_file(std::string const& file_name, std::streamoff size) {
+#if defined(__unix__) || defined(__APPLE__)
+	if (::truncate(file_name.c_str(), static_cast<off_t>(size)) != 0) {
+		throw std::runtime_error("Could not truncate file '" + file_name + "'.");
+	}
+#else
+	std::string temp_name = file_name + ".tmp";
+	{
+		std::ifstream file_in(file_name, std::ios_base::in | std::ios_base::binary);
+		std::ofstream file_out(temp_name, std::ios_base::out | std::ios_base::binary);
+		std::vector<char> buffer(1 << 20);
+		while (size > 0 && file_in && file_out) {
+			std::streamsize count = static_cast<std::streamsize>(
+				std::min<std::streamoff>(size, buffer.size()));
+			file_in.read(buffer.data(), count);
+			file_out.write(buffer.data(), file_in.gcount());
+			size -= file_in.gcount();
+		}
+		if (size != 0 || !file_out.flush()) {
+			file_out.close();
+			std::remove(temp_name.c_str());
+			throw std::runtime_error("Could not truncate file '" + file_name + "'.");
+		}
+	}
+	if (std::remove(file_name.c_str()) != 0
+			|| std::rename(temp_name.c_str(), file_name.c_str()) != 0) {
+		throw std::runtime_error("Could not truncate file '" + file_name + "'.");
+	}
+#endif
+}
+
+}
+
+MomentaSetup::MomentaSetup(
+		part::Particles ps,
+		Double beam_energy,
+		math::Vec3 target_pol) :
+		ps(ps),
+		S(2. * beam_energy * ps.M),
+		init(ps, beam_energy),
+		target_pol(target_pol) { }
+
+Momenta event_momenta(MomentaSetup const& setup, EventRecord const& record) {
+	kin::Kinematics kin(setup.ps, setup.S, kin::PhaseSpace {
+		record.x, record.y, record.z,
+		record.ph_t_sq, record.phi_h, record.phi,
+	});
+	Momenta momenta;
+	momenta.p = setup.init.p;
+	momenta.k1 = setup.init.k1;
+	switch (static_cast<EventType>(record.type - 1)) {
+	case EventType::NRAD:
+		// Non-radiative event.
+		{
+			kin::Final fin(setup.init, setup.target_pol, kin);
+			momenta.q = fin.q;
+			momenta.k2 = fin.k2;
+			momenta.ph = fin.ph;
+			momenta.k = math::Vec4();
+		}
+		break;
+	case EventType::RAD:
+		// Radiative event.
+		{
+			kin::KinematicsRad kin_rad(kin, record.tau, record.phi_k, record.R);
+			kin::FinalRad fin(setup.init, setup.target_pol, kin_rad);
+			momenta.q = fin.q;
+			momenta.k2 = fin.k2;
+			momenta.ph = fin.ph;
+			momenta.k = fin.k;
+		}
+		break;
+	default:
+		UNREACHABLE();
+	}
+	return momenta;
+}
+
+RootWriter::RootWriter(
+		WriterOptions options,
+		part::Particles ps,
+		Double beam_energy,
+		math::Vec3 target_pol,
+		TTree* events) :
+		_options(options),
+		_setup(ps, beam_energy, target_pol),
+		_events(events),
+		_momenta_ptrs { &_p, &_k1, &_q, &_k2, &_ph, &_k } {
+	// TODO: Right now, this is depending on the `SfXX` structure having a
+	// very specific format. This isn't guaranteed to be true in the future,
+	// if things get reorganized. Not sure what a better approach is, as
+	// ROOT doesn't have another way of writing plain C-structs into trees.
+	char const* sf_leaves = "F_UUL/D:F_UUT/D:F_UU_cos_phih/D:F_UU_cos_2phih/D:F_UL_sin_phih/D:F_UL_sin_2phih/D:F_UTL_sin_phih_m_phis/D:F_UTT_sin_phih_m_phis/D:F_UT_sin_2phih_m_phis/D:F_UT_sin_3phih_m_phis/D:F_UT_sin_phis/D:F_UT_sin_phih_p_phis/D:F_LU_sin_phih/D:F_LL/D:F_LL_cos_phih/D:F_LT_cos_phih_m_phis/D:F_LT_cos_2phih_m_phis/D:F_LT_cos_phis/D";
+	char const* momenta_names[6] = { "p", "k1", "q", "k2", "ph", "k" };
+	std::size_t num_momenta = 0;
+	if (_options.write_momenta) {
+		num_momenta = _options.write_photon ? 6 : 5;
+	}
+	if (_events == nullptr) {
+		_events = new TTree("events", "events");
+		// Automatic saves would leave the tree on disk ahead of the latest
+		// checkpoint, so only save at checkpoints.
+		if (_options.checkpoints) {
+			_events->SetAutoSave(0);
+		}
+		_events->Branch("type", &_type);
+		_events->Branch("weight", &_weight);
+		_events->Branch("x", &_x);
+		_events->Branch("y", &_y);
+		_events->Branch("z", &_z);
+		_events->Branch("ph_t_sq", &_ph_t_sq);
+		_events->Branch("phi_h", &_phi_h);
+		_events->Branch("phi", &_phi);
+		_events->Branch("tau", &_tau);
+		_events->Branch("phi_k", &_phi_k);
+		_events->Branch("R", &_R);
+		for (std::size_t idx = 0; idx < num_momenta; ++idx) {
+			_events->Branch(momenta_names[idx], "TLorentzVector", _momenta_ptrs[idx]);
+		}
+		if (_options.write_sf_set) {
+			_events->Branch("sf", &_sf, sf_leaves);
+		}
+	} else {
+		if (_options.checkpoints) {
+			_events->SetAutoSave(0);
+		}
+		bool success = _events->SetBranchAddress("type", &_type) >= 0
+			&& _events->SetBranchAddress("weight", &_weight) >= 0
+			&& _events->SetBranchAddress("x", &_x) >= 0
+			&& _events->SetBranchAddress("y", &_y) >= 0
+			&& _events->SetBranchAddress("z", &_z) >= 0
+			&& _events->SetBranchAddress("ph_t_sq", &_ph_t_sq) >= 0
+			&& _events->SetBranchAddress("phi_h", &_phi_h) >= 0
+			&& _events->SetBranchAddress("phi", &_phi) >= 0
+			&& _events->SetBranchAddress("tau", &_tau) >= 0
+			&& _events->SetBranchAddress("phi_k", &_phi_k) >= 0
+			&& _events->SetBranchAddress("R", &_R) >= 0;
+		for (std::size_t idx = 0; idx < num_momenta; ++idx) {
+			success = success
+				&& _events->SetBranchAddress(momenta_names[idx], &_momenta_ptrs[idx]) >= 0;
+		}
+		if (_options.write_sf_set) {
+			success = success && _events->SetBranchAddress("sf", &_sf) >= 0;
+		}
+		if (!success) {
+			throw std::runtime_error(
+				"Existing events tree doesn't have the expected branches.");
+		}
+	}
+}
+
+void RootWriter::write(EventRecord const& record, sf::SfLP const& sf) {
+	_type = record.type;
+	_weight = record.weight;
+	_x = record.x;
+	_y = record.y;
+	_z = record.z;
+	_ph_t_sq = record.ph_t_sq;
+	_phi_h = record.phi_h;
+	_phi = record.phi;
+	_tau = record.tau;
+	_phi_k = record.phi_k;
+	_R = record.R;
+	if (_options.write_momenta) {
+		Momenta momenta = event_momenta(_setup, record);
+		_p = convert_vec4(momenta.p);
+		_k1 = convert_vec4(momenta.k1);
+		_q = convert_vec4(momenta.q);
+		_k2 = convert_vec4(momenta.k2);
+		_ph = convert_vec4(momenta.ph);
+		_k = convert_vec4(momenta.k);
+	}
+	if (_options.write_sf_set) {
+		_sf = sf;
+	}
+	_events->Fill();
+}
+
+void RootWriter::checkpoint() {
+	// Flush all baskets, and save the tree header and the directory, so that
+	// the file can be reopened with every event written so far.
+	if (_events->AutoSave("SaveSelf FlushBaskets") <= 0) {
+		throw std::runtime_error("Could not save events tree.");
+	}
+}
+
+BinaryWriter::BinaryWriter(
+		std::string file_name,
+		WriterOptions options,
+		part::Particles ps,
+		Double beam_energy,
+		math::Vec3 target_pol,
+		Long resume_num_records) :
+		_options(options),
+		_setup(ps, beam_energy, target_pol),
+		_file_name(file_name),
+		_header() {
+	static_assert(
+		sizeof(sf::SfLP) == event_file::NUM_SF * sizeof(Double),
+		"Structure functions must be stored without padding.");
+	if (!event_file::host_is_little_endian()) {
+		throw std::runtime_error(
+			"Binary event files can only be written on little-endian hosts.");
+	}
+	std::memcpy(_header.magic, event_file::MAGIC, sizeof(event_file::MAGIC));
+	_header.version = event_file::VERSION;
+	_header.flags = 0;
+	if (_options.write_momenta) {
+		_header.flags |= event_file::FLAG_MOMENTA;
+		if (_options.write_photon) {
+			_header.flags |= event_file::FLAG_PHOTON;
+		}
+	}
+	if (_options.write_sf_set) {
+		_header.flags |= event_file::FLAG_SF_SET;
+	}
+	_header.records_offset = sizeof(event_file::Header);
+	_header.record_size = event_file::record_size(_header.flags);
+	_header.num_records = 0;
+	_buffer.resize(_header.record_size);
+	if (resume_num_records < 0) {
+		// Don't overwrite existing files, same as for ROOT files.
+		if (std::ifstream(file_name)) {
+			throw std::runtime_error("File '" + file_name + "' already exists.");
+		}
+		_file.open(file_name, std::ios_base::out | std::ios_base::binary);
+		if (!_file) {
+			throw std::runtime_error("Could not create file '" + file_name + "'.");
+		}
+		// Reserve space for the header, which is filled in at the end.
+		write_header();
+	} else {
+		// Check that the existing file has the same layout, then drop any
+		// records written after the checkpoint.
+		event_file::Header header_old;
+		std::ifstream file_old(file_name, std::ios_base::in | std::ios_base::binary);
+		if (!file_old.read(reinterpret_cast<char*>(&header_old), sizeof(header_old))
+				|| std::memcmp(header_old.magic, _header.magic, sizeof(_header.magic)) != 0
+				|| header_old.version != _header.version
+				|| header_old.flags != _header.flags
+				|| header_old.records_offset != _header.records_offset
+				|| header_old.record_size != _header.record_size) {
+			throw std::runtime_error(
+				"File '" + file_name + "' is not a compatible event file.");
+		}
+		_header.num_records = resume_num_records;
+		std::streamoff size = static_cast<std::streamoff>(
+			_header.records_offset + _header.num_records * _header.record_size);
+		// Truncating can only drop records, never fill in missing ones.
+		file_old.seekg(0, std::ios_base::end);
+		if (!file_old || file_old.tellg() < size) {
+			throw std::runtime_error(
+				"File '" + file_name + "' has fewer events than the checkpoint.");
+		}
+		file_old.close();
+		truncate_file(file_name, size);
+		_file.open(
+			file_name,
+			std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+		_file.seekp(0, std::ios_base::end);
+		if (!_file) {
+			throw std::runtime_error("Could not open file '" + file_name + "'.");
+		}
+	}
+}
+
+void BinaryWriter::write_header() {
+	_file.write(reinterpret_cast<char const*>(&_header), sizeof(_header));
+	if (!_file) {
+		throw std::runtime_error("Could not write to file '" + _file_name + "'.");
+	}
+}
+
+void BinaryWriter::write(EventRecord const& record, sf::SfLP const& sf) {
+	char* ptr = _buffer.data();
+	event_file::Record base;
+	base.type = record.type;
+	base.reserved = 0;
+	base.weight = record.weight;
+	base.x = record.x;
+	base.y = record.y;
+	base.z = record.z;
+	base.ph_t_sq = record.ph_t_sq;
+	base.phi_h = record.phi_h;
+	base.phi = record.phi;
+	base.tau = record.tau;
+	base.phi_k = record.phi_k;
+	base.R = record.R;
+	std::memcpy(ptr, &base, sizeof(base));
+	ptr += sizeof(base);
+	if (_options.write_momenta) {
+		Momenta momenta = event_momenta(_setup, record);
+		math::Vec4 const vecs[6] = {
+			momenta.p, momenta.k1, momenta.q, momenta.k2, momenta.ph, momenta.k,
+		};
+		std::size_t num_momenta = event_file::num_momenta(_header.flags);
+		for (std::size_t idx = 0; idx < num_momenta; ++idx) {
+			Double vec[4] = { vecs[idx].x, vecs[idx].y, vecs[idx].z, vecs[idx].t };
+			std::memcpy(ptr, vec, sizeof(vec));
+			ptr += sizeof(vec);
+		}
+	}
+	if (_options.write_sf_set) {
+		std::memcpy(ptr, &sf, sizeof(sf));
+		ptr += sizeof(sf);
+	}
+	_file.write(_buffer.data(), _buffer.size());
+	if (!_file) {
+		throw std::runtime_error("Could not write to file '" + _file_name + "'.");
+	}
+	_header.num_records += 1;
+}
+
+void BinaryWriter::checkpoint() {
+	// Keep the record count in the header up to date, so that the file can be
+	// read up to the checkpoint.
+	std::streampos pos = _file.tellp();
+	_file.seekp(0);
+	write_header();
+	_file.seekp(pos);
+	_file.flush();
+	if (!_file) {
+		throw std::runtime_error("Could not write to file '" + _file_name + "'.");
+	}
+}
+
+void BinaryWriter::finish(
+		std::string const& params,
+		std::array<event_file::Stats, NUM_EVENT_TYPES + 1> const& stats) {
+	static_assert(
+		NUM_EVENT_TYPES + 1 == sizeof(_header.stats) / sizeof(_header.stats[0]),
+		"Event file header must have statistics for every event type.");
+	_header.params_offset = _header.records_offset
+		+ _header.num_records * _header.record_size;
+	_header.params_size = params.size();
+	for (std::size_t idx = 0; idx < stats.size(); ++idx) {
+		_header.stats[idx] = stats[idx];
+	}
+	_file.write(params.data(), params.size());
+	_file.seekp(0);
+	write_header();
+	_file.close();
+	if (!_file) {
+		throw std::runtime_error("Could not write to file '" + _file_name + "'.");
+	}
+}
@@ -0,0 +1,150 @@
+#ifndef SIDISGEN_WRITER_HPP
+#define SIDISGEN_WRITER_HPP
+
+#include <array>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <TLorentzVector.h>
+#include <TTree.h>
+
+#include <sidis/sidis.hpp>
+#include <sidis/extra/event_file.hpp>
+
+#include "utility.hpp"
+
+// Compact description of a generated event. The generation workers hand these
+// to the writer, which reconstructs everything else that it needs (such as the
+// particle momenta) from the phase space variables.
+struct EventRecord {
+	// Type of the event, as written to the "type" branch (so `EventType` + 1).
+	// Special values are used to pass messages to the writer.
+	Int type;
+	Double weight;
+	Double x, y, z, ph_t_sq, phi_h, phi, tau, phi_k, R;
+};
+
+// Record type marking the end of the events.
+Int const EVENT_RECORD_END = 0;
+// Record type asking the writer to make the events so far durable, and then
+// save a checkpoint.
+Int const EVENT_RECORD_CHECKPOINT = -1;
+
+// Which optional quantities to write for each event.
+struct WriterOptions {
+	bool write_momenta;
+	bool write_photon;
+	bool write_sf_set;
+	// Whether checkpoints will be made while writing.
+	bool checkpoints;
+};
+
+// Initial conditions needed to reconstruct the particle momenta of an event.
+struct MomentaSetup {
+	sidis::part::Particles ps;
+	Double S;
+	sidis::kin::Initial init;
+	sidis::math::Vec3 target_pol;
+
+	MomentaSetup(
+		sidis::part::Particles ps,
+		Double beam_energy,
+		sidis::math::Vec3 target_pol);
+};
+
+// Particle momenta of an event. The radiated photon momentum `k` is zero for
+// non-radiative events.
+struct Momenta {
+	sidis::math::Vec4 p, k1, q, k2, ph, k;
+};
+
+// Builds the momenta in the same way as the generator does, so that they match
+// those of the original event.
+Momenta event_momenta(MomentaSetup const& setup, EventRecord const& record);
+
+// Destination for generated events, called from the writer thread.
+class EventWriter {
+public:
+	virtual ~EventWriter() = default;
+	// The structure functions are ignored unless `write_sf_set` is on.
+	virtual void write(EventRecord const& record, sidis::sf::SfLP const& sf) = 0;
+	// Makes sure that all events written so far can be recovered from the
+	// file, even if the program is interrupted later.
+	virtual void checkpoint() = 0;
+};
+
+// Writes events to the "events" tree in the current ROOT directory.
+class RootWriter final : public EventWriter {
+	WriterOptions _options;
+	MomentaSetup _setup;
+
+	// Owned by the ROOT directory.
+	TTree* _events;
+	Int _type;
+	Double _weight;
+	Double _x, _y, _z, _ph_t_sq, _phi_h, _phi, _tau, _phi_k, _R;
+	TLorentzVector _p, _k1, _q, _k2, _ph, _k;
+	// ROOT needs the addresses of pointers to objects when reattaching
+	// branches of an existing tree.
+	TLorentzVector* _momenta_ptrs[6];
+	sidis::sf::SfLP _sf;
+
+public:
+	// If `events` is provided, new events are appended to that existing tree
+	// instead of a new one.
+	RootWriter(
+		WriterOptions options,
+		sidis::part::Particles ps,
+		Double beam_energy,
+		sidis::math::Vec3 target_pol,
+		TTree* events=nullptr);
+	RootWriter(RootWriter const&) = delete;
+	RootWriter& operator=(RootWriter const&) = delete;
+
+	// Fills the tree with the event.
+	void write(EventRecord const& record, sidis::sf::SfLP const& sf) override;
+	void checkpoint() override;
+
+	TTree& tree() {
+		return *_events;
+	}
+};
+
+// Writes events as fixed-size little-endian records, following the layout in
+// `sidis/extra/event_file.hpp`. The header is only complete once `finish` has
+// been called.
+class BinaryWriter final : public EventWriter {
+	WriterOptions _options;
+	MomentaSetup _setup;
+	std::string _file_name;
+	std::ofstream _file;
+	sidis::event_file::Header _header;
+	std::vector<char> _buffer;
+
+	void write_header();
+
+public:
+	// If `resume_num_records` is non-negative, the existing file is reopened
+	// and truncated to that many records, and new events are appended.
+	BinaryWriter(
+		std::string file_name,
+		WriterOptions options,
+		sidis::part::Particles ps,
+		Double beam_energy,
+		sidis::math::Vec3 target_pol,
+		Long resume_num_records=-1);
+	BinaryWriter(BinaryWriter const&) = delete;
+	BinaryWriter& operator=(BinaryWriter const&) = delete;
+
+	void write(EventRecord const& record, sidis::sf::SfLP const& sf) override;
+	void checkpoint() override;
+
+	// Appends the parameters and writes the final header.
+	void finish(
+		std::string const& params,
+		std::array<sidis::event_file::Stats, NUM_EVENT_TYPES + 1> const& stats);
+};
+
+#endif
+
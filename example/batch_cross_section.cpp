@@ -0,0 +1,119 @@
+#include <chrono>
+#include <cmath>
+#include <initializer_list>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <sidis/sidis.hpp>
+#include <sidis/sf_set/test.hpp>
+
+using namespace sidis;
+
+// This program compares the time taken by the batched cross-sections against
+// going through the same points one at a time, for a few polarizations.
+int main(int argc, char** argv) {
+	if (argc != 2) {
+		std::cerr << "Usage: batch_cross_section <E_b>" << std::endl;
+		return 1;
+	}
+	Real beam_energy = std::stold(argv[1]);
+	std::size_t const num_points = 256;
+	std::size_t const num_reps = 2000;
+
+	Real Mth = MASS_P + MASS_PI_0;
+	part::Particles ps(part::Nucleus::P, part::Lepton::E, part::Hadron::PI_P, Mth);
+	Real S = 2. * ps.M * beam_energy;
+	sf::set::TestSfSet sf(part::Nucleus::P);
+
+	// Choose random points that are kinematically valid.
+	std::random_device rd;
+	std::mt19937 rng(rd());
+	std::uniform_real_distribution<Real> dist(0., 1.);
+	std::vector<kin::PhaseSpace> ph_spaces;
+	std::vector<kin::Kinematics> kins;
+	while (kins.size() < num_points) {
+		Real point[6] = {
+			dist(rng), dist(rng), dist(rng),
+			dist(rng), dist(rng), dist(rng),
+		};
+		kin::Kinematics kin;
+		if (cut::take(ps, S, point, &kin, nullptr)) {
+			ph_spaces.push_back({
+				kin.x, kin.y, kin.z, kin.ph_t_sq, kin.phi_h, kin.phi });
+			kins.push_back(kin);
+		}
+	}
+
+	using Clock = std::chrono::steady_clock;
+	Clock::time_point start = Clock::now();
+	for (std::size_t rep = 0; rep < num_reps; ++rep) {
+		kin::KinematicsBatch kin_batch(ps, S, ph_spaces);
+	}
+	std::chrono::duration<double> time_kin = Clock::now() - start;
+	std::cout << "KinematicsBatch construction: " << time_kin.count() << " s"
+		<< std::endl;
+
+	kin::KinematicsBatch kin_batch(ps, S, ph_spaces);
+	xs::BatchBuffer buf;
+	std::vector<Real> xs_scalar(num_points);
+	std::vector<Real> xs_batch(num_points);
+	for (unsigned pol_mask : { 0u, 7u, 15u }) {
+		Real beam_pol = (pol_mask & 8u) ? 0.8 : 0.;
+		math::Vec3 eta(
+			(pol_mask & 4u) ? 0.3 : 0.,
+			(pol_mask & 2u) ? -0.5 : 0.,
+			(pol_mask & 1u) ? 0.6 : 0.);
+
+		start = Clock::now();
+		for (std::size_t rep = 0; rep < num_reps; ++rep) {
+			for (std::size_t idx = 0; idx < num_points; ++idx) {
+				xs_scalar[idx] = xs::born(kins[idx], sf, beam_pol, eta);
+			}
+		}
+		Clock::time_point end_scalar = Clock::now();
+		for (std::size_t rep = 0; rep < num_reps; ++rep) {
+			xs::born_batch(kin_batch, sf, beam_pol, eta, buf, xs_batch.data());
+		}
+		Clock::time_point end_batch = Clock::now();
+		Real max_diff = 0.;
+		for (std::size_t idx = 0; idx < num_points; ++idx) {
+			max_diff = std::fmax(
+				max_diff,
+				std::abs(xs_batch[idx] / xs_scalar[idx] - 1.));
+		}
+		std::chrono::duration<double> time_scalar = end_scalar - start;
+		std::chrono::duration<double> time_batch = end_batch - end_scalar;
+		std::cout << "Born, polarization mask " << pol_mask << ": "
+			<< "scalar " << time_scalar.count() << " s, "
+			<< "batch " << time_batch.count() << " s, "
+			<< "max. relative difference " << max_diff << std::endl;
+
+		start = Clock::now();
+		for (std::size_t rep = 0; rep < num_reps; ++rep) {
+			for (std::size_t idx = 0; idx < num_points; ++idx) {
+				xs_scalar[idx] = xs::nrad_ir(kins[idx], sf, beam_pol, eta);
+			}
+		}
+		end_scalar = Clock::now();
+		for (std::size_t rep = 0; rep < num_reps; ++rep) {
+			xs::nrad_ir_batch(kin_batch, sf, beam_pol, eta, buf, xs_batch.data());
+		}
+		end_batch = Clock::now();
+		max_diff = 0.;
+		for (std::size_t idx = 0; idx < num_points; ++idx) {
+			max_diff = std::fmax(
+				max_diff,
+				std::abs(xs_batch[idx] / xs_scalar[idx] - 1.));
+		}
+		time_scalar = end_scalar - start;
+		time_batch = end_batch - end_scalar;
+		std::cout << "Non-radiative, polarization mask " << pol_mask << ": "
+			<< "scalar " << time_scalar.count() << " s, "
+			<< "batch " << time_batch.count() << " s, "
+			<< "max. relative difference " << max_diff << std::endl;
+	}
+
+	return 0;
+}
@@ -1,21 +1,22 @@
 #ifndef SIDIS_CROSS_SECTION_HPP
 #define SIDIS_CROSS_SECTION_HPP
 
+#include <vector>
+
 #include "sidis/constant.hpp"
 #include "sidis/integ_params.hpp"
 #include "sidis/numeric.hpp"
+#include "sidis/particle.hpp"
+#include "sidis/phenom.hpp"
+#include "sidis/vector.hpp"
 
 namespace sidis {
 
-namespace math {
-	struct Vec3;
-}
 namespace kin {
 	struct Kinematics;
 	struct KinematicsRad;
-}
-namespace ph {
-	struct Phenom;
+	struct KinematicsBatch;
+	struct KinematicsRadBatch;
 }
 namespace lep {
 	struct LepBornBaseUU;
@@ -58,6 +59,7 @@ namespace had {
 }
 namespace sf {
 	class SfSet;
+	struct SfLP;
 }
 
 namespace xs {
@@ -115,6 +117,100 @@ math::IntegParams const DEFAULT_INTEG_PARAMS {
  * \ref XsBornGroup "base Born cross-section functions".
  */
 
+/**
+ * \defgroup ContextXsGroup Cross-section contexts
+ * Everything about a setup that stays the same between cross-section
+ * calculations can be bundled into an xs::Context, which is then passed to the
+ * cross-section functions in place of the structure functions and
+ * polarizations. This avoids redoing setup work on every call.
+ * \ingroup XsGroup
+ */
+/// \{
+
+/**
+ * Bundle of the particles, the beam energy, the structure functions, and the
+ * polarizations for a SIDIS experiment. The phenomenological inputs are taken
+ * from a ph::PhenomTable covering the kinematically allowed range of
+ * \f$Q^2\f$, instead of being computed directly as in ph::Phenom::Phenom().
+ *
+ * The structure functions are held by reference, and must outlive the context.
+ */
+class Context final {
+	part::Particles _ps;
+	Real _S;
+	sf::SfSet const& _sf;
+	Real _lambda_e;
+	math::Vec3 _target_pol;
+	ph::PhenomTable _phenom;
+
+public:
+	/// Set up a context, with beam polarization \p lambda_e and target
+	/// polarization \p target_pol (in the target frame).
+	Context(
+		part::Particles const& ps,
+		Real S,
+		sf::SfSet const& sf,
+		Real lambda_e,
+		math::Vec3 target_pol);
+
+	part::Particles const& particles() const {
+		return _ps;
+	}
+	Real S() const {
+		return _S;
+	}
+	sf::SfSet const& sf() const {
+		return _sf;
+	}
+	Real lambda_e() const {
+		return _lambda_e;
+	}
+	math::Vec3 target_pol() const {
+		return _target_pol;
+	}
+
+	/// Phenomenological inputs at \f$Q^2\f$ of \p Q_sq.
+	ph::Phenom phenom(Real Q_sq) const;
+	/// Phenomenological inputs at \p kin.
+	ph::Phenom phenom(kin::Kinematics const& kin) const;
+	/// \copydoc phenom()
+	ph::Phenom phenom(kin::KinematicsRad const& kin) const;
+	/// Target polarization in the hadron frame at \p kin.
+	math::Vec3 eta(kin::Kinematics const& kin) const;
+	/// \copydoc eta()
+	math::Vec3 eta(kin::KinematicsRad const& kin) const;
+};
+
+/// Context version of xs::born().
+Real born(kin::Kinematics const& kin, Context const& ctx);
+/// Context version of xs::born(), using structure functions \p sf already
+/// evaluated at \p kin.
+Real born(kin::Kinematics const& kin, Context const& ctx, sf::SfLP const& sf);
+/// Context version of xs::amm().
+Real amm(kin::Kinematics const& kin, Context const& ctx);
+/// Context version of xs::nrad_ir().
+Real nrad_ir(kin::Kinematics const& kin, Context const& ctx, Real k_0_bar=INF);
+/// Context version of xs::nrad_ir(), using structure functions \p sf already
+/// evaluated at \p kin.
+Real nrad_ir(kin::Kinematics const& kin, Context const& ctx, sf::SfLP const& sf, Real k_0_bar=INF);
+/// Context version of xs::nrad_integ().
+math::EstErr nrad_integ(kin::Kinematics const& kin, Context const& ctx, Real k_0_bar=INF, math::IntegParams params=DEFAULT_INTEG_PARAMS);
+/// Context version of xs::nrad_integ(), using structure functions \p sf_0
+/// already evaluated at \p kin.
+math::EstErr nrad_integ(kin::Kinematics const& kin, Context const& ctx, sf::SfLP const& sf_0, Real k_0_bar=INF, math::IntegParams params=DEFAULT_INTEG_PARAMS);
+/// Context version of xs::rad_f().
+Real rad_f(kin::KinematicsRad const& kin, Context const& ctx);
+/// Context version of xs::rad().
+Real rad(kin::KinematicsRad const& kin, Context const& ctx);
+/// Context version of xs::rad_f_integ().
+math::EstErr rad_f_integ(kin::Kinematics const& kin, Context const& ctx, Real k_0_bar=INF, math::IntegParams params=DEFAULT_INTEG_PARAMS);
+/// Context version of xs::rad_f_integ(), using structure functions \p sf_0
+/// already evaluated at \p kin.
+math::EstErr rad_f_integ(kin::Kinematics const& kin, Context const& ctx, sf::SfLP const& sf_0, Real k_0_bar=INF, math::IntegParams params=DEFAULT_INTEG_PARAMS);
+/// Context version of xs::rad_integ().
+math::EstErr rad_integ(kin::Kinematics const& kin, Context const& ctx, Real k_0_bar=INF, math::IntegParams params=DEFAULT_INTEG_PARAMS);
+/// \}
+
 /**
  * \defgroup GeneralXsGroup General cross-section functions
  * Functions for doing various kinds of cross-section calculations. They take a
@@ -129,6 +225,11 @@ math::IntegParams const DEFAULT_INTEG_PARAMS {
 Real born(kin::Kinematics const& kin, sf::SfSet const& sf, Real lambda_e, math::Vec3 eta);
 /// \copydoc born()
 Real born(kin::Kinematics const& kin, ph::Phenom const& phenom, sf::SfSet const& sf, Real lambda_e, math::Vec3 eta);
+/// %Born cross-section \f$\sigma_{B}\f$, using structure functions \p sf
+/// already evaluated at \p kin.
+Real born(kin::Kinematics const& kin, sf::SfLP const& sf, Real lambda_e, math::Vec3 eta);
+/// \copydoc born(kin::Kinematics const&, sf::SfLP const&, Real, math::Vec3)
+Real born(kin::Kinematics const& kin, ph::Phenom const& phenom, sf::SfLP const& sf, Real lambda_e, math::Vec3 eta);
 /// Anomalous magnetic moment cross-section \f$\sigma_{AMM}\f$, related to
 /// vertex correction diagram.
 Real amm(kin::Kinematics const& kin, sf::SfSet const& sf, Real lambda_e, math::Vec3 eta);
@@ -139,6 +240,11 @@ Real amm(kin::Kinematics const& kin, ph::Phenom const& phenom, sf::SfSet const&
 Real nrad_ir(kin::Kinematics const& kin, sf::SfSet const& sf, Real lambda_e, math::Vec3 eta, Real k_0_bar=INF);
 /// \copydoc nrad_ir()
 Real nrad_ir(kin::Kinematics const& kin, ph::Phenom const& phenom, sf::SfSet const& sf, Real lambda_e, math::Vec3 eta, Real k_0_bar=INF);
+/// Non-radiative cross-section \f$\sigma_{\text{nrad}}^{IR}\f$, using
+/// structure functions \p sf already evaluated at \p kin.
+Real nrad_ir(kin::Kinematics const& kin, sf::SfLP const& sf, Real lambda_e, math::Vec3 eta, Real k_0_bar=INF);
+/// \copydoc nrad_ir(kin::Kinematics const&, sf::SfLP const&, Real, math::Vec3, Real)
+Real nrad_ir(kin::Kinematics const& kin, ph::Phenom const& phenom, sf::SfLP const& sf, Real lambda_e, math::Vec3 eta, Real k_0_bar=INF);
 /// Non-radiative cross-section \f$\sigma_{\text{nrad}}\f$, integrated over the
 /// radiated photon with energy below soft cutoff \p k_0_bar (if \p k_0_bar is
 /// set to infinity (default), then the entire radiative part is integrated
@@ -146,6 +252,12 @@ Real nrad_ir(kin::Kinematics const& kin, ph::Phenom const& phenom, sf::SfSet con
 math::EstErr nrad_integ(kin::Kinematics const& kin, sf::SfSet const& sf, Real lambda_e, math::Vec3 eta, Real k_0_bar=INF, math::IntegParams params=DEFAULT_INTEG_PARAMS);
 /// \copydoc nrad_integ()
 math::EstErr nrad_integ(kin::Kinematics const& kin, ph::Phenom const& phenom, sf::SfSet const& sf, Real lambda_e, math::Vec3 eta, Real k_0_bar=INF, math::IntegParams params=DEFAULT_INTEG_PARAMS);
+/// Non-radiative cross-section \f$\sigma_{\text{nrad}}\f$, using structure
+/// functions \p sf_0 already evaluated at \p kin. The structure functions
+/// for the radiated photon are still taken from \p sf.
+math::EstErr nrad_integ(kin::Kinematics const& kin, sf::SfSet const& sf, sf::SfLP const& sf_0, Real lambda_e, math::Vec3 eta, Real k_0_bar=INF, math::IntegParams params=DEFAULT_INTEG_PARAMS);
+/// \copydoc nrad_integ(kin::Kinematics const&, sf::SfSet const&, sf::SfLP const&, Real, math::Vec3, Real, math::IntegParams)
+math::EstErr nrad_integ(kin::Kinematics const& kin, ph::Phenom const& phenom, sf::SfSet const& sf, sf::SfLP const& sf_0, Real lambda_e, math::Vec3 eta, Real k_0_bar=INF, math::IntegParams params=DEFAULT_INTEG_PARAMS);
 /// Radiative cross-section with infrared divergence removed
 /// \f$\sigma_{R}^{F}\f$.
 Real rad_f(kin::KinematicsRad const& kin, sf::SfSet const& sf, Real lambda_e, math::Vec3 eta);
@@ -162,6 +274,12 @@ Real rad(kin::KinematicsRad const& kin, ph::Phenom const& phenom, sf::SfSet cons
 math::EstErr rad_f_integ(kin::Kinematics const& kin, sf::SfSet const& sf, Real lambda_e, math::Vec3 eta, Real k_0_bar=INF, math::IntegParams params=DEFAULT_INTEG_PARAMS);
 /// \copydoc rad_f_integ()
 math::EstErr rad_f_integ(kin::Kinematics const& kin, ph::Phenom const& phenom, sf::SfSet const& sf, Real lambda_e, math::Vec3 eta, Real k_0_bar=INF, math::IntegParams params=DEFAULT_INTEG_PARAMS);
+/// Radiative cross-section \f$\sigma_{R}^{F}\f$ integrated below \p k_0_bar,
+/// using structure functions \p sf_0 already evaluated at \p kin for the
+/// infrared subtraction.
+math::EstErr rad_f_integ(kin::Kinematics const& kin, sf::SfSet const& sf, sf::SfLP const& sf_0, Real lambda_e, math::Vec3 eta, Real k_0_bar=INF, math::IntegParams params=DEFAULT_INTEG_PARAMS);
+/// \copydoc rad_f_integ(kin::Kinematics const&, sf::SfSet const&, sf::SfLP const&, Real, math::Vec3, Real, math::IntegParams)
+math::EstErr rad_f_integ(kin::Kinematics const& kin, ph::Phenom const& phenom, sf::SfSet const& sf, sf::SfLP const& sf_0, Real lambda_e, math::Vec3 eta, Real k_0_bar=INF, math::IntegParams params=DEFAULT_INTEG_PARAMS);
 /// Radiative cross-section \f$\sigma_{R}\f$, integrated over the radiated
 /// photon with energy above soft cutoff \p k_0_bar.
 math::EstErr rad_integ(kin::Kinematics const& kin, sf::SfSet const& sf, Real lambda_e, math::Vec3 eta, Real k_0_bar=INF, math::IntegParams params=DEFAULT_INTEG_PARAMS);
@@ -169,6 +287,179 @@ math::EstErr rad_integ(kin::Kinematics const& kin, sf::SfSet const& sf, Real lam
 math::EstErr rad_integ(kin::Kinematics const& kin, ph::Phenom const& phenom, sf::SfSet const& sf, Real lambda_e, math::Vec3 eta, Real k_0_bar=INF, math::IntegParams params=DEFAULT_INTEG_PARAMS);
 /// \}
 
+/**
+ * \defgroup BatchXsGroup Batched cross-section functions
+ * Versions of xs::born(), xs::nrad_ir(), and xs::rad() that work on many points
+ * of phase space at once. They take a kin::KinematicsBatch (or a
+ * kin::KinematicsRadBatch), and write the cross-section at each point into the
+ * buffer \p xs_out, which must have room for `kin.size()` values. The
+ * polarizations are the same for every point in the batch. The results agree
+ * with the general cross-section functions up to rounding.
+ *
+ * For the non-radiative cross-sections, only the structure functions and the
+ * QED correction factors are evaluated point by point. The hadronic and
+ * leptonic coefficients and their contraction are then computed straight from
+ * the arrays of the batch, in a single loop without branches or function
+ * calls, so that the compiler can vectorize it.
+ * \ingroup XsGroup
+ */
+/// \{
+
+/**
+ * Scratch space for the batched cross-section functions, holding the values
+ * computed point by point for each point of the batch. Passing the same
+ * BatchBuffer to many calls avoids allocating it each time. The contents are
+ * only meaningful during a call.
+ */
+struct BatchBuffer {
+	/// \name Structure functions
+	/// Only those needed for the polarization of the call are filled in.
+	/// \{
+	std::vector<Real> F_UUL;
+	std::vector<Real> F_UUT;
+	std::vector<Real> F_UU_cos_phih;
+	std::vector<Real> F_UU_cos_2phih;
+	std::vector<Real> F_UL_sin_phih;
+	std::vector<Real> F_UL_sin_2phih;
+	std::vector<Real> F_UTL_sin_phih_m_phis;
+	std::vector<Real> F_UTT_sin_phih_m_phis;
+	std::vector<Real> F_UT_sin_2phih_m_phis;
+	std::vector<Real> F_UT_sin_3phih_m_phis;
+	std::vector<Real> F_UT_sin_phis;
+	std::vector<Real> F_UT_sin_phih_p_phis;
+	std::vector<Real> F_LU_sin_phih;
+	std::vector<Real> F_LL;
+	std::vector<Real> F_LL_cos_phih;
+	std::vector<Real> F_LT_cos_phih_m_phis;
+	std::vector<Real> F_LT_cos_2phih_m_phis;
+	std::vector<Real> F_LT_cos_phis;
+	/// \}
+	/// Coefficients of the %Born lepton coefficients, see xs::Born and
+	/// xs::Nrad.
+	std::vector<Real> coeff_born;
+	/// Coefficients of the AMM lepton coefficients, see xs::Nrad.
+	std::vector<Real> coeff_amm;
+};
+
+/// Batched version of xs::born(), using \p buf as scratch space.
+void born_batch(kin::KinematicsBatch const& kin, sf::SfSet const& sf, Real lambda_e, math::Vec3 eta, BatchBuffer& buf, Real* xs_out);
+/// Batched version of xs::nrad_ir(), using \p buf as scratch space.
+void nrad_ir_batch(kin::KinematicsBatch const& kin, sf::SfSet const& sf, Real lambda_e, math::Vec3 eta, BatchBuffer& buf, Real* xs_out, Real k_0_bar=INF);
+/// Batched version of xs::rad(). The radiative lepton coefficients have no
+/// batched form, and the structure functions are needed at the shifted
+/// kinematics, so each point is evaluated in turn, reading its kinematics out
+/// of the batch instead of recomputing them.
+void rad_batch(kin::KinematicsRadBatch const& kin, sf::SfSet const& sf, Real lambda_e, math::Vec3 eta, Real* xs_out);
+/// Context version of xs::born_batch(). The target polarization of \p ctx
+/// must be zero, since in the hadron frame it would differ from point to point.
+void born_batch(kin::KinematicsBatch const& kin, Context const& ctx, BatchBuffer& buf, Real* xs_out);
+/// Context version of xs::nrad_ir_batch(). The target polarization of \p ctx
+/// must be zero, as for xs::born_batch().
+void nrad_ir_batch(kin::KinematicsBatch const& kin, Context const& ctx, BatchBuffer& buf, Real* xs_out, Real k_0_bar=INF);
+/// \}
+
+/**
+ * \defgroup EvaluatorGroup Cross-section evaluators
+ * When many cross-sections of the same kind are computed with the same beam
+ * and target polarizations, an xs::Evaluator can be used instead of the
+ * general cross-section functions. It chooses which polarized parts of the
+ * cross-section are needed once, when it is constructed, instead of on every
+ * call.
+ * \ingroup XsGroup
+ */
+/// \{
+
+/// Kinds of cross-sections that can be computed by an xs::Evaluator.
+enum class Kind {
+	BORN,    ///< %Born cross-section, see xs::born()
+	AMM,     ///< Anomalous magnetic moment cross-section, see xs::amm()
+	NRAD_IR, ///< Non-radiative cross-section, see xs::nrad_ir()
+	RAD,     ///< Radiative cross-section, see xs::rad()
+	RAD_F,   ///< Infrared-divergent-free radiative cross-section, see xs::rad_f()
+};
+
+/**
+ * Computes a single kind of cross-section with fixed beam and target
+ * polarizations. The results are the same as from the corresponding general
+ * cross-section function, with the target polarization \p eta in the hadron
+ * frame given by frame::hadron_from_target().
+ *
+ * The radiative kinds (xs::Kind::RAD and xs::Kind::RAD_F) are evaluated with
+ * kin::KinematicsRad, and the others with kin::Kinematics. Evaluating with the
+ * wrong kinematics throws `std::invalid_argument`.
+ */
+class Evaluator final {
+	using Kernel = Real (*)(kin::Kinematics const&, ph::Phenom const&, sf::SfSet const&, Real, math::Vec3, Real);
+	using KernelLP = Real (*)(kin::Kinematics const&, ph::Phenom const&, sf::SfLP const&, Real, math::Vec3, Real);
+	using KernelRad = Real (*)(kin::KinematicsRad const&, ph::Phenom const&, sf::SfSet const&, Real, math::Vec3, Real);
+
+	Kind _kind;
+	Real _lambda_e;
+	math::Vec3 _target_pol;
+	Real _k_0_bar;
+	Kernel _kernel;
+	KernelLP _kernel_lp;
+	KernelRad _kernel_rad;
+
+public:
+	/// Prepare to compute cross-sections of kind \p kind, with beam
+	/// polarization \p lambda_e and target polarization \p target_pol (in the
+	/// target frame). The soft photon cutoff \p k_0_bar is only used for
+	/// xs::Kind::NRAD_IR.
+	Evaluator(Kind kind, Real lambda_e, math::Vec3 target_pol, Real k_0_bar=INF);
+	/// Prepare to compute cross-sections of kind \p kind, with the
+	/// polarizations from \p ctx.
+	Evaluator(Kind kind, Context const& ctx, Real k_0_bar=INF) :
+		Evaluator(kind, ctx.lambda_e(), ctx.target_pol(), k_0_bar) { }
+
+	Kind kind() const {
+		return _kind;
+	}
+	Real lambda_e() const {
+		return _lambda_e;
+	}
+	math::Vec3 target_pol() const {
+		return _target_pol;
+	}
+
+	/// Cross-section at \p kin.
+	Real eval(kin::Kinematics const& kin, sf::SfSet const& sf) const {
+		return _kernel(kin, ph::Phenom(kin), sf, _lambda_e, _target_pol, _k_0_bar);
+	}
+	/// \copydoc eval(kin::Kinematics const&, sf::SfSet const&) const
+	Real eval(kin::Kinematics const& kin, ph::Phenom const& phenom, sf::SfSet const& sf) const {
+		return _kernel(kin, phenom, sf, _lambda_e, _target_pol, _k_0_bar);
+	}
+	/// Cross-section at \p kin, using structure functions \p sf already
+	/// evaluated at \p kin. Only xs::Kind::BORN, xs::Kind::AMM, and
+	/// xs::Kind::NRAD_IR can be evaluated this way.
+	Real eval(kin::Kinematics const& kin, sf::SfLP const& sf) const {
+		return _kernel_lp(kin, ph::Phenom(kin), sf, _lambda_e, _target_pol, _k_0_bar);
+	}
+	/// \copydoc eval(kin::Kinematics const&, sf::SfLP const&) const
+	Real eval(kin::Kinematics const& kin, ph::Phenom const& phenom, sf::SfLP const& sf) const {
+		return _kernel_lp(kin, phenom, sf, _lambda_e, _target_pol, _k_0_bar);
+	}
+	/// Cross-section at \p kin, with the phenomenological inputs and structure
+	/// functions from \p ctx. The polarizations of the evaluator are used, not
+	/// those of \p ctx.
+	Real eval(kin::Kinematics const& kin, Context const& ctx) const {
+		return _kernel(kin, ctx.phenom(kin), ctx.sf(), _lambda_e, _target_pol, _k_0_bar);
+	}
+	/// Radiative cross-section at \p kin.
+	Real eval(kin::KinematicsRad const& kin, sf::SfSet const& sf) const;
+	/// \copydoc eval(kin::KinematicsRad const&, sf::SfSet const&) const
+	Real eval(kin::KinematicsRad const& kin, ph::Phenom const& phenom, sf::SfSet const& sf) const {
+		return _kernel_rad(kin, phenom, sf, _lambda_e, _target_pol, _k_0_bar);
+	}
+	/// Radiative cross-section at \p kin, with the phenomenological inputs and
+	/// structure functions from \p ctx.
+	Real eval(kin::KinematicsRad const& kin, Context const& ctx) const {
+		return _kernel_rad(kin, ctx.phenom(kin), ctx.sf(), _lambda_e, _target_pol, _k_0_bar);
+	}
+};
+/// \}
+
 /// \name Born correction factors
 /// These correction factors to the %Born cross-section give the contribution
 /// from vacuum polarization and from soft radiated photon.
@@ -180,6 +180,13 @@ bool take(
 bool take(
 	part::Particles const& ps, Real S, const Real point[6],
 	kin::Kinematics* kin_out, Real* jac_out);
+/// Draw from non-radiative SIDIS phase space within the bounds of Cut%s. Cuts
+/// that depend on the full kinematics are not checked, so the result should be
+/// checked afterwards with valid().
+bool take(
+	Cut const& cut,
+	part::Particles const& ps, Real S, const Real point[6],
+	kin::PhaseSpace* ph_space_out, Real* jac_out);
 /// Draw from non-radiative SIDIS phase space subject to Cut%s.
 bool take(
 	Cut const& cut,
@@ -207,6 +214,12 @@ bool take(
 bool take(
 	kin::Kinematics const& kin, const Real point[3],
 	kin::KinematicsRad* kin_out, Real* jac_out);
+/// Draw from the radiative SIDIS phase space within the bounds of Cut%s. Cuts
+/// that depend on the full kinematics are not checked, so the result should be
+/// checked afterwards with valid().
+bool take(
+	CutRad const& cut, kin::Kinematics const& kin, const Real point[3],
+	kin::PhaseSpaceRad* ph_space_out, Real* jac_out);
 /// Draw from the radiative SIDIS phase space subject to Cut%s.
 bool take(
 	CutRad const& cut, kin::Kinematics const& kin, const Real point[3],
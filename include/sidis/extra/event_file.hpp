@@ -0,0 +1,276 @@
+#ifndef SIDIS_EVENT_FILE_HPP
+#define SIDIS_EVENT_FILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+// Event files are memory-mapped where POSIX is available. Elsewhere, they are
+// read into memory in full.
+#if defined(__unix__) || defined(__APPLE__)
+#define SIDIS_EVENT_FILE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define SIDIS_EVENT_FILE_MMAP 0
+#include <fstream>
+#include <vector>
+#endif
+
+namespace sidis {
+namespace event_file {
+
+// Layout of the flat binary event files written by `sidisgen` when
+// `file.format` is `binary`. All values are little-endian. The file consists
+// of:
+// * The `Header`.
+// * `num_records` records of `record_size` bytes each, starting at
+//   `records_offset`. Each begins with a `Record`, optionally followed by the
+//   particle momenta and the structure functions, depending on the flags.
+// * The parameters used to generate the events, as the text of a parameter
+//   file, starting at `params_offset`.
+
+char const MAGIC[8] = { 'S', 'I', 'D', 'I', 'S', 'E', 'V', 'T' };
+std::uint32_t const VERSION = 1;
+
+// Flags describing which optional parts are included in each record.
+std::uint32_t const FLAG_MOMENTA = 1 << 0;
+std::uint32_t const FLAG_PHOTON = 1 << 1;
+std::uint32_t const FLAG_SF_SET = 1 << 2;
+
+// Order of the 4-momenta in a record, each stored as `{ x, y, z, t }`.
+std::size_t const MOMENTUM_P = 0;
+std::size_t const MOMENTUM_K1 = 1;
+std::size_t const MOMENTUM_Q = 2;
+std::size_t const MOMENTUM_K2 = 3;
+std::size_t const MOMENTUM_PH = 4;
+std::size_t const MOMENTUM_K = 5;
+// Number of structure functions stored (matching `sf::SfLP`).
+std::size_t const NUM_SF = 18;
+
+// Statistics of the generated events, matching the `stats` directory of ROOT
+// event files.
+struct Stats {
+	double prime;
+	double weight_mom[4];
+	double weight_max;
+	double num_events;
+	double num_events_acc;
+	double norm;
+};
+
+struct Header {
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t flags;
+	std::uint64_t records_offset;
+	std::uint64_t record_size;
+	std::uint64_t num_records;
+	std::uint64_t params_offset;
+	std::uint64_t params_size;
+	// Statistics for the total, then for each event type (non-radiative,
+	// radiative).
+	Stats stats[3];
+};
+
+// Base part of each record.
+struct Record {
+	// Event type (1 for non-radiative, 2 for radiative).
+	std::int32_t type;
+	std::uint32_t reserved;
+	double weight;
+	double x, y, z, ph_t_sq, phi_h, phi;
+	double tau, phi_k, R;
+};
+
+static_assert(sizeof(Stats) == 9 * 8, "Unexpected padding in `Stats`.");
+static_assert(sizeof(Header) == 56 + 3 * sizeof(Stats), "Unexpected padding in `Header`.");
+static_assert(sizeof(Record) == 11 * 8, "Unexpected padding in `Record`.");
+
+inline bool host_is_little_endian() {
+	std::uint16_t test = 1;
+	unsigned char byte;
+	std::memcpy(&byte, &test, 1);
+	return byte == 1;
+}
+
+// Number of 4-momenta stored in each record with the given flags.
+inline std::size_t num_momenta(std::uint32_t flags) {
+	if (!(flags & FLAG_MOMENTA)) {
+		return 0;
+	}
+	return (flags & FLAG_PHOTON) ? 6 : 5;
+}
+
+// Size in bytes of each record with the given flags.
+inline std::size_t record_size(std::uint32_t flags) {
+	return sizeof(Record)
+		+ 4 * sizeof(double) * num_momenta(flags)
+		+ ((flags & FLAG_SF_SET) ? NUM_SF * sizeof(double) : 0);
+}
+
+// Read-only view of an event file, mapped into memory. Records are accessed in
+// place without copying. Without POSIX, the file is copied into memory first.
+class Reader final {
+#if SIDIS_EVENT_FILE_MMAP
+	int _fd;
+	void* _data;
+#else
+	// Stored as `double` so that the records are aligned.
+	std::vector<double> _data;
+#endif
+	std::size_t _size;
+	Header const* _header;
+
+#if SIDIS_EVENT_FILE_MMAP
+	unsigned char const* bytes() const {
+		return static_cast<unsigned char const*>(_data);
+	}
+	void close() {
+		if (_data != MAP_FAILED) {
+			::munmap(_data, _size);
+		}
+		if (_fd >= 0) {
+			::close(_fd);
+		}
+	}
+	void open(std::string const& file_name) {
+		_fd = ::open(file_name.c_str(), O_RDONLY);
+		if (_fd < 0) {
+			throw std::runtime_error(
+				"Could not open event file '" + file_name + "'.");
+		}
+		struct stat file_stat;
+		if (::fstat(_fd, &file_stat) != 0
+				|| static_cast<std::size_t>(file_stat.st_size) < sizeof(Header)) {
+			close();
+			throw std::runtime_error(
+				"Event file '" + file_name + "' is too small.");
+		}
+		_size = static_cast<std::size_t>(file_stat.st_size);
+		_data = ::mmap(nullptr, _size, PROT_READ, MAP_SHARED, _fd, 0);
+		if (_data == MAP_FAILED) {
+			close();
+			throw std::runtime_error(
+				"Could not map event file '" + file_name + "'.");
+		}
+	}
+#else
+	unsigned char const* bytes() const {
+		return reinterpret_cast<unsigned char const*>(_data.data());
+	}
+	void close() {
+		_data.clear();
+	}
+	void open(std::string const& file_name) {
+		std::ifstream file(file_name, std::ios_base::in | std::ios_base::binary);
+		if (!file) {
+			throw std::runtime_error(
+				"Could not open event file '" + file_name + "'.");
+		}
+		file.seekg(0, std::ios_base::end);
+		std::streamoff file_size = file.tellg();
+		if (!file || file_size < static_cast<std::streamoff>(sizeof(Header))) {
+			throw std::runtime_error(
+				"Event file '" + file_name + "' is too small.");
+		}
+		_size = static_cast<std::size_t>(file_size);
+		_data.resize((_size + sizeof(double) - 1) / sizeof(double));
+		file.seekg(0);
+		if (!file.read(reinterpret_cast<char*>(_data.data()), _size)) {
+			throw std::runtime_error(
+				"Could not read event file '" + file_name + "'.");
+		}
+	}
+#endif
+
+	// Checks that every part of the file described by the header lies within
+	// the file, without overflowing.
+	bool valid_header() const {
+		Header const& header = *_header;
+		return std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0
+			&& header.version == VERSION
+			&& header.record_size == record_size(header.flags)
+			&& header.records_offset >= sizeof(Header)
+			&& header.records_offset % alignof(double) == 0
+			&& header.records_offset <= _size
+			&& header.num_records <= (_size - header.records_offset) / header.record_size
+			&& header.params_offset <= _size
+			&& header.params_size <= _size - header.params_offset;
+	}
+
+public:
+	explicit Reader(std::string const& file_name) :
+#if SIDIS_EVENT_FILE_MMAP
+			_fd(-1),
+			_data(MAP_FAILED),
+#endif
+			_size(0),
+			_header(nullptr) {
+		if (!host_is_little_endian()) {
+			throw std::runtime_error(
+				"Event files can only be mapped on little-endian hosts.");
+		}
+		open(file_name);
+		_header = reinterpret_cast<Header const*>(bytes());
+		if (!valid_header()) {
+			close();
+			throw std::runtime_error(
+				"Invalid header in event file '" + file_name + "'.");
+		}
+	}
+	Reader(Reader const&) = delete;
+	Reader& operator=(Reader const&) = delete;
+	~Reader() {
+		close();
+	}
+
+	Header const& header() const {
+		return *_header;
+	}
+	std::uint32_t flags() const {
+		return _header->flags;
+	}
+	std::uint64_t size() const {
+		return _header->num_records;
+	}
+	// Parameters used to generate the events, as the text of a parameter file.
+	std::string params() const {
+		char const* begin = reinterpret_cast<char const*>(
+			bytes() + _header->params_offset);
+		return std::string(begin, begin + _header->params_size);
+	}
+
+	Record const& record(std::uint64_t idx) const {
+		return *reinterpret_cast<Record const*>(
+			bytes() + _header->records_offset + idx * _header->record_size);
+	}
+	// Momenta of a record, as `num_momenta(flags())` consecutive 4-vectors
+	// `{ x, y, z, t }` in the order given by the `MOMENTUM_*` constants. Null
+	// if momenta weren't written.
+	double const* momenta(std::uint64_t idx) const {
+		if (!(_header->flags & FLAG_MOMENTA)) {
+			return nullptr;
+		}
+		return reinterpret_cast<double const*>(&record(idx) + 1);
+	}
+	// Structure functions of a record, in the order of `sf::SfLP`. Null if
+	// structure functions weren't written.
+	double const* sf(std::uint64_t idx) const {
+		if (!(_header->flags & FLAG_SF_SET)) {
+			return nullptr;
+		}
+		return reinterpret_cast<double const*>(&record(idx) + 1)
+			+ 4 * num_momenta(_header->flags);
+	}
+};
+
+}
+}
+
+#endif
+
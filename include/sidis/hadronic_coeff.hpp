@@ -26,6 +26,8 @@ namespace had {
  * process.
  *
  * Structure functions from sf::SfSet are used to calculate these coefficients.
+ * Alternatively, an sf::SfLP evaluated at the same kinematics can be provided,
+ * to reuse structure functions that have already been computed.
  */
 /// \{
 struct HadBaseUU {
@@ -89,18 +91,21 @@ struct HadUU {
 	HadBaseUU uu;
 	HadUU() = default;
 	HadUU(kin::Kinematics const& kin, sf::SfSet const& sf);
+	HadUU(kin::Kinematics const& kin, sf::SfLP const& sf);
 };
 struct HadUL {
 	HadBaseUU uu;
 	HadBaseUL ul;
 	HadUL() = default;
 	HadUL(kin::Kinematics const& kin, sf::SfSet const& sf);
+	HadUL(kin::Kinematics const& kin, sf::SfLP const& sf);
 };
 struct HadUT {
 	HadBaseUU uu;
 	HadBaseUT ut;
 	HadUT() = default;
 	HadUT(kin::Kinematics const& kin, sf::SfSet const& sf);
+	HadUT(kin::Kinematics const& kin, sf::SfLP const& sf);
 };
 struct HadUP {
 	HadBaseUU uu;
@@ -108,12 +113,14 @@ struct HadUP {
 	HadBaseUT ut;
 	HadUP() = default;
 	HadUP(kin::Kinematics const& kin, sf::SfSet const& sf);
+	HadUP(kin::Kinematics const& kin, sf::SfLP const& sf);
 };
 struct HadLU {
 	HadBaseUU uu;
 	HadBaseLU lu;
 	HadLU() = default;
 	HadLU(kin::Kinematics const& kin, sf::SfSet const& sf);
+	HadLU(kin::Kinematics const& kin, sf::SfLP const& sf);
 };
 struct HadLL {
 	HadBaseUU uu;
@@ -122,6 +129,7 @@ struct HadLL {
 	HadBaseLL ll;
 	HadLL() = default;
 	HadLL(kin::Kinematics const& kin, sf::SfSet const& sf);
+	HadLL(kin::Kinematics const& kin, sf::SfLP const& sf);
 };
 struct HadLT {
 	HadBaseUU uu;
@@ -130,6 +138,7 @@ struct HadLT {
 	HadBaseLT lt;
 	HadLT() = default;
 	HadLT(kin::Kinematics const& kin, sf::SfSet const& sf);
+	HadLT(kin::Kinematics const& kin, sf::SfLP const& sf);
 };
 struct HadLP {
 	HadBaseUU uu;
@@ -140,6 +149,7 @@ struct HadLP {
 	HadBaseLT lt;
 	HadLP() = default;
 	HadLP(kin::Kinematics const& kin, sf::SfSet const& sf);
+	HadLP(kin::Kinematics const& kin, sf::SfLP const& sf);
 };
 /// \}
 
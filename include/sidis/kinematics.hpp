@@ -1,6 +1,9 @@
 #ifndef SIDIS_KINEMATICS_HPP
 #define SIDIS_KINEMATICS_HPP
 
+#include <cstddef>
+#include <vector>
+
 #include "sidis/numeric.hpp"
 #include "sidis/particle.hpp"
 #include "sidis/vector.hpp"
@@ -569,6 +572,216 @@ struct KinematicsRad {
 	KinematicsRad(Kinematics const& kin, Real tau, Real phi_k, Real R);
 };
 
+/**
+ * Describes the kinematics of many points in phase space at once, all sharing
+ * the same particles and beam energy. Holds the same kinematic quantities as
+ * Kinematics, but stored as a structure of arrays with one entry for each
+ * point. The quantities for the whole batch are computed together in a single
+ * pass, which lets the compiler vectorize the calculation. The batch can be
+ * passed to the batched cross-section functions like xs::born_batch().
+ * \sa Kinematics
+ */
+struct KinematicsBatch {
+	/// \name %Initial state description
+	/// \{
+	/// \copydoc Kinematics::target
+	part::Nucleus target;
+	/// \copydoc Kinematics::beam
+	part::Lepton beam;
+	/// \copydoc Kinematics::hadron
+	part::Hadron hadron;
+
+	/// \copydoc Kinematics::S
+	Real S;
+	/// \copydoc Kinematics::M
+	Real M;
+	/// \copydoc Kinematics::m
+	Real m;
+	/// \copydoc Kinematics::mh
+	Real mh;
+	/// \copydoc Kinematics::Mth
+	Real Mth;
+	/// \copydoc Kinematics::lambda_S
+	Real lambda_S;
+	/// \copydoc Kinematics::lambda_S_sqrt
+	Real lambda_S_sqrt;
+	/// \}
+
+	/// \name Kinematic variables
+	/// See Kinematics for descriptions. Each has one entry for each point in
+	/// the batch.
+	/// \{
+	std::vector<Real> x;
+	std::vector<Real> y;
+	std::vector<Real> z;
+	std::vector<Real> ph_t_sq;
+	std::vector<Real> phi_h;
+	std::vector<Real> phi;
+	std::vector<Real> Q_sq;
+	std::vector<Real> Q;
+	std::vector<Real> t;
+	std::vector<Real> W_sq;
+	std::vector<Real> X;
+	std::vector<Real> S_x;
+	std::vector<Real> S_p;
+	std::vector<Real> V_1;
+	std::vector<Real> V_2;
+	std::vector<Real> V_m;
+	std::vector<Real> V_p;
+	std::vector<Real> lambda_X;
+	std::vector<Real> lambda_Y;
+	std::vector<Real> lambda_1;
+	std::vector<Real> lambda_2;
+	std::vector<Real> lambda_3;
+	std::vector<Real> lambda_X_sqrt;
+	std::vector<Real> lambda_Y_sqrt;
+	std::vector<Real> lambda_1_sqrt;
+	std::vector<Real> lambda_2_sqrt;
+	std::vector<Real> lambda_3_sqrt;
+	std::vector<Real> mx_sq;
+	std::vector<Real> mx;
+	std::vector<Real> vol_phi_h;
+	std::vector<Real> C_1;
+	std::vector<Real> ph_0;
+	std::vector<Real> ph_t;
+	std::vector<Real> ph_l;
+	std::vector<Real> cos_phi_h;
+	std::vector<Real> sin_phi_h;
+	std::vector<Real> q_0;
+	std::vector<Real> q_t;
+	std::vector<Real> q_l;
+	std::vector<Real> phi_q;
+	std::vector<Real> cos_phi_q;
+	std::vector<Real> sin_phi_q;
+	std::vector<Real> k2_0;
+	std::vector<Real> k2_t;
+	std::vector<Real> k2_l;
+	std::vector<Real> k1_t;
+	std::vector<Real> cos_phi;
+	std::vector<Real> sin_phi;
+	/// \}
+
+	/// Initialize an empty KinematicsBatch in an invalid state.
+	KinematicsBatch() = default;
+	/// Fill in a KinematicsBatch corresponding to particles \p ps, with beam
+	/// energy given by \p S, at each of the PhaseSpace points \p ph_spaces.
+	KinematicsBatch(
+		part::Particles const& ps,
+		Real S,
+		std::vector<PhaseSpace> const& ph_spaces);
+
+	/// Number of points in the batch.
+	std::size_t size() const {
+		return x.size();
+	}
+	/// Gives the Kinematics of the point at index \p idx. Nothing is
+	/// recomputed, the quantities are copied out of the batch.
+	Kinematics at(std::size_t idx) const;
+};
+
+/**
+ * Describes the kinematics of many points in radiative phase space at once.
+ * Similar to KinematicsBatch, but holds the same kinematic quantities as
+ * KinematicsRad.
+ * \sa KinematicsRad
+ */
+struct KinematicsRadBatch {
+	/// \name Kinematic variables
+	/// See KinematicsRad for descriptions. Each has one entry for each point
+	/// in the batch.
+	/// \{
+	std::vector<Real> tau;
+	std::vector<Real> phi_k;
+	std::vector<Real> R;
+	std::vector<Real> tau_min;
+	std::vector<Real> tau_max;
+	std::vector<Real> mu;
+	std::vector<Real> z_1;
+	std::vector<Real> z_2;
+	std::vector<Real> lambda_V;
+	std::vector<Real> lambda_RV;
+	std::vector<Real> lambda_RY;
+	std::vector<Real> lambda_H;
+	std::vector<Real> lambda_z;
+	std::vector<Real> lambda_z_sqrt;
+	std::vector<Real> k_0_bar;
+	std::vector<Real> vol_phi_k_R;
+	std::vector<Real> vol_phi_hk;
+	std::vector<Real> F_22;
+	std::vector<Real> F_21;
+	std::vector<Real> F_2p;
+	std::vector<Real> F_2m;
+	std::vector<Real> F_d;
+	std::vector<Real> F_1p;
+	std::vector<Real> F_IR;
+	std::vector<Real> k_0;
+	std::vector<Real> k_t;
+	std::vector<Real> k_l;
+	std::vector<Real> cos_phi_k;
+	std::vector<Real> sin_phi_k;
+	std::vector<Real> shift_x;
+	std::vector<Real> shift_y;
+	std::vector<Real> shift_z;
+	std::vector<Real> shift_ph_t_sq;
+	std::vector<Real> shift_phi_h;
+	std::vector<Real> shift_phi_q;
+	std::vector<Real> shift_cos_phi_h;
+	std::vector<Real> shift_sin_phi_h;
+	std::vector<Real> shift_cos_phi_q;
+	std::vector<Real> shift_sin_phi_q;
+	std::vector<Real> shift_Q_sq;
+	std::vector<Real> shift_Q;
+	std::vector<Real> shift_t;
+	std::vector<Real> shift_W_sq;
+	std::vector<Real> shift_S_x;
+	std::vector<Real> shift_V_m;
+	std::vector<Real> shift_lambda_Y;
+	std::vector<Real> shift_lambda_1;
+	std::vector<Real> shift_lambda_2;
+	std::vector<Real> shift_lambda_3;
+	std::vector<Real> shift_lambda_Y_sqrt;
+	std::vector<Real> shift_lambda_1_sqrt;
+	std::vector<Real> shift_lambda_2_sqrt;
+	std::vector<Real> shift_lambda_3_sqrt;
+	std::vector<Real> shift_mx_sq;
+	std::vector<Real> shift_mx;
+	std::vector<Real> shift_vol_phi_h;
+	std::vector<Real> shift_C_1;
+	std::vector<Real> shift_ph_t;
+	std::vector<Real> shift_ph_l;
+	std::vector<Real> shift_q_0;
+	std::vector<Real> shift_q_t;
+	std::vector<Real> shift_q_l;
+	std::vector<Real> shift_k1_t;
+	/// \}
+
+	/// Initialize an empty KinematicsRadBatch in an invalid state.
+	KinematicsRadBatch() = default;
+	/// Fill in a KinematicsRadBatch corresponding to particles \p ps, with
+	/// beam energy given by \p S, at each of the PhaseSpaceRad points
+	/// \p ph_spaces.
+	KinematicsRadBatch(
+		part::Particles const& ps,
+		Real S,
+		std::vector<PhaseSpaceRad> const& ph_spaces);
+
+	/// Number of points in the batch.
+	std::size_t size() const {
+		return tau.size();
+	}
+	/// Discard the radiative kinematic variables to get a KinematicsBatch
+	/// describing the points in the non-radiative PhaseSpace.
+	KinematicsBatch const& project() const {
+		return _kin;
+	}
+	/// Gives the KinematicsRad of the point at index \p idx. Nothing is
+	/// recomputed, the quantities are copied out of the batch.
+	KinematicsRad at(std::size_t idx) const;
+
+private:
+	KinematicsBatch _kin;
+};
+
 /**
  * %Initial state of the system before the SIDIS process. Contains the target
  * and beam particle types as well as the initial 4-momenta of both.
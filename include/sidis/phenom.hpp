@@ -1,6 +1,9 @@
 #ifndef SIDIS_PHENOM_HPP
 #define SIDIS_PHENOM_HPP
 
+#include <array>
+#include <cstddef>
+
 #include "sidis/numeric.hpp"
 
 namespace sidis {
@@ -25,6 +28,8 @@ Real alpha_qed(Real Q_sq=0.);
 /// Factor \f$\frac{\alpha}{\pi}\delta_{\text{vac}}^{\text{had}}\sigma_{B}\f$
 /// gives the vacuum polarization cross-section due to hadron loops.
 Real delta_vac_had(kin::Kinematics const& kin);
+/// \copydoc delta_vac_had(kin::Kinematics const&)
+Real delta_vac_had(Real Q_sq);
 
 /**
  * Bundle of phenomenological inputs for the cross section, at a specific
@@ -48,6 +53,39 @@ struct Phenom {
 	/// Provide custom values for the phenomenological inputs.
 	Phenom(Real alpha_qed, Real delta_vac_had);
 };
+
+/**
+ * Table of the default phenomenological inputs over a range of \f$Q^2\f$,
+ * for when many ph::Phenom are needed. The inputs are linearly interpolated in
+ * \f$\log Q^2\f$, with a relative accuracy better than \f$10^{-5}\f$ for
+ * ranges of up to 20 e-foldings. Outside of the range of the table, and where
+ * the hadron vacuum polarization parameterization changes, they are computed
+ * directly instead.
+ *
+ * The table is stored inline, so that it can be freely copied along with the
+ * objects that hold it.
+ */
+class PhenomTable final {
+public:
+	/// Number of cells in the table.
+	static std::size_t const CELLS = 4096;
+
+private:
+	Real _ln_Q_sq_min;
+	Real _ln_Q_sq_step;
+	std::array<Real, CELLS + 1> _alpha_qed;
+	std::array<Real, CELLS + 1> _delta_vac_had;
+	// Cells in which `delta_vac_had` is discontinuous. Unused entries are set
+	// to `CELLS`.
+	std::array<std::size_t, 2> _break_cells;
+
+public:
+	/// Tabulate the inputs between \p Q_sq_min and \p Q_sq_max.
+	PhenomTable(Real Q_sq_min, Real Q_sq_max);
+
+	/// Phenomenological inputs at \f$Q^2\f$ of \p Q_sq.
+	Phenom operator()(Real Q_sq) const;
+};
 /// \}
 
 }
@@ -1,18 +1,27 @@
 #include "sidis/cross_section.hpp"
 
+#include <algorithm>
+#include <array>
 #include <cmath>
+#include <cstddef>
 #include <limits>
+#include <stdexcept>
 #include <string>
+#include <vector>
 
 #include "sidis/bound.hpp"
 #include "sidis/constant.hpp"
 #include "sidis/cut.hpp"
 #include "sidis/frame.hpp"
 #include "sidis/Exc_structure_function.hpp"
+#include "sidis/hadronic_coeff.hpp"
 #include "sidis/kinematics.hpp"
 #include "sidis/leptonic_coeff.hpp"
 #include "sidis/phenom.hpp"
 #include "sidis/structure_function.hpp"
+#include "sidis/transform.hpp"
+#include "sidis/extra/integrate.hpp"
+#include "sidis/extra/math.hpp"
 
 using namespace sidis;
 using namespace sidis::cut;
@@ -24,15 +33,28 @@ using namespace sidis::ph;
 using namespace sidis::sf;
 using namespace sidis::xs;
 
+// Mask describing the polarization state, used to choose which base cross-
+// sections are needed.
+#define SIDIS_MACRO_XS_POL_MASK(lambda_e, eta) ( \
+	(((lambda_e) != 0.) << 3) \
+	| (((eta).x != 0.) << 2) \
+	| (((eta).y != 0.) << 1) \
+	| (((eta).z != 0.) << 0))
+#define SIDIS_MACRO_XS_POL_MASK_P(lambda_e, eta) ( \
+	(((lambda_e) != 0.) << 1) \
+	| (((eta).x != 0. || (eta).y != 0. || (eta).z != 0.) << 0))
+
 // Macro that computes the cross-section from the base cross-sections in an
 // optimized way. For example, if the polarization is zero, then the
 // cross-section can be computed just using the UU base cross-section.
-#define SIDIS_MACRO_XS_FROM_BASE(name, Lep, Had, kin, sf, b, lambda_e, eta) ([&]() { \
-	/* Create a mask describing the polarization state. */ \
-	unsigned pol_mask = (((lambda_e) != 0.) << 3) \
-		| (((eta).x != 0.) << 2) \
-		| (((eta).y != 0.) << 1) \
-		| (((eta).z != 0.) << 0); \
+#define SIDIS_MACRO_XS_FROM_BASE(name, Lep, Had, kin, sf, b, lambda_e, eta) \
+	SIDIS_MACRO_XS_FROM_BASE_MASK(name, Lep, Had, kin, sf, b, lambda_e, eta, \
+		SIDIS_MACRO_XS_POL_MASK(lambda_e, eta))
+
+// Same as `SIDIS_MACRO_XS_FROM_BASE`, but with the polarization mask given
+// explicitly. When the mask is a constant, only the matching case is compiled.
+#define SIDIS_MACRO_XS_FROM_BASE_MASK(name, Lep, Had, kin, sf, b, lambda_e, eta, mask) ([&]() { \
+	unsigned const pol_mask = (mask); \
 	Real uu = 0.; \
 	Vec3 up = VEC3_ZERO; \
 	Real lu = 0.; \
@@ -201,10 +223,14 @@ using namespace sidis::xs;
 // Similar to `SIDIS_MACRO_XS_FROM_BASE`, except this one works with base cross-
 // sections where the XL, XT1, and XT2 cases are all grouped together into an
 // XP case.
-#define SIDIS_MACRO_XS_FROM_BASE_P(name, Lep, Had, kin, sf, b, lambda_e, eta) ([&]() { \
-	/* Create a mask describing the polarization state. */ \
-	unsigned pol_mask = (((lambda_e) != 0.) << 1) \
-		| (((eta).x != 0. || (eta).y != 0. || (eta).z != 0.) << 0); \
+#define SIDIS_MACRO_XS_FROM_BASE_P(name, Lep, Had, kin, sf, b, lambda_e, eta) \
+	SIDIS_MACRO_XS_FROM_BASE_P_MASK(name, Lep, Had, kin, sf, b, lambda_e, eta, \
+		SIDIS_MACRO_XS_POL_MASK_P(lambda_e, eta))
+
+// Same as `SIDIS_MACRO_XS_FROM_BASE_P`, but with the polarization mask given
+// explicitly.
+#define SIDIS_MACRO_XS_FROM_BASE_P_MASK(name, Lep, Had, kin, sf, b, lambda_e, eta, mask) ([&]() { \
+	unsigned const pol_mask = (mask); \
 	Real uu = 0.; \
 	Vec3 up = VEC3_ZERO; \
 	Real lu = 0.; \
@@ -251,9 +277,7 @@ using namespace sidis::xs;
 // structure functions to be provided, for endpoint-subtraction-related
 // calculations.
 #define SIDIS_MACRO_XS_FROM_BASE_P_0(name, Lep, Had, kin, sf, had_0, b, lambda_e, eta) ([&]() { \
-	/* Create a mask describing the polarization state. */ \
-	unsigned pol_mask = (((lambda_e) != 0.) << 1) \
-		| (((eta).x != 0. || (eta).y != 0. || (eta).z != 0.) << 0); \
+	unsigned pol_mask = SIDIS_MACRO_XS_POL_MASK_P(lambda_e, eta); \
 	Real uu = 0.; \
 	Vec3 up = VEC3_ZERO; \
 	Real lu = 0.; \
@@ -307,7 +331,73 @@ using namespace sidis::xs;
 
 namespace {
 
-Real delta_vert_rad_0(Kinematics const& kin) {
+// Kernels used by `xs::Evaluator`, one for each kind of cross-section and each
+// polarization mask. Since the mask is a template parameter, only the needed
+// base cross-sections are compiled into each kernel. The target polarization is
+// given in the target frame, and is only rotated into the hadron frame when it
+// is non-zero.
+template<unsigned PolMask, typename SF>
+Real born_kernel(Kinematics const& kin, Phenom const& phenom, SF const& sf, Real lambda_e, Vec3 target_pol, Real) {
+	Vec3 eta = (PolMask & 0x7) ? frame::hadron_from_target(kin) * target_pol : VEC3_ZERO;
+	Born b(kin, phenom);
+	return SIDIS_MACRO_XS_FROM_BASE_MASK(born, LepBorn, Had, kin, sf, b, lambda_e, eta, PolMask);
+}
+
+template<unsigned PolMask, typename SF>
+Real amm_kernel(Kinematics const& kin, Phenom const& phenom, SF const& sf, Real lambda_e, Vec3 target_pol, Real) {
+	Vec3 eta = (PolMask & 0x7) ? frame::hadron_from_target(kin) * target_pol : VEC3_ZERO;
+	Amm b(kin, phenom);
+	return SIDIS_MACRO_XS_FROM_BASE_MASK(amm, LepAmm, Had, kin, sf, b, lambda_e, eta, PolMask);
+}
+
+template<unsigned PolMask, typename SF>
+Real nrad_ir_kernel(Kinematics const& kin, Phenom const& phenom, SF const& sf, Real lambda_e, Vec3 target_pol, Real k_0_bar) {
+	Vec3 eta = (PolMask & 0x7) ? frame::hadron_from_target(kin) * target_pol : VEC3_ZERO;
+	Nrad b(kin, phenom, k_0_bar);
+	return SIDIS_MACRO_XS_FROM_BASE_MASK(nrad_ir, LepNrad, Had, kin, sf, b, lambda_e, eta, PolMask);
+}
+
+template<unsigned PolMask>
+Real rad_kernel(KinematicsRad const& kin, Phenom const& phenom, SfSet const& sf, Real lambda_e, Vec3 target_pol, Real) {
+	Vec3 eta = (PolMask & 0x1) ? frame::hadron_from_target(kin.project()) * target_pol : VEC3_ZERO;
+	Rad b(kin, phenom);
+	return SIDIS_MACRO_XS_FROM_BASE_P_MASK(rad, LepRad, HadRad, kin, sf, b, lambda_e, eta, PolMask);
+}
+
+template<unsigned PolMask>
+Real rad_f_kernel(KinematicsRad const& kin, Phenom const& phenom, SfSet const& sf, Real lambda_e, Vec3 target_pol, Real) {
+	Vec3 eta = (PolMask & 0x1) ? frame::hadron_from_target(kin.project()) * target_pol : VEC3_ZERO;
+	Rad b(kin, phenom);
+	return SIDIS_MACRO_XS_FROM_BASE_P_MASK(rad_f, LepRad, HadRadF, kin, sf, b, lambda_e, eta, PolMask);
+}
+
+// Used in place of a kernel when an `xs::Evaluator` can't handle the kind of
+// kinematics or structure functions.
+template<typename K, typename SF>
+Real invalid_kernel(K const&, Phenom const&, SF const&, Real, Vec3, Real) {
+	throw std::invalid_argument(
+		"Cross-section evaluator can't be used with these kinematics or "
+		"structure functions.");
+}
+
+// Kernel tables, indexed by `(beam polarized) << 1 | (target polarized)`. Once
+// rotated into the hadron frame, all components of a non-zero target
+// polarization are generally non-zero, so the corresponding masks are used.
+#define SIDIS_MACRO_XS_KERNELS(kernel, SF) { \
+	&kernel<0x0, SF>, \
+	&kernel<0x7, SF>, \
+	&kernel<0x8, SF>, \
+	&kernel<0xf, SF> }
+#define SIDIS_MACRO_XS_KERNELS_P(kernel) { \
+	&kernel<0x0>, \
+	&kernel<0x1>, \
+	&kernel<0x2>, \
+	&kernel<0x3> }
+
+// The QED correction factors are templated on the kinematics, so that the
+// batched cross-sections can use them with `BatchPoint`.
+template<typename K>
+Real delta_vert_rad_0(K const& kin) {
 	// Equation [1.3].
 	Real Q_m_sq = kin.Q_sq + 2.*sq(kin.m);
 	Real S_prime = kin.S - kin.Q_sq - kin.V_1;
@@ -353,6 +443,492 @@ Real delta_vert_rad_0(Kinematics const& kin) {
 	return delta;
 }
 
+template<typename K>
+Real delta_vert_rad_ir_kin(K const& kin, Real k_0_bar) {
+	// Paragraph following equation [1.C17].
+	Real k0_max = (kin.mx_sq - sq(kin.Mth))/(2.*kin.mx);
+	if (!(k_0_bar > 0.)) {
+		return -INF;
+	}
+	Real Q_m_sq = kin.Q_sq + 2.*sq(kin.m);
+	Real diff_m = sqrt1p_1m((4.*sq(kin.m))/kin.Q_sq);
+	Real sum_m = 2. + diff_m;
+	Real lambda_m = kin.Q_sq*(kin.Q_sq + 4.*sq(kin.m));
+	Real lambda_m_sqrt = std::sqrt(lambda_m);
+	Real L_m = 1./lambda_m_sqrt*std::log(sum_m/diff_m);
+	Real delta_0 = delta_vert_rad_0(kin);
+	// This comes from subtracting `delta_H` (equation [1.38]) from `delta_VR`
+	// (equation [1.52]).
+	Real delta_shift = 2.*(Q_m_sq*L_m - 1.)*std::log(
+		k_0_bar < k0_max ?
+		(2.*k_0_bar)/kin.m :
+		(kin.mx_sq - sq(kin.Mth))/(kin.m*kin.mx));
+	return delta_0 + delta_shift;
+}
+
+template<typename K>
+Real delta_vac_lep_kin(K const& kin) {
+	// Equation [1.50].
+	Real ms[3] = { MASS_E, MASS_MU, MASS_TAU };
+	Real delta = 0.;
+	for (unsigned idx = 0; idx < 3; ++idx) {
+		Real m = ms[idx];
+		Real lambda_sqrt = std::sqrt(kin.Q_sq*(kin.Q_sq + 4.*sq(m)));
+		Real diff_m = sqrt1p_1m((4.*sq(m))/kin.Q_sq);
+		Real sum_m = 2. + diff_m;
+		Real L_m = 1./lambda_sqrt*std::log(sum_m/diff_m);
+		delta += 2./3.L*(kin.Q_sq
+			+ 2.*sq(m))*L_m
+			- 10./9.L
+			+ (8.*sq(m))/(3.*kin.Q_sq)*(1. - 2.*sq(m)*L_m);
+	}
+	return delta;
+}
+
+
+// Kinematic variables of one point of a `KinematicsBatch`, holding only those
+// needed by the QED correction factors.
+struct BatchPoint {
+	Real S;
+	Real m;
+	Real Mth;
+	Real Q_sq;
+	Real X;
+	Real V_1;
+	Real V_2;
+	Real mx_sq;
+	Real mx;
+};
+
+BatchPoint batch_point(KinematicsBatch const& kin, std::size_t idx) {
+	BatchPoint point;
+	point.S = kin.S;
+	point.m = kin.m;
+	point.Mth = kin.Mth;
+	point.Q_sq = kin.Q_sq[idx];
+	point.X = kin.X[idx];
+	point.V_1 = kin.V_1[idx];
+	point.V_2 = kin.V_2[idx];
+	point.mx_sq = kin.mx_sq[idx];
+	point.mx = kin.mx[idx];
+	return point;
+}
+
+// The batched cross-sections are contracted in chunks of this many points. The
+// results of a chunk go into a local array first, since the compiler can tell
+// that it doesn't overlap with any of the input arrays.
+std::size_t const BATCH_CHUNK_SIZE = 64;
+
+void resize_batch_buffer(BatchBuffer& buf, std::size_t n) {
+	buf.F_UUL.resize(n);
+	buf.F_UUT.resize(n);
+	buf.F_UU_cos_phih.resize(n);
+	buf.F_UU_cos_2phih.resize(n);
+	buf.F_UL_sin_phih.resize(n);
+	buf.F_UL_sin_2phih.resize(n);
+	buf.F_UTL_sin_phih_m_phis.resize(n);
+	buf.F_UTT_sin_phih_m_phis.resize(n);
+	buf.F_UT_sin_2phih_m_phis.resize(n);
+	buf.F_UT_sin_3phih_m_phis.resize(n);
+	buf.F_UT_sin_phis.resize(n);
+	buf.F_UT_sin_phih_p_phis.resize(n);
+	buf.F_LU_sin_phih.resize(n);
+	buf.F_LL.resize(n);
+	buf.F_LL_cos_phih.resize(n);
+	buf.F_LT_cos_phih_m_phis.resize(n);
+	buf.F_LT_cos_2phih_m_phis.resize(n);
+	buf.F_LT_cos_phis.resize(n);
+	buf.coeff_born.resize(n);
+	buf.coeff_amm.resize(n);
+}
+
+void store_sf(BatchBuffer& buf, std::size_t idx, SfBaseUU const& sf) {
+	buf.F_UUL[idx] = sf.F_UUL;
+	buf.F_UUT[idx] = sf.F_UUT;
+	buf.F_UU_cos_phih[idx] = sf.F_UU_cos_phih;
+	buf.F_UU_cos_2phih[idx] = sf.F_UU_cos_2phih;
+}
+void store_sf(BatchBuffer& buf, std::size_t idx, SfBaseUL const& sf) {
+	buf.F_UL_sin_phih[idx] = sf.F_UL_sin_phih;
+	buf.F_UL_sin_2phih[idx] = sf.F_UL_sin_2phih;
+}
+void store_sf(BatchBuffer& buf, std::size_t idx, SfBaseUT const& sf) {
+	buf.F_UTL_sin_phih_m_phis[idx] = sf.F_UTL_sin_phih_m_phis;
+	buf.F_UTT_sin_phih_m_phis[idx] = sf.F_UTT_sin_phih_m_phis;
+	buf.F_UT_sin_2phih_m_phis[idx] = sf.F_UT_sin_2phih_m_phis;
+	buf.F_UT_sin_3phih_m_phis[idx] = sf.F_UT_sin_3phih_m_phis;
+	buf.F_UT_sin_phis[idx] = sf.F_UT_sin_phis;
+	buf.F_UT_sin_phih_p_phis[idx] = sf.F_UT_sin_phih_p_phis;
+}
+void store_sf(BatchBuffer& buf, std::size_t idx, SfBaseLU const& sf) {
+	buf.F_LU_sin_phih[idx] = sf.F_LU_sin_phih;
+}
+void store_sf(BatchBuffer& buf, std::size_t idx, SfBaseLL const& sf) {
+	buf.F_LL[idx] = sf.F_LL;
+	buf.F_LL_cos_phih[idx] = sf.F_LL_cos_phih;
+}
+void store_sf(BatchBuffer& buf, std::size_t idx, SfBaseLT const& sf) {
+	buf.F_LT_cos_phih_m_phis[idx] = sf.F_LT_cos_phih_m_phis;
+	buf.F_LT_cos_2phih_m_phis[idx] = sf.F_LT_cos_2phih_m_phis;
+	buf.F_LT_cos_phis[idx] = sf.F_LT_cos_phis;
+}
+void store_sf(BatchBuffer& buf, std::size_t idx, SfUU const& sf) {
+	store_sf(buf, idx, sf.uu);
+}
+void store_sf(BatchBuffer& buf, std::size_t idx, SfUL const& sf) {
+	store_sf(buf, idx, sf.uu);
+	store_sf(buf, idx, sf.ul);
+}
+void store_sf(BatchBuffer& buf, std::size_t idx, SfUT const& sf) {
+	store_sf(buf, idx, sf.uu);
+	store_sf(buf, idx, sf.ut);
+}
+void store_sf(BatchBuffer& buf, std::size_t idx, SfUP const& sf) {
+	store_sf(buf, idx, sf.uu);
+	store_sf(buf, idx, sf.ul);
+	store_sf(buf, idx, sf.ut);
+}
+void store_sf(BatchBuffer& buf, std::size_t idx, SfLU const& sf) {
+	store_sf(buf, idx, sf.uu);
+	store_sf(buf, idx, sf.lu);
+}
+void store_sf(BatchBuffer& buf, std::size_t idx, SfLL const& sf) {
+	store_sf(buf, idx, sf.uu);
+	store_sf(buf, idx, sf.ul);
+	store_sf(buf, idx, sf.lu);
+	store_sf(buf, idx, sf.ll);
+}
+void store_sf(BatchBuffer& buf, std::size_t idx, SfLT const& sf) {
+	store_sf(buf, idx, sf.uu);
+	store_sf(buf, idx, sf.ut);
+	store_sf(buf, idx, sf.lu);
+	store_sf(buf, idx, sf.lt);
+}
+void store_sf(BatchBuffer& buf, std::size_t idx, SfLP const& sf) {
+	store_sf(buf, idx, sf.uu);
+	store_sf(buf, idx, sf.ul);
+	store_sf(buf, idx, sf.ut);
+	store_sf(buf, idx, sf.lu);
+	store_sf(buf, idx, sf.ll);
+	store_sf(buf, idx, sf.lt);
+}
+
+// Fills in the structure functions of every point of the batch, asking for the
+// same ones as the hadronic coefficients in `SIDIS_MACRO_XS_FROM_BASE` do.
+#define SIDIS_MACRO_XS_BATCH_SF(method) \
+	for (std::size_t idx = 0; idx < kin.size(); ++idx) { \
+		store_sf(buf, idx, sf.method( \
+			kin.hadron, kin.x[idx], kin.z[idx], kin.Q_sq[idx], kin.ph_t_sq[idx])); \
+	}
+void fill_batch_sf(KinematicsBatch const& kin, SfSet const& sf, unsigned pol_mask, BatchBuffer& buf) {
+	switch (pol_mask) {
+	case 0:  /* 0000 */
+		SIDIS_MACRO_XS_BATCH_SF(sf_uu)
+		break;
+	case 1:  /* 0001 */
+		SIDIS_MACRO_XS_BATCH_SF(sf_ul)
+		break;
+	case 2:  /* 0010 */
+	case 4:  /* 0100 */
+	case 6:  /* 0110 */
+		SIDIS_MACRO_XS_BATCH_SF(sf_ut)
+		break;
+	case 3:  /* 0011 */
+	case 5:  /* 0101 */
+	case 7:  /* 0111 */
+		SIDIS_MACRO_XS_BATCH_SF(sf_up)
+		break;
+	case 8:  /* 1000 */
+		SIDIS_MACRO_XS_BATCH_SF(sf_lu)
+		break;
+	case 9:  /* 1001 */
+		SIDIS_MACRO_XS_BATCH_SF(sf_ll)
+		break;
+	case 10: /* 1010 */
+	case 12: /* 1100 */
+	case 14: /* 1110 */
+		SIDIS_MACRO_XS_BATCH_SF(sf_lt)
+		break;
+	case 11: /* 1011 */
+	case 13: /* 1101 */
+	case 15: /* 1111 */
+		SIDIS_MACRO_XS_BATCH_SF(sf_lp)
+		break;
+	}
+}
+#undef SIDIS_MACRO_XS_BATCH_SF
+
+// Computes the hadronic and leptonic coefficients of each point of the batch
+// straight from its arrays, and contracts them into the cross-section. Gives
+// the non-radiative cross-section with `WithAmm`, and the Born cross-section
+// otherwise. The equations and the order of operations are the same as in
+// `HadBaseXX`, `LepBornBaseXX`, `LepAmmBaseXX`, and the base cross-sections,
+// so that the results match. Since the polarization mask is a template
+// parameter, the loop has no branches and only reads the arrays that it needs,
+// so it can be vectorized.
+template<unsigned PolMask, bool WithAmm>
+void contract_batch(KinematicsBatch const& kin, BatchBuffer const& buf, Real lambda_e, Vec3 eta, Real* xs_out) {
+	bool const pol_x = PolMask & 0x4;
+	bool const pol_y = PolMask & 0x2;
+	bool const pol_z = PolMask & 0x1;
+	bool const pol_l = PolMask & 0x8;
+	Real const S = kin.S;
+	Real const M = kin.M;
+	Real const m = kin.m;
+	Real const mh = kin.mh;
+	Real const lambda_S_sqrt = kin.lambda_S_sqrt;
+	std::size_t n = kin.size();
+	for (std::size_t start = 0; start < n; start += BATCH_CHUNK_SIZE) {
+		std::size_t chunk_size = std::min(BATCH_CHUNK_SIZE, n - start);
+		Real xs_chunk[BATCH_CHUNK_SIZE];
+		for (std::size_t chunk_idx = 0; chunk_idx < chunk_size; ++chunk_idx) {
+			std::size_t idx = start + chunk_idx;
+			Real z = kin.z[idx];
+			Real Q_sq = kin.Q_sq[idx];
+			Real Q = kin.Q[idx];
+			Real X = kin.X[idx];
+			Real S_x = kin.S_x[idx];
+			Real V_1 = kin.V_1[idx];
+			Real V_2 = kin.V_2[idx];
+			Real V_m = kin.V_m[idx];
+			Real lambda_Y = kin.lambda_Y[idx];
+			Real lambda_Y_sqrt = kin.lambda_Y_sqrt[idx];
+			Real lambda_2 = kin.lambda_2[idx];
+			Real lambda_3 = kin.lambda_3[idx];
+			Real C_1 = kin.C_1[idx];
+			Real ph_t = kin.ph_t[idx];
+			Real ph_t_sq = kin.ph_t_sq[idx];
+			Real coeff_born = buf.coeff_born[idx];
+			Real coeff_amm = WithAmm ? buf.coeff_amm[idx] : 0.;
+
+			// Lepton coefficients. Equations [1.16] and [1.54].
+			Real L_1 = Q_sq - 2.*sq(m);
+			Real L_2 = 0.5*(S*X - sq(M)*Q_sq);
+			Real L_3 = 0.5*(V_1*V_2 - sq(mh)*Q_sq);
+			Real L_4 = 0.5*(S*V_2 + X*V_1 - z*Q_sq*S_x);
+			if (WithAmm) {
+				L_1 = coeff_born*L_1 + coeff_amm*6.;
+				L_2 = coeff_born*L_2 + coeff_amm*(-lambda_Y/(2.*Q_sq));
+				L_3 = coeff_born*L_3 + coeff_amm*(-2.*sq(mh) - 2.*sq(V_m)/Q_sq);
+				L_4 = coeff_born*L_4 + coeff_amm*(-2.*S_x*(z + V_m/Q_sq));
+			}
+			Real L_5 = 0.;
+			Real L_6 = 0.;
+			Real L_7 = 0.;
+			Real L_8 = 0.;
+			Real L_9 = 0.;
+			if (pol_x || pol_z) {
+				Real S_p = kin.S_p[idx];
+				Real V_p = kin.V_p[idx];
+				Real vol_phi_h = kin.vol_phi_h[idx];
+				L_6 = -S_p*vol_phi_h;
+				L_8 = -2.*V_p*vol_phi_h;
+				if (WithAmm) {
+					L_6 = coeff_born*L_6;
+					L_8 = coeff_born*L_8;
+				}
+			}
+			if (pol_l) {
+				Real vol_phi_h = kin.vol_phi_h[idx];
+				L_5 = (2.*S*vol_phi_h)/lambda_S_sqrt;
+				if (WithAmm) {
+					L_5 = coeff_born*L_5 + coeff_amm*(
+						(2.*(2.*S + S_x)*vol_phi_h)/(lambda_S_sqrt*Q_sq));
+				}
+			}
+			if (pol_l && (pol_x || pol_z)) {
+				Real S_p = kin.S_p[idx];
+				Real V_p = kin.V_p[idx];
+				L_7 = S/(4.*lambda_S_sqrt)*(
+					lambda_Y*V_p
+					- S_p*S_x*(z*Q_sq + V_m));
+				L_9 = 1./(2.*lambda_S_sqrt)*(
+					S*(
+						Q_sq*(z*S_x*V_p - sq(mh)*S_p)
+						+ V_m*(S*V_2 - X*V_1))
+					+ 2.*sq(m)*(
+						4.*sq(M)*sq(V_m)
+						+ lambda_Y*sq(mh)
+						- z*sq(S_x)*(z*Q_sq + 2.*V_m)));
+				if (WithAmm) {
+					L_7 = coeff_born*L_7 + coeff_amm*(
+						(2.*S + S_x)/(4.*lambda_S_sqrt*Q_sq)*(
+							S_x*(S*V_2 - X*V_1 - z*S_p*Q_sq)
+							+ 4.*sq(M)*Q_sq*V_p));
+					L_9 = coeff_born*L_9 + coeff_amm*(
+						1./(2.*lambda_S_sqrt*Q_sq)*(
+							sq(S_x)*(
+								4.*sq(m)*(sq(mh) - z*(z*Q_sq + 2.*V_m))
+								+ V_1*V_m)
+							- 4.*(sq(M)*(Q_sq - 4.*sq(m)) + sq(S))
+								*(sq(mh)*Q_sq + sq(V_m))
+							+ z*Q_sq*S_x*(
+								S_x*(z*Q_sq + V_1 + V_m)
+								+ 2.*S*V_p)
+							+ 2.*S*S_x*V_m*V_p));
+				}
+			}
+			// For the Born cross-section, the coefficient multiplies each base
+			// cross-section instead, as in `born_base_uu` and the others.
+			Real coeff = WithAmm ? 1. : coeff_born;
+
+			// Hadronic coefficients and contraction. Equation [1.14].
+			Real lambda_Y_sqrt_cb = lambda_Y_sqrt*lambda_Y_sqrt*lambda_Y_sqrt;
+			Real xs_uu;
+			{
+				Real H_00 = C_1*buf.F_UUL[idx];
+				Real H_01 = -C_1*buf.F_UU_cos_phih[idx];
+				Real H_11 = C_1*(buf.F_UU_cos_2phih[idx] + buf.F_UUT[idx]);
+				Real H_22 = C_1*(buf.F_UUT[idx] - buf.F_UU_cos_2phih[idx]);
+				Real H_10 = H_22;
+				Real H_20 = 4./(sq(lambda_Y)*ph_t_sq)*(
+					lambda_Y*ph_t_sq*Q_sq*H_00
+					+ sq(lambda_3)*sq(S_x)*H_11
+					- lambda_2*lambda_Y*H_22
+					-2.*S_x*lambda_3*ph_t*Q*lambda_Y_sqrt*H_01);
+				Real H_30 = 1./ph_t_sq*(H_11 - H_22);
+				Real H_40 = 2./(lambda_Y*ph_t_sq)*(
+					lambda_3*S_x*(H_22 - H_11)
+					+ ph_t*Q*lambda_Y_sqrt*H_01);
+				xs_uu = coeff*(L_1*H_10 + L_2*H_20 + L_3*H_30 + L_4*H_40);
+			}
+			Vec3 xs_up = VEC3_ZERO;
+			if (pol_z) {
+				Real H_023 = -C_1*buf.F_UL_sin_phih[idx];
+				Real H_123 = C_1*buf.F_UL_sin_2phih[idx];
+				Real H_63 = 4./(lambda_Y_sqrt_cb*ph_t_sq)*(
+					lambda_3*S_x*H_123
+					-Q*ph_t*lambda_Y_sqrt*H_023);
+				Real H_83 = -2./(lambda_Y_sqrt*ph_t_sq)*H_123;
+				xs_up.z = coeff*(L_6*H_63 + L_8*H_83);
+			}
+			if (pol_x || pol_y) {
+				Real F_UT_sin_2phih_m_phis = buf.F_UT_sin_2phih_m_phis[idx];
+				Real F_UT_sin_3phih_m_phis = buf.F_UT_sin_3phih_m_phis[idx];
+				Real F_UT_sin_phis = buf.F_UT_sin_phis[idx];
+				Real F_UT_sin_phih_p_phis = buf.F_UT_sin_phih_p_phis[idx];
+				if (pol_x) {
+					Real H_021 = -C_1*(F_UT_sin_2phih_m_phis + F_UT_sin_phis);
+					Real H_121 = C_1*(F_UT_sin_3phih_m_phis + F_UT_sin_phih_p_phis);
+					Real H_61 = 4./(lambda_Y_sqrt_cb*ph_t_sq)*(
+						lambda_3*S_x*H_121
+						- Q*ph_t*lambda_Y_sqrt*H_021);
+					Real H_81 = -2./(lambda_Y_sqrt*ph_t_sq)*H_121;
+					xs_up.x = coeff*(L_6*H_61 + L_8*H_81);
+				}
+				if (pol_y) {
+					Real F_UTT_sin_phih_m_phis = buf.F_UTT_sin_phih_m_phis[idx];
+					Real H_002 = C_1*buf.F_UTL_sin_phih_m_phis[idx];
+					Real H_012 = C_1*(F_UT_sin_phis - F_UT_sin_2phih_m_phis);
+					Real H_112 = C_1*(F_UT_sin_3phih_m_phis + F_UTT_sin_phih_m_phis - F_UT_sin_phih_p_phis);
+					Real H_222 = C_1*(F_UT_sin_phih_p_phis + F_UTT_sin_phih_m_phis - F_UT_sin_3phih_m_phis);
+					Real H_12 = -H_222;
+					Real H_22 = 4./(sq(lambda_Y)*ph_t_sq)*(
+						- lambda_Y*ph_t_sq*Q_sq*H_002
+						- sq(lambda_3)*sq(S_x)*H_112
+						+ lambda_2*lambda_Y*H_222
+						+ 2.*S_x*lambda_3*ph_t*Q*lambda_Y_sqrt*H_012);
+					Real H_32 = 1./ph_t_sq*(H_222 - H_112);
+					Real H_42 = 2./(lambda_Y*ph_t_sq)*(
+						lambda_3*S_x*(H_112 - H_222)
+						- ph_t*Q*lambda_Y_sqrt*H_012);
+					xs_up.y = coeff*(L_1*H_12 + L_2*H_22 + L_3*H_32 + L_4*H_42);
+				}
+			}
+			Real xs_lu = 0.;
+			Vec3 xs_lp = VEC3_ZERO;
+			if (pol_l) {
+				Real H_01 = -C_1*buf.F_LU_sin_phih[idx];
+				Real H_50 = (2.*Q)/(ph_t*lambda_Y_sqrt)*H_01;
+				xs_lu = coeff*L_5*H_50;
+				if (pol_z) {
+					Real H_023 = C_1*buf.F_LL_cos_phih[idx];
+					Real H_123 = -C_1*buf.F_LL[idx];
+					Real H_73 = 4./(lambda_Y_sqrt_cb*ph_t_sq)*(
+						lambda_3*S_x*H_123
+						- Q*ph_t*lambda_Y_sqrt*H_023);
+					Real H_93 = -2./(lambda_Y_sqrt*ph_t_sq)*H_123;
+					xs_lp.z = coeff*(L_7*H_73 + L_9*H_93);
+				}
+				if (pol_x) {
+					Real H_021 = C_1*(buf.F_LT_cos_2phih_m_phis[idx] + buf.F_LT_cos_phis[idx]);
+					Real H_121 = -C_1*buf.F_LT_cos_phih_m_phis[idx];
+					Real H_71 = 4./(lambda_Y_sqrt_cb*ph_t_sq)*(
+						lambda_3*S_x*H_121
+						- Q*ph_t*lambda_Y_sqrt*H_021);
+					Real H_91 = -2./(lambda_Y_sqrt*ph_t_sq)*H_121;
+					xs_lp.x = coeff*(L_7*H_71 + L_9*H_91);
+				}
+				if (pol_y) {
+					Real H_012 = -C_1*(buf.F_LT_cos_phis[idx] - buf.F_LT_cos_2phih_m_phis[idx]);
+					Real H_52 = -(2.*Q)/(ph_t*lambda_Y_sqrt)*H_012;
+					xs_lp.y = coeff*L_5*H_52;
+				}
+			}
+			xs_chunk[chunk_idx] = xs_uu + dot(xs_up, eta) + lambda_e*(xs_lu + dot(xs_lp, eta));
+		}
+		std::copy(xs_chunk, xs_chunk + chunk_size, xs_out + start);
+	}
+}
+
+// Table of `contract_batch` kernels, indexed by polarization mask.
+#define SIDIS_MACRO_XS_CONTRACT_BATCH(with_amm) { \
+	&contract_batch<0x0, with_amm>, &contract_batch<0x1, with_amm>, \
+	&contract_batch<0x2, with_amm>, &contract_batch<0x3, with_amm>, \
+	&contract_batch<0x4, with_amm>, &contract_batch<0x5, with_amm>, \
+	&contract_batch<0x6, with_amm>, &contract_batch<0x7, with_amm>, \
+	&contract_batch<0x8, with_amm>, &contract_batch<0x9, with_amm>, \
+	&contract_batch<0xa, with_amm>, &contract_batch<0xb, with_amm>, \
+	&contract_batch<0xc, with_amm>, &contract_batch<0xd, with_amm>, \
+	&contract_batch<0xe, with_amm>, &contract_batch<0xf, with_amm> }
+using ContractBatch = void (*)(KinematicsBatch const&, BatchBuffer const&, Real, Vec3, Real*);
+
+// The batched cross-sections, taking the phenomenological inputs at each point
+// from `alpha_qed_at` or `phenom_at`, so that both the direct calculation and
+// the table of an `xs::Context` can be used.
+template<typename F>
+void born_batch_impl(KinematicsBatch const& kin, SfSet const& sf, Real lambda_e, Vec3 eta, F alpha_qed_at, BatchBuffer& buf, Real* xs_out) {
+	static ContractBatch const kernels[16] = SIDIS_MACRO_XS_CONTRACT_BATCH(false);
+	unsigned pol_mask = SIDIS_MACRO_XS_POL_MASK(lambda_e, eta);
+	resize_batch_buffer(buf, kin.size());
+	fill_batch_sf(kin, sf, pol_mask, buf);
+	for (std::size_t idx = 0; idx < kin.size(); ++idx) {
+		// Same as `Born`.
+		Real alpha_qed = alpha_qed_at(kin.Q_sq[idx]);
+		buf.coeff_born[idx] = (sq(alpha_qed)*kin.S*sq(kin.S_x[idx]))
+			/(8.*kin.M*kin.ph_l[idx]*kin.lambda_S);
+	}
+	kernels[pol_mask](kin, buf, lambda_e, eta, xs_out);
+}
+
+template<typename F>
+void nrad_ir_batch_impl(KinematicsBatch const& kin, SfSet const& sf, Real lambda_e, Vec3 eta, F phenom_at, BatchBuffer& buf, Real* xs_out, Real k_0_bar) {
+	static ContractBatch const kernels[16] = SIDIS_MACRO_XS_CONTRACT_BATCH(true);
+	unsigned pol_mask = SIDIS_MACRO_XS_POL_MASK(lambda_e, eta);
+	resize_batch_buffer(buf, kin.size());
+	fill_batch_sf(kin, sf, pol_mask, buf);
+	for (std::size_t idx = 0; idx < kin.size(); ++idx) {
+		// Same as `Nrad`, `Born`, and `Amm`.
+		BatchPoint point = batch_point(kin, idx);
+		Phenom phenom = phenom_at(point.Q_sq);
+		Real born_coeff = (sq(phenom.alpha_qed)*kin.S*sq(kin.S_x[idx]))
+			/(8.*kin.M*kin.ph_l[idx]*kin.lambda_S);
+		Real lambda_m = point.Q_sq*(point.Q_sq + 4.*sq(kin.m));
+		Real lambda_m_sqrt = std::sqrt(lambda_m);
+		Real diff_m = sqrt1p_1m((4.*sq(kin.m))/point.Q_sq);
+		Real sum_m = 2. + diff_m;
+		Real L_m = 1./lambda_m_sqrt*std::log(sum_m/diff_m);
+		Real amm_coeff = L_m*point.Q_sq*(std::pow(phenom.alpha_qed, 3)*sq(kin.m)*kin.S*sq(kin.S_x[idx]))
+			/(16.*PI*kin.M*kin.ph_l[idx]*kin.lambda_S);
+		Real born_factor = 1. + phenom.alpha_qed/PI*(
+			delta_vert_rad_ir_kin(point, k_0_bar)
+			+ delta_vac_lep_kin(point)
+			+ phenom.delta_vac_had);
+		buf.coeff_born[idx] = born_factor*born_coeff;
+		buf.coeff_amm[idx] = amm_coeff;
+	}
+	kernels[pol_mask](kin, buf, lambda_e, eta, xs_out);
+}
 }
 
 Real xs::born(Kinematics const& kin, Phenom const& phenom, SfSet const& sf, Real lambda_e, Vec3 eta) {
@@ -360,6 +936,11 @@ Real xs::born(Kinematics const& kin, Phenom const& phenom, SfSet const& sf, Real
 	return SIDIS_MACRO_XS_FROM_BASE(born, LepBorn, Had, kin, sf, b, lambda_e, eta);
 }
 
+Real xs::born(Kinematics const& kin, Phenom const& phenom, SfLP const& sf, Real lambda_e, Vec3 eta) {
+	Born b(kin, phenom);
+	return SIDIS_MACRO_XS_FROM_BASE(born, LepBorn, Had, kin, sf, b, lambda_e, eta);
+}
+
 Real xs::amm(Kinematics const& kin, Phenom const& phenom, SfSet const& sf, Real lambda_e, Vec3 eta) {
 	Amm b(kin, phenom);
 	return SIDIS_MACRO_XS_FROM_BASE(amm, LepAmm, Had, kin, sf, b, lambda_e, eta);
@@ -370,6 +951,11 @@ Real xs::nrad_ir(Kinematics const& kin, Phenom const& phenom, SfSet const& sf, R
 	return SIDIS_MACRO_XS_FROM_BASE(nrad_ir, LepNrad, Had, kin, sf, b, lambda_e, eta);
 }
 
+Real xs::nrad_ir(Kinematics const& kin, Phenom const& phenom, SfLP const& sf, Real lambda_e, Vec3 eta, Real k_0_bar) {
+	Nrad b(kin, phenom, k_0_bar);
+	return SIDIS_MACRO_XS_FROM_BASE(nrad_ir, LepNrad, Had, kin, sf, b, lambda_e, eta);
+}
+
 Real xs::rad(KinematicsRad const& kin, Phenom const& phenom, SfSet const& sf, Real lambda_e, Vec3 eta) {
 	Rad b(kin, phenom);
 	return SIDIS_MACRO_XS_FROM_BASE_P(rad, LepRad, HadRad, kin, sf, b, lambda_e, eta);
@@ -380,18 +966,189 @@ Real xs::rad_f(KinematicsRad const& kin, Phenom const& phenom, SfSet const& sf,
 	return SIDIS_MACRO_XS_FROM_BASE_P(rad_f, LepRad, HadRadF, kin, sf, b, lambda_e, eta);
 }
 
+void xs::born_batch(KinematicsBatch const& kin, SfSet const& sf, Real lambda_e, Vec3 eta, BatchBuffer& buf, Real* xs_out) {
+	born_batch_impl(
+		kin, sf, lambda_e, eta,
+		[](Real Q_sq) { return ph::alpha_qed(Q_sq); },
+		buf, xs_out);
+}
+
+void xs::nrad_ir_batch(KinematicsBatch const& kin, SfSet const& sf, Real lambda_e, Vec3 eta, BatchBuffer& buf, Real* xs_out, Real k_0_bar) {
+	nrad_ir_batch_impl(
+		kin, sf, lambda_e, eta,
+		[](Real Q_sq) { return Phenom(ph::alpha_qed(Q_sq), ph::delta_vac_had(Q_sq)); },
+		buf, xs_out, k_0_bar);
+}
+
+void xs::rad_batch(KinematicsRadBatch const& kin, SfSet const& sf, Real lambda_e, Vec3 eta, Real* xs_out) {
+	for (std::size_t idx = 0; idx < kin.size(); ++idx) {
+		KinematicsRad kin_rad = kin.at(idx);
+		xs_out[idx] = rad(kin_rad, Phenom(kin_rad.project()), sf, lambda_e, eta);
+	}
+}
+
+xs::Evaluator::Evaluator(Kind kind, Real lambda_e, Vec3 target_pol, Real k_0_bar) :
+		_kind(kind),
+		_lambda_e(lambda_e),
+		_target_pol(target_pol),
+		_k_0_bar(k_0_bar),
+		_kernel(&invalid_kernel<Kinematics, SfSet>),
+		_kernel_lp(&invalid_kernel<Kinematics, SfLP>),
+		_kernel_rad(&invalid_kernel<KinematicsRad, SfSet>) {
+	Kernel const born_kernels[4] = SIDIS_MACRO_XS_KERNELS(born_kernel, SfSet);
+	KernelLP const born_kernels_lp[4] = SIDIS_MACRO_XS_KERNELS(born_kernel, SfLP);
+	Kernel const amm_kernels[4] = SIDIS_MACRO_XS_KERNELS(amm_kernel, SfSet);
+	KernelLP const amm_kernels_lp[4] = SIDIS_MACRO_XS_KERNELS(amm_kernel, SfLP);
+	Kernel const nrad_ir_kernels[4] = SIDIS_MACRO_XS_KERNELS(nrad_ir_kernel, SfSet);
+	KernelLP const nrad_ir_kernels_lp[4] = SIDIS_MACRO_XS_KERNELS(nrad_ir_kernel, SfLP);
+	KernelRad const rad_kernels[4] = SIDIS_MACRO_XS_KERNELS_P(rad_kernel);
+	KernelRad const rad_f_kernels[4] = SIDIS_MACRO_XS_KERNELS_P(rad_f_kernel);
+	unsigned pol_idx = ((lambda_e != 0.) << 1)
+		| ((target_pol.x != 0. || target_pol.y != 0. || target_pol.z != 0.) << 0);
+	switch (kind) {
+	case Kind::BORN:
+		_kernel = born_kernels[pol_idx];
+		_kernel_lp = born_kernels_lp[pol_idx];
+		break;
+	case Kind::AMM:
+		_kernel = amm_kernels[pol_idx];
+		_kernel_lp = amm_kernels_lp[pol_idx];
+		break;
+	case Kind::NRAD_IR:
+		_kernel = nrad_ir_kernels[pol_idx];
+		_kernel_lp = nrad_ir_kernels_lp[pol_idx];
+		break;
+	case Kind::RAD:
+		_kernel_rad = rad_kernels[pol_idx];
+		break;
+	case Kind::RAD_F:
+		_kernel_rad = rad_f_kernels[pol_idx];
+		break;
+	default:
+		throw std::invalid_argument("Unknown kind of cross-section.");
+	}
+}
+
+Real xs::Evaluator::eval(KinematicsRad const& kin, SfSet const& sf) const {
+	return _kernel_rad(kin, Phenom(kin.project()), sf, _lambda_e, _target_pol, _k_0_bar);
+}
+
+xs::Context::Context(
+		part::Particles const& ps,
+		Real S,
+		SfSet const& sf,
+		Real lambda_e,
+		Vec3 target_pol) :
+		_ps(ps),
+		_S(S),
+		_sf(sf),
+		_lambda_e(lambda_e),
+		_target_pol(target_pol),
+		// The largest possible `Q_sq` is `S`. The table starts at the bottom of
+		// the range where `alpha_qed` is defined.
+		_phenom(sq(MASS_E), S) { }
+
+Phenom xs::Context::phenom(Real Q_sq) const {
+	return _phenom(Q_sq);
+}
+Phenom xs::Context::phenom(Kinematics const& kin) const {
+	return _phenom(kin.Q_sq);
+}
+Phenom xs::Context::phenom(KinematicsRad const& kin) const {
+	return _phenom(kin.Q_sq);
+}
+Vec3 xs::Context::eta(Kinematics const& kin) const {
+	return frame::hadron_from_target(kin) * _target_pol;
+}
+Vec3 xs::Context::eta(KinematicsRad const& kin) const {
+	// Avoid projecting the kinematics when there is no target polarization.
+	if (_target_pol == VEC3_ZERO) {
+		return VEC3_ZERO;
+	}
+	return frame::hadron_from_target(kin.project()) * _target_pol;
+}
+
+Real xs::born(Kinematics const& kin, Context const& ctx) {
+	return born(kin, ctx.phenom(kin), ctx.sf(), ctx.lambda_e(), ctx.eta(kin));
+}
+Real xs::born(Kinematics const& kin, Context const& ctx, SfLP const& sf) {
+	return born(kin, ctx.phenom(kin), sf, ctx.lambda_e(), ctx.eta(kin));
+}
+Real xs::amm(Kinematics const& kin, Context const& ctx) {
+	return amm(kin, ctx.phenom(kin), ctx.sf(), ctx.lambda_e(), ctx.eta(kin));
+}
+Real xs::nrad_ir(Kinematics const& kin, Context const& ctx, Real k_0_bar) {
+	return nrad_ir(kin, ctx.phenom(kin), ctx.sf(), ctx.lambda_e(), ctx.eta(kin), k_0_bar);
+}
+Real xs::nrad_ir(Kinematics const& kin, Context const& ctx, SfLP const& sf, Real k_0_bar) {
+	return nrad_ir(kin, ctx.phenom(kin), sf, ctx.lambda_e(), ctx.eta(kin), k_0_bar);
+}
+EstErr xs::nrad_integ(Kinematics const& kin, Context const& ctx, Real k_0_bar, IntegParams params) {
+	return nrad_integ(kin, ctx.phenom(kin), ctx.sf(), ctx.lambda_e(), ctx.eta(kin), k_0_bar, params);
+}
+EstErr xs::nrad_integ(Kinematics const& kin, Context const& ctx, SfLP const& sf_0, Real k_0_bar, IntegParams params) {
+	return nrad_integ(kin, ctx.phenom(kin), ctx.sf(), sf_0, ctx.lambda_e(), ctx.eta(kin), k_0_bar, params);
+}
+Real xs::rad_f(KinematicsRad const& kin, Context const& ctx) {
+	return rad_f(kin, ctx.phenom(kin), ctx.sf(), ctx.lambda_e(), ctx.eta(kin));
+}
+Real xs::rad(KinematicsRad const& kin, Context const& ctx) {
+	return rad(kin, ctx.phenom(kin), ctx.sf(), ctx.lambda_e(), ctx.eta(kin));
+}
+EstErr xs::rad_f_integ(Kinematics const& kin, Context const& ctx, Real k_0_bar, IntegParams params) {
+	return rad_f_integ(kin, ctx.phenom(kin), ctx.sf(), ctx.lambda_e(), ctx.eta(kin), k_0_bar, params);
+}
+EstErr xs::rad_f_integ(Kinematics const& kin, Context const& ctx, SfLP const& sf_0, Real k_0_bar, IntegParams params) {
+	return rad_f_integ(kin, ctx.phenom(kin), ctx.sf(), sf_0, ctx.lambda_e(), ctx.eta(kin), k_0_bar, params);
+}
+EstErr xs::rad_integ(Kinematics const& kin, Context const& ctx, Real k_0_bar, IntegParams params) {
+	return rad_integ(kin, ctx.phenom(kin), ctx.sf(), ctx.lambda_e(), ctx.eta(kin), k_0_bar, params);
+}
+void xs::born_batch(KinematicsBatch const& kin, Context const& ctx, BatchBuffer& buf, Real* xs_out) {
+	if (ctx.target_pol() != VEC3_ZERO) {
+		throw std::invalid_argument(
+			"Batched cross-sections can't be used with a polarized target.");
+	}
+	born_batch_impl(
+		kin, ctx.sf(), ctx.lambda_e(), VEC3_ZERO,
+		[&ctx](Real Q_sq) { return ctx.phenom(Q_sq).alpha_qed; },
+		buf, xs_out);
+}
+void xs::nrad_ir_batch(KinematicsBatch const& kin, Context const& ctx, BatchBuffer& buf, Real* xs_out, Real k_0_bar) {
+	if (ctx.target_pol() != VEC3_ZERO) {
+		throw std::invalid_argument(
+			"Batched cross-sections can't be used with a polarized target.");
+	}
+	nrad_ir_batch_impl(
+		kin, ctx.sf(), ctx.lambda_e(), VEC3_ZERO,
+		[&ctx](Real Q_sq) { return ctx.phenom(Q_sq); },
+		buf, xs_out, k_0_bar);
+}
+
 EstErr xs::nrad_integ(Kinematics const& kin, Phenom const& phenom, SfSet const& sf, Real lambda_e, Vec3 eta, Real k_0_bar, IntegParams params) {
+	// The full set of structure functions is needed for the infrared
+	// subtraction anyway, so share them with the non-radiative part.
+	SfLP sf_0 = sf.sf_lp(kin.hadron, kin.x, kin.z, kin.Q_sq, kin.ph_t_sq);
+	return nrad_integ(kin, phenom, sf, sf_0, lambda_e, eta, k_0_bar, params);
+}
+
+EstErr xs::nrad_integ(Kinematics const& kin, Phenom const& phenom, SfSet const& sf, SfLP const& sf_0, Real lambda_e, Vec3 eta, Real k_0_bar, IntegParams params) {
 	// The soft part of the radiative cross-section (below `k_0_bar`) is bundled
 	// into the return value here.
-	Real xs_nrad_ir = nrad_ir(kin, phenom, sf, lambda_e, eta, k_0_bar);
+	Real xs_nrad_ir = nrad_ir(kin, phenom, sf_0, lambda_e, eta, k_0_bar);
 	// TODO: The integration parameters should be modified here to account for
 	// the `xs_nrad_ir` contribution.
-	EstErr xs_rad_f = rad_f_integ(kin, phenom, sf, lambda_e, eta, k_0_bar, params);
+	EstErr xs_rad_f = rad_f_integ(kin, phenom, sf, sf_0, lambda_e, eta, k_0_bar, params);
 	return { xs_nrad_ir + xs_rad_f.val, xs_rad_f.err };
 }
 
 EstErr xs::rad_f_integ(Kinematics const& kin, Phenom const& phenom, SfSet const& sf, Real lambda_e, Vec3 eta, Real k_0_bar, IntegParams params) {
-	HadLP had_0(kin, sf);
+	SfLP sf_0 = sf.sf_lp(kin.hadron, kin.x, kin.z, kin.Q_sq, kin.ph_t_sq);
+	return rad_f_integ(kin, phenom, sf, sf_0, lambda_e, eta, k_0_bar, params);
+}
+
+EstErr xs::rad_f_integ(Kinematics const& kin, Phenom const& phenom, SfSet const& sf, SfLP const& sf_0, Real lambda_e, Vec3 eta, Real k_0_bar, IntegParams params) {
+	HadLP had_0(kin, sf_0);
 	CutRad cut;
 	cut.k_0_bar = Bound(0., k_0_bar);
 	EstErr xs_integ = integrate<3>(
@@ -446,12 +1203,18 @@ EstErr xs::rad_integ(Kinematics const& kin, Phenom const& phenom, SfSet const& s
 Real xs::born(Kinematics const& kin, SfSet const& sf, Real lambda_e, Vec3 eta) {
 	return born(kin, Phenom(kin), sf, lambda_e, eta);
 }
+Real xs::born(Kinematics const& kin, SfLP const& sf, Real lambda_e, Vec3 eta) {
+	return born(kin, Phenom(kin), sf, lambda_e, eta);
+}
 Real xs::amm(Kinematics const& kin, SfSet const& sf, Real lambda_e, Vec3 eta) {
 	return amm(kin, Phenom(kin), sf, lambda_e, eta);
 }
 Real xs::nrad_ir(Kinematics const& kin, SfSet const& sf, Real lambda_e, Vec3 eta, Real k_0_bar) {
 	return nrad_ir(kin, Phenom(kin), sf, lambda_e, eta, k_0_bar);
 }
+Real xs::nrad_ir(Kinematics const& kin, SfLP const& sf, Real lambda_e, Vec3 eta, Real k_0_bar) {
+	return nrad_ir(kin, Phenom(kin), sf, lambda_e, eta, k_0_bar);
+}
 Real xs::rad(KinematicsRad const& kin, SfSet const& sf, Real lambda_e, Vec3 eta) {
 	return rad(kin, Phenom(kin.project()), sf, lambda_e, eta);
 }
@@ -461,34 +1224,22 @@ Real xs::rad_f(KinematicsRad const& kin, SfSet const& sf, Real lambda_e, Vec3 et
 EstErr xs::nrad_integ(Kinematics const& kin, SfSet const& sf, Real lambda_e, Vec3 eta, Real k_0_bar, IntegParams params) {
 	return nrad_integ(kin, Phenom(kin), sf, lambda_e, eta, k_0_bar, params);
 }
+EstErr xs::nrad_integ(Kinematics const& kin, SfSet const& sf, SfLP const& sf_0, Real lambda_e, Vec3 eta, Real k_0_bar, IntegParams params) {
+	return nrad_integ(kin, Phenom(kin), sf, sf_0, lambda_e, eta, k_0_bar, params);
+}
 EstErr xs::rad_f_integ(Kinematics const& kin, SfSet const& sf, Real lambda_e, Vec3 eta, Real k_0_bar, IntegParams params) {
 	return rad_f_integ(kin, Phenom(kin), sf, lambda_e, eta, k_0_bar, params);
 }
+EstErr xs::rad_f_integ(Kinematics const& kin, SfSet const& sf, SfLP const& sf_0, Real lambda_e, Vec3 eta, Real k_0_bar, IntegParams params) {
+	return rad_f_integ(kin, Phenom(kin), sf, sf_0, lambda_e, eta, k_0_bar, params);
+}
 EstErr xs::rad_integ(Kinematics const& kin, SfSet const& sf, Real lambda_e, Vec3 eta, Real k_0_bar, IntegParams params) {
 	return rad_integ(kin, Phenom(kin), sf, lambda_e, eta, k_0_bar, params);
 }
 
 // Radiative corrections to Born cross-section.
 Real xs::delta_vert_rad_ir(Kinematics const& kin, Real k_0_bar) {
-	// Paragraph following equation [1.C17].
-	Real k0_max = (kin.mx_sq - sq(kin.Mth))/(2.*kin.mx);
-	if (!(k_0_bar > 0.)) {
-		return -INF;
-	}
-	Real Q_m_sq = kin.Q_sq + 2.*sq(kin.m);
-	Real diff_m = sqrt1p_1m((4.*sq(kin.m))/kin.Q_sq);
-	Real sum_m = 2. + diff_m;
-	Real lambda_m = kin.Q_sq*(kin.Q_sq + 4.*sq(kin.m));
-	Real lambda_m_sqrt = std::sqrt(lambda_m);
-	Real L_m = 1./lambda_m_sqrt*std::log(sum_m/diff_m);
-	Real delta_0 = delta_vert_rad_0(kin);
-	// This comes from subtracting `delta_H` (equation [1.38]) from `delta_VR`
-	// (equation [1.52]).
-	Real delta_shift = 2.*(Q_m_sq*L_m - 1.)*std::log(
-		k_0_bar < k0_max ?
-		(2.*k_0_bar)/kin.m :
-		(kin.mx_sq - sq(kin.Mth))/(kin.m*kin.mx));
-	return delta_0 + delta_shift;
+	return delta_vert_rad_ir_kin(kin, k_0_bar);
 }
 Real xs::delta_rad_ir_hard(Kinematics const& kin, Real k_0_bar) {
 	Real k0_max = (kin.mx_sq - sq(kin.Mth))/(2.*kin.mx);
@@ -510,21 +1261,7 @@ Real xs::delta_rad_ir_hard(Kinematics const& kin, Real k_0_bar) {
 }
 
 Real xs::delta_vac_lep(Kinematics const& kin) {
-	// Equation [1.50].
-	Real ms[3] = { MASS_E, MASS_MU, MASS_TAU };
-	Real delta = 0.;
-	for (unsigned idx = 0; idx < 3; ++idx) {
-		Real m = ms[idx];
-		Real lambda_sqrt = std::sqrt(kin.Q_sq*(kin.Q_sq + 4.*sq(m)));
-		Real diff_m = sqrt1p_1m((4.*sq(m))/kin.Q_sq);
-		Real sum_m = 2. + diff_m;
-		Real L_m = 1./lambda_sqrt*std::log(sum_m/diff_m);
-		delta += 2./3.L*(kin.Q_sq
-			+ 2.*sq(m))*L_m
-			- 10./9.L
-			+ (8.*sq(m))/(3.*kin.Q_sq)*(1. - 2.*sq(m)*L_m);
-	}
-	return delta;
+	return delta_vac_lep_kin(kin);
 }
 
 // Born base functions.
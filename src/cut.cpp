@@ -425,7 +425,7 @@ bool cut::take(
 bool cut::take(
 		Cut const& cut,
 		Particles const& ps, Real S, const Real point[6],
-		Kinematics* kin_out, Real* jac_out) {
+		PhaseSpace* ph_space_out, Real* jac_out) {
 	Real jac_x, jac_y, jac_z, jac_ph_t_sq, jac_phi_h, jac_phi;
 	Real x = apply_map(map::Inverse(X_CUTOFF), point[0], x_bound(cut, ps, S), &jac_x);
 	Real y = apply_map(map::Inverse(), point[1], y_bound(cut, ps, S, x), &jac_y);
@@ -434,14 +434,28 @@ bool cut::take(
 	Real phi_h = apply_map(map::Linear(), point[4], cut.phi_h.valid() ? cut.phi_h : Bound(-PI, PI), &jac_phi_h);
 	Real phi = apply_map(map::Linear(), point[5], cut.phi.valid() ? cut.phi : Bound(-PI, PI), &jac_phi);
 
-	PhaseSpace ph_space { x, y, z, ph_t_sq, phi_h, phi };
-	Kinematics kin(ps, S, ph_space);
-	if (kin_out != nullptr) {
-		*kin_out = kin;
+	if (ph_space_out != nullptr) {
+		*ph_space_out = PhaseSpace { x, y, z, ph_t_sq, phi_h, phi };
 	}
 	if (jac_out != nullptr) {
 		*jac_out = jac_x * jac_y * jac_z * jac_ph_t_sq * jac_phi_h * jac_phi;
 	}
+	// The remaining cuts can only be checked with the full kinematics.
+	return true;
+}
+
+bool cut::take(
+		Cut const& cut,
+		Particles const& ps, Real S, const Real point[6],
+		Kinematics* kin_out, Real* jac_out) {
+	PhaseSpace ph_space;
+	if (!cut::take(cut, ps, S, point, &ph_space, jac_out)) {
+		return false;
+	}
+	Kinematics kin(ps, S, ph_space);
+	if (kin_out != nullptr) {
+		*kin_out = kin;
+	}
 	return valid(cut, kin);
 }
 
@@ -552,7 +566,7 @@ bool cut::take(
 bool cut::take(
 		CutRad const& cut,
 		Kinematics const& kin, const Real point[3],
-		KinematicsRad* kin_out, Real* jac_out) {
+		PhaseSpaceRad* ph_space_out, Real* jac_out) {
 	Real tau_p1 = kin.Q_sq / kin.X;
 	Real tau_pr = -(1. - kin.y);
 	Real tau_lim1 = SQRT_2 * kin.lambda_1_sqrt * kin.m / sq(kin.X);
@@ -572,13 +586,32 @@ bool cut::take(
 		map::Log(R_trans),
 		point[2], R_bound(cut, kin, tau, phi_k), &jac_R);
 
-	KinematicsRad kin_rad(kin, tau, phi_k, R);
-	if (kin_out != nullptr) {
-		*kin_out = kin_rad;
+	if (ph_space_out != nullptr) {
+		*ph_space_out = {
+			kin.x, kin.y, kin.z,
+			kin.ph_t_sq, kin.phi_h, kin.phi,
+			tau, phi_k, R,
+		};
 	}
 	if (jac_out != nullptr) {
 		*jac_out = jac_tau * jac_phi_k * jac_R;
 	}
+	// The remaining cuts can only be checked with the full kinematics.
+	return true;
+}
+
+bool cut::take(
+		CutRad const& cut,
+		Kinematics const& kin, const Real point[3],
+		KinematicsRad* kin_out, Real* jac_out) {
+	PhaseSpaceRad ph_space;
+	if (!cut::take(cut, kin, point, &ph_space, jac_out)) {
+		return false;
+	}
+	KinematicsRad kin_rad(kin, ph_space.tau, ph_space.phi_k, ph_space.R);
+	if (kin_out != nullptr) {
+		*kin_out = kin_rad;
+	}
 	return valid(cut, kin_rad);
 }
 
@@ -391,27 +391,47 @@ HadUU::HadUU(Kinematics const& kin, SfSet const& sf_set) {
 	SfUU sf = sf_set.sf_uu(kin.hadron, kin.x, kin.z, kin.Q_sq, kin.ph_t_sq);
 	uu = make_had_base_uu(kin, sf.uu);
 }
+HadUU::HadUU(Kinematics const& kin, SfLP const& sf) {
+	uu = make_had_base_uu(kin, sf.uu);
+}
 HadUL::HadUL(Kinematics const& kin, SfSet const& sf_set) {
 	SfUL sf = sf_set.sf_ul(kin.hadron, kin.x, kin.z, kin.Q_sq, kin.ph_t_sq);
 	uu = make_had_base_uu(kin, sf.uu);
 	ul = make_had_base_ul(kin, sf.ul);
 }
+HadUL::HadUL(Kinematics const& kin, SfLP const& sf) {
+	uu = make_had_base_uu(kin, sf.uu);
+	ul = make_had_base_ul(kin, sf.ul);
+}
 HadUT::HadUT(Kinematics const& kin, SfSet const& sf_set) {
 	SfUT sf = sf_set.sf_ut(kin.hadron, kin.x, kin.z, kin.Q_sq, kin.ph_t_sq);
 	uu = make_had_base_uu(kin, sf.uu);
 	ut = make_had_base_ut(kin, sf.ut);
 }
+HadUT::HadUT(Kinematics const& kin, SfLP const& sf) {
+	uu = make_had_base_uu(kin, sf.uu);
+	ut = make_had_base_ut(kin, sf.ut);
+}
 HadUP::HadUP(Kinematics const& kin, SfSet const& sf_set) {
 	SfUP sf = sf_set.sf_up(kin.hadron, kin.x, kin.z, kin.Q_sq, kin.ph_t_sq);
 	uu = make_had_base_uu(kin, sf.uu);
 	ul = make_had_base_ul(kin, sf.ul);
 	ut = make_had_base_ut(kin, sf.ut);
 }
+HadUP::HadUP(Kinematics const& kin, SfLP const& sf) {
+	uu = make_had_base_uu(kin, sf.uu);
+	ul = make_had_base_ul(kin, sf.ul);
+	ut = make_had_base_ut(kin, sf.ut);
+}
 HadLU::HadLU(Kinematics const& kin, SfSet const& sf_set) {
 	SfLU sf = sf_set.sf_lu(kin.hadron, kin.x, kin.z, kin.Q_sq, kin.ph_t_sq);
 	uu = make_had_base_uu(kin, sf.uu);
 	lu = make_had_base_lu(kin, sf.lu);
 }
+HadLU::HadLU(Kinematics const& kin, SfLP const& sf) {
+	uu = make_had_base_uu(kin, sf.uu);
+	lu = make_had_base_lu(kin, sf.lu);
+}
 HadLL::HadLL(Kinematics const& kin, SfSet const& sf_set) {
 	SfLL sf = sf_set.sf_ll(kin.hadron, kin.x, kin.z, kin.Q_sq, kin.ph_t_sq);
 	uu = make_had_base_uu(kin, sf.uu);
@@ -419,6 +439,12 @@ HadLL::HadLL(Kinematics const& kin, SfSet const& sf_set) {
 	lu = make_had_base_lu(kin, sf.lu);
 	ll = make_had_base_ll(kin, sf.ll);
 }
+HadLL::HadLL(Kinematics const& kin, SfLP const& sf) {
+	uu = make_had_base_uu(kin, sf.uu);
+	ul = make_had_base_ul(kin, sf.ul);
+	lu = make_had_base_lu(kin, sf.lu);
+	ll = make_had_base_ll(kin, sf.ll);
+}
 HadLT::HadLT(Kinematics const& kin, SfSet const& sf_set) {
 	SfLT sf = sf_set.sf_lt(kin.hadron, kin.x, kin.z, kin.Q_sq, kin.ph_t_sq);
 	uu = make_had_base_uu(kin, sf.uu);
@@ -426,6 +452,12 @@ HadLT::HadLT(Kinematics const& kin, SfSet const& sf_set) {
 	lu = make_had_base_lu(kin, sf.lu);
 	lt = make_had_base_lt(kin, sf.lt);
 }
+HadLT::HadLT(Kinematics const& kin, SfLP const& sf) {
+	uu = make_had_base_uu(kin, sf.uu);
+	ut = make_had_base_ut(kin, sf.ut);
+	lu = make_had_base_lu(kin, sf.lu);
+	lt = make_had_base_lt(kin, sf.lt);
+}
 HadLP::HadLP(Kinematics const& kin, SfSet const& sf_set) {
 	SfLP sf = sf_set.sf_lp(kin.hadron, kin.x, kin.z, kin.Q_sq, kin.ph_t_sq);
 	uu = make_had_base_uu(kin, sf.uu);
@@ -435,6 +467,14 @@ HadLP::HadLP(Kinematics const& kin, SfSet const& sf_set) {
 	ll = make_had_base_ll(kin, sf.ll);
 	lt = make_had_base_lt(kin, sf.lt);
 }
+HadLP::HadLP(Kinematics const& kin, SfLP const& sf) {
+	uu = make_had_base_uu(kin, sf.uu);
+	ul = make_had_base_ul(kin, sf.ul);
+	ut = make_had_base_ut(kin, sf.ut);
+	lu = make_had_base_lu(kin, sf.lu);
+	ll = make_had_base_ll(kin, sf.ll);
+	lt = make_had_base_lt(kin, sf.lt);
+}
 
 // HadRadBaseXX constructors.
 HadRadBaseUU::HadRadBaseUU(KinematicsRad const& kin, SfSet const& sf_set) :
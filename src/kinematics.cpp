@@ -455,6 +455,782 @@ Kinematics KinematicsRad::project_shift() const {
 	return kin;
 }
 
+// The batched kinematics are computed with the same equations as `Kinematics`
+// and `KinematicsRad`, in the same order, so that they give identical results.
+// Most loops only compute a single quantity, which keeps the number of arrays
+// involved small enough for the compiler to be able to vectorize them.
+KinematicsBatch::KinematicsBatch(
+		Particles const& ps,
+		Real S,
+		std::vector<PhaseSpace> const& ph_spaces) :
+		target(ps.target),
+		beam(ps.beam),
+		hadron(ps.hadron),
+		S(S),
+		M(ps.M),
+		m(ps.m),
+		mh(ps.mh),
+		Mth(ps.Mth) {
+	// Local copies, so that the compiler knows they aren't changed by the
+	// stores in the loops below.
+	Real M = ps.M;
+	Real m = ps.m;
+	Real mh = ps.mh;
+	std::size_t n = ph_spaces.size();
+	x.resize(n);
+	y.resize(n);
+	z.resize(n);
+	ph_t_sq.resize(n);
+	phi_h.resize(n);
+	phi.resize(n);
+	Q_sq.resize(n);
+	Q.resize(n);
+	t.resize(n);
+	W_sq.resize(n);
+	X.resize(n);
+	S_x.resize(n);
+	S_p.resize(n);
+	V_1.resize(n);
+	V_2.resize(n);
+	V_m.resize(n);
+	V_p.resize(n);
+	lambda_X.resize(n);
+	lambda_Y.resize(n);
+	lambda_1.resize(n);
+	lambda_2.resize(n);
+	lambda_3.resize(n);
+	lambda_X_sqrt.resize(n);
+	lambda_Y_sqrt.resize(n);
+	lambda_1_sqrt.resize(n);
+	lambda_2_sqrt.resize(n);
+	lambda_3_sqrt.resize(n);
+	mx_sq.resize(n);
+	mx.resize(n);
+	vol_phi_h.resize(n);
+	C_1.resize(n);
+	ph_0.resize(n);
+	ph_t.resize(n);
+	ph_l.resize(n);
+	cos_phi_h.resize(n);
+	sin_phi_h.resize(n);
+	q_0.resize(n);
+	q_t.resize(n);
+	q_l.resize(n);
+	phi_q.resize(n);
+	cos_phi_q.resize(n);
+	sin_phi_q.resize(n);
+	k2_0.resize(n);
+	k2_t.resize(n);
+	k2_l.resize(n);
+	k1_t.resize(n);
+	cos_phi.resize(n);
+	sin_phi.resize(n);
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		x[idx] = ph_spaces[idx].x;
+		y[idx] = ph_spaces[idx].y;
+		z[idx] = ph_spaces[idx].z;
+		ph_t_sq[idx] = ph_spaces[idx].ph_t_sq;
+		phi_h[idx] = ph_spaces[idx].phi_h;
+		phi[idx] = ph_spaces[idx].phi;
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		phi_q[idx] = std::fmod(PI - phi[idx], 2.*PI);
+		if (phi_q[idx] > PI) {
+			phi_q[idx] -= 2.*PI;
+		} else if (phi_q[idx] < -PI) {
+			phi_q[idx] += 2.*PI;
+		}
+	}
+
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		cos_phi_h[idx] = std::cos(phi_h[idx]);
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		sin_phi_h[idx] = std::sin(phi_h[idx]);
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		cos_phi[idx] = std::cos(phi[idx]);
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		sin_phi[idx] = std::sin(phi[idx]);
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		cos_phi_q[idx] = -cos_phi[idx];
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		sin_phi_q[idx] = sin_phi[idx];
+	}
+
+	// Equation [1.3].
+	Real lambda_S = sq(S) - 4.*sq(M)*sq(m);
+	Real lambda_S_sqrt = std::sqrt(lambda_S);
+	this->lambda_S = lambda_S;
+	this->lambda_S_sqrt = lambda_S_sqrt;
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		Q_sq[idx] = S*x[idx]*y[idx];
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		Q[idx] = std::sqrt(Q_sq[idx]);
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		X[idx] = (1. - y[idx])*S;
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		S_x[idx] = S*y[idx];
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		S_p[idx] = S*(2. - y[idx]);
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		lambda_X[idx] = sq(X[idx]) - 4.*sq(M)*sq(m);
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		lambda_Y[idx] = sq(S_x[idx]) + 4.*sq(M)*Q_sq[idx];
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		lambda_1[idx] = Q_sq[idx]*(S*X[idx] - sq(M)*Q_sq[idx]) - sq(m)*lambda_Y[idx];
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		lambda_X_sqrt[idx] = std::sqrt(lambda_X[idx]);
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		lambda_Y_sqrt[idx] = std::sqrt(lambda_Y[idx]);
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		lambda_1_sqrt[idx] = std::sqrt(lambda_1[idx]);
+	}
+
+	// Equation [1.4]. The equations have been re-arranged in terms of
+	// `ph_t_sq`.
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		ph_0[idx] = (z[idx]*S_x[idx])/(2.*M);
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		ph_t[idx] = std::sqrt(ph_t_sq[idx]);
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		Real ph_ratio_sq = ph_t_sq[idx]/sq(ph_0[idx]) + sq(mh/ph_0[idx]);
+		ph_l[idx] = ph_0[idx]*std::sqrt(1. - ph_ratio_sq);
+	}
+
+	// Virtual photon and scattered lepton 4-momentum components.
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		q_0[idx] = S_x[idx]/(2.*M);
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		q_t[idx] = lambda_1_sqrt[idx]/lambda_S_sqrt;
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		q_l[idx] = (2.*sq(M)*Q_sq[idx] + S*S_x[idx])/(2.*M*lambda_S_sqrt);
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		k2_0[idx] = X[idx]/(2.*M);
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		k2_l[idx] = (S*X[idx] - 2.*sq(M)*Q_sq[idx] - 4.*sq(M)*sq(m))/(2.*M*lambda_S_sqrt);
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		k2_t[idx] = lambda_1_sqrt[idx]/lambda_S_sqrt;
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		k1_t[idx] = lambda_1_sqrt[idx]/lambda_Y_sqrt[idx];
+	}
+
+	// Equation [1.5].
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		V_1[idx] = ph_0[idx]*S/M
+			- (ph_l[idx]*(S*S_x[idx] + 2.*sq(M)*Q_sq[idx]))/(M*lambda_Y_sqrt[idx])
+			- 2.*ph_t[idx]*k1_t[idx]*cos_phi_h[idx];
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		V_2[idx] = ph_0[idx]*X[idx]/M
+			- (ph_l[idx]*(X[idx]*S_x[idx] - 2.*sq(M)*Q_sq[idx]))/(M*lambda_Y_sqrt[idx])
+			- 2.*ph_t[idx]*k1_t[idx]*cos_phi_h[idx];
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		V_p[idx] = 0.5*(V_1[idx] + V_2[idx]);
+	}
+	// See `Kinematics` for why `V_m` is computed this way.
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		Real ph_ratio_sq = ph_t_sq[idx]/sq(ph_0[idx]) + sq(mh/ph_0[idx]);
+		Real lambda_Y_ratio = (4.*sq(M)*Q_sq[idx])/sq(S_x[idx]);
+		V_m[idx] = -(ph_0[idx]*S_x[idx])/(2.*M)*sqrt1p_1m(
+			lambda_Y_ratio - ph_ratio_sq*(1. + lambda_Y_ratio));
+	}
+
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		t[idx] = sq(mh) - Q_sq[idx] - 2.*V_m[idx];
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		W_sq[idx] = sq(M) + S_x[idx] - Q_sq[idx];
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		mx_sq[idx] = sq(M) + t[idx] + (1. - z[idx])*S_x[idx];
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		mx[idx] = std::sqrt(mx_sq[idx]);
+	}
+
+	// Paragraph below equation [1.14].
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		lambda_2[idx] = sq(V_m[idx]) + sq(mh)*Q_sq[idx];
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		lambda_3[idx] = V_m[idx] + z[idx]*Q_sq[idx];
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		lambda_2_sqrt[idx] = std::sqrt(lambda_2[idx]);
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		lambda_3_sqrt[idx] = std::sqrt(lambda_3[idx]);
+	}
+
+	// Equations [1.6] and [1.18].
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		vol_phi_h[idx] = -0.5*ph_t[idx]*lambda_1_sqrt[idx]*sin_phi_h[idx];
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		C_1[idx] = (4.*M*ph_l[idx]*(Q_sq[idx] + 2.*x[idx]*sq(M)))/sq(sq(Q_sq[idx]));
+	}
+}
+
+Kinematics KinematicsBatch::at(std::size_t idx) const {
+	Kinematics kin;
+	kin.target = target;
+	kin.beam = beam;
+	kin.hadron = hadron;
+	kin.S = S;
+	kin.M = M;
+	kin.m = m;
+	kin.mh = mh;
+	kin.Mth = Mth;
+	kin.lambda_S = lambda_S;
+	kin.lambda_S_sqrt = lambda_S_sqrt;
+	kin.x = x[idx];
+	kin.y = y[idx];
+	kin.z = z[idx];
+	kin.ph_t_sq = ph_t_sq[idx];
+	kin.phi_h = phi_h[idx];
+	kin.phi = phi[idx];
+	kin.Q_sq = Q_sq[idx];
+	kin.Q = Q[idx];
+	kin.t = t[idx];
+	kin.W_sq = W_sq[idx];
+	kin.X = X[idx];
+	kin.S_x = S_x[idx];
+	kin.S_p = S_p[idx];
+	kin.V_1 = V_1[idx];
+	kin.V_2 = V_2[idx];
+	kin.V_m = V_m[idx];
+	kin.V_p = V_p[idx];
+	kin.lambda_X = lambda_X[idx];
+	kin.lambda_Y = lambda_Y[idx];
+	kin.lambda_1 = lambda_1[idx];
+	kin.lambda_2 = lambda_2[idx];
+	kin.lambda_3 = lambda_3[idx];
+	kin.lambda_X_sqrt = lambda_X_sqrt[idx];
+	kin.lambda_Y_sqrt = lambda_Y_sqrt[idx];
+	kin.lambda_1_sqrt = lambda_1_sqrt[idx];
+	kin.lambda_2_sqrt = lambda_2_sqrt[idx];
+	kin.lambda_3_sqrt = lambda_3_sqrt[idx];
+	kin.mx_sq = mx_sq[idx];
+	kin.mx = mx[idx];
+	kin.vol_phi_h = vol_phi_h[idx];
+	kin.C_1 = C_1[idx];
+	kin.ph_0 = ph_0[idx];
+	kin.ph_t = ph_t[idx];
+	kin.ph_l = ph_l[idx];
+	kin.cos_phi_h = cos_phi_h[idx];
+	kin.sin_phi_h = sin_phi_h[idx];
+	kin.q_0 = q_0[idx];
+	kin.q_t = q_t[idx];
+	kin.q_l = q_l[idx];
+	kin.phi_q = phi_q[idx];
+	kin.cos_phi_q = cos_phi_q[idx];
+	kin.sin_phi_q = sin_phi_q[idx];
+	kin.k2_0 = k2_0[idx];
+	kin.k2_t = k2_t[idx];
+	kin.k2_l = k2_l[idx];
+	kin.k1_t = k1_t[idx];
+	kin.cos_phi = cos_phi[idx];
+	kin.sin_phi = sin_phi[idx];
+	return kin;
+}
+
+KinematicsRadBatch::KinematicsRadBatch(
+		Particles const& ps,
+		Real S,
+		std::vector<PhaseSpaceRad> const& ph_spaces) {
+	std::size_t n = ph_spaces.size();
+	std::vector<PhaseSpace> ph_spaces_proj;
+	ph_spaces_proj.reserve(n);
+	for (PhaseSpaceRad const& ph_space : ph_spaces) {
+		ph_spaces_proj.push_back(ph_space.project());
+	}
+	_kin = KinematicsBatch(ps, S, ph_spaces_proj);
+	KinematicsBatch const& k = _kin;
+	Real M = k.M;
+	Real m = k.m;
+	Real mh = k.mh;
+	Real lambda_S = k.lambda_S;
+	Real lambda_S_sqrt = k.lambda_S_sqrt;
+	tau.resize(n);
+	phi_k.resize(n);
+	R.resize(n);
+	tau_min.resize(n);
+	tau_max.resize(n);
+	mu.resize(n);
+	z_1.resize(n);
+	z_2.resize(n);
+	lambda_V.resize(n);
+	lambda_RV.resize(n);
+	lambda_RY.resize(n);
+	lambda_H.resize(n);
+	lambda_z.resize(n);
+	lambda_z_sqrt.resize(n);
+	k_0_bar.resize(n);
+	vol_phi_k_R.resize(n);
+	vol_phi_hk.resize(n);
+	F_22.resize(n);
+	F_21.resize(n);
+	F_2p.resize(n);
+	F_2m.resize(n);
+	F_d.resize(n);
+	F_1p.resize(n);
+	F_IR.resize(n);
+	k_0.resize(n);
+	k_t.resize(n);
+	k_l.resize(n);
+	cos_phi_k.resize(n);
+	sin_phi_k.resize(n);
+	shift_x.resize(n);
+	shift_y.resize(n);
+	shift_z.resize(n);
+	shift_ph_t_sq.resize(n);
+	shift_phi_h.resize(n);
+	shift_phi_q.resize(n);
+	shift_cos_phi_h.resize(n);
+	shift_sin_phi_h.resize(n);
+	shift_cos_phi_q.resize(n);
+	shift_sin_phi_q.resize(n);
+	shift_Q_sq.resize(n);
+	shift_Q.resize(n);
+	shift_t.resize(n);
+	shift_W_sq.resize(n);
+	shift_S_x.resize(n);
+	shift_V_m.resize(n);
+	shift_lambda_Y.resize(n);
+	shift_lambda_1.resize(n);
+	shift_lambda_2.resize(n);
+	shift_lambda_3.resize(n);
+	shift_lambda_Y_sqrt.resize(n);
+	shift_lambda_1_sqrt.resize(n);
+	shift_lambda_2_sqrt.resize(n);
+	shift_lambda_3_sqrt.resize(n);
+	shift_mx_sq.resize(n);
+	shift_mx.resize(n);
+	shift_vol_phi_h.resize(n);
+	shift_C_1.resize(n);
+	shift_ph_t.resize(n);
+	shift_ph_l.resize(n);
+	shift_q_0.resize(n);
+	shift_q_t.resize(n);
+	shift_q_l.resize(n);
+	shift_k1_t.resize(n);
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		tau[idx] = ph_spaces[idx].tau;
+		phi_k[idx] = ph_spaces[idx].phi_k;
+		R[idx] = ph_spaces[idx].R;
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		cos_phi_k[idx] = std::cos(phi_k[idx]);
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		sin_phi_k[idx] = std::sin(phi_k[idx]);
+	}
+
+	// Equation [1.44].
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		tau_min[idx] = (k.S_x[idx] - k.lambda_Y_sqrt[idx])/(2.*sq(M));
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		tau_max[idx] = (k.S_x[idx] + k.lambda_Y_sqrt[idx])/(2.*sq(M));
+	}
+
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		lambda_H[idx] = sq(k.z[idx]*k.S_x[idx]) - 4.*sq(M)*sq(mh);
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		lambda_V[idx] = k.z[idx]*sq(k.S_x[idx]) - 4.*sq(M)*k.V_m[idx];
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		lambda_RY[idx] = R[idx]*(k.S_x[idx] - 2.*sq(M)*tau[idx]);
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		Real cos_phi_hk = std::cos(k.phi_h[idx] - phi_k[idx]);
+		Real tau_root = std::sqrt((tau[idx] - tau_min[idx])*(tau_max[idx] - tau[idx]));
+		lambda_RV[idx] = (2.*M)/k.lambda_Y_sqrt[idx]*(
+			2.*sq(M)*R[idx]*k.ph_t[idx]*tau_root*cos_phi_hk
+			+ lambda_RY[idx]*k.ph_l[idx]);
+		// Equation [1.B3].
+		mu[idx] = k.ph_0[idx]/M
+			+ 1./k.lambda_Y_sqrt[idx]*(
+				(2.*tau[idx]*sq(M) - k.S_x[idx])*k.ph_l[idx]/M
+				- 2.*M*k.ph_t[idx]*cos_phi_hk*tau_root);
+	}
+
+	// Equation [1.B4].
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		lambda_z[idx] = (tau_max[idx] - tau[idx])*(tau[idx] - tau_min[idx])*k.lambda_1[idx];
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		lambda_z_sqrt[idx] = std::sqrt(lambda_z[idx]);
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		z_1[idx] = 1./k.lambda_Y[idx]*(
+			k.Q_sq[idx]*k.S_p[idx]
+			+ tau[idx]*(S*k.S_x[idx] + 2.*sq(M)*k.Q_sq[idx])
+			- 2.*M*lambda_z_sqrt[idx]*cos_phi_k[idx]);
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		z_2[idx] = 1./k.lambda_Y[idx]*(
+			k.Q_sq[idx]*k.S_p[idx]
+			+ tau[idx]*(k.X[idx]*k.S_x[idx] - 2.*sq(M)*k.Q_sq[idx])
+			- 2.*M*lambda_z_sqrt[idx]*cos_phi_k[idx]);
+	}
+
+	// Real photon 4-momentum components.
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		k_0[idx] = R[idx]/(2.*M);
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		k_t[idx] = (M*R[idx]*lambda_z_sqrt[idx])/(k.lambda_1_sqrt[idx]*k.lambda_Y_sqrt[idx]);
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		k_l[idx] = lambda_RY[idx]/(2.*M*k.lambda_Y_sqrt[idx]);
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		k_0_bar[idx] = ((1. + tau[idx] - mu[idx])*R[idx])/(2.*k.mx[idx]);
+	}
+
+	// Equation [1.B5].
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		F_22[idx] = 1./sq(z_2[idx]);
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		F_21[idx] = 1./sq(z_1[idx]);
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		F_2p[idx] = F_22[idx] + F_21[idx];
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		F_2m[idx] = F_22[idx] - F_21[idx];
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		F_d[idx] = 1./(z_1[idx]*z_2[idx]);
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		F_1p[idx] = 1./z_1[idx] + 1./z_2[idx];
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		F_IR[idx] = sq(m)*F_2p[idx] - (k.Q_sq[idx] + 2.*sq(m))*F_d[idx];
+	}
+
+	// Equations [1.30] and [1.A9].
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		vol_phi_k_R[idx] = -0.5*sin_phi_k[idx]*M*lambda_z_sqrt[idx]/k.lambda_Y_sqrt[idx];
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		vol_phi_hk[idx] = 1./(2.*k.lambda_1[idx])*(
+			R[idx]*k.vol_phi_h[idx]*(
+				z_1[idx]*k.lambda_Y[idx]
+				- k.Q_sq[idx]*k.S_p[idx]
+				- tau[idx]*(S*k.S_x[idx] + 2.*sq(M)*k.Q_sq[idx]))
+			+ R[idx]*vol_phi_k_R[idx]*(
+				k.S_x[idx]*(
+					k.z[idx]*k.Q_sq[idx]*k.S_p[idx]
+					- S*k.V_2[idx]
+					+ k.X[idx]*k.V_1[idx])
+				- 4.*k.V_p[idx]*sq(M)*k.Q_sq[idx]));
+	}
+
+	// Shifted kinematic variables.
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		shift_Q_sq[idx] = k.Q_sq[idx] + R[idx]*tau[idx];
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		shift_Q[idx] = std::sqrt(shift_Q_sq[idx]);
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		shift_S_x[idx] = k.S_x[idx] - R[idx];
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		shift_V_m[idx] = k.V_m[idx] + (lambda_RV[idx] - k.z[idx]*R[idx]*k.S_x[idx])/(4.*sq(M));
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		shift_x[idx] = shift_Q_sq[idx]/shift_S_x[idx];
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		shift_y[idx] = k.y[idx] - R[idx]/S;
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		shift_z[idx] = k.S_x[idx]/shift_S_x[idx]*k.z[idx];
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		shift_t[idx] = k.t[idx] - R[idx]*tau[idx]
+			+ (k.z[idx]*R[idx]*k.S_x[idx] - lambda_RV[idx])/(2.*sq(M));
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		shift_W_sq[idx] = k.W_sq[idx] - R[idx]*(1. + tau[idx]);
+	}
+
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		shift_lambda_Y[idx] = k.lambda_Y[idx] + sq(R[idx]) - 2.*lambda_RY[idx];
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		shift_lambda_1[idx] = k.lambda_1[idx] + 1./(4.*sq(M))*(
+			(sq(R[idx]) - 2.*lambda_RY[idx])*lambda_S
+			+ R[idx]*(S - 2.*sq(M)*z_1[idx])*(
+				2.*S*k.S_x[idx] + 4.*sq(M)*k.Q_sq[idx]
+				- R[idx]*(S - 2.*sq(M)*z_1[idx])));
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		shift_lambda_2[idx] = sq(shift_V_m[idx]) + sq(mh)*shift_Q_sq[idx];
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		shift_lambda_3[idx] = shift_V_m[idx] + shift_z[idx]*shift_Q_sq[idx];
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		shift_lambda_Y_sqrt[idx] = std::sqrt(shift_lambda_Y[idx]);
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		shift_lambda_1_sqrt[idx] = std::sqrt(shift_lambda_1[idx]);
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		shift_lambda_2_sqrt[idx] = std::sqrt(shift_lambda_2[idx]);
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		shift_lambda_3_sqrt[idx] = std::sqrt(shift_lambda_3[idx]);
+	}
+
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		shift_ph_t_sq[idx] = k.ph_t_sq[idx] + 1./(shift_lambda_Y[idx])*(
+			+ (sq(R[idx]) - 2.*lambda_RY[idx])*sq(k.ph_l[idx])
+			+ (k.lambda_Y_sqrt[idx]*lambda_RV[idx]*k.ph_l[idx])/M
+			- sq(lambda_RV[idx])/(4.*sq(M)));
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		shift_ph_t[idx] = std::sqrt(shift_ph_t_sq[idx]);
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		shift_ph_l[idx] = 1./shift_lambda_Y_sqrt[idx]*(
+			k.lambda_Y_sqrt[idx]*k.ph_l[idx] - lambda_RV[idx]/(2.*M));
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		shift_q_0[idx] = shift_S_x[idx]/(2.*M);
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		shift_q_t[idx] = shift_lambda_1_sqrt[idx]/lambda_S_sqrt;
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		shift_q_l[idx] = k.q_l[idx]
+			- R[idx]/(2.*M*lambda_S_sqrt)*(S - 2.*sq(M)*z_1[idx]);
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		shift_k1_t[idx] = shift_lambda_1_sqrt[idx]/shift_lambda_Y_sqrt[idx];
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		shift_mx_sq[idx] = k.mx_sq[idx] - R[idx]*(1. + tau[idx])
+			+ (k.z[idx]*R[idx]*k.S_x[idx] - lambda_RV[idx])/(2.*sq(M));
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		shift_mx[idx] = std::sqrt(shift_mx_sq[idx]);
+	}
+
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		shift_vol_phi_h[idx] = k.vol_phi_h[idx] + 1./(2.*k.lambda_1[idx])*(
+			R[idx]*k.vol_phi_h[idx]*(
+				tau[idx]*lambda_S
+				+ 2.*sq(m)*k.S_x[idx]
+				+ k.Q_sq[idx]*S
+				- z_1[idx]*(S*k.S_x[idx] + 2.*sq(M)*k.Q_sq[idx]))
+			+ R[idx]*vol_phi_k_R[idx]*(
+				2.*sq(m)*(4.*k.V_m[idx]*sq(M) - k.z[idx]*sq(k.S_x[idx]))
+				+ S*(S*k.V_2[idx] - k.X[idx]*k.V_1[idx] - k.z[idx]*k.Q_sq[idx]*k.S_x[idx])
+				+ 2.*k.V_1[idx]*sq(M)*k.Q_sq[idx]));
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		shift_C_1[idx] = (4.*M*shift_ph_l[idx]*(shift_Q_sq[idx] + 2.*shift_x[idx]*sq(M)))
+			/sq(sq(shift_Q_sq[idx]));
+	}
+
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		shift_sin_phi_h[idx] = -2.*shift_vol_phi_h[idx]
+			/(shift_ph_t[idx]*shift_q_t[idx]*lambda_S_sqrt);
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		shift_cos_phi_h[idx] = 1./(
+				4.*sq(M)*shift_ph_t[idx]*shift_q_t[idx]
+				*shift_lambda_Y_sqrt[idx]*lambda_S_sqrt)*(
+			shift_lambda_Y[idx]*(k.z[idx]*S*k.S_x[idx] - 2.*sq(M)*k.V_1[idx])
+			- (lambda_V[idx] - lambda_RV[idx])*(
+				S*shift_S_x[idx]
+				+ 2.*sq(M)*k.Q_sq[idx]
+				+ 2.*sq(M)*z_1[idx]*R[idx]));
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		shift_sin_phi_q[idx] = 1./shift_q_t[idx]*(
+			k.q_t[idx]*k.sin_phi_q[idx]
+			- (2.*M)/k.lambda_Y_sqrt[idx]*(
+				k_t[idx]*(
+					-k.q_l[idx]*k.sin_phi[idx]*cos_phi_k[idx]
+					+ k.lambda_Y_sqrt[idx]/(2.*M)*k.cos_phi[idx]*sin_phi_k[idx])
+				+ k_l[idx]*k.q_t[idx]*k.sin_phi[idx]));
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		shift_cos_phi_q[idx] = 1./shift_q_t[idx]*(
+			k.q_t[idx]*k.cos_phi_q[idx]
+			- (2.*M)/k.lambda_Y_sqrt[idx]*(
+				k_t[idx]*(
+					k.q_l[idx]*k.cos_phi[idx]*cos_phi_k[idx]
+					+ k.lambda_Y_sqrt[idx]/(2.*M)*k.sin_phi[idx]*sin_phi_k[idx])
+				- k_l[idx]*k.q_t[idx]*k.cos_phi[idx]));
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		shift_phi_h[idx] = std::atan2(shift_sin_phi_h[idx], shift_cos_phi_h[idx]);
+	}
+	for (std::size_t idx = 0; idx < n; ++idx) {
+		shift_phi_q[idx] = std::atan2(shift_sin_phi_q[idx], shift_cos_phi_q[idx]);
+	}
+}
+
+KinematicsRad KinematicsRadBatch::at(std::size_t idx) const {
+	KinematicsBatch const& k = _kin;
+	KinematicsRad kin;
+	kin.target = k.target;
+	kin.beam = k.beam;
+	kin.hadron = k.hadron;
+	kin.S = k.S;
+	kin.M = k.M;
+	kin.m = k.m;
+	kin.mh = k.mh;
+	kin.Mth = k.Mth;
+	kin.lambda_S = k.lambda_S;
+	kin.lambda_S_sqrt = k.lambda_S_sqrt;
+	kin.x = k.x[idx];
+	kin.y = k.y[idx];
+	kin.z = k.z[idx];
+	kin.ph_t_sq = k.ph_t_sq[idx];
+	kin.phi_h = k.phi_h[idx];
+	kin.phi = k.phi[idx];
+	kin.Q_sq = k.Q_sq[idx];
+	kin.Q = k.Q[idx];
+	kin.t = k.t[idx];
+	kin.W_sq = k.W_sq[idx];
+	kin.X = k.X[idx];
+	kin.S_x = k.S_x[idx];
+	kin.S_p = k.S_p[idx];
+	kin.V_1 = k.V_1[idx];
+	kin.V_2 = k.V_2[idx];
+	kin.V_m = k.V_m[idx];
+	kin.V_p = k.V_p[idx];
+	kin.lambda_X = k.lambda_X[idx];
+	kin.lambda_Y = k.lambda_Y[idx];
+	kin.lambda_1 = k.lambda_1[idx];
+	kin.lambda_2 = k.lambda_2[idx];
+	kin.lambda_3 = k.lambda_3[idx];
+	kin.lambda_X_sqrt = k.lambda_X_sqrt[idx];
+	kin.lambda_Y_sqrt = k.lambda_Y_sqrt[idx];
+	kin.lambda_1_sqrt = k.lambda_1_sqrt[idx];
+	kin.lambda_2_sqrt = k.lambda_2_sqrt[idx];
+	kin.lambda_3_sqrt = k.lambda_3_sqrt[idx];
+	kin.mx_sq = k.mx_sq[idx];
+	kin.mx = k.mx[idx];
+	kin.vol_phi_h = k.vol_phi_h[idx];
+	kin.C_1 = k.C_1[idx];
+	kin.ph_0 = k.ph_0[idx];
+	kin.ph_t = k.ph_t[idx];
+	kin.ph_l = k.ph_l[idx];
+	kin.cos_phi_h = k.cos_phi_h[idx];
+	kin.sin_phi_h = k.sin_phi_h[idx];
+	kin.q_0 = k.q_0[idx];
+	kin.q_t = k.q_t[idx];
+	kin.q_l = k.q_l[idx];
+	kin.phi_q = k.phi_q[idx];
+	kin.cos_phi_q = k.cos_phi_q[idx];
+	kin.sin_phi_q = k.sin_phi_q[idx];
+	kin.k2_0 = k.k2_0[idx];
+	kin.k2_t = k.k2_t[idx];
+	kin.k2_l = k.k2_l[idx];
+	kin.k1_t = k.k1_t[idx];
+	kin.cos_phi = k.cos_phi[idx];
+	kin.sin_phi = k.sin_phi[idx];
+	kin.tau = tau[idx];
+	kin.phi_k = phi_k[idx];
+	kin.R = R[idx];
+	kin.tau_min = tau_min[idx];
+	kin.tau_max = tau_max[idx];
+	kin.mu = mu[idx];
+	kin.z_1 = z_1[idx];
+	kin.z_2 = z_2[idx];
+	kin.lambda_V = lambda_V[idx];
+	kin.lambda_RV = lambda_RV[idx];
+	kin.lambda_RY = lambda_RY[idx];
+	kin.lambda_H = lambda_H[idx];
+	kin.lambda_z = lambda_z[idx];
+	kin.lambda_z_sqrt = lambda_z_sqrt[idx];
+	kin.k_0_bar = k_0_bar[idx];
+	kin.vol_phi_k_R = vol_phi_k_R[idx];
+	kin.vol_phi_hk = vol_phi_hk[idx];
+	kin.F_22 = F_22[idx];
+	kin.F_21 = F_21[idx];
+	kin.F_2p = F_2p[idx];
+	kin.F_2m = F_2m[idx];
+	kin.F_d = F_d[idx];
+	kin.F_1p = F_1p[idx];
+	kin.F_IR = F_IR[idx];
+	kin.k_0 = k_0[idx];
+	kin.k_t = k_t[idx];
+	kin.k_l = k_l[idx];
+	kin.cos_phi_k = cos_phi_k[idx];
+	kin.sin_phi_k = sin_phi_k[idx];
+	kin.shift_x = shift_x[idx];
+	kin.shift_y = shift_y[idx];
+	kin.shift_z = shift_z[idx];
+	kin.shift_ph_t_sq = shift_ph_t_sq[idx];
+	kin.shift_phi_h = shift_phi_h[idx];
+	kin.shift_phi_q = shift_phi_q[idx];
+	kin.shift_cos_phi_h = shift_cos_phi_h[idx];
+	kin.shift_sin_phi_h = shift_sin_phi_h[idx];
+	kin.shift_cos_phi_q = shift_cos_phi_q[idx];
+	kin.shift_sin_phi_q = shift_sin_phi_q[idx];
+	kin.shift_Q_sq = shift_Q_sq[idx];
+	kin.shift_Q = shift_Q[idx];
+	kin.shift_t = shift_t[idx];
+	kin.shift_W_sq = shift_W_sq[idx];
+	kin.shift_S_x = shift_S_x[idx];
+	kin.shift_V_m = shift_V_m[idx];
+	kin.shift_lambda_Y = shift_lambda_Y[idx];
+	kin.shift_lambda_1 = shift_lambda_1[idx];
+	kin.shift_lambda_2 = shift_lambda_2[idx];
+	kin.shift_lambda_3 = shift_lambda_3[idx];
+	kin.shift_lambda_Y_sqrt = shift_lambda_Y_sqrt[idx];
+	kin.shift_lambda_1_sqrt = shift_lambda_1_sqrt[idx];
+	kin.shift_lambda_2_sqrt = shift_lambda_2_sqrt[idx];
+	kin.shift_lambda_3_sqrt = shift_lambda_3_sqrt[idx];
+	kin.shift_mx_sq = shift_mx_sq[idx];
+	kin.shift_mx = shift_mx[idx];
+	kin.shift_vol_phi_h = shift_vol_phi_h[idx];
+	kin.shift_C_1 = shift_C_1[idx];
+	kin.shift_ph_t = shift_ph_t[idx];
+	kin.shift_ph_l = shift_ph_l[idx];
+	kin.shift_q_0 = shift_q_0[idx];
+	kin.shift_q_t = shift_q_t[idx];
+	kin.shift_q_l = shift_q_l[idx];
+	kin.shift_k1_t = shift_k1_t[idx];
+	return kin;
+}
+
 Final::Final(Initial const& init, Vec3 target_pol, Kinematics const& kin) {
 	beam = kin.beam;
 	hadron = kin.hadron;
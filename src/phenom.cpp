@@ -1,6 +1,8 @@
 #include "sidis/phenom.hpp"
 
+#include <array>
 #include <cmath>
+#include <stdexcept>
 
 #include "sidis/constant.hpp"
 #include "sidis/kinematics.hpp"
@@ -15,6 +17,8 @@ namespace {
 Real const Q_SQ_MAX = 100.;
 Real const NF = 1.;
 Real const BETA_0 = 4. / 3. * NF;
+// Values of Q^2 where the parameterization of `delta_vac_had` changes.
+std::array<Real, 2> const DELTA_VAC_HAD_BREAKS = {{ 1., 64. }};
 
 Real beta_qed(Real alpha) {
 	Real alpha_r = alpha / (4. * PI);
@@ -68,15 +72,19 @@ Real ph::alpha_qed(Real Q_sq) {
 }
 
 Real ph::delta_vac_had(Kinematics const& kin) {
+	return delta_vac_had(kin.Q_sq);
+}
+
+Real ph::delta_vac_had(Real Q_sq) {
 	// TODO: This vacuum hadron polarization calculation needs to be replaced
 	// with a better one.
 	Real alpha = 7.2973525664e-3L;
-	if (kin.Q_sq < 1.) {
-		return -(2.*PI)/alpha*(-1.345e-9L - 2.302e-3L*std::log(1. + 4.091L*kin.Q_sq));
-	} else if (kin.Q_sq < 64.) {
-		return -(2.*PI)/alpha*(-1.512e-3L - 2.822e-3L*std::log(1. + 1.218L*kin.Q_sq));
+	if (Q_sq < DELTA_VAC_HAD_BREAKS[0]) {
+		return -(2.*PI)/alpha*(-1.345e-9L - 2.302e-3L*std::log(1. + 4.091L*Q_sq));
+	} else if (Q_sq < DELTA_VAC_HAD_BREAKS[1]) {
+		return -(2.*PI)/alpha*(-1.512e-3L - 2.822e-3L*std::log(1. + 1.218L*Q_sq));
 	} else {
-		return -(2.*PI)/alpha*(-1.1344e-3L - 3.0680e-3L*std::log(1. + 0.99992L*kin.Q_sq));
+		return -(2.*PI)/alpha*(-1.1344e-3L - 3.0680e-3L*std::log(1. + 0.99992L*Q_sq));
 	}
 }
 
@@ -90,3 +98,37 @@ Phenom::Phenom(Real alpha_qed, Real delta_vac_had) :
 	alpha_qed(alpha_qed),
 	delta_vac_had(delta_vac_had) { }
 
+PhenomTable::PhenomTable(Real Q_sq_min, Real Q_sq_max) :
+		_ln_Q_sq_min(std::log(Q_sq_min)),
+		_ln_Q_sq_step((std::log(Q_sq_max) - std::log(Q_sq_min)) / CELLS) {
+	if (!(Q_sq_min > 0.) || !(Q_sq_max > Q_sq_min)) {
+		throw std::invalid_argument("Invalid Q^2 range for phenomenological table.");
+	}
+	for (std::size_t idx = 0; idx <= CELLS; ++idx) {
+		Real Q_sq = std::exp(_ln_Q_sq_min + idx * _ln_Q_sq_step);
+		_alpha_qed[idx] = ph::alpha_qed(Q_sq);
+		_delta_vac_had[idx] = ph::delta_vac_had(Q_sq);
+	}
+	for (std::size_t idx = 0; idx < _break_cells.size(); ++idx) {
+		Real cell = (std::log(DELTA_VAC_HAD_BREAKS[idx]) - _ln_Q_sq_min) / _ln_Q_sq_step;
+		_break_cells[idx] = cell >= 0. && cell < CELLS ?
+			static_cast<std::size_t>(cell) :
+			CELLS;
+	}
+}
+
+Phenom PhenomTable::operator()(Real Q_sq) const {
+	Real t = (std::log(Q_sq) - _ln_Q_sq_min) / _ln_Q_sq_step;
+	// Written so that NaN also falls back to the direct computation.
+	if (!(t >= 0. && t < CELLS)) {
+		return Phenom(ph::alpha_qed(Q_sq), ph::delta_vac_had(Q_sq));
+	}
+	std::size_t cell = static_cast<std::size_t>(t);
+	if (cell == _break_cells[0] || cell == _break_cells[1]) {
+		return Phenom(ph::alpha_qed(Q_sq), ph::delta_vac_had(Q_sq));
+	}
+	Real frac = t - cell;
+	return Phenom(
+		(1. - frac) * _alpha_qed[cell] + frac * _alpha_qed[cell + 1],
+		(1. - frac) * _delta_vac_had[cell] + frac * _delta_vac_had[cell + 1]);
+}
@@ -1,11 +1,14 @@
 #include <catch2/catch.hpp>
 
+#include <cmath>
 #include <fstream>
 #include <istream>
 #include <limits>
 #include <memory>
 #include <sstream>
+#include <stdexcept>
 #include <utility>
+#include <vector>
 
 #include <sidis/sidis.hpp>
 #include <sidis/sf_set/mask.hpp>
@@ -219,6 +222,10 @@ TEST_CASE(
 	Real born = xs::born(kin, phenom, *sf, beam_pol, eta);
 	Real amm = xs::amm(kin, phenom, *sf, beam_pol, eta);
 	Real nrad = xs::nrad_ir(kin, phenom, *sf, beam_pol, eta, input.k0_cut);
+	// Also compute them from structure functions that were evaluated already.
+	sf::SfLP sf_lp = sf->sf_lp(kin.hadron, kin.x, kin.z, kin.Q_sq, kin.ph_t_sq);
+	Real born_lp = xs::born(kin, phenom, sf_lp, beam_pol, eta);
+	Real nrad_lp = xs::nrad_ir(kin, phenom, sf_lp, beam_pol, eta, input.k0_cut);
 
 	// Print state information.
 	std::stringstream ss;
@@ -248,6 +255,12 @@ TEST_CASE(
 	CHECK_THAT(
 		nrad,
 		RelMatcher<Real>(output.nrad, 10.*output.err_nrad));
+	CHECK_THAT(
+		born_lp,
+		RelMatcher<Real>(output.born, 10.*output.err_born));
+	CHECK_THAT(
+		nrad_lp,
+		RelMatcher<Real>(output.nrad, 10.*output.err_nrad));
 }
 
 TEST_CASE(
@@ -321,3 +334,252 @@ TEST_CASE(
 		RelMatcher<Real>(output.rad, 10.*output.err_rad));
 }
 
+
+TEST_CASE(
+		"Batched cross-sections",
+		"[xs]") {
+	// Every polarization case should give the same results as going through
+	// the points one at a time.
+	unsigned pol_mask = GENERATE(range(0u, 16u));
+	Real beam_pol = (pol_mask & 8u) ? 0.8 : 0.;
+	math::Vec3 eta(
+		(pol_mask & 4u) ? 0.3 : 0.,
+		(pol_mask & 2u) ? -0.5 : 0.,
+		(pol_mask & 1u) ? 0.6 : 0.);
+	sf::set::TestSfSet sf(part::Nucleus::P);
+	Real Mth = MASS_P + MASS_PI_0;
+	part::Particles ps(part::Nucleus::P, part::Lepton::E, part::Hadron::PI_P, Mth);
+	Real S = 2.*MASS_P*10.6;
+	// More points than fit in one chunk of the contraction.
+	std::vector<kin::PhaseSpace> ph_spaces;
+	for (unsigned idx = 0; idx < 150; ++idx) {
+		Real t = (idx + 0.5)/150.;
+		ph_spaces.push_back({
+			0.15 + 0.35*t,
+			0.3 + 0.4*std::fmod(7.*t, 1.),
+			0.25 + 0.45*std::fmod(3.*t, 1.),
+			0.02 + 0.38*std::fmod(11.*t, 1.),
+			-3. + 6.*std::fmod(5.*t, 1.),
+			-3. + 6.*std::fmod(13.*t, 1.),
+		});
+	}
+	kin::KinematicsBatch kin_batch(ps, S, ph_spaces);
+	REQUIRE(kin_batch.size() == ph_spaces.size());
+
+	// Radiative points are only taken where the non-radiative point is valid.
+	std::vector<kin::PhaseSpaceRad> ph_spaces_rad;
+	for (kin::PhaseSpace const& ph_space : ph_spaces) {
+		kin::Kinematics kin(ps, S, ph_space);
+		if (!cut::valid(kin)) {
+			continue;
+		}
+		Real t = ph_space.x;
+		Real tau = cut::tau_bound(kin).lerp(std::fmod(17.*t, 1.));
+		Real phi_k = -3. + 6.*std::fmod(19.*t, 1.);
+		Real R = cut::R_bound(kin, tau, phi_k).lerp(std::fmod(23.*t, 1.));
+		ph_spaces_rad.push_back({
+			ph_space.x, ph_space.y, ph_space.z,
+			ph_space.ph_t_sq, ph_space.phi_h, ph_space.phi,
+			tau, phi_k, R,
+		});
+	}
+	kin::KinematicsRadBatch kin_rad_batch(ps, S, ph_spaces_rad);
+	REQUIRE(kin_rad_batch.size() == ph_spaces_rad.size());
+
+	xs::BatchBuffer buf;
+	std::vector<Real> born(kin_batch.size());
+	std::vector<Real> nrad(kin_batch.size());
+	std::vector<Real> rad(kin_rad_batch.size());
+	xs::born_batch(kin_batch, sf, beam_pol, eta, buf, born.data());
+	xs::nrad_ir_batch(kin_batch, sf, beam_pol, eta, buf, nrad.data(), 0.01);
+	xs::rad_batch(kin_rad_batch, sf, beam_pol, eta, rad.data());
+	for (std::size_t idx = 0; idx < kin_batch.size(); ++idx) {
+		kin::Kinematics kin(ps, S, ph_spaces[idx]);
+		if (!cut::valid(kin)) {
+			continue;
+		}
+		INFO("pol_mask = " << pol_mask << ", idx = " << idx);
+		CHECK_THAT(
+			born[idx],
+			RelMatcher<Real>(xs::born(kin, sf, beam_pol, eta), 1e-12));
+		CHECK_THAT(
+			nrad[idx],
+			RelMatcher<Real>(xs::nrad_ir(kin, sf, beam_pol, eta, 0.01), 1e-12));
+	}
+	for (std::size_t idx = 0; idx < kin_rad_batch.size(); ++idx) {
+		kin::KinematicsRad kin_rad(ps, S, ph_spaces_rad[idx]);
+		INFO("pol_mask = " << pol_mask << ", idx = " << idx);
+		CHECK_THAT(
+			rad[idx],
+			RelMatcher<Real>(xs::rad(kin_rad, sf, beam_pol, eta), 1e-12));
+	}
+}
+
+TEST_CASE(
+		"Cross-section evaluators",
+		"[xs]") {
+	// The evaluators should give the same results as the general cross-section
+	// functions, for every combination of beam and target polarization.
+	unsigned pol_idx = GENERATE(range(0u, 6u));
+	Real beam_pol = (pol_idx & 1u) ? 0.8 : 0.;
+	math::Vec3 target_pol = math::VEC3_ZERO;
+	if (pol_idx / 2u == 1u) {
+		target_pol = math::Vec3(0., 0., 0.7);
+	} else if (pol_idx / 2u == 2u) {
+		target_pol = math::Vec3(0.3, -0.5, 0.6);
+	}
+	sf::set::TestSfSet sf(part::Nucleus::P);
+	Real Mth = MASS_P + MASS_PI_0;
+	part::Particles ps(part::Nucleus::P, part::Lepton::E, part::Hadron::PI_P, Mth);
+	Real S = 2.*MASS_P*10.6;
+	xs::Evaluator born(xs::Kind::BORN, beam_pol, target_pol);
+	xs::Evaluator amm(xs::Kind::AMM, beam_pol, target_pol);
+	xs::Evaluator nrad_ir(xs::Kind::NRAD_IR, beam_pol, target_pol, 0.01);
+	xs::Evaluator rad(xs::Kind::RAD, beam_pol, target_pol);
+	xs::Evaluator rad_f(xs::Kind::RAD_F, beam_pol, target_pol);
+	std::vector<kin::PhaseSpace> ph_spaces {
+		{ 0.2, 0.5, 0.4, 0.1, 0.3, -1.2 },
+		{ 0.35, 0.3, 0.6, 0.4, 2.1, 0.7 },
+		{ 0.15, 0.7, 0.25, 0.02, -2.6, 2.9 },
+	};
+	for (kin::PhaseSpace ph_space : ph_spaces) {
+		kin::Kinematics kin(ps, S, ph_space);
+		Real tau = cut::tau_bound(kin).lerp(0.3);
+		Real phi_k = 0.8;
+		Real R = cut::R_bound(kin, tau, phi_k).lerp(0.4);
+		kin::KinematicsRad kin_rad(kin, tau, phi_k, R);
+		math::Vec3 eta = frame::hadron_from_target(kin) * target_pol;
+		sf::SfLP sf_lp = sf.sf_lp(kin.hadron, kin.x, kin.z, kin.Q_sq, kin.ph_t_sq);
+		INFO("pol_idx = " << pol_idx << ", x = " << ph_space.x);
+		CHECK_THAT(
+			born.eval(kin, sf),
+			RelMatcher<Real>(xs::born(kin, sf, beam_pol, eta), 1e-12));
+		CHECK_THAT(
+			born.eval(kin, sf_lp),
+			RelMatcher<Real>(xs::born(kin, sf_lp, beam_pol, eta), 1e-12));
+		CHECK_THAT(
+			amm.eval(kin, sf),
+			RelMatcher<Real>(xs::amm(kin, sf, beam_pol, eta), 1e-12));
+		CHECK_THAT(
+			nrad_ir.eval(kin, sf),
+			RelMatcher<Real>(xs::nrad_ir(kin, sf, beam_pol, eta, 0.01), 1e-12));
+		CHECK_THAT(
+			nrad_ir.eval(kin, sf_lp),
+			RelMatcher<Real>(xs::nrad_ir(kin, sf_lp, beam_pol, eta, 0.01), 1e-12));
+		CHECK_THAT(
+			rad.eval(kin_rad, sf),
+			RelMatcher<Real>(xs::rad(kin_rad, sf, beam_pol, eta), 1e-12));
+		CHECK_THAT(
+			rad_f.eval(kin_rad, sf),
+			RelMatcher<Real>(xs::rad_f(kin_rad, sf, beam_pol, eta), 1e-12));
+		CHECK_THROWS_AS(born.eval(kin_rad, sf), std::invalid_argument);
+		CHECK_THROWS_AS(rad.eval(kin, sf), std::invalid_argument);
+		CHECK_THROWS_AS(rad.eval(kin, sf_lp), std::invalid_argument);
+	}
+}
+
+TEST_CASE(
+		"Phenomenological input tables",
+		"[xs]") {
+	// The table should agree with the direct computation everywhere, including
+	// near the changes in the hadron vacuum polarization parameterization, and
+	// outside of the range of the table.
+	ph::PhenomTable table(1e-4, 50.);
+	for (Real Q_sq : { 1e-5, 1e-4, 0.013, 0.5, 0.9999, 1., 1.0001, 3.7, 63.99, 64.1, 200. }) {
+		ph::Phenom phenom = table(Q_sq);
+		INFO("Q_sq = " << Q_sq);
+		CHECK_THAT(
+			phenom.alpha_qed,
+			RelMatcher<Real>(ph::alpha_qed(Q_sq), 1e-5));
+		CHECK_THAT(
+			phenom.delta_vac_had,
+			RelMatcher<Real>(ph::delta_vac_had(Q_sq), 1e-5));
+	}
+}
+
+TEST_CASE(
+		"Cross-section contexts",
+		"[xs]") {
+	// Going through a context should be the same as computing the polarization
+	// in the hadron frame by hand, up to the accuracy of the phenomenological
+	// input table.
+	Real beam_pol = GENERATE(0., 0.8);
+	math::Vec3 target_pol = GENERATE(math::VEC3_ZERO, math::Vec3(0.3, -0.5, 0.6));
+	sf::set::TestSfSet sf(part::Nucleus::P);
+	Real Mth = MASS_P + MASS_PI_0;
+	part::Particles ps(part::Nucleus::P, part::Lepton::E, part::Hadron::PI_P, Mth);
+	Real S = 2.*MASS_P*10.6;
+	xs::Context ctx(ps, S, sf, beam_pol, target_pol);
+	xs::Evaluator born_eval(xs::Kind::BORN, ctx);
+	xs::Evaluator rad_eval(xs::Kind::RAD, ctx);
+	std::vector<kin::PhaseSpace> ph_spaces {
+		{ 0.2, 0.5, 0.4, 0.1, 0.3, -1.2 },
+		{ 0.35, 0.3, 0.6, 0.4, 2.1, 0.7 },
+		{ 0.15, 0.7, 0.25, 0.02, -2.6, 2.9 },
+	};
+	for (kin::PhaseSpace ph_space : ph_spaces) {
+		kin::Kinematics kin(ps, S, ph_space);
+		Real tau = cut::tau_bound(kin).lerp(0.3);
+		Real phi_k = 0.8;
+		Real R = cut::R_bound(kin, tau, phi_k).lerp(0.4);
+		kin::KinematicsRad kin_rad(kin, tau, phi_k, R);
+		math::Vec3 eta = frame::hadron_from_target(kin) * target_pol;
+		sf::SfLP sf_lp = sf.sf_lp(kin.hadron, kin.x, kin.z, kin.Q_sq, kin.ph_t_sq);
+		INFO("x = " << ph_space.x);
+		CHECK_THAT(
+			xs::born(kin, ctx),
+			RelMatcher<Real>(xs::born(kin, sf, beam_pol, eta), 1e-5));
+		CHECK_THAT(
+			xs::born(kin, ctx, sf_lp),
+			RelMatcher<Real>(xs::born(kin, sf_lp, beam_pol, eta), 1e-5));
+		CHECK_THAT(
+			xs::amm(kin, ctx),
+			RelMatcher<Real>(xs::amm(kin, sf, beam_pol, eta), 1e-5));
+		CHECK_THAT(
+			xs::nrad_ir(kin, ctx, 0.01),
+			RelMatcher<Real>(xs::nrad_ir(kin, sf, beam_pol, eta, 0.01), 1e-5));
+		CHECK_THAT(
+			xs::nrad_ir(kin, ctx, sf_lp, 0.01),
+			RelMatcher<Real>(xs::nrad_ir(kin, sf_lp, beam_pol, eta, 0.01), 1e-5));
+		CHECK_THAT(
+			xs::rad(kin_rad, ctx),
+			RelMatcher<Real>(xs::rad(kin_rad, sf, beam_pol, eta), 1e-5));
+		CHECK_THAT(
+			xs::rad_f(kin_rad, ctx),
+			RelMatcher<Real>(xs::rad_f(kin_rad, sf, beam_pol, eta), 1e-5));
+		CHECK_THAT(
+			born_eval.eval(kin, ctx),
+			RelMatcher<Real>(xs::born(kin, ctx), 1e-12));
+		CHECK_THAT(
+			rad_eval.eval(kin_rad, ctx),
+			RelMatcher<Real>(xs::rad(kin_rad, ctx), 1e-12));
+	}
+
+	// The batched versions use the same table, so they agree with the context
+	// versions up to rounding, but only without target polarization.
+	kin::KinematicsBatch kin_batch(ps, S, ph_spaces);
+	xs::BatchBuffer buf;
+	std::vector<Real> born(kin_batch.size());
+	std::vector<Real> nrad(kin_batch.size());
+	if (target_pol != math::VEC3_ZERO) {
+		CHECK_THROWS_AS(
+			xs::born_batch(kin_batch, ctx, buf, born.data()),
+			std::invalid_argument);
+		CHECK_THROWS_AS(
+			xs::nrad_ir_batch(kin_batch, ctx, buf, nrad.data(), 0.01),
+			std::invalid_argument);
+		return;
+	}
+	xs::born_batch(kin_batch, ctx, buf, born.data());
+	xs::nrad_ir_batch(kin_batch, ctx, buf, nrad.data(), 0.01);
+	for (std::size_t idx = 0; idx < kin_batch.size(); ++idx) {
+		kin::Kinematics kin(ps, S, ph_spaces[idx]);
+		INFO("x = " << ph_spaces[idx].x);
+		CHECK_THAT(
+			born[idx],
+			RelMatcher<Real>(xs::born(kin, ctx), 1e-12));
+		CHECK_THAT(
+			nrad[idx],
+			RelMatcher<Real>(xs::nrad_ir(kin, ctx, 0.01), 1e-12));
+	}
+}
@@ -5,6 +5,7 @@
 #include <limits>
 #include <sstream>
 #include <utility>
+#include <vector>
 
 #include <sidis/constant.hpp>
 #include <sidis/frame.hpp>
@@ -1033,3 +1034,202 @@ TEST_CASE(
 	CHECK_THAT(target_from_shift.z.z, RelMatcher<Real>(target_from_hadron.z.z, prec));
 }
 
+
+TEST_CASE(
+		"Batched kinematics checks",
+		"[kin]") {
+	// The batched kinematics should agree with the kinematics computed one
+	// point at a time.
+	Real E_b = GENERATE(5.5, 10.6, 160.);
+	Real Mth = MASS_P + MASS_PI_0;
+	part::Particles ps(part::Nucleus::P, part::Lepton::E, part::Hadron::PI_P, Mth);
+	Real S = 2.*ps.M*E_b;
+	std::size_t const num_points = 67;
+	PhaseSpaceGenerator gen(ps, S);
+	std::vector<kin::PhaseSpace> ph_spaces;
+	for (std::size_t idx = 0; idx < num_points; ++idx) {
+		ph_spaces.push_back(gen.get());
+		gen.next();
+	}
+	kin::KinematicsBatch batch(ps, S, ph_spaces);
+	REQUIRE(batch.size() == num_points);
+
+	Real prec = 1e2 * std::numeric_limits<Real>::epsilon();
+	for (std::size_t idx = 0; idx < num_points; ++idx) {
+		kin::Kinematics kin(ps, S, ph_spaces[idx]);
+		kin::Kinematics kin_batch = batch.at(idx);
+		INFO("E_b = " << E_b << ", idx = " << idx);
+		CHECK(kin_batch.target == kin.target);
+		CHECK(kin_batch.beam == kin.beam);
+		CHECK(kin_batch.hadron == kin.hadron);
+#define SIDIS_TEST_CHECK_FIELD(name) \
+		CHECK_THAT(kin_batch.name, RelMatcher<Real>(kin.name, prec))
+		SIDIS_TEST_CHECK_FIELD(S);
+		SIDIS_TEST_CHECK_FIELD(M);
+		SIDIS_TEST_CHECK_FIELD(m);
+		SIDIS_TEST_CHECK_FIELD(mh);
+		SIDIS_TEST_CHECK_FIELD(Mth);
+		SIDIS_TEST_CHECK_FIELD(lambda_S);
+		SIDIS_TEST_CHECK_FIELD(lambda_S_sqrt);
+		SIDIS_TEST_CHECK_FIELD(x);
+		SIDIS_TEST_CHECK_FIELD(y);
+		SIDIS_TEST_CHECK_FIELD(z);
+		SIDIS_TEST_CHECK_FIELD(ph_t_sq);
+		SIDIS_TEST_CHECK_FIELD(phi_h);
+		SIDIS_TEST_CHECK_FIELD(phi);
+		SIDIS_TEST_CHECK_FIELD(Q_sq);
+		SIDIS_TEST_CHECK_FIELD(Q);
+		SIDIS_TEST_CHECK_FIELD(t);
+		SIDIS_TEST_CHECK_FIELD(W_sq);
+		SIDIS_TEST_CHECK_FIELD(X);
+		SIDIS_TEST_CHECK_FIELD(S_x);
+		SIDIS_TEST_CHECK_FIELD(S_p);
+		SIDIS_TEST_CHECK_FIELD(V_1);
+		SIDIS_TEST_CHECK_FIELD(V_2);
+		SIDIS_TEST_CHECK_FIELD(V_m);
+		SIDIS_TEST_CHECK_FIELD(V_p);
+		SIDIS_TEST_CHECK_FIELD(lambda_X);
+		SIDIS_TEST_CHECK_FIELD(lambda_Y);
+		SIDIS_TEST_CHECK_FIELD(lambda_1);
+		SIDIS_TEST_CHECK_FIELD(lambda_2);
+		SIDIS_TEST_CHECK_FIELD(lambda_3);
+		SIDIS_TEST_CHECK_FIELD(lambda_X_sqrt);
+		SIDIS_TEST_CHECK_FIELD(lambda_Y_sqrt);
+		SIDIS_TEST_CHECK_FIELD(lambda_1_sqrt);
+		SIDIS_TEST_CHECK_FIELD(lambda_2_sqrt);
+		SIDIS_TEST_CHECK_FIELD(lambda_3_sqrt);
+		SIDIS_TEST_CHECK_FIELD(mx_sq);
+		SIDIS_TEST_CHECK_FIELD(mx);
+		SIDIS_TEST_CHECK_FIELD(vol_phi_h);
+		SIDIS_TEST_CHECK_FIELD(C_1);
+		SIDIS_TEST_CHECK_FIELD(ph_0);
+		SIDIS_TEST_CHECK_FIELD(ph_t);
+		SIDIS_TEST_CHECK_FIELD(ph_l);
+		SIDIS_TEST_CHECK_FIELD(cos_phi_h);
+		SIDIS_TEST_CHECK_FIELD(sin_phi_h);
+		SIDIS_TEST_CHECK_FIELD(q_0);
+		SIDIS_TEST_CHECK_FIELD(q_t);
+		SIDIS_TEST_CHECK_FIELD(q_l);
+		SIDIS_TEST_CHECK_FIELD(phi_q);
+		SIDIS_TEST_CHECK_FIELD(cos_phi_q);
+		SIDIS_TEST_CHECK_FIELD(sin_phi_q);
+		SIDIS_TEST_CHECK_FIELD(k2_0);
+		SIDIS_TEST_CHECK_FIELD(k2_t);
+		SIDIS_TEST_CHECK_FIELD(k2_l);
+		SIDIS_TEST_CHECK_FIELD(k1_t);
+		SIDIS_TEST_CHECK_FIELD(cos_phi);
+		SIDIS_TEST_CHECK_FIELD(sin_phi);
+#undef SIDIS_TEST_CHECK_FIELD
+	}
+}
+
+TEST_CASE(
+		"Batched radiative kinematics checks",
+		"[kin]") {
+	// The batched radiative kinematics should agree with the kinematics
+	// computed one point at a time, both before and after projecting out the
+	// photon.
+	Real E_b = GENERATE(5.5, 10.6, 160.);
+	Real Mth = MASS_P + MASS_PI_0;
+	part::Particles ps(part::Nucleus::P, part::Lepton::E, part::Hadron::PI_P, Mth);
+	Real S = 2.*ps.M*E_b;
+	std::size_t const num_points = 67;
+	PhaseSpaceRadGenerator gen(ps, S);
+	std::vector<kin::PhaseSpaceRad> ph_spaces;
+	for (std::size_t idx = 0; idx < num_points; ++idx) {
+		ph_spaces.push_back(gen.get());
+		gen.next();
+	}
+	kin::KinematicsRadBatch batch(ps, S, ph_spaces);
+	REQUIRE(batch.size() == num_points);
+	REQUIRE(batch.project().size() == num_points);
+
+	Real prec = 1e2 * std::numeric_limits<Real>::epsilon();
+	for (std::size_t idx = 0; idx < num_points; ++idx) {
+		kin::KinematicsRad kin(ps, S, ph_spaces[idx]);
+		kin::KinematicsRad kin_batch = batch.at(idx);
+		kin::Kinematics kin_nrad = kin.project();
+		kin::Kinematics kin_nrad_batch = batch.project().at(idx);
+		INFO("E_b = " << E_b << ", idx = " << idx);
+#define SIDIS_TEST_CHECK_FIELD(name) \
+		CHECK_THAT(kin_nrad_batch.name, RelMatcher<Real>(kin_nrad.name, prec))
+		SIDIS_TEST_CHECK_FIELD(S);
+		SIDIS_TEST_CHECK_FIELD(x);
+		SIDIS_TEST_CHECK_FIELD(y);
+		SIDIS_TEST_CHECK_FIELD(z);
+		SIDIS_TEST_CHECK_FIELD(ph_t_sq);
+		SIDIS_TEST_CHECK_FIELD(phi_h);
+		SIDIS_TEST_CHECK_FIELD(phi);
+		SIDIS_TEST_CHECK_FIELD(Q_sq);
+		SIDIS_TEST_CHECK_FIELD(W_sq);
+		SIDIS_TEST_CHECK_FIELD(mx_sq);
+		SIDIS_TEST_CHECK_FIELD(vol_phi_h);
+#undef SIDIS_TEST_CHECK_FIELD
+#define SIDIS_TEST_CHECK_FIELD(name) \
+		CHECK_THAT(kin_batch.name, RelMatcher<Real>(kin.name, prec))
+		SIDIS_TEST_CHECK_FIELD(tau);
+		SIDIS_TEST_CHECK_FIELD(phi_k);
+		SIDIS_TEST_CHECK_FIELD(R);
+		SIDIS_TEST_CHECK_FIELD(tau_min);
+		SIDIS_TEST_CHECK_FIELD(tau_max);
+		SIDIS_TEST_CHECK_FIELD(mu);
+		SIDIS_TEST_CHECK_FIELD(z_1);
+		SIDIS_TEST_CHECK_FIELD(z_2);
+		SIDIS_TEST_CHECK_FIELD(lambda_V);
+		SIDIS_TEST_CHECK_FIELD(lambda_RV);
+		SIDIS_TEST_CHECK_FIELD(lambda_RY);
+		SIDIS_TEST_CHECK_FIELD(lambda_H);
+		SIDIS_TEST_CHECK_FIELD(lambda_z);
+		SIDIS_TEST_CHECK_FIELD(lambda_z_sqrt);
+		SIDIS_TEST_CHECK_FIELD(k_0_bar);
+		SIDIS_TEST_CHECK_FIELD(vol_phi_k_R);
+		SIDIS_TEST_CHECK_FIELD(vol_phi_hk);
+		SIDIS_TEST_CHECK_FIELD(F_22);
+		SIDIS_TEST_CHECK_FIELD(F_21);
+		SIDIS_TEST_CHECK_FIELD(F_2p);
+		SIDIS_TEST_CHECK_FIELD(F_2m);
+		SIDIS_TEST_CHECK_FIELD(F_d);
+		SIDIS_TEST_CHECK_FIELD(F_1p);
+		SIDIS_TEST_CHECK_FIELD(F_IR);
+		SIDIS_TEST_CHECK_FIELD(k_0);
+		SIDIS_TEST_CHECK_FIELD(k_t);
+		SIDIS_TEST_CHECK_FIELD(k_l);
+		SIDIS_TEST_CHECK_FIELD(cos_phi_k);
+		SIDIS_TEST_CHECK_FIELD(sin_phi_k);
+		SIDIS_TEST_CHECK_FIELD(shift_x);
+		SIDIS_TEST_CHECK_FIELD(shift_y);
+		SIDIS_TEST_CHECK_FIELD(shift_z);
+		SIDIS_TEST_CHECK_FIELD(shift_ph_t_sq);
+		SIDIS_TEST_CHECK_FIELD(shift_phi_h);
+		SIDIS_TEST_CHECK_FIELD(shift_phi_q);
+		SIDIS_TEST_CHECK_FIELD(shift_cos_phi_h);
+		SIDIS_TEST_CHECK_FIELD(shift_sin_phi_h);
+		SIDIS_TEST_CHECK_FIELD(shift_cos_phi_q);
+		SIDIS_TEST_CHECK_FIELD(shift_sin_phi_q);
+		SIDIS_TEST_CHECK_FIELD(shift_Q_sq);
+		SIDIS_TEST_CHECK_FIELD(shift_Q);
+		SIDIS_TEST_CHECK_FIELD(shift_t);
+		SIDIS_TEST_CHECK_FIELD(shift_W_sq);
+		SIDIS_TEST_CHECK_FIELD(shift_S_x);
+		SIDIS_TEST_CHECK_FIELD(shift_V_m);
+		SIDIS_TEST_CHECK_FIELD(shift_lambda_Y);
+		SIDIS_TEST_CHECK_FIELD(shift_lambda_1);
+		SIDIS_TEST_CHECK_FIELD(shift_lambda_2);
+		SIDIS_TEST_CHECK_FIELD(shift_lambda_3);
+		SIDIS_TEST_CHECK_FIELD(shift_lambda_Y_sqrt);
+		SIDIS_TEST_CHECK_FIELD(shift_lambda_1_sqrt);
+		SIDIS_TEST_CHECK_FIELD(shift_lambda_2_sqrt);
+		SIDIS_TEST_CHECK_FIELD(shift_lambda_3_sqrt);
+		SIDIS_TEST_CHECK_FIELD(shift_mx_sq);
+		SIDIS_TEST_CHECK_FIELD(shift_mx);
+		SIDIS_TEST_CHECK_FIELD(shift_vol_phi_h);
+		SIDIS_TEST_CHECK_FIELD(shift_C_1);
+		SIDIS_TEST_CHECK_FIELD(shift_ph_t);
+		SIDIS_TEST_CHECK_FIELD(shift_ph_l);
+		SIDIS_TEST_CHECK_FIELD(shift_q_0);
+		SIDIS_TEST_CHECK_FIELD(shift_q_t);
+		SIDIS_TEST_CHECK_FIELD(shift_q_l);
+		SIDIS_TEST_CHECK_FIELD(shift_k1_t);
+#undef SIDIS_TEST_CHECK_FIELD
+	}
+}